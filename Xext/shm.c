@@ -1340,33 +1340,27 @@ ProcShmCreateSegment(ClientPtr client)
 }
 #endif /* SHM_FD_PASSING */
 
+static int (*ProcShmVector[]) (ClientPtr) = {
+    [X_ShmQueryVersion] = ProcShmQueryVersion,
+    [X_ShmAttach] = ProcShmAttach,
+    [X_ShmDetach] = ProcShmDetach,
+    [X_ShmPutImage] = ProcShmPutImage,
+    [X_ShmGetImage] = ProcShmGetImage,
+    [X_ShmCreatePixmap] = ProcShmCreatePixmap,
+#ifdef SHM_FD_PASSING
+    [X_ShmAttachFd] = ProcShmAttachFd,
+    [X_ShmCreateSegment] = ProcShmCreateSegment,
+#endif
+};
+
 static int
 ProcShmDispatch(ClientPtr client)
 {
     REQUEST(xReq);
 
-    switch (stuff->data) {
-    case X_ShmQueryVersion:
-        return ProcShmQueryVersion(client);
-    case X_ShmAttach:
-        return ProcShmAttach(client);
-    case X_ShmDetach:
-        return ProcShmDetach(client);
-    case X_ShmPutImage:
-        return ProcShmPutImage(client);
-    case X_ShmGetImage:
-        return ProcShmGetImage(client);
-    case X_ShmCreatePixmap:
-        return ProcShmCreatePixmap(client);
-#ifdef SHM_FD_PASSING
-    case X_ShmAttachFd:
-        return ProcShmAttachFd(client);
-    case X_ShmCreateSegment:
-        return ProcShmCreateSegment(client);
-#endif
-    default:
-        return BadRequest;
-    }
+    if (stuff->data < ARRAY_SIZE(ProcShmVector) && ProcShmVector[stuff->data])
+        return (*ProcShmVector[stuff->data]) (client);
+    return BadRequest;
 }
 
 static void _X_COLD
@@ -1472,33 +1466,27 @@ SProcShmCreateSegment(ClientPtr client)
 }
 #endif  /* SHM_FD_PASSING */
 
+static int (*SProcShmVector[]) (ClientPtr) = {
+    [X_ShmQueryVersion] = ProcShmQueryVersion,
+    [X_ShmAttach] = SProcShmAttach,
+    [X_ShmDetach] = SProcShmDetach,
+    [X_ShmPutImage] = SProcShmPutImage,
+    [X_ShmGetImage] = SProcShmGetImage,
+    [X_ShmCreatePixmap] = SProcShmCreatePixmap,
+#ifdef SHM_FD_PASSING
+    [X_ShmAttachFd] = SProcShmAttachFd,
+    [X_ShmCreateSegment] = SProcShmCreateSegment,
+#endif
+};
+
 static int _X_COLD
 SProcShmDispatch(ClientPtr client)
 {
     REQUEST(xReq);
 
-    switch (stuff->data) {
-    case X_ShmQueryVersion:
-        return ProcShmQueryVersion(client);
-    case X_ShmAttach:
-        return SProcShmAttach(client);
-    case X_ShmDetach:
-        return SProcShmDetach(client);
-    case X_ShmPutImage:
-        return SProcShmPutImage(client);
-    case X_ShmGetImage:
-        return SProcShmGetImage(client);
-    case X_ShmCreatePixmap:
-        return SProcShmCreatePixmap(client);
-#ifdef SHM_FD_PASSING
-    case X_ShmAttachFd:
-        return SProcShmAttachFd(client);
-    case X_ShmCreateSegment:
-        return SProcShmCreateSegment(client);
-#endif
-    default:
-        return BadRequest;
-    }
+    if (stuff->data < ARRAY_SIZE(SProcShmVector) && SProcShmVector[stuff->data])
+        return (*SProcShmVector[stuff->data]) (client);
+    return BadRequest;
 }
 
 static void ShmPixmapDestroy(CallbackListPtr *pcbl, ScreenPtr pScreen, PixmapPtr pPixmap)
@@ -1547,6 +1535,8 @@ ShmExtensionInit(void)
         (extEntry = AddExtension(SHMNAME, ShmNumberEvents, ShmNumberErrors,
                                  ProcShmDispatch, SProcShmDispatch,
                                  ShmResetProc, StandardMinorOpcode))) {
+        SetExtensionRequestVectors(extEntry, ARRAY_SIZE(ProcShmVector),
+                                   ProcShmVector, SProcShmVector);
         ShmReqCode = (unsigned char) extEntry->base;
         ShmCompletionCode = extEntry->eventBase;
         BadShmSegCode = extEntry->errorBase;
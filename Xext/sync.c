@@ -723,6 +723,7 @@ SyncAwaitTriggerFired(SyncTrigger * pTrigger)
 
  bail:
     /* unblock the client */
+    SmartScheduleBoostClient(pAwaitUnion->header.client);
     AttendClient(pAwaitUnion->header.client);
     /* delete the await */
     FreeResource(pAwaitUnion->header.delete_id, X11_RESTYPE_NONE);
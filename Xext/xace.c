@@ -156,7 +156,7 @@ XaceHookIsSet(int hook)
 {
     if (hook < 0 || hook >= XACE_NUM_HOOKS)
         return 0;
-    return XaceHooks[hook] != NULL;
+    return !CallbackListEmpty(XaceHooks[hook]);
 }
 
 /* XaceCensorImage
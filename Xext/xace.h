@@ -68,7 +68,8 @@ int XaceHookIsSet(int hook);
  */
 int XaceHookDispatch0(ClientPtr ptr, int major);
 #define XaceHookDispatch(c, m) \
-    ((XaceHooks[XACE_EXT_DISPATCH] && (m) >= EXTENSION_BASE) ? \
+    ((!CallbackListEmpty(XaceHooks[XACE_EXT_DISPATCH]) && \
+      (m) >= EXTENSION_BASE) ? \
     XaceHookDispatch0((c), (m)) : \
     Success)
 
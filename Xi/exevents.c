@@ -2824,6 +2824,7 @@ RecalculateDeviceDeliverableEvents(WindowPtr pWin)
                              & ~inputMasks->dontPropagateMask[i] &
                              XIPropagateMask);
         }
+        RecalculateEventSummary(pChild);
         if (pChild->firstChild) {
             pChild = pChild->firstChild;
             continue;
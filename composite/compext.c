@@ -145,22 +145,32 @@ static int
 SingleCompositeRedirectWindow(ClientPtr client, xCompositeRedirectWindowReq *stuff)
 {
     WindowPtr pWin;
+    int ret;
 
     VERIFY_WINDOW(pWin, stuff->window, client,
                   DixSetAttrAccess | DixManageAccess | DixBlendAccess);
 
-    return compRedirectWindow(client, pWin, stuff->update);
+    ret = compRedirectWindow(client, pWin, stuff->update);
+
+    if (ret == Success && stuff->update == CompositeRedirectManual)
+        SmartScheduleCriticalClient(client);
+    return ret;
 }
 
 static int
 SingleRedirectSubwindows(ClientPtr client, xCompositeRedirectSubwindowsReq *stuff)
 {
     WindowPtr pWin;
+    int ret;
 
     VERIFY_WINDOW(pWin, stuff->window, client,
                   DixSetAttrAccess | DixManageAccess | DixBlendAccess);
 
-    return compRedirectSubwindows(client, pWin, stuff->update);
+    ret = compRedirectSubwindows(client, pWin, stuff->update);
+
+    if (ret == Success && stuff->update == CompositeRedirectManual)
+        SmartScheduleCriticalClient(client);
+    return ret;
 }
 
 static int
@@ -155,6 +155,7 @@ DamageExtReport(DamagePtr pDamage, RegionPtr pRegion, void *closure)
         DamageExtNotify(pDamageExt, NullBox, 0);
         break;
     case DamageReportNone:
+    case DamageReportTiles:
         break;
     }
 }
@@ -59,87 +59,183 @@ SOFTWARE.
 #include "dix.h"
 
 #define InitialTableSize 256
+#define InitialHashSize 512     /* must be a power of two */
+#define AtomBatch 32
+
+/*
+ * Atoms are kept in two arrays: nodeTable, indexed by atom, holds each
+ * atom's name, length and hash for NameForAtom, and hashTable is an open
+ * addressed (linear probing) index from name to atom.  The hash slots
+ * store the full hash next to the atom, so a probe only looks at the
+ * node of a slot whose hash matches.  Atoms are never freed
+ * individually, so there are no deleted slots to deal with.
+ */
 
 typedef struct _Node {
-    struct _Node *left, *right;
-    Atom a;
-    unsigned int fingerPrint;
     const char *string;
+    unsigned int len;
+    unsigned int hash;
 } NodeRec, *NodePtr;
 
+typedef struct _AtomSlot {
+    unsigned int hash;
+    Atom a;                     /* None if the slot is empty */
+} AtomSlotRec, *AtomSlotPtr;
+
 static Atom lastAtom = None;
-static NodePtr atomRoot = NULL;
 static unsigned long tableLength;
-static NodePtr *nodeTable;
+static NodePtr nodeTable;
+static AtomSlotPtr hashTable;
+static unsigned int hashMask;
 
-Atom
-MakeAtom(const char *string, unsigned len, Bool makeit)
+static inline unsigned int
+AtomHash(const char *string, unsigned len)
 {
-    NodePtr *np;
-    unsigned i;
-    int comp;
-    unsigned int fp = 0;
-
-    np = &atomRoot;
-    for (i = 0; i < (len + 1) / 2; i++) {
-        fp = fp * 27 + string[i];
-        fp = fp * 27 + string[len - 1 - i];
+    /* FNV-1a */
+    unsigned int hash = 2166136261U;
+
+    while (len--) {
+        hash ^= (unsigned char) *string++;
+        hash *= 16777619U;
     }
-    while (*np != NULL) {
-        if (fp < (*np)->fingerPrint)
-            np = &((*np)->left);
-        else if (fp > (*np)->fingerPrint)
-            np = &((*np)->right);
-        else {                  /* now start testing the strings */
-            comp = strncmp(string, (*np)->string, (int) len);
-            if ((comp < 0) || ((comp == 0) && (len < strlen((*np)->string))))
-                np = &((*np)->left);
-            else if (comp > 0)
-                np = &((*np)->right);
-            else
-                return (*np)->a;
-        }
+    return hash;
+}
+
+/*
+ * Return the slot holding the atom named string, or the empty slot where
+ * it would go.
+ */
+static AtomSlotPtr
+FindAtomSlot(const char *string, unsigned len, unsigned int hash)
+{
+    unsigned int i;
+
+    for (i = hash & hashMask; hashTable[i].a != None; i = (i + 1) & hashMask) {
+        NodePtr nd;
+
+        if (hashTable[i].hash != hash)
+            continue;
+        nd = &nodeTable[hashTable[i].a];
+        if (nd->len == len && memcmp(nd->string, string, len) == 0)
+            break;
+    }
+    return &hashTable[i];
+}
+
+static Bool
+GrowAtomHash(void)
+{
+    unsigned int size = (hashMask + 1) * 2;
+    AtomSlotPtr table, old = hashTable;
+    unsigned int i, j;
+
+    table = calloc(size, sizeof(AtomSlotRec));
+    if (!table)
+        return FALSE;
+    for (i = 0; i <= hashMask; i++) {
+        if (old[i].a == None)
+            continue;
+        for (j = old[i].hash & (size - 1); table[j].a != None;
+             j = (j + 1) & (size - 1));
+        table[j] = old[i];
     }
-    if (makeit) {
-        NodePtr nd = calloc(1, sizeof(NodeRec));
-        if (!nd)
+    hashTable = table;
+    hashMask = size - 1;
+    free(old);
+    return TRUE;
+}
+
+static Atom
+AddAtom(const char *string, unsigned len, unsigned int hash, AtomSlotPtr slot)
+{
+    NodePtr nd;
+
+    if ((lastAtom + 1) >= tableLength) {
+        NodePtr table;
+
+        table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodeRec));
+        if (!table)
             return BAD_RESOURCE;
-        if (lastAtom < XA_LAST_PREDEFINED) {
-            nd->string = string;
-        }
-        else {
-            nd->string = strndup(string, len);
-            if (!nd->string) {
-                free(nd);
-                return BAD_RESOURCE;
-            }
-        }
-        if ((lastAtom + 1) >= tableLength) {
-            NodePtr *table;
-
-            table = reallocarray(nodeTable, tableLength, 2 * sizeof(NodePtr));
-            if (!table) {
-                if (nd->string != string) {
-                    /* nd->string has been strdup'ed */
-                    free((char *) nd->string);
-                }
-                free(nd);
-                return BAD_RESOURCE;
-            }
-            tableLength <<= 1;
-            nodeTable = table;
-        }
-        *np = nd;
-        nd->left = nd->right = NULL;
-        nd->fingerPrint = fp;
-        nd->a = ++lastAtom;
-        nodeTable[lastAtom] = nd;
-        return nd->a;
+        tableLength <<= 1;
+        nodeTable = table;
+    }
+    /* keep the load factor at or below one half */
+    if ((lastAtom + 1) * 2 > hashMask) {
+        if (!GrowAtomHash())
+            return BAD_RESOURCE;
+        slot = FindAtomSlot(string, len, hash);
+    }
+
+    nd = &nodeTable[lastAtom + 1];
+    if (lastAtom < XA_LAST_PREDEFINED) {
+        nd->string = string;
     }
+    else {
+        nd->string = strndup(string, len);
+        if (!nd->string)
+            return BAD_RESOURCE;
+    }
+    nd->len = len;
+    nd->hash = hash;
+    slot->hash = hash;
+    slot->a = ++lastAtom;
+    return lastAtom;
+}
+
+Atom
+MakeAtom(const char *string, unsigned len, Bool makeit)
+{
+    unsigned int hash;
+    AtomSlotPtr slot;
+
+    /* names are stored NUL-terminated, so anything after a NUL is lost */
+    len = strnlen(string, len);
+    hash = AtomHash(string, len);
+    slot = FindAtomSlot(string, len, hash);
+    if (slot->a != None)
+        return slot->a;
+    if (makeit)
+        return AddAtom(string, len, hash, slot);
     else
         return None;
 }
 
+Bool
+MakeAtoms(const char *const *strings, const unsigned *lens, int count,
+          Bool makeit, Atom *atoms)
+{
+    unsigned int hashes[AtomBatch];
+    unsigned int batchLens[AtomBatch];
+    int i, j, n;
+
+    for (i = 0; i < count; i += n) {
+        n = min(count - i, AtomBatch);
+
+        /* hash the whole batch first and start pulling in its slots */
+        for (j = 0; j < n; j++) {
+            batchLens[j] = strnlen(strings[i + j], lens[i + j]);
+            hashes[j] = AtomHash(strings[i + j], batchLens[j]);
+            __builtin_prefetch(&hashTable[hashes[j] & hashMask]);
+        }
+
+        for (j = 0; j < n; j++) {
+            AtomSlotPtr slot;
+
+            slot = FindAtomSlot(strings[i + j], batchLens[j], hashes[j]);
+            if (slot->a != None)
+                atoms[i + j] = slot->a;
+            else if (makeit)
+                atoms[i + j] = AddAtom(strings[i + j], batchLens[j],
+                                       hashes[j], slot);
+            else
+                atoms[i + j] = None;
+            if (atoms[i + j] == BAD_RESOURCE)
+                return FALSE;
+        }
+    }
+    return TRUE;
+}
+
 Bool
 ValidAtom(Atom atom)
 {
@@ -149,41 +245,28 @@ ValidAtom(Atom atom)
 const char *
 NameForAtom(Atom atom)
 {
-    NodePtr node;
-
-    if (atom > lastAtom)
-        return 0;
-    if ((node = nodeTable[atom]) == NULL)
+    if (atom == None || atom > lastAtom)
         return 0;
-    return node->string;
-}
-
-static void
-FreeAtom(NodePtr patom)
-{
-    if (patom->left)
-        FreeAtom(patom->left);
-    if (patom->right)
-        FreeAtom(patom->right);
-    if (patom->a > XA_LAST_PREDEFINED) {
-        /*
-         * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
-         * cast here
-         */
-        free((char *) patom->string);
-    }
-    free(patom);
+    return nodeTable[atom].string;
 }
 
 void
 FreeAllAtoms(void)
 {
-    if (atomRoot == NULL)
+    Atom a;
+
+    if (nodeTable == NULL)
         return;
-    FreeAtom(atomRoot);
-    atomRoot = NULL;
+    /*
+     * All strings above XA_LAST_PREDEFINED are strdup'ed, so it's safe to
+     * cast here
+     */
+    for (a = XA_LAST_PREDEFINED + 1; a <= lastAtom; a++)
+        free((char *) nodeTable[a].string);
     free(nodeTable);
     nodeTable = NULL;
+    free(hashTable);
+    hashTable = NULL;
     lastAtom = None;
 }
 
@@ -192,10 +275,13 @@ InitAtoms(void)
 {
     FreeAllAtoms();
     tableLength = InitialTableSize;
-    nodeTable = calloc(InitialTableSize, sizeof(NodePtr));
+    nodeTable = calloc(InitialTableSize, sizeof(NodeRec));
     if (!nodeTable)
         FatalError("creating atom table");
-    nodeTable[None] = NULL;
+    hashMask = InitialHashSize - 1;
+    hashTable = calloc(InitialHashSize, sizeof(AtomSlotRec));
+    if (!hashTable)
+        FatalError("creating atom table");
     MakePredeclaredAtoms();
     if (lastAtom != XA_LAST_PREDEFINED)
         FatalError("builtin atom number mismatch");
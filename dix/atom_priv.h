@@ -5,6 +5,9 @@
 #ifndef _XSERVER_DIX_ATOM_PRIV_H
 #define _XSERVER_DIX_ATOM_PRIV_H
 
+#include <X11/Xdefs.h>
+#include <X11/X.h>
+
 /*
  * @brief initialize atom table
  */
@@ -15,4 +18,21 @@ void InitAtoms(void);
  */
 void FreeAllAtoms(void);
 
+/*
+ * @brief look up or create a batch of atoms at once
+ *
+ * Like calling MakeAtom() for each name, but all names of a batch are
+ * hashed up front so their table probes can overlap.
+ *
+ * @param strings the atom names
+ * @param lens    length of each name
+ * @param count   number of names
+ * @param makeit  create atoms that don't exist yet
+ * @param atoms   receives the atom for each name, None if it doesn't
+ *                exist and makeit is FALSE
+ * @return FALSE if an atom couldn't be allocated
+ */
+Bool MakeAtoms(const char *const *strings, const unsigned *lens, int count,
+               Bool makeit, Atom *atoms);
+
 #endif /* _XSERVER_DIX_ATOM_PRIV_H */
@@ -106,8 +106,10 @@ Equipment Corporation.
 #include "dix/colormap_priv.h"
 #include "dix/cursor_priv.h"
 #include "dix/dix_priv.h"
+#include "dix/extension_priv.h"
 #include "dix/input_priv.h"
 #include "dix/gc_priv.h"
+#include "dix/profile_priv.h"
 #include "dix/registry_priv.h"
 #include "dix/resource_priv.h"
 #include "dix/screenint_priv.h"
@@ -254,6 +256,154 @@ static int SmartLastIndex[SMART_MAX_PRIORITY - SMART_MIN_PRIORITY + 1];
 long SmartLastPrint;
 #endif
 
+/*
+ * Latency-aware scheduling (-schedLatency)
+ *
+ * The smart scheduler above only balances how many ticks clients consume,
+ * so an interactive client can end up waiting behind one that uploads
+ * images as fast as it can.  In latency-aware mode clients that are known
+ * to be latency critical (compositing managers) or that have just been
+ * woken up by an event they were waiting for (Sync awaits, Present
+ * completions) run ahead of other clients of the same priority, unless
+ * they used up their whole slice the last time they ran.
+ *
+ * For each client, how long it waited between becoming ready and being
+ * scheduled and how long its requests took to execute are collected in
+ * log2 histograms of microseconds, which are logged when the client goes
+ * away and for all current clients with the request profile.
+ */
+Bool SmartScheduleLatencyAware = FALSE;
+
+/* log2 histograms in microseconds, the last bucket is open ended */
+#define SMART_HISTOGRAM_BUCKETS 20
+
+typedef struct _SmartLatency {
+    CARD64 ready_since;         /* when the client became ready, 0 if not */
+    Bool critical;              /* latency critical for its whole life */
+    Bool boost;                 /* run it ahead of others next time */
+    Bool exhausted;             /* used up its whole slice last time */
+    CARD32 wait[SMART_HISTOGRAM_BUCKETS];       /* from ready to scheduled */
+    CARD32 service[SMART_HISTOGRAM_BUCKETS];    /* per request */
+} SmartLatencyRec, *SmartLatencyPtr;
+
+static SmartLatencyPtr smartLatency[MAXCLIENTS];
+static int smartCriticalClients;
+
+static SmartLatencyPtr
+SmartLatency(ClientPtr client)
+{
+    if (!SmartScheduleLatencyAware || !client->index)
+        return NULL;
+    if (!smartLatency[client->index])
+        smartLatency[client->index] = calloc(1, sizeof(SmartLatencyRec));
+    return smartLatency[client->index];
+}
+
+static void
+SmartLatencyRecord(CARD32 *histogram, CARD64 usec)
+{
+    int bucket = 0;
+
+    while (usec && bucket < SMART_HISTOGRAM_BUCKETS - 1) {
+        usec >>= 1;
+        bucket++;
+    }
+    histogram[bucket]++;
+}
+
+void
+SmartScheduleCriticalClient(ClientPtr client)
+{
+    SmartLatencyPtr latency = SmartLatency(client);
+
+    if (latency && !latency->critical) {
+        latency->critical = TRUE;
+        smartCriticalClients++;
+    }
+}
+
+void
+SmartScheduleBoostClient(ClientPtr client)
+{
+    SmartLatencyPtr latency = SmartLatency(client);
+
+    if (latency)
+        latency->boost = TRUE;
+}
+
+static void
+SmartLatencyLogHistogram(ClientPtr client, int verb, const char *what,
+                         const CARD32 *histogram)
+{
+    char line[SMART_HISTOGRAM_BUCKETS * 24];
+    int len = 0, i;
+
+    for (i = 0; i < SMART_HISTOGRAM_BUCKETS; i++) {
+        if (!histogram[i])
+            continue;
+        len += snprintf(line + len, sizeof(line) - len, " %s%lluus:%u",
+                        i == SMART_HISTOGRAM_BUCKETS - 1 ? ">=" : "<",
+                        i == SMART_HISTOGRAM_BUCKETS - 1 ?
+                        1ULL << (i - 1) : 1ULL << i,
+                        (unsigned) histogram[i]);
+    }
+    if (len)
+        LogMessageVerb(X_INFO, verb, "client %d (%s) %s:%s\n", client->index,
+                       GetClientCmdName(client) ? GetClientCmdName(client) :
+                       "unknown", what, line);
+}
+
+static void
+SmartLatencyClientGone(ClientPtr client)
+{
+    SmartLatencyPtr latency = smartLatency[client->index];
+
+    if (!latency)
+        return;
+    SmartLatencyLogHistogram(client, 3, "scheduling wait", latency->wait);
+    SmartLatencyLogHistogram(client, 3, "request time", latency->service);
+    if (latency->critical)
+        smartCriticalClients--;
+    free(latency);
+    smartLatency[client->index] = NULL;
+}
+
+void
+SmartScheduleLogLatency(void)
+{
+    int i;
+
+    for (i = 1; i < currentMaxClients; i++) {
+        SmartLatencyPtr latency = smartLatency[i];
+
+        if (!latency || !clients[i])
+            continue;
+        SmartLatencyLogHistogram(clients[i], 0, "scheduling wait",
+                                 latency->wait);
+        SmartLatencyLogHistogram(clients[i], 0, "request time",
+                                 latency->service);
+    }
+}
+
+static inline void
+SmartLatencyReady(ClientPtr client)
+{
+    SmartLatencyPtr latency = SmartLatency(client);
+
+    if (latency && !latency->ready_since)
+        latency->ready_since = GetTimeInMicros();
+}
+
+/* Whether client should run ahead of others of the same priority */
+static inline Bool
+SmartLatencyUrgent(ClientPtr client)
+{
+    SmartLatencyPtr latency = smartLatency[client->index];
+
+    return latency && (latency->critical || latency->boost) &&
+        !latency->exhausted;
+}
+
 void Dispatch(void);
 
 static struct xorg_list ready_clients;
@@ -278,8 +428,11 @@ clients_are_ready(void)
 void
 mark_client_ready(ClientPtr client)
 {
-    if (xorg_list_is_empty(&client->ready))
+    if (xorg_list_is_empty(&client->ready)) {
         xorg_list_append(&client->ready, &ready_clients);
+        if (SmartScheduleLatencyAware)
+            SmartLatencyReady(client);
+    }
 }
 
 /*
@@ -288,8 +441,11 @@ mark_client_ready(ClientPtr client)
  */
 void mark_client_saved_ready(ClientPtr client)
 {
-    if (xorg_list_is_empty(&client->ready))
+    if (xorg_list_is_empty(&client->ready)) {
         xorg_list_append(&client->ready, &saved_ready_clients);
+        if (SmartScheduleLatencyAware)
+            SmartLatencyReady(client);
+    }
 }
 
 /* Client has no requests queued and no data on network */
@@ -297,6 +453,8 @@ void
 mark_client_not_ready(ClientPtr client)
 {
     xorg_list_del(&client->ready);
+    if (smartLatency[client->index])
+        smartLatency[client->index]->ready_since = 0;
 }
 
 static void
@@ -331,6 +489,7 @@ SmartScheduleClient(void)
     long now = SmartScheduleTime;
     long idle;
     int nready = 0;
+    Bool urgent, bestUrgent = FALSE;
 
     bestRobin = 0;
     idle = 2 * SmartScheduleSlice;
@@ -350,15 +509,20 @@ SmartScheduleClient(void)
              SmartLastIndex[pClient->smart_priority -
                             SMART_MIN_PRIORITY]) & 0xff;
 
+        urgent = SmartScheduleLatencyAware && SmartLatencyUrgent(pClient);
+
         /* pick the best client */
         if (!best ||
             pClient->priority > best->priority ||
             (pClient->priority == best->priority &&
-             (pClient->smart_priority > best->smart_priority ||
-              (pClient->smart_priority == best->smart_priority && robin > bestRobin))))
+             (urgent > bestUrgent ||
+              (urgent == bestUrgent &&
+               (pClient->smart_priority > best->smart_priority ||
+                (pClient->smart_priority == best->smart_priority && robin > bestRobin))))))
         {
             best = pClient;
             bestRobin = robin;
+            bestUrgent = urgent;
         }
 #ifdef SMART_DEBUG
         if ((now - SmartLastPrint) >= 5000)
@@ -372,6 +536,16 @@ SmartScheduleClient(void)
     }
 #endif
     SmartLastIndex[best->smart_priority - SMART_MIN_PRIORITY] = best->index;
+    if (smartLatency[best->index]) {
+        SmartLatencyPtr latency = smartLatency[best->index];
+
+        if (latency->ready_since) {
+            SmartLatencyRecord(latency->wait,
+                               GetTimeInMicros() - latency->ready_since);
+            latency->ready_since = 0;
+        }
+        latency->boost = FALSE;
+    }
     /*
      * Set current client pointer
      */
@@ -382,7 +556,8 @@ SmartScheduleClient(void)
     /*
      * Adjust slice
      */
-    if (nready == 1 && SmartScheduleLatencyLimited == 0) {
+    if (nready == 1 && SmartScheduleLatencyLimited == 0 &&
+        smartCriticalClients == 0) {
         /*
          * If it's been a long time since another client
          * has run, bump the slice up to get maximal
@@ -468,12 +643,40 @@ DisableLimitedSchedulingLatency(void)
         SmartScheduleLatencyLimited = 0;
 }
 
+/*
+ * Look up the minor opcode of an extension request and the proc to run it,
+ * straight from the extension's request vector if it has one.  proc is the
+ * client's requestVector entry; if that isn't the extension's main proc,
+ * because the client has a vector of its own or the main proc is wrapped,
+ * proc is used.
+ */
+static inline RequestProcPtr
+ExtensionRequestProc(ClientPtr client, RequestProcPtr proc)
+{
+    const ExtensionDispatchRec *d = &ExtensionDispatch[client->majorOp];
+    int swapped = client->swapped;
+
+    if (!d->ext)
+        return proc;
+    if (d->standardMinor)
+        client->minorOp = ((xReq *) client->requestBuffer)->data;
+    else
+        client->minorOp = d->ext->MinorOpcode(client);
+    if (proc == d->main[swapped] && client->minorOp < d->numRequests &&
+        d->requests[swapped][client->minorOp])
+        return d->requests[swapped][client->minorOp];
+    return proc;
+}
+
 void
 Dispatch(void)
 {
     int result;
     ClientPtr client;
+    RequestProcPtr proc;
     long start_tick;
+    Bool exhausted;
+    CARD64 request_start = 0, request_output = 0;
 
     nextFreeClientID = 1;
     nClients = 0;
@@ -482,6 +685,9 @@ Dispatch(void)
     init_client_ready();
 
     while (!dispatchException) {
+        if (ProfileTogglePending)
+            ProfileToggle();
+
         if (InputCheckPending()) {
             ProcessInputEvents();
             FlushIfCriticalOutputPending();
@@ -501,6 +707,7 @@ Dispatch(void)
             isItTimeToYield = FALSE;
 
             start_tick = SmartScheduleTime;
+            exhausted = FALSE;
             while (!isItTimeToYield) {
                 if (InputCheckPending())
                     ProcessInputEvents();
@@ -511,6 +718,7 @@ Dispatch(void)
                     /* Penalize clients which consume ticks */
                     if (client->smart_priority > SMART_MIN_PRIORITY)
                         client->smart_priority--;
+                    exhausted = TRUE;
                     break;
                 }
 
@@ -526,12 +734,9 @@ Dispatch(void)
                 client->sequence++;
                 client->majorOp = ((xReq *) client->requestBuffer)->reqType;
                 client->minorOp = 0;
-                if (client->majorOp >= EXTENSION_BASE) {
-                    ExtensionEntry *ext = GetExtensionEntry(client->majorOp);
-
-                    if (ext)
-                        client->minorOp = ext->MinorOpcode(client);
-                }
+                proc = client->requestVector[client->majorOp];
+                if (client->majorOp >= EXTENSION_BASE)
+                    proc = ExtensionRequestProc(client, proc);
 #ifdef XSERVER_DTRACE
                 if (XSERVER_REQUEST_START_ENABLED())
                     XSERVER_REQUEST_START(LookupMajorName(client->majorOp),
@@ -545,10 +750,26 @@ Dispatch(void)
                 else {
                     result = XaceHookDispatch(client, client->majorOp);
                     if (result == Success) {
+                        if (ProfileEnabled)
+                            request_output = ProfileClientOutput(client);
+                        if (SmartScheduleLatencyAware || ProfileEnabled)
+                            request_start = GetTimeInMicros();
                         currentClient = client;
-                        result =
-                            (*client->requestVector[client->majorOp]) (client);
+                        result = (*proc) (client);
                         currentClient = NULL;
+                        if (SmartScheduleLatencyAware || ProfileEnabled) {
+                            CARD64 usec = GetTimeInMicros() - request_start;
+
+                            if (SmartScheduleLatencyAware &&
+                                smartLatency[client->index])
+                                SmartLatencyRecord(smartLatency[client->index]->service,
+                                                   usec);
+                            /* the client may have been closed down */
+                            if (ProfileEnabled && clients[client->index] == client)
+                                ProfileRequest(client, usec,
+                                               ProfileClientOutput(client) -
+                                               request_output);
+                        }
                     }
                 }
                 if (!SmartScheduleSignalEnable)
@@ -573,8 +794,15 @@ Dispatch(void)
                 }
             }
             FlushAllOutput();
-            if (client == SmartLastClient)
+            if (client == SmartLastClient) {
                 client->smart_stop_tick = SmartScheduleTime;
+                if (smartLatency[client->index]) {
+                    smartLatency[client->index]->exhausted = exhausted;
+                    /* still has requests queued, so it is waiting again */
+                    if (client_is_ready(client))
+                        SmartLatencyReady(client);
+                }
+            }
         }
         dispatchException &= ~DE_PRIORITYCHANGE;
     }
@@ -584,6 +812,7 @@ Dispatch(void)
     KillAllClients();
     dispatchException &= ~DE_RESET;
     SmartScheduleLatencyLimited = 0;
+    ResetInputPoolStats();
     ResetOsBuffers();
 }
 
@@ -1155,7 +1384,7 @@ ProcGrabServer(ClientPtr client)
     grabClient = client;
     mark_client_grab(client);
 
-    if (ServerGrabCallback) {
+    if (!CallbackListEmpty(ServerGrabCallback)) {
         ServerGrabInfoRec grabinfo;
 
         grabinfo.client = client;
@@ -1183,7 +1412,7 @@ UngrabServer(ClientPtr client)
         AttendClient(clients[i]);
     }
 
-    if (ServerGrabCallback) {
+    if (!CallbackListEmpty(ServerGrabCallback)) {
         ServerGrabInfoRec grabinfo;
 
         grabinfo.client = client;
@@ -2135,6 +2364,51 @@ ProcPutImage(ClientPtr client)
     return Success;
 }
 
+/* The GetImage chunk being handed to the output layer, cleared again by
+ * ImageChunkRelease() if the output layer is done with it right away. */
+static char *imageChunkWriting;
+
+static void
+ImageChunkRelease(void *closure)
+{
+    if (closure == imageChunkWriting)
+        imageChunkWriting = NULL;
+    else
+        free(closure);
+}
+
+/* Send a chunk of GetImage data.  pBuf is handed over to the output layer
+ * rather than copied.  If it has been written out or copied by the time
+ * WriteToClientRef() returns, it is filled again for the next chunk,
+ * otherwise it stays queued and a new one is allocated.  Returns the
+ * buffer to fill next, or NULL after the last chunk and if none can be
+ * had.
+ *
+ * Buffers are cleared when allocated: GetImage leaves the scanline padding
+ * alone and writes nothing at all for a switched away VT, and whatever was
+ * in that memory before must not go out to the client. */
+static char *
+WriteImageChunk(ClientPtr client, char *pBuf, int count, long length,
+                Bool last)
+{
+    char *pNext = NULL;
+
+    imageChunkWriting = pBuf;
+    WriteToClientRef(client, count, pBuf, ImageChunkRelease, pBuf);
+    if (!imageChunkWriting) {
+        if (!last)
+            return pBuf;
+        free(pBuf);
+        return NULL;
+    }
+
+    /* still queued, freed once it has been written */
+    imageChunkWriting = NULL;
+    if (!last && !(pNext = calloc(1, length)))
+        dixMarkClientException(client);
+    return pNext;
+}
+
 static int
 DoGetImage(ClientPtr client, int format, Drawable drawable,
            int x, int y, int width, int height,
@@ -2297,8 +2571,11 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
             ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                           BitsPerPixel(pDraw->depth), ClientOrder(client));
 
-            WriteToClient(client, (int) (nlines * widthBytesLine), pBuf);
             linesDone += nlines;
+            pBuf = WriteImageChunk(client, pBuf, (int) (nlines * widthBytesLine),
+                                   length, linesDone >= height);
+            if (!pBuf)
+                return Success;
         }
     }
     else {                      /* XYPixmap */
@@ -2325,8 +2602,13 @@ DoGetImage(ClientPtr client, int format, Drawable drawable,
                     ReformatImage(pBuf, (int) (nlines * widthBytesLine),
                                   1, ClientOrder(client));
 
-                    WriteToClient(client, (int)(nlines * widthBytesLine), pBuf);
                     linesDone += nlines;
+                    pBuf = WriteImageChunk(client, pBuf,
+                                           (int) (nlines * widthBytesLine),
+                                           length, linesDone >= height &&
+                                           !(planemask & (plane - 1)));
+                    if (!pBuf)
+                        return Success;
                 }
             }
         }
@@ -3597,7 +3879,7 @@ CloseDownClient(ClientPtr client)
              */
             FreeClientNeverRetainResources(client);
             client->clientState = ClientStateRetained;
-            if (ClientStateCallback) {
+            if (!CallbackListEmpty(ClientStateCallback)) {
                 NewClientInfoRec clientinfo;
 
                 clientinfo.client = client;
@@ -3629,7 +3911,7 @@ CloseDownClient(ClientPtr client)
             SetDispatchExceptionTimer();
 
         client->clientState = ClientStateGone;
-        if (ClientStateCallback) {
+        if (!CallbackListEmpty(ClientStateCallback)) {
             NewClientInfoRec clientinfo;
 
             clientinfo.client = client;
@@ -3637,6 +3919,8 @@ CloseDownClient(ClientPtr client)
             clientinfo.setup = (xConnSetup *) NULL;
             CallCallbacks((&ClientStateCallback), (void *) &clientinfo);
         }
+        SmartLatencyClientGone(client);
+        ProfileClientGone(client);
         TouchListenerGone(client->clientAsMask);
         GestureListenerGone(client->clientAsMask);
         FreeClientResources(client);
@@ -3731,7 +4015,7 @@ NextAvailableClient(void *ospriv)
      * ClientStateCallback. */
     ReserveClientIds(client);
 
-    if (ClientStateCallback) {
+    if (!CallbackListEmpty(ClientStateCallback)) {
         NewClientInfoRec clientinfo;
 
         clientinfo.client = client;
@@ -3851,7 +4135,7 @@ SendConnSetup(ClientPtr client, const char *reason)
 		      lConnectionInfo);
     }
     client->clientState = ClientStateRunning;
-    if (ClientStateCallback) {
+    if (!CallbackListEmpty(ClientStateCallback)) {
         NewClientInfoRec clientinfo;
 
         clientinfo.client = client;
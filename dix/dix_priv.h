@@ -129,6 +129,16 @@ void EnableLimitedSchedulingLatency(void);
 
 void DisableLimitedSchedulingLatency(void);
 
+/*
+ * Hints for latency-aware scheduling (-schedLatency), no-ops otherwise.
+ * A critical client, e.g. a compositing manager, runs ahead of other clients
+ * of the same priority for the rest of its life; a boosted one only the next
+ * time it is ready, e.g. after something it waited for has happened.
+ */
+void SmartScheduleCriticalClient(ClientPtr client);
+
+void SmartScheduleBoostClient(ClientPtr client);
+
 int dix_main(int argc, char *argv[], char *envp[]);
 
 void SetMaskForEvent(int deviceid, Mask mask, int event);
@@ -207,6 +217,7 @@ void FreezeThisEventIfNeededForSyncGrab(DeviceIntPtr thisDev,
 void FixKeyState(DeviceEvent *event, DeviceIntPtr keybd);
 
 void RecalculateDeliverableEvents(WindowPtr pWin);
+void RecalculateEventSummary(WindowPtr pWin);
 
 void DoFocusEvents(DeviceIntPtr dev,
                    WindowPtr fromWin,
@@ -38,6 +38,12 @@ extern Bool SmartScheduleSignalEnable;
 void SmartScheduleStartTimer(void);
 void SmartScheduleStopTimer(void);
 
+/* latency-aware scheduling (-schedLatency) */
+extern Bool SmartScheduleLatencyAware;
+
+/* Log the latency histograms of all current clients */
+void SmartScheduleLogLatency(void);
+
 /* Client has requests queued or data on the network */
 void mark_client_ready(ClientPtr client);
 
@@ -82,6 +82,7 @@ Author:  Adobe Systems Incorporated
 
 #include <dix-config.h>
 
+#include <string.h>
 #include <X11/X.h>
 #include <X11/Xmd.h>
 
@@ -650,14 +651,23 @@ static CallbackListPtr **listsToCleanup = NULL;
 static Bool
 _AddCallback(CallbackListPtr *pcbl, CallbackProcPtr callback, void *data)
 {
-    CallbackPtr cbr = calloc(1, sizeof(CallbackRec));
-    if (!cbr)
-        return FALSE;
-    cbr->proc = callback;
-    cbr->data = data;
-    cbr->next = (*pcbl)->list;
-    cbr->deleted = FALSE;
-    (*pcbl)->list = cbr;
+    CallbackListPtr cbl = *pcbl;
+
+    if (cbl->numEntries == cbl->size) {
+        int size = cbl->size ? cbl->size * 2 : 4;
+        CallbackPtr callbacks = reallocarray(cbl->callbacks, size,
+                                             sizeof(CallbackRec));
+        if (!callbacks)
+            return FALSE;
+        cbl->callbacks = callbacks;
+        cbl->size = size;
+    }
+    /* entries added while the list is being called are not called until
+     * the next time round, _CallCallbacks() only walks the older ones */
+    cbl->callbacks[cbl->numEntries].proc = callback;
+    cbl->callbacks[cbl->numEntries].data = data;
+    cbl->numEntries++;
+    cbl->numCallbacks++;
     return TRUE;
 }
 
@@ -665,38 +675,42 @@ static Bool
 _DeleteCallback(CallbackListPtr *pcbl, CallbackProcPtr callback, void *data)
 {
     CallbackListPtr cbl = *pcbl;
-    CallbackPtr cbr, pcbr;
+    int i;
 
-    for (pcbr = NULL, cbr = cbl->list; cbr != NULL; pcbr = cbr, cbr = cbr->next) {
-        if ((cbr->proc == callback) && (cbr->data == data))
+    /* the newest matching registration goes first */
+    for (i = cbl->numEntries - 1; i >= 0; i--) {
+        if (cbl->callbacks[i].proc == callback &&
+            cbl->callbacks[i].data == data)
             break;
     }
-    if (cbr != NULL) {
-        if (cbl->inCallback) {
-            ++(cbl->numDeleted);
-            cbr->deleted = TRUE;
-        }
-        else {
-            if (pcbr == NULL)
-                cbl->list = cbr->next;
-            else
-                pcbr->next = cbr->next;
-            free(cbr);
-        }
-        return TRUE;
+    if (i < 0)
+        return FALSE;
+
+    cbl->numCallbacks--;
+    if (cbl->inCallback)
+        cbl->callbacks[i].proc = NULL;
+    else {
+        memmove(&cbl->callbacks[i], &cbl->callbacks[i + 1],
+                (cbl->numEntries - i - 1) * sizeof(CallbackRec));
+        cbl->numEntries--;
     }
-    return FALSE;
+    return TRUE;
 }
 
 void
 _CallCallbacks(CallbackListPtr *pcbl, void *call_data)
 {
     CallbackListPtr cbl = *pcbl;
-    CallbackPtr cbr, pcbr;
+    int i, j;
 
     ++(cbl->inCallback);
-    for (cbr = cbl->list; cbr != NULL; cbr = cbr->next) {
-        (*(cbr->proc)) (pcbl, cbr->data, call_data);
+    /* a callback may add to the list and move the array, so index it
+     * afresh every time round */
+    for (i = cbl->numEntries - 1; i >= 0; i--) {
+        CallbackProcPtr proc = cbl->callbacks[i].proc;
+
+        if (proc)
+            (*proc) (pcbl, cbl->callbacks[i].data, call_data);
     }
     --(cbl->inCallback);
 
@@ -710,31 +724,13 @@ _CallCallbacks(CallbackListPtr *pcbl, void *call_data)
         return;
     }
 
-    /* Were some individual callbacks on the list marked for deletion?
-     * If so, do the deletions.
-     */
+    /* Drop the slots of callbacks deleted while we were calling them */
 
-    if (cbl->numDeleted) {
-        for (pcbr = NULL, cbr = cbl->list; (cbr != NULL) && cbl->numDeleted;) {
-            if (cbr->deleted) {
-                if (pcbr) {
-                    cbr = cbr->next;
-                    free(pcbr->next);
-                    pcbr->next = cbr;
-                }
-                else {
-                    cbr = cbr->next;
-                    free(cbl->list);
-                    cbl->list = cbr;
-                }
-                cbl->numDeleted--;
-            }
-            else {              /* this one wasn't deleted */
-
-                pcbr = cbr;
-                cbr = cbr->next;
-            }
-        }
+    if (cbl->numCallbacks != cbl->numEntries) {
+        for (i = j = 0; i < cbl->numEntries; i++)
+            if (cbl->callbacks[i].proc)
+                cbl->callbacks[j++] = cbl->callbacks[i];
+        cbl->numEntries = j;
     }
 }
 
@@ -757,11 +753,7 @@ void DeleteCallbackList(CallbackListPtr *pcbl)
         }
     }
 
-    CallbackPtr cbr, nextcbr;
-    for (cbr = cbl->list; cbr != NULL; cbr = nextcbr) {
-        nextcbr = cbr->next;
-        free(cbr);
-    }
+    free(cbl->callbacks);
     free(cbl);
     *pcbl = NULL;
 }
@@ -777,10 +769,6 @@ CreateCallbackList(CallbackListPtr *pcbl)
     CallbackListPtr cbl = calloc(1, sizeof(CallbackListRec));
     if (!cbl)
         return FALSE;
-    cbl->inCallback = 0;
-    cbl->deleted = FALSE;
-    cbl->numDeleted = 0;
-    cbl->list = NULL;
     *pcbl = cbl;
 
     for (i = 0; i < numCallbackListsToCleanup; i++) {
@@ -1159,7 +1159,7 @@ EnqueueEvent(InternalEvent *ev, DeviceIntPtr device)
         event->type == ET_KeyRelease)
         AccessXCancelRepeatKey(device->key->xkbInfo, event->detail.key);
 
-    if (DeviceEventCallback) {
+    if (!CallbackListEmpty(DeviceEventCallback)) {
         DeviceEventInfoRec eventinfo;
 
         /*  The RECORD spec says that the root window field of motion events
@@ -2804,6 +2804,36 @@ EventIsDeliverable(DeviceIntPtr dev, int evtype, WindowPtr win)
     return rc;
 }
 
+/**
+ * Fill in the event summary bits an event of the given type is matched
+ * against, the same masks EventIsDeliverable() looks at.
+ */
+static void
+EventSummaryForType(DeviceIntPtr dev, int evtype, EventSummaryRec *interest)
+{
+    int type;
+
+    interest->xi2 = 0;
+    interest->xi = 0;
+    interest->core = 0;
+
+    if ((type = GetXI2Type(evtype)) != 0 && type < 64)
+        interest->xi2 = (uint64_t) 1 << type;
+    if ((type = GetXIType(evtype)) != 0)
+        interest->xi = event_get_filter_from_type(dev, type);
+    if ((type = GetCoreType(evtype)) != 0)
+        interest->core = event_get_filter_from_type(dev, type);
+}
+
+static inline Bool
+EventSummaryMatches(const EventSummaryRec *summary,
+                    const EventSummaryRec *interest)
+{
+    return (summary->core & interest->core) ||
+        (summary->xi & interest->xi) ||
+        (summary->xi2 & interest->xi2);
+}
+
 static int
 DeliverEvent(DeviceIntPtr dev, xEvent *xE, int count,
              WindowPtr win, Window child, GrabPtr grab)
@@ -2886,12 +2916,23 @@ DeliverDeviceEvents(WindowPtr pWin, InternalEvent *event, GrabPtr grab,
     Window child = None;
     int deliveries = 0;
     int mask;
+    EventSummaryRec interest;
 
     verify_internal_event(event);
 
+    EventSummaryForType(dev, event->any.type, &interest);
+
     // try the window and all its parent, whichever one first wants the event
     while (pWin) {
-        if ((mask = EventIsDeliverable(dev, event->any.type, pWin))) {
+        /* nobody on this window or above it wants the event */
+        if (!EventSummaryMatches(&pWin->ancestorEvents, &interest)) {
+            deliveries = 0;
+            break;
+        }
+
+        mask = 0;
+        if (EventSummaryMatches(&pWin->selectedEvents, &interest) &&
+            (mask = EventIsDeliverable(dev, event->any.type, pWin))) {
             /* XI2 events first */
             if (mask & EVENT_XI2_MASK) {
                 deliveries =
@@ -4502,6 +4543,7 @@ RecalculateDeliverableEvents(WindowPtr pWin)
             pChild->deliverableEvents |=
                 (pChild->parent->deliverableEvents &
                  ~wDontPropagateMask(pChild) & PropagateMask);
+        RecalculateEventSummary(pChild);
         if (pChild->firstChild) {
             pChild = pChild->firstChild;
             continue;
@@ -4514,6 +4556,53 @@ RecalculateDeliverableEvents(WindowPtr pWin)
     }
 }
 
+/**
+ * Recalculate the event summaries of a single window from the selections
+ * on it and the summary of its parent, which must be up to date.
+ *
+ * DeliverDeviceEvents() uses them to skip windows nobody selected the event
+ * on, and to stop going up the tree once nobody above wants it.
+ */
+void
+RecalculateEventSummary(WindowPtr pWin)
+{
+    OtherInputMasks *inputMasks = wOtherInputMasks(pWin);
+    EventSummaryRec *selected = &pWin->selectedEvents;
+    EventSummaryRec *ancestor = &pWin->ancestorEvents;
+    Mask dontPropagate = 0;
+    int i, j;
+
+    selected->core = pWin->eventMask | wOtherEventMasks(pWin);
+    selected->xi = 0;
+    selected->xi2 = 0;
+    if (inputMasks) {
+        XI2Mask *xi2mask = inputMasks->xi2mask;
+
+        for (i = 0; i < EMASKSIZE; i++) {
+            selected->xi |= inputMasks->inputEvents[i];
+            dontPropagate |= inputMasks->dontPropagateMask[i];
+        }
+        for (i = 0; i < xi2mask_num_masks(xi2mask); i++) {
+            const unsigned char *mask = xi2mask_get_one_mask(xi2mask, i);
+
+            for (j = 0; j < xi2mask_mask_size(xi2mask) && j < 8; j++)
+                selected->xi2 |= (uint64_t) mask[j] << (j * 8);
+        }
+    }
+
+    *ancestor = *selected;
+    if (pWin->parent) {
+        ancestor->core |= pWin->parent->ancestorEvents.core;
+        ancestor->xi |= pWin->parent->ancestorEvents.xi;
+        ancestor->xi2 |= pWin->parent->ancestorEvents.xi2;
+    }
+
+    /* a window that stops an event must be looked at, even if nobody
+     * selected it there */
+    selected->core |= wDontPropagateMask(pWin);
+    selected->xi |= dontPropagate;
+}
+
 /**
  *
  *  \param value must conform to DeleteType
@@ -6110,7 +6199,7 @@ WriteEventsToClient(ClientPtr pClient, int count, xEvent *events)
     }
 #endif /* XINERAMA */
 
-    if (EventCallback) {
+    if (!CallbackListEmpty(EventCallback)) {
         EventInfoRec eventinfo;
 
         eventinfo.client = pClient;
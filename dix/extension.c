@@ -69,6 +69,8 @@ int lastEvent = EXTENSION_EVENT_BASE;
 static int lastError = FirstExtensionError;
 static unsigned int NumExtensions = RESERVED_EXTENSIONS;
 
+ExtensionDispatchRec ExtensionDispatch[256];
+
 static struct { const char *name; int id; } reservedExt[] = {
     { "BIG-REQUESTS",               EXTENSION_MAJOR_BIG_REQUESTS },
     { "Apple-WM",                   EXTENSION_MAJOR_APPLE_WM },
@@ -170,6 +172,15 @@ AddExtension(const char *name, int NumEvents, int NumErrors,
     ext->MinorOpcode = MinorOpcodeProc;
     ProcVector[i + EXTENSION_BASE] = MainProc;
     SwappedProcVector[i + EXTENSION_BASE] = SwappedMainProc;
+    if (ext->base < ARRAY_SIZE(ExtensionDispatch)) {
+        ExtensionDispatchPtr d = &ExtensionDispatch[ext->base];
+
+        memset(d, 0, sizeof(*d));
+        d->ext = ext;
+        d->standardMinor = MinorOpcodeProc == StandardMinorOpcode;
+        d->main[0] = MainProc;
+        d->main[1] = SwappedMainProc;
+    }
     if (NumEvents) {
         ext->eventBase = lastEvent;
         ext->eventLast = lastEvent + NumEvents;
@@ -203,6 +214,21 @@ badalloc:
     return NULL;
 }
 
+void
+SetExtensionRequestVectors(ExtensionEntry *ext, int numRequests,
+                           int (**procs) (ClientPtr),
+                           int (**swappedProcs) (ClientPtr))
+{
+    ExtensionDispatchPtr d;
+
+    if (!ext || ext->base >= ARRAY_SIZE(ExtensionDispatch))
+        return;
+    d = &ExtensionDispatch[ext->base];
+    d->numRequests = numRequests;
+    d->requests[0] = procs;
+    d->requests[1] = swappedProcs;
+}
+
 /*
  * CheckExtension returns the extensions[] entry for the requested
  * extension name.  Maybe this could just return a Bool instead?
@@ -255,6 +281,9 @@ CloseDownExtensions(void)
         if (extensions[i]->CloseDown)
             extensions[i]->CloseDown(extensions[i]);
         NumExtensions = i;
+        if (extensions[i]->base < ARRAY_SIZE(ExtensionDispatch))
+            memset(&ExtensionDispatch[extensions[i]->base], 0,
+                   sizeof(ExtensionDispatchRec));
         free((void *) extensions[i]->name);
         dixFreePrivates(extensions[i]->devPrivates, PRIVATE_EXTENSION);
         free(extensions[i]);
@@ -6,6 +6,7 @@
 #define _XSERVER_EXTENSION_PRIV_H
 
 #include "misc.h"
+#include "extnsionst.h"
 
 #define EXTENSION_MAJOR_APPLE_WM            (EXTENSION_BASE + 0)
 #define EXTENSION_MAJOR_APPLE_DRI           (EXTENSION_BASE + 1)
@@ -46,4 +47,23 @@
 
 #define RESERVED_EXTENSIONS                 38
 
+/*
+ * Flat dispatch table for extension requests, indexed by major opcode and
+ * then by the client's byte order.  AddExtension() fills in the main procs;
+ * extensions that keep their requests in vectors indexed by minor opcode
+ * add those with SetExtensionRequestVectors() so Dispatch() can call the
+ * request's proc directly.
+ */
+typedef int (*RequestProcPtr) (ClientPtr);
+
+typedef struct _ExtensionDispatch {
+    ExtensionEntry *ext;
+    Bool standardMinor;         /* minor opcode is in the data byte */
+    int numRequests;
+    RequestProcPtr main[2];     /* unswapped, swapped */
+    RequestProcPtr *requests[2];
+} ExtensionDispatchRec, *ExtensionDispatchPtr;
+
+extern ExtensionDispatchRec ExtensionDispatch[256];
+
 #endif /* _XSERVER_EXTENSION_PRIV_H */
@@ -91,6 +91,7 @@ Equipment Corporation.
 #include "dix/dix_priv.h"
 #include "dix/input_priv.h"
 #include "dix/gc_priv.h"
+#include "dix/profile_priv.h"
 #include "dix/registry_priv.h"
 #include "dix/selection_priv.h"
 #include "os/audit.h"
@@ -284,6 +285,8 @@ dix_main(int argc, char *argv[], char *envp[])
 
         InputThreadInit();
 
+        ProfileInit();
+
         Dispatch();
 
         UnrefCursor(rootCursor);
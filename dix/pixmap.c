@@ -31,6 +31,7 @@ from The Open Group.
 #include <X11/X.h>
 #include <X11/extensions/render.h>
 
+#include "dix/privates_priv.h"
 #include "mi/mi_priv.h"
 
 #include "scrnintstr.h"
@@ -101,7 +102,8 @@ AllocatePixmap(ScreenPtr pScreen, int pixDataSize)
     if (pScreen->totalPixmapSize > ((size_t) - 1) - pixDataSize)
         return NullPixmap;
 
-    pPixmap = calloc(1, pScreen->totalPixmapSize + pixDataSize);
+    pPixmap = dixAllocateObject(PRIVATE_PIXMAP,
+                                pScreen->totalPixmapSize + pixDataSize);
     if (!pPixmap)
         return NullPixmap;
 
@@ -114,7 +116,7 @@ void
 FreePixmap(PixmapPtr pPixmap)
 {
     dixFiniPrivates(pPixmap, PRIVATE_PIXMAP);
-    free(pPixmap);
+    dixFreeObject(pPixmap, PRIVATE_PIXMAP);
 }
 
 void PixmapUnshareSecondaryPixmap(PixmapPtr secondary_pixmap)
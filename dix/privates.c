@@ -53,6 +53,7 @@ from The Open Group.
 #include <stddef.h>
 
 #include "dix/colormap_priv.h"
+#include "dix/privates_priv.h"
 
 #include "windowstr.h"
 #include "resource.h"
@@ -63,6 +64,7 @@ from The Open Group.
 #include "scrnintstr.h"
 #include "extnsionst.h"
 #include "inputstr.h"
+#include "list.h"
 
 static DevPrivateSetRec global_keys[PRIVATE_LAST];
 
@@ -292,6 +294,228 @@ static Bool (*const allocated_early[PRIVATE_LAST]) (FixupFunc, unsigned) = {
     [PRIVATE_DEVICE] = fixupDevices,
 };
 
+/*
+ * Slab caches
+ *
+ * Windows, GCs, pixmaps and pictures are created and destroyed at a high
+ * rate, so objects of these types are carved out of slabs of
+ * PRIVATE_SLAB_BYTES instead of being allocated one by one.  Each type has
+ * a few caches, one per object size: the size of the privates is fixed once
+ * the first object is created, but screen-specific privates differ between
+ * screens and pixmaps may carry their pixels.  Every object of these types
+ * is preceded by a header pointing to its slab, or NULL if it didn't fit in
+ * one.  Registering a new key for a type throws its unused slabs away, the
+ * next object creates a cache for the new size.
+ */
+#define PRIVATE_SLAB_BYTES      16384
+#define PRIVATE_SLAB_MAX_OBJECT 2048
+#define PRIVATE_SLAB_CACHES     4
+#define PRIVATE_OBJECT_ALIGN    16
+
+static const Bool slab_private[PRIVATE_LAST] = {
+    [PRIVATE_WINDOW] = TRUE,
+    [PRIVATE_PIXMAP] = TRUE,
+    [PRIVATE_GC] = TRUE,
+    [PRIVATE_PICTURE] = TRUE,
+};
+
+typedef struct _PrivateSlabCache *PrivateSlabCachePtr;
+
+typedef struct _PrivateSlab {
+    PrivateSlabCachePtr cache;
+    struct xorg_list entry;     /* in cache->partial unless full */
+    void *free;                 /* free objects, through their header */
+    int used;
+} PrivateSlabRec, *PrivateSlabPtr;
+
+typedef union _PrivateObjectHeader {
+    PrivateSlabPtr slab;        /* while allocated */
+    union _PrivateObjectHeader *next;   /* while free */
+    char align[PRIVATE_OBJECT_ALIGN];
+} PrivateObjectHeader;
+
+typedef struct _PrivateSlabCache {
+    unsigned size;              /* per object, header included, 0 if unused */
+    int perSlab;
+    int slabs;
+    int empty;                  /* slabs without any objects in use */
+    int live;                   /* objects in use */
+    struct xorg_list partial;   /* slabs with free objects, emptiest last */
+} PrivateSlabCacheRec;
+
+typedef struct _PrivateSlabType {
+    PrivateSlabCacheRec caches[PRIVATE_SLAB_CACHES];
+    unsigned long allocs;       /* objects allocated */
+    unsigned long reused;       /* of those, from an existing slab */
+} PrivateSlabTypeRec;
+
+static PrivateSlabTypeRec slab_types[PRIVATE_LAST];
+
+#define SLAB_HEADER_SIZE \
+    ((sizeof(PrivateSlabRec) + PRIVATE_OBJECT_ALIGN - 1) & \
+     ~(PRIVATE_OBJECT_ALIGN - 1))
+
+static void
+dixSlabCacheRelease(PrivateSlabCachePtr cache)
+{
+    PrivateSlabPtr slab, tmp;
+
+    assert(!cache->live);
+    if (cache->size) {
+        xorg_list_for_each_entry_safe(slab, tmp, &cache->partial, entry)
+            free(slab);
+    }
+    memset(cache, 0, sizeof(*cache));
+}
+
+/* Throw away the slabs of type that have no objects in them */
+static void
+dixSlabFlush(DevPrivateType type)
+{
+    int c;
+
+    for (c = 0; c < PRIVATE_SLAB_CACHES; c++) {
+        PrivateSlabCachePtr cache = &slab_types[type].caches[c];
+
+        if (cache->size && !cache->live)
+            dixSlabCacheRelease(cache);
+    }
+}
+
+static PrivateSlabCachePtr
+dixSlabCache(DevPrivateType type, unsigned size)
+{
+    PrivateSlabCachePtr cache, unused = NULL;
+    int c;
+
+    for (c = 0; c < PRIVATE_SLAB_CACHES; c++) {
+        cache = &slab_types[type].caches[c];
+        if (cache->size == size)
+            return cache;
+        if (!unused && !cache->live)
+            unused = cache;
+    }
+    if (!unused)
+        return NULL;
+
+    dixSlabCacheRelease(unused);
+    unused->size = size;
+    unused->perSlab = (PRIVATE_SLAB_BYTES - SLAB_HEADER_SIZE) / size;
+    if (unused->perSlab < 4)
+        unused->perSlab = 4;
+    xorg_list_init(&unused->partial);
+    return unused;
+}
+
+static PrivateSlabPtr
+dixSlabGrow(PrivateSlabCachePtr cache)
+{
+    PrivateSlabPtr slab;
+    char *object;
+    int i;
+
+    slab = malloc(SLAB_HEADER_SIZE + (size_t) cache->perSlab * cache->size);
+    if (!slab)
+        return NULL;
+    slab->cache = cache;
+    slab->used = 0;
+    slab->free = NULL;
+    object = (char *) slab + SLAB_HEADER_SIZE;
+    for (i = 0; i < cache->perSlab; i++, object += cache->size) {
+        ((PrivateObjectHeader *) object)->next = slab->free;
+        slab->free = object;
+    }
+    xorg_list_add(&slab->entry, &cache->partial);
+    cache->slabs++;
+    cache->empty++;
+    return slab;
+}
+
+void *
+dixAllocateObject(DevPrivateType type, size_t size)
+{
+    PrivateSlabCachePtr cache = NULL;
+    PrivateObjectHeader *header;
+    PrivateSlabPtr slab;
+
+    if (!slab_private[type])
+        return calloc(1, size);
+
+    size = (size + sizeof(PrivateObjectHeader) + PRIVATE_OBJECT_ALIGN - 1) &
+        ~(PRIVATE_OBJECT_ALIGN - 1);
+    slab_types[type].allocs++;
+
+    if (size <= PRIVATE_SLAB_MAX_OBJECT)
+        cache = dixSlabCache(type, size);
+    if (!cache) {
+        if (!(header = calloc(1, size)))
+            return NULL;
+        header->slab = NULL;
+        return header + 1;
+    }
+
+    if (xorg_list_is_empty(&cache->partial)) {
+        if (!(slab = dixSlabGrow(cache)))
+            return NULL;
+    }
+    else {
+        slab = xorg_list_first_entry(&cache->partial, PrivateSlabRec, entry);
+        slab_types[type].reused++;
+    }
+
+    header = slab->free;
+    slab->free = header->next;
+    if (!slab->used++)
+        cache->empty--;
+    if (!slab->free)
+        xorg_list_del(&slab->entry);
+    cache->live++;
+
+    header->slab = slab;
+    memset(header + 1, 0, size - sizeof(*header));
+    return header + 1;
+}
+
+void
+dixFreeObject(void *object, DevPrivateType type)
+{
+    PrivateObjectHeader *header;
+    PrivateSlabCachePtr cache;
+    PrivateSlabPtr slab;
+
+    if (!slab_private[type] || !object) {
+        free(object);
+        return;
+    }
+
+    header = (PrivateObjectHeader *) object - 1;
+    if (!(slab = header->slab)) {
+        free(header);
+        return;
+    }
+    cache = slab->cache;
+
+    /* a full slab goes back to the front, so that it is refilled first */
+    if (!slab->free)
+        xorg_list_add(&slab->entry, &cache->partial);
+    header->next = slab->free;
+    slab->free = header;
+    cache->live--;
+
+    if (!--slab->used) {
+        /* keep one empty slab around, free any others */
+        xorg_list_del(&slab->entry);
+        if (cache->empty) {
+            free(slab);
+            cache->slabs--;
+        }
+        else {
+            xorg_list_append(&slab->entry, &cache->partial);
+            cache->empty++;
+        }
+    }
+}
+
 static void
 grow_private_set(DevPrivateSetPtr set, unsigned bytes)
 {
@@ -370,6 +594,7 @@ dixRegisterPrivateKey(DevPrivateKey key, DevPrivateType type, unsigned size)
                 grow_screen_specific_set(t, bytes);
                 if (allocated_early[t])
                     allocated_early[t] (dixMovePrivates, bytes);
+                dixSlabFlush(t);
             }
 
         }
@@ -385,6 +610,7 @@ dixRegisterPrivateKey(DevPrivateKey key, DevPrivateType type, unsigned size)
         offset = global_keys[type].offset;
         global_keys[type].offset += bytes;
         grow_screen_specific_set(type, bytes);
+        dixSlabFlush(type);
     }
 
     /* Setup this key */
@@ -481,7 +707,7 @@ _dixAllocateObjectWithPrivates(unsigned baseSize, unsigned clear,
     /* round up so that void * is aligned */
     baseSize = (baseSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
     totalSize = baseSize + global_keys[type].offset;
-    void *object = calloc(1, totalSize);
+    void *object = dixAllocateObject(type, totalSize);
     if (!object)
         return NULL;
 
@@ -534,7 +760,7 @@ _dixFreeObjectWithPrivates(void *object, PrivatePtr privates,
                            DevPrivateType type)
 {
     _dixFiniPrivates(privates, type);
-    free(object);
+    dixFreeObject(object, type);
 }
 
 /*
@@ -626,6 +852,7 @@ dixRegisterScreenSpecificPrivateKey(ScreenPtr pScreen, DevPrivateKey key,
     assert (!pScreen->screenSpecificPrivates[type].created);
     offset = pScreen->screenSpecificPrivates[type].offset;
     pScreen->screenSpecificPrivates[type].offset += bytes;
+    dixSlabFlush(type);
 
     /* Setup this key */
     key->offset = offset;
@@ -710,7 +937,7 @@ _dixAllocateScreenObjectWithPrivates(ScreenPtr pScreen,
     /* round up so that pointer is aligned */
     baseSize = (baseSize + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
     totalSize = baseSize + privates_size;
-    void *object = calloc(1, totalSize);
+    void *object = dixAllocateObject(type, totalSize);
     if (!object)
         return NULL;
 
@@ -752,6 +979,21 @@ dixPrivateUsage(void)
             objects += global_keys[t].created;
             alloc += global_keys[t].allocated;
         }
+        if (slab_types[t].allocs) {
+            PrivateSlabTypeRec *st = &slab_types[t];
+            unsigned long slab_bytes = 0;
+            int c, slabs = 0;
+
+            for (c = 0; c < PRIVATE_SLAB_CACHES; c++) {
+                slabs += st->caches[c].slabs;
+                slab_bytes += (unsigned long) st->caches[c].slabs *
+                    (SLAB_HEADER_SIZE +
+                     st->caches[c].perSlab * st->caches[c].size);
+            }
+            ErrorF("%s: %lu allocs, %lu from existing slabs, "
+                   "%d slabs = %lu bytes\n", key_names[t], st->allocs,
+                   st->reused, slabs, slab_bytes);
+        }
     }
     ErrorF("TOTAL: %d objects, %d bytes, %d allocs\n", objects, bytes, alloc);
 }
@@ -782,6 +1024,9 @@ dixResetPrivates(void)
         global_keys[t].offset = 0;
         global_keys[t].created = 0;
         global_keys[t].allocated = 0;
+        dixSlabFlush(t);
+        slab_types[t].allocs = 0;
+        slab_types[t].reused = 0;
     }
 }
 
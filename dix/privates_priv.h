@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Object allocation internals
+ */
+#ifndef _XSERVER_DIX_PRIVATES_PRIV_H
+#define _XSERVER_DIX_PRIVATES_PRIV_H
+
+#include <stddef.h>
+
+#include "include/privates.h"
+
+/*
+ * Allocate size zeroed bytes for an object of the given type, from the
+ * type's slab caches if it has any.  The object must be released with
+ * dixFreeObject() and the same type.
+ */
+void *dixAllocateObject(DevPrivateType type, size_t size);
+
+void dixFreeObject(void *object, DevPrivateType type);
+
+#endif /* _XSERVER_DIX_PRIVATES_PRIV_H */
@@ -0,0 +1,315 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Per-request profiling.
+ *
+ * When enabled, Dispatch() accounts every request it executes to its
+ * (major, minor) opcode and to the client that sent it: how many there
+ * were, how long they took, the longest one and how many bytes went in
+ * and out.  Profiling is switched on with -profile or at runtime with
+ * SIGUSR2; the next SIGUSR2 writes the statistics to the log and switches
+ * it off again.  While disabled, the cost is a single branch per request.
+ */
+
+#include <dix-config.h>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "dix/dix_priv.h"
+#include "dix/dixstruct_priv.h"
+#include "dix/profile_priv.h"
+#include "dix/registry_priv.h"
+#include "os/client_priv.h"
+#include "os/osdep.h"
+
+#include "dixstruct.h"
+#include "misc.h"
+#include "os.h"
+
+Bool ProfileEnabled = FALSE;
+volatile char ProfileTogglePending = FALSE;
+
+typedef struct _ProfileClient {
+    ProfileCountersRec counters;
+    CARD64 written;
+} ProfileClientRec, *ProfileClientPtr;
+
+typedef struct _ProfileLine {
+    char name[64];
+    ProfileCountersRec counters;
+} ProfileLineRec, *ProfileLinePtr;
+
+/* core requests have a single entry, extensions one per minor opcode */
+static ProfileCountersPtr profileRequests[256];
+static ProfileClientPtr profileClients[MAXCLIENTS];
+static ProfileCountersRec profileGoneClients;
+static CARD64 profileStart;
+
+static void
+ProfileAdd(ProfileCountersPtr counters, CARD64 usec, CARD64 bytes_in,
+           CARD64 bytes_out)
+{
+    counters->count++;
+    counters->time += usec;
+    if (usec > counters->max_time)
+        counters->max_time = usec;
+    counters->bytes_in += bytes_in;
+    counters->bytes_out += bytes_out;
+}
+
+static void
+ProfileMerge(ProfileCountersPtr to, const ProfileCountersRec *from)
+{
+    to->count += from->count;
+    to->time += from->time;
+    if (from->max_time > to->max_time)
+        to->max_time = from->max_time;
+    to->bytes_in += from->bytes_in;
+    to->bytes_out += from->bytes_out;
+}
+
+void
+ProfileRequest(ClientPtr client, CARD64 usec, CARD64 bytes_out)
+{
+    int major = client->majorOp;
+    int minor = major < EXTENSION_BASE ? 0 : client->minorOp;
+    CARD64 bytes_in = (CARD64) client->req_len << 2;
+
+    if (!profileRequests[major]) {
+        profileRequests[major] = calloc(major < EXTENSION_BASE ? 1 : 256,
+                                        sizeof(ProfileCountersRec));
+        if (!profileRequests[major])
+            return;
+    }
+    ProfileAdd(&profileRequests[major][minor], usec, bytes_in, bytes_out);
+
+    if (profileClients[client->index])
+        ProfileAdd(&profileClients[client->index]->counters, usec, bytes_in,
+                   bytes_out);
+}
+
+void
+ProfileOutput(ClientPtr client, int count)
+{
+    ProfileClientPtr pc = profileClients[client->index];
+
+    if (!pc) {
+        pc = calloc(1, sizeof(ProfileClientRec));
+        if (!pc)
+            return;
+        profileClients[client->index] = pc;
+    }
+    pc->written += count;
+}
+
+CARD64
+ProfileClientOutput(ClientPtr client)
+{
+    /* make sure the record exists before the request is accounted to it */
+    ProfileOutput(client, 0);
+    return profileClients[client->index] ?
+        profileClients[client->index]->written : 0;
+}
+
+void
+ProfileClientGone(ClientPtr client)
+{
+    ProfileClientPtr pc = profileClients[client->index];
+
+    profileClients[client->index] = NULL;
+
+    if (pc) {
+        pc->counters.bytes_out = pc->written;
+        ProfileMerge(&profileGoneClients, &pc->counters);
+        free(pc);
+    }
+}
+
+Bool
+ProfileGetRequest(int major, int minor, ProfileCountersPtr counters)
+{
+    if (major < 0 || major > 255 || minor < 0 || minor > 255 ||
+        !profileRequests[major])
+        return FALSE;
+    *counters = profileRequests[major][major < EXTENSION_BASE ? 0 : minor];
+    return counters->count != 0;
+}
+
+Bool
+ProfileGetClient(ClientPtr client, ProfileCountersPtr counters)
+{
+    if (!profileClients[client->index])
+        return FALSE;
+    *counters = profileClients[client->index]->counters;
+    return TRUE;
+}
+
+static const char *
+ProfileRequestName(int major, int minor)
+{
+#ifdef X_REGISTRY_REQUEST
+    return major < EXTENSION_BASE ? LookupMajorName(major) :
+        LookupRequestName(major, minor);
+#else
+    return XREGISTRY_UNKNOWN;
+#endif
+}
+
+static int
+ProfileCompareLines(const void *a, const void *b)
+{
+    const ProfileLineRec *la = a, *lb = b;
+
+    if (la->counters.time != lb->counters.time)
+        return la->counters.time < lb->counters.time ? 1 : -1;
+    return la->counters.count < lb->counters.count ? 1 :
+        la->counters.count > lb->counters.count ? -1 : 0;
+}
+
+static void
+ProfileLogLines(const char *what, ProfileLinePtr lines, int n)
+{
+    int i;
+
+    qsort(lines, n, sizeof(*lines), ProfileCompareLines);
+
+    LogMessageVerb(X_NONE, 0, "%12s %12s %10s %10s %14s %14s  %s\n",
+                   "requests", "total ms", "avg us", "max us",
+                   "bytes in", "bytes out", what);
+    for (i = 0; i < n; i++) {
+        ProfileCountersPtr c = &lines[i].counters;
+
+        LogMessageVerb(X_NONE, 0,
+                       "%12llu %12llu %10llu %10llu %14llu %14llu  %s\n",
+                       (unsigned long long) c->count,
+                       (unsigned long long) (c->time / 1000),
+                       (unsigned long long) (c->time / c->count),
+                       (unsigned long long) c->max_time,
+                       (unsigned long long) c->bytes_in,
+                       (unsigned long long) c->bytes_out, lines[i].name);
+    }
+}
+
+void
+ProfileDump(void)
+{
+    ProfileLinePtr lines;
+    int major, minor, i, n;
+
+    n = MAXCLIENTS;
+    for (major = 0; major < 256; major++)
+        for (minor = 0; profileRequests[major] &&
+             minor < (major < EXTENSION_BASE ? 1 : 256); minor++)
+            n += !!profileRequests[major][minor].count;
+
+    lines = calloc(n, sizeof(ProfileLineRec));
+    if (!lines)
+        return;
+
+    LogMessage(X_INFO, "Request profile over %llu seconds:\n",
+               (unsigned long long) ((GetTimeInMicros() - profileStart) /
+                                     1000000));
+
+    n = 0;
+    for (major = 0; major < 256; major++) {
+        if (!profileRequests[major])
+            continue;
+        for (minor = 0; minor < (major < EXTENSION_BASE ? 1 : 256); minor++) {
+            if (!profileRequests[major][minor].count)
+                continue;
+            snprintf(lines[n].name, sizeof(lines[n].name), "%s (%d.%d)",
+                     ProfileRequestName(major, minor), major, minor);
+            lines[n++].counters = profileRequests[major][minor];
+        }
+    }
+    ProfileLogLines("request", lines, n);
+
+    n = 0;
+    for (i = 1; i < MAXCLIENTS; i++) {
+        const char *cmd;
+
+        if (!profileClients[i] || !profileClients[i]->counters.count)
+            continue;
+        cmd = clients[i] ? GetClientCmdName(clients[i]) : NULL;
+        snprintf(lines[n].name, sizeof(lines[n].name), "%d (%s)", i,
+                 cmd ? cmd : "unknown");
+        lines[n].counters = profileClients[i]->counters;
+        lines[n++].counters.bytes_out = profileClients[i]->written;
+    }
+    if (profileGoneClients.count) {
+        snprintf(lines[n].name, sizeof(lines[n].name), "disconnected clients");
+        lines[n++].counters = profileGoneClients;
+    }
+    ProfileLogLines("client", lines, n);
+
+    free(lines);
+
+    /* and how long the clients still around had to wait, -schedLatency */
+    SmartScheduleLogLatency();
+}
+
+static void
+ProfileReset(void)
+{
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        free(profileRequests[i]);
+        profileRequests[i] = NULL;
+    }
+    for (i = 0; i < MAXCLIENTS; i++) {
+        free(profileClients[i]);
+        profileClients[i] = NULL;
+    }
+    memset(&profileGoneClients, 0, sizeof(profileGoneClients));
+    profileStart = GetTimeInMicros();
+}
+
+void
+ProfileToggle(void)
+{
+    ProfileTogglePending = FALSE;
+
+    if (ProfileEnabled) {
+        ProfileEnabled = FALSE;
+        ProfileDump();
+        LogMessage(X_INFO, "Request profiling disabled\n");
+    }
+    else {
+        ProfileReset();
+        ProfileEnabled = TRUE;
+        LogMessage(X_INFO, "Request profiling enabled\n");
+    }
+}
+
+#ifdef SIGUSR2
+static void
+ProfileSignal(int signo)
+{
+    ProfileTogglePending = TRUE;
+}
+#endif
+
+void
+ProfileInit(void)
+{
+    static Bool been_here;
+
+    if (been_here)
+        return;
+    been_here = TRUE;
+
+#ifdef SIGUSR2
+    {
+        OsSigHandlerPtr old = OsSignal(SIGUSR2, ProfileSignal);
+
+        /* leave SIGUSR2 alone if the DDX uses it */
+        if (old != SIG_DFL)
+            OsSignal(SIGUSR2, old);
+    }
+#endif
+    profileStart = GetTimeInMicros();
+}
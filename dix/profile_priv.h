@@ -0,0 +1,52 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Per-request profiling
+ */
+#ifndef _XSERVER_DIX_PROFILE_PRIV_H
+#define _XSERVER_DIX_PROFILE_PRIV_H
+
+#include <X11/Xdefs.h>
+#include <X11/Xmd.h>
+
+struct _Client;
+
+typedef struct _ProfileCounters {
+    CARD64 count;               /* requests */
+    CARD64 time;                /* total microseconds spent in them */
+    CARD64 max_time;            /* longest one, in microseconds */
+    CARD64 bytes_in;            /* request bytes */
+    CARD64 bytes_out;           /* replies, events and errors */
+} ProfileCountersRec, *ProfileCountersPtr;
+
+/* whether requests are being profiled, -profile or toggled by SIGUSR2 */
+extern Bool ProfileEnabled;
+
+/* SIGUSR2 was received, the main loop calls ProfileToggle() */
+extern volatile char ProfileTogglePending;
+
+/* Install the SIGUSR2 handler and start profiling if -profile was given */
+void ProfileInit(void);
+
+/* Switch profiling on, or dump the statistics to the log and switch it off */
+void ProfileToggle(void);
+
+/* Account for the request client has just executed */
+void ProfileRequest(struct _Client *client, CARD64 usec, CARD64 bytes_out);
+
+/* Account for count bytes of output to client */
+void ProfileOutput(struct _Client *client, int count);
+
+/* Total number of bytes written to client so far */
+CARD64 ProfileClientOutput(struct _Client *client);
+
+void ProfileClientGone(struct _Client *client);
+
+/* Statistics collected for one request type / client, FALSE if none */
+Bool ProfileGetRequest(int major, int minor, ProfileCountersPtr counters);
+Bool ProfileGetClient(struct _Client *client, ProfileCountersPtr counters);
+
+/* Write the statistics collected since profiling was switched on to the
+ * log, ProfileToggle() clears them when it switches profiling on again */
+void ProfileDump(void);
+
+#endif /* _XSERVER_DIX_PROFILE_PRIV_H */
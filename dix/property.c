@@ -71,8 +71,198 @@ SOFTWARE.
  *   Properties belong to windows.  The list of properties should not be
  *   traversed directly.  Instead, use the three functions listed above.
  *
+ *   Once a window has PROPERTY_INDEX_THRESHOLD properties, an index from
+ *   name to the first property of that name in the list is built, so
+ *   lookups on windows with many properties (typically the root window)
+ *   don't have to walk the list.  It is dropped again when the window
+ *   gets below the threshold.  The list itself stays the authority:
+ *   it keeps the order ListProperties reports, and security modules may
+ *   walk on from the property found to other instances of the same name.
+ *
  *****************************************************************/
 
+typedef struct _PropertyIndexSlot {
+    Atom name;                  /* None if the slot is empty */
+    PropertyPtr prop;
+} PropertyIndexSlotRec;
+
+typedef struct _PropertyIndex {
+    unsigned int count;         /* properties in the list */
+    unsigned int dups;          /* properties sharing a name with another */
+    unsigned int mask;          /* number of slots - 1 */
+    PropertyIndexSlotRec slots[];
+} PropertyIndexRec, *PropertyIndexPtr;
+
+static inline unsigned int
+PropertyIndexHash(PropertyIndexPtr index, Atom name)
+{
+    return (name * 0x9e3779b1U) & index->mask;
+}
+
+static PropertyIndexSlotRec *
+PropertyIndexFind(PropertyIndexPtr index, Atom name)
+{
+    unsigned int i;
+
+    for (i = PropertyIndexHash(index, name);
+         index->slots[i].name != None && index->slots[i].name != name;
+         i = (i + 1) & index->mask);
+    return &index->slots[i];
+}
+
+static void
+PropertyIndexRemove(PropertyIndexPtr index, PropertyIndexSlotRec *slot)
+{
+    unsigned int i = slot - index->slots, j = i, home;
+
+    /* shift following entries back so probes never see a hole */
+    for (;;) {
+        j = (j + 1) & index->mask;
+        if (index->slots[j].name == None)
+            break;
+        home = PropertyIndexHash(index, index->slots[j].name);
+        if ((i <= j) ? (i < home && home <= j) : (i < home || home <= j))
+            continue;
+        index->slots[i] = index->slots[j];
+        i = j;
+    }
+    index->slots[i].name = None;
+    index->slots[i].prop = NULL;
+}
+
+/*
+ * (Re)build the index of a window from its property list, sized for
+ * count properties.  On allocation failure the window just keeps using
+ * the list.
+ */
+static void
+BuildPropertyIndex(WindowPtr pWin, unsigned int count)
+{
+    PropertyIndexPtr index;
+    PropertyPtr pProp;
+    unsigned int size = PROPERTY_INDEX_THRESHOLD * 4;
+
+    while (size < count * 4)
+        size <<= 1;
+    index = calloc(1, sizeof(PropertyIndexRec) +
+                   size * sizeof(PropertyIndexSlotRec));
+    free(pWin->propertyIndex);
+    pWin->propertyIndex = index;
+    if (!index)
+        return;
+
+    index->mask = size - 1;
+    for (pProp = pWin->properties; pProp; pProp = pProp->next) {
+        PropertyIndexSlotRec *slot = PropertyIndexFind(index, pProp->propertyName);
+
+        index->count++;
+        if (slot->name == None) {
+            slot->name = pProp->propertyName;
+            slot->prop = pProp;
+        }
+        else
+            index->dups++;
+    }
+}
+
+static PropertyPtr
+FindProperty(WindowPtr pWin, Atom propertyName)
+{
+    PropertyPtr pProp;
+
+    if (pWin->propertyIndex)
+        return PropertyIndexFind(pWin->propertyIndex, propertyName)->prop;
+
+    for (pProp = pWin->properties; pProp; pProp = pProp->next)
+        if (pProp->propertyName == propertyName)
+            break;
+    return pProp;
+}
+
+static void
+LinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->propertyIndex;
+
+    pProp->next = pWin->properties;
+    pWin->properties = pProp;
+
+    if (index) {
+        PropertyIndexSlotRec *slot;
+
+        /* keep the load factor at or below one half */
+        if (++index->count * 2 > index->mask) {
+            BuildPropertyIndex(pWin, index->count);
+            return;
+        }
+        slot = PropertyIndexFind(index, pProp->propertyName);
+        if (slot->name != None)
+            index->dups++;
+        /* the new property is at the head, so it's the first of its name */
+        slot->name = pProp->propertyName;
+        slot->prop = pProp;
+    }
+    else {
+        unsigned int count = 0;
+
+        for (pProp = pWin->properties; pProp && count < PROPERTY_INDEX_THRESHOLD;
+             pProp = pProp->next)
+            count++;
+        if (count >= PROPERTY_INDEX_THRESHOLD)
+            BuildPropertyIndex(pWin, count);
+    }
+}
+
+static void
+UnlinkProperty(WindowPtr pWin, PropertyPtr pProp)
+{
+    PropertyIndexPtr index = pWin->propertyIndex;
+    PropertyPtr prevProp;
+
+    if (pWin->properties == pProp) {
+        /* Takes care of head */
+        if (!(pWin->properties = pProp->next))
+            CheckWindowOptionalNeed(pWin);
+    }
+    else {
+        /* Need to traverse to find the previous element */
+        prevProp = pWin->properties;
+        while (prevProp->next != pProp)
+            prevProp = prevProp->next;
+        prevProp->next = pProp->next;
+    }
+
+    if (index && index->count <= PROPERTY_INDEX_THRESHOLD) {
+        /* few enough for the list again */
+        free(index);
+        pWin->propertyIndex = NULL;
+    }
+    else if (index) {
+        PropertyIndexSlotRec *slot = PropertyIndexFind(index, pProp->propertyName);
+
+        index->count--;
+        if (slot->prop != pProp) {
+            /* a later instance of a name that's still indexed */
+            index->dups--;
+        }
+        else if (index->dups) {
+            PropertyPtr next;
+
+            for (next = pProp->next; next; next = next->next)
+                if (next->propertyName == pProp->propertyName)
+                    break;
+            if (next) {
+                slot->prop = next;
+                index->dups--;
+            }
+            else
+                PropertyIndexRemove(index, slot);
+        }
+        else
+            PropertyIndexRemove(index, slot);
+    }
+}
+
 #ifdef notdef
 static void
 PrintPropertys(WindowPtr pWin)
@@ -101,10 +291,7 @@ dixLookupProperty(PropertyPtr *result, WindowPtr pWin, Atom propertyName,
 
     client->errorValue = propertyName;
 
-    for (pProp = pWin->properties; pProp; pProp = pProp->next)
-        if (pProp->propertyName == propertyName)
-            break;
-
+    pProp = FindProperty(pWin, propertyName);
     if (pProp)
         rc = XaceHookPropertyAccess(client, pWin, &pProp, access_mode);
     *result = pProp;
@@ -362,8 +549,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
             pClient->errorValue = property;
             return rc;
         }
-        pProp->next = pWin->properties;
-        pWin->properties = pProp;
+        LinkProperty(pWin, pProp);
     }
     else if (rc == Success) {
         /* To append or prepend to a property the request format and type
@@ -441,7 +627,7 @@ dixChangeWindowProperty(ClientPtr pClient, WindowPtr pWin, Atom property,
 int
 DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     int rc;
 
     rc = dixLookupProperty(&pProp, pWin, propName, client, DixDestroyAccess);
@@ -449,18 +635,7 @@ DeleteProperty(ClientPtr client, WindowPtr pWin, Atom propName)
         return Success;         /* Succeed if property does not exist */
 
     if (rc == Success) {
-        if (pWin->properties == pProp) {
-            /* Takes care of head */
-            if (!(pWin->properties = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->properties;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        UnlinkProperty(pWin, pProp);
 
         deliverPropertyNotifyEvent(pWin, PropertyDelete, pProp);
         notifyVRRMode(client, pWin, PropertyDelete, pProp);
@@ -484,6 +659,8 @@ DeleteAllWindowProperties(WindowPtr pWin)
     }
 
     pWin->properties = NULL;
+    free(pWin->propertyIndex);
+    pWin->propertyIndex = NULL;
 }
 
 /*****************
@@ -499,7 +676,7 @@ DeleteAllWindowProperties(WindowPtr pWin)
 int
 ProcGetProperty(ClientPtr client)
 {
-    PropertyPtr pProp, prevProp;
+    PropertyPtr pProp;
     unsigned long n, len, ind;
     int rc;
     Mask win_mode = DixGetPropAccess, prop_mode = DixReadAccess;
@@ -612,25 +789,22 @@ ProcGetProperty(ClientPtr client)
         notifyVRRMode(client, pWin, PropertyDelete, pProp);
     }
 
-    void *payload = calloc(1, len);
-    if (!payload)
-        return BadAlloc;
-    memcpy(payload, (char*)(pProp->data) + ind, len);
+    void *payload;
+    if (p.delete && (rep.bytesAfter == 0) && (ind == 0)) {
+        /* all of it, and the property goes away: send its data as is */
+        payload = pProp->data;
+        pProp->data = NULL;
+    }
+    else {
+        payload = malloc(len);
+        if (!payload)
+            return BadAlloc;
+        memcpy(payload, (char*)(pProp->data) + ind, len);
+    }
 
     if (p.delete && (rep.bytesAfter == 0)) {
         /* Delete the Property */
-        if (pWin->properties == pProp) {
-            /* Takes care of head */
-            if (!(pWin->properties = pProp->next))
-                CheckWindowOptionalNeed(pWin);
-        }
-        else {
-            /* Need to traverse to find the previous element */
-            prevProp = pWin->properties;
-            while (prevProp->next != pProp)
-                prevProp = prevProp->next;
-            prevProp->next = pProp->next;
-        }
+        UnlinkProperty(pWin, pProp);
 
         free(pProp->data);
         dixFreeObjectWithPrivates(pProp, PRIVATE_PROPERTY);
@@ -649,8 +823,8 @@ ProcGetProperty(ClientPtr client)
     }
 
     WriteToClient(client, sizeof(rep), &rep);
-    WriteToClient(client, len, payload);
-    free(payload);
+    /* large values are written from payload, which is freed afterwards */
+    WriteToClientRef(client, len, payload, free, payload);
     return Success;
 }
 
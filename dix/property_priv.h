@@ -57,6 +57,9 @@ SOFTWARE.
 #include "window.h"
 #include "property.h"
 
+/* properties on a window from which lookups go through an index */
+#define PROPERTY_INDEX_THRESHOLD 16
+
 typedef struct _PropertyStateRec {
     WindowPtr win;
     PropertyPtr prop;
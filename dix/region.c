@@ -77,6 +77,11 @@ Equipment Corporation.
 
 #include <dix-config.h>
 
+#include <stdint.h>
+#include <string.h>
+
+#include "dix/region_priv.h"
+
 #include "regionstr.h"
 #include <X11/Xprotostr.h>
 #include <X11/Xfuncproto.h>
@@ -231,6 +236,7 @@ InitRegions(void)
 {
     pixman_region_set_static_pointers(&RegionEmptyBox, &RegionEmptyData,
                                       &RegionBrokenData);
+    RegionSelectKernels(KERNELS_BEST);
 }
 
 /*****************************************************************
@@ -384,6 +390,150 @@ RegionRectAlloc(RegionPtr pRgn, int n)
     return TRUE;
 }
 
+/*======================================================================
+ *	    Band Kernels
+ *====================================================================*/
+
+/*
+ * The inner loops of the band walking code below: comparing the x
+ * coordinates of two bands when coalescing them and finding the end of a
+ * band.  Both look at one 16-bit lane of every box, so SSE2 handles two
+ * and AVX2 four boxes per compare; which set is used is picked at runtime.
+ * Large unsorted rectangle lists are radix sorted instead of quicksorted.
+ */
+
+typedef Bool (*BandXEqualProcPtr) (const BoxRec *a, const BoxRec *b, int n);
+typedef BoxPtr (*BandEndProcPtr) (BoxPtr r, BoxPtr rEnd, int y1);
+
+/* quicksort is faster below this */
+#define RADIX_SORT_MIN_RECTS 128
+
+static Bool
+RegionBandXEqualC(const BoxRec *a, const BoxRec *b, int n)
+{
+    do {
+        if (a->x1 != b->x1 || a->x2 != b->x2)
+            return FALSE;
+        a++;
+        b++;
+    } while (--n);
+    return TRUE;
+}
+
+static BoxPtr
+RegionBandEndC(BoxPtr r, BoxPtr rEnd, int y1)
+{
+    while (r != rEnd && r->y1 == y1)
+        r++;
+    return r;
+}
+
+#ifdef X86_KERNELS
+
+#include <immintrin.h>
+
+/* byte masks of the x1/x2 and the y1 lanes of boxes in a vector */
+#define BOX_X_LANES  0x3333
+#define BOX_Y1_LANES 0x0c0c
+
+__attribute__((target("sse2")))
+static Bool
+RegionBandXEqualSSE2(const BoxRec *a, const BoxRec *b, int n)
+{
+    for (; n >= 2; n -= 2, a += 2, b += 2) {
+        __m128i va = _mm_loadu_si128((const __m128i *) a);
+        __m128i vb = _mm_loadu_si128((const __m128i *) b);
+
+        if ((_mm_movemask_epi8(_mm_cmpeq_epi16(va, vb)) & BOX_X_LANES) !=
+            BOX_X_LANES)
+            return FALSE;
+    }
+    return !n || (a->x1 == b->x1 && a->x2 == b->x2);
+}
+
+__attribute__((target("sse2")))
+static BoxPtr
+RegionBandEndSSE2(BoxPtr r, BoxPtr rEnd, int y1)
+{
+    __m128i vy = _mm_set1_epi16(y1);
+
+    for (; rEnd - r >= 2; r += 2) {
+        __m128i v = _mm_loadu_si128((const __m128i *) r);
+        unsigned int diff =
+            ~_mm_movemask_epi8(_mm_cmpeq_epi16(v, vy)) & BOX_Y1_LANES;
+
+        if (diff)
+            return r + (__builtin_ctz(diff) >> 3);
+    }
+    return RegionBandEndC(r, rEnd, y1);
+}
+
+__attribute__((target("avx2")))
+static Bool
+RegionBandXEqualAVX2(const BoxRec *a, const BoxRec *b, int n)
+{
+    const unsigned int lanes = BOX_X_LANES | (BOX_X_LANES << 16);
+
+    for (; n >= 4; n -= 4, a += 4, b += 4) {
+        __m256i va = _mm256_loadu_si256((const __m256i *) a);
+        __m256i vb = _mm256_loadu_si256((const __m256i *) b);
+
+        if (((unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi16(va, vb)) &
+             lanes) != lanes)
+            return FALSE;
+    }
+    return !n || RegionBandXEqualSSE2(a, b, n);
+}
+
+__attribute__((target("avx2")))
+static BoxPtr
+RegionBandEndAVX2(BoxPtr r, BoxPtr rEnd, int y1)
+{
+    const unsigned int lanes = BOX_Y1_LANES | (BOX_Y1_LANES << 16);
+    __m256i vy = _mm256_set1_epi16(y1);
+
+    for (; rEnd - r >= 4; r += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) r);
+        unsigned int diff =
+            ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi16(v, vy)) &
+            lanes;
+
+        if (diff)
+            return r + (__builtin_ctz(diff) >> 3);
+    }
+    return RegionBandEndSSE2(r, rEnd, y1);
+}
+#endif /* x86 */
+
+static BandXEqualProcPtr RegionBandXEqual = RegionBandXEqualC;
+static BandEndProcPtr RegionBandEnd = RegionBandEndC;
+static Bool RegionRadixSort = FALSE;
+
+KernelLevel
+RegionSelectKernels(KernelLevel level)
+{
+    level = OsClampKernels(level);
+
+    switch (level) {
+#ifdef X86_KERNELS
+    case KERNELS_AVX2:
+        RegionBandXEqual = RegionBandXEqualAVX2;
+        RegionBandEnd = RegionBandEndAVX2;
+        break;
+    case KERNELS_SSE2:
+        RegionBandXEqual = RegionBandXEqualSSE2;
+        RegionBandEnd = RegionBandEndSSE2;
+        break;
+#endif
+    default:
+        RegionBandXEqual = RegionBandXEqualC;
+        RegionBandEnd = RegionBandEndC;
+        break;
+    }
+    RegionRadixSort = level != KERNELS_REFERENCE;
+    return level;
+}
+
 /*======================================================================
  *	    Generic Region Operator
  *====================================================================*/
@@ -442,24 +592,17 @@ RegionCoalesce(RegionPtr pReg,  /* Region to coalesce                */
      */
     y2 = pCurBox->y2;
 
-    do {
-        if ((pPrevBox->x1 != pCurBox->x1) || (pPrevBox->x2 != pCurBox->x2)) {
-            return curStart;
-        }
-        pPrevBox++;
-        pCurBox++;
-        numRects--;
-    } while (numRects);
+    if (!(*RegionBandXEqual) (pPrevBox, pCurBox, numRects))
+        return curStart;
 
     /*
      * The bands may be merged, so set the bottom y of each box
      * in the previous band to the bottom y of the current band.
      */
-    numRects = curStart - prevStart;
     pReg->data->numRects -= numRects;
     do {
-        pPrevBox--;
         pPrevBox->y2 = y2;
+        pPrevBox++;
         numRects--;
     } while (numRects);
     return prevStart;
@@ -519,9 +662,8 @@ RegionAppendNonO(RegionPtr pReg, BoxPtr r, BoxPtr rEnd, int y1, int y2)
 {							    \
     ry1 = r->y1;					    \
     rBandEnd = r+1;					    \
-    while ((rBandEnd != rEnd) && (rBandEnd->y1 == ry1)) {   \
-	rBandEnd++;					    \
-    }							    \
+    if ((rBandEnd != rEnd) && (rBandEnd->y1 == ry1))	    \
+	rBandEnd = (*RegionBandEnd) (rBandEnd + 1, rEnd, ry1); \
 }
 
 #define	AppendRegions(newReg, r, rEnd)					\
@@ -1105,6 +1247,67 @@ QuickSortRects(BoxRec rects[], int numRects)
     } while (numRects > 1);
 }
 
+/* (y1, x1) as an unsigned sort key */
+#define RectKey(r) \
+    (((uint32_t) ((uint16_t) (r)->y1 ^ 0x8000) << 16) | \
+     ((uint16_t) (r)->x1 ^ 0x8000))
+
+/*
+ * Stable LSD radix sort on (y1, x1), one byte per pass.  Passes in which
+ * all keys have the same byte, like the high byte of x1 on small screens,
+ * are skipped.  Returns FALSE if the scratch array can't be allocated.
+ */
+static Bool
+RadixSortRects(BoxRec rects[], int numRects)
+{
+    uint32_t count[4][256];
+    BoxPtr tmp, src, dst, t;
+    uint32_t key;
+    int pass, i;
+
+    tmp = malloc(numRects * sizeof(BoxRec));
+    if (!tmp)
+        return FALSE;
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < numRects; i++) {
+        key = RectKey(&rects[i]);
+        count[0][key & 0xff]++;
+        count[1][(key >> 8) & 0xff]++;
+        count[2][(key >> 16) & 0xff]++;
+        count[3][key >> 24]++;
+    }
+
+    src = rects;
+    dst = tmp;
+    for (pass = 0; pass < 4; pass++) {
+        uint32_t *c = count[pass];
+        int shift = pass * 8;
+        uint32_t offset = 0, n;
+
+        /* all in one bucket, this pass wouldn't move anything */
+        if (c[(RectKey(&src[0]) >> shift) & 0xff] == (uint32_t) numRects)
+            continue;
+
+        for (i = 0; i < 256; i++) {
+            n = c[i];
+            c[i] = offset;
+            offset += n;
+        }
+        for (i = 0; i < numRects; i++)
+            dst[c[(RectKey(&src[i]) >> shift) & 0xff]++] = src[i];
+
+        t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != rects)
+        memcpy(rects, src, numRects * sizeof(BoxRec));
+    free(tmp);
+    return TRUE;
+}
+
 /*-
  *-----------------------------------------------------------------------
  * RegionValidate --
@@ -1184,7 +1387,9 @@ RegionValidate(RegionPtr badreg, Bool *pOverlap)
     }
 
     /* Step 1: Sort the rects array into ascending (y1, x1) order */
-    QuickSortRects(RegionBoxptr(badreg), numRects);
+    if (!RegionRadixSort || numRects < RADIX_SORT_MIN_RECTS ||
+        !RadixSortRects(RegionBoxptr(badreg), numRects))
+        QuickSortRects(RegionBoxptr(badreg), numRects);
 
     /* Step 2: Scatter the sorted array into the minimum number of regions */
 
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Region code internals
+ */
+#ifndef _XSERVER_DIX_REGION_PRIV_H
+#define _XSERVER_DIX_REGION_PRIV_H
+
+#include "os/kernels_priv.h"
+
+/*
+ * Pick how regions are built: KERNELS_REFERENCE quicksorts the rectangles
+ * given to RegionValidate() and scans bands one box at a time, every
+ * other level radix sorts large lists, and SSE2 or AVX2 compare two or
+ * four boxes per step when coalescing and splitting bands.  Returns the
+ * level the CPU allowed.  InitRegions() asks for KERNELS_BEST.
+ */
+KernelLevel RegionSelectKernels(KernelLevel level);
+
+#endif /* _XSERVER_DIX_REGION_PRIV_H */
@@ -105,8 +105,8 @@ Equipment Corporation.
  *      A resource ID is a 32 bit quantity, the upper 2 bits of which are
  *	off-limits for client-visible resources.  The next 8 bits are
  *      used as client ID, and the low 22 bits come from the client.
- *	A resource ID is "hashed" by extracting and xoring subfields
- *      (varying with the size of the hash table).
+ *	A resource ID is hashed by multiplying it with the golden ratio;
+ *      see the comment above the client table below.
  *
  *      It is sometimes necessary for the server to create an ID that looks
  *      like it belongs to a client.  This ID, however,  must not be one
@@ -151,27 +151,50 @@ Equipment Corporation.
 #define TypeNameString(t) LookupResourceName(t)
 #endif
 
-static void RebuildTable(int    /*client */
-    );
-
 #define SERVER_MINID 32
 
-#define INITBUCKETS 64
-#define INITHASHSIZE 6
-#define MAXHASHSIZE 16
+/*
+ * Each client's resources live in an open-addressed hash table.  The
+ * slots keep id, type and value inline, and a separate array of control
+ * bytes holds a 7 bit tag of each occupied slot's hash, so a probe scans
+ * contiguous control bytes and only touches a slot whose tag matches.
+ *
+ * Growing the table does not rehash everything at once: the previous
+ * table is kept as "old" and its slots are moved over MIGRATESTEP at a
+ * time by subsequent AddResource/FreeResource calls.  Lookups consult
+ * both tables while a migration is in progress.
+ */
+
+#define INITSLOTS 64            /* must be a power of two */
+#define MIGRATESTEP 16
+
+#define SLOT_EMPTY   0x80
+#define SLOT_DELETED 0xfe
+#define SlotFree(c) ((c) & 0x80)
 
 typedef struct _Resource {
-    struct _Resource *next;
     XID id;
     RESTYPE type;
     void *value;
+    unsigned int serial;        /* insertion order, for LIFO freeing */
 } ResourceRec, *ResourcePtr;
 
+typedef struct _ResourceTable {
+    ResourcePtr slots;          /* ctrl bytes follow the slots */
+    unsigned char *ctrl;
+    unsigned int mask;          /* number of slots - 1 */
+    unsigned int shift;         /* 32 - log2(number of slots) */
+    unsigned int used;          /* live and deleted slots */
+} ResourceTableRec, *ResourceTablePtr;
+
 typedef struct _ClientResource {
-    ResourcePtr *resources;
+    ResourceTableRec table;
+    ResourceTableRec old;       /* being migrated into table */
+    unsigned int migrate;       /* next slot of old to migrate */
     int elements;
-    int buckets;
-    int hashsize;               /* log(2)(buckets) */
+    unsigned int serial;
+    unsigned int generation;    /* bumped when slots move under a walk */
+    int walking;                /* no migration while non-zero */
     XID fakeID;
     XID endFakeID;
 } ClientResourceRec;
@@ -498,7 +521,7 @@ CallbackListPtr ResourceStateCallback;
 static inline void
 CallResourceStateCallback(ResourceState state, ResourceRec * res)
 {
-    if (ResourceStateCallback) {
+    if (!CallbackListEmpty(ResourceStateCallback)) {
         ResourceStateInfoRec rsi = { state, res->id, res->type, res->value };
         CallCallbacks(&ResourceStateCallback, &rsi);
     }
@@ -632,6 +655,212 @@ ResourceClientBits(void)
 
     return cache_ilog2;
 }
+static inline unsigned int
+ResourceHash(XID id)
+{
+    /* Fibonacci hashing spreads the sequential ids clients allocate */
+    return id * 0x9e3779b1U;
+}
+
+static inline unsigned int
+ResourceTableLimit(ResourceTablePtr table)
+{
+    /* keep at least a quarter of the slots empty to bound probe length */
+    return (table->mask + 1) / 4 * 3;
+}
+
+static Bool
+ResourceTableInit(ResourceTablePtr table, unsigned int size)
+{
+    table->slots = malloc(size * (sizeof(ResourceRec) + 1));
+    if (!table->slots)
+        return FALSE;
+    table->ctrl = (unsigned char *) (table->slots + size);
+    memset(table->ctrl, SLOT_EMPTY, size);
+    table->mask = size - 1;
+    table->shift = 32 - ilog2(size);
+    table->used = 0;
+    return TRUE;
+}
+
+static void
+ResourceTableFini(ResourceTablePtr table)
+{
+    free(table->slots);
+    memset(table, 0, sizeof(*table));
+}
+
+static void
+ResourceTableInsert(ResourceTablePtr table, const ResourceRec *res)
+{
+    unsigned int hash = ResourceHash(res->id);
+    unsigned int i = hash >> table->shift;
+    unsigned int probes;
+
+    for (probes = 0; !SlotFree(table->ctrl[i]); probes++) {
+        /* callers keep a free slot, a full table would probe forever */
+        assert(probes < table->mask);
+        i = (i + 1) & table->mask;
+    }
+    if (table->ctrl[i] == SLOT_EMPTY)
+        table->used++;
+    table->ctrl[i] = hash & 0x7f;
+    table->slots[i] = *res;
+}
+
+static inline Bool
+ResourceMatches(const ResourceRec *res, XID id, RESTYPE type, RESTYPE rclass)
+{
+    if (res->id != id)
+        return FALSE;
+    if (type)
+        return res->type == type;
+    return (res->type & rclass) != 0;
+}
+
+static ResourcePtr
+ResourceTableFind(ResourceTablePtr table, XID id, RESTYPE type,
+                  RESTYPE rclass, ResourcePtr best)
+{
+    unsigned int hash, i;
+    unsigned char tag;
+
+    if (!table->ctrl)
+        return best;
+
+    hash = ResourceHash(id);
+    tag = hash & 0x7f;
+    for (i = hash >> table->shift; table->ctrl[i] != SLOT_EMPTY;
+         i = (i + 1) & table->mask) {
+        ResourcePtr res = &table->slots[i];
+
+        if (table->ctrl[i] != tag || !ResourceMatches(res, id, type, rclass))
+            continue;
+        if (!best || (int) (res->serial - best->serial) > 0)
+            best = res;
+    }
+    return best;
+}
+
+/*
+ * Find the most recently added resource with the given id whose type is
+ * type, or, if type is X11_RESTYPE_NONE, whose type is in rclass.
+ */
+static ResourcePtr
+LookupResource(ClientResourceRec *rrec, XID id, RESTYPE type, RESTYPE rclass)
+{
+    ResourcePtr res;
+
+    res = ResourceTableFind(&rrec->table, id, type, rclass, NULL);
+    return ResourceTableFind(&rrec->old, id, type, rclass, res);
+}
+
+static void
+RemoveResource(ClientResourceRec *rrec, ResourcePtr res)
+{
+    ResourceTablePtr table = &rrec->table;
+
+    if (res < table->slots || res > table->slots + table->mask)
+        table = &rrec->old;
+    table->ctrl[res - table->slots] = SLOT_DELETED;
+    rrec->elements--;
+}
+
+/*
+ * Move up to count slots of the old table into the current one, and drop
+ * the old table once it has been emptied.  Migrated slots are marked
+ * deleted rather than empty so that probes for the remaining entries
+ * still find them.
+ */
+static void
+MigrateResources(ClientResourceRec *rrec, unsigned int count)
+{
+    ResourceTablePtr old = &rrec->old;
+
+    if (!old->ctrl)
+        return;
+    while (count-- && rrec->migrate <= old->mask) {
+        unsigned int i = rrec->migrate++;
+
+        if (SlotFree(old->ctrl[i]))
+            continue;
+        ResourceTableInsert(&rrec->table, &old->slots[i]);
+        old->ctrl[i] = SLOT_DELETED;
+    }
+    if (rrec->migrate > old->mask)
+        ResourceTableFini(old);
+}
+
+static Bool
+GrowResourceTable(ClientResourceRec *rrec)
+{
+    ResourceTableRec table;
+    unsigned int size = INITSLOTS, i;
+
+    /* size for the live entries of both tables; deleted slots are not
+     * carried over */
+    while (size / 8 * 3 <= rrec->elements)
+        size <<= 1;
+
+    if (!ResourceTableInit(&table, size))
+        return FALSE;
+
+    if (rrec->old.ctrl) {
+        /* The previous migration has to finish first, and into the new
+         * table: the current one need not have room for what is left,
+         * migration stops while the table is walked.  This moves slots
+         * under walkers, so tell them. */
+        if (rrec->walking)
+            rrec->generation++;
+        for (i = rrec->migrate; i <= rrec->old.mask; i++)
+            if (!SlotFree(rrec->old.ctrl[i]))
+                ResourceTableInsert(&table, &rrec->old.slots[i]);
+        ResourceTableFini(&rrec->old);
+    }
+
+    rrec->old = rrec->table;
+    rrec->table = table;
+    rrec->migrate = 0;
+    return TRUE;
+}
+
+typedef Bool (*ResourceWalkFunc) (ClientResourceRec *rrec, ResourcePtr res,
+                                  void *closure);
+
+/*
+ * Call func for each resource of a client until it returns TRUE.  Slots
+ * do not move while a walk is in progress, so func may freely add, free
+ * and look up resources.  Only if func adds so many resources that a
+ * pending migration must be completed does the walk start over, and func
+ * then gets called more than once for some resources.
+ */
+static Bool
+WalkClientResources(ClientResourceRec *rrec, ResourceWalkFunc func,
+                    void *closure)
+{
+    ResourceTableRec tables[2];
+    unsigned int generation, t, i;
+    Bool done = FALSE;
+
+ restart:
+    tables[0] = rrec->old;
+    tables[1] = rrec->table;
+    generation = rrec->generation;
+    rrec->walking++;
+    for (t = 0; t < 2 && !done; t++) {
+        for (i = 0; tables[t].ctrl && i <= tables[t].mask && !done; i++) {
+            if (SlotFree(tables[t].ctrl[i]))
+                continue;
+            done = func(rrec, &tables[t].slots[i], closure);
+            if (!done && rrec->generation != generation) {
+                rrec->walking--;
+                goto restart;
+            }
+        }
+    }
+    rrec->walking--;
+    return done;
+}
 
 /*****************
  * InitClientResources
@@ -642,7 +871,7 @@ ResourceClientBits(void)
 Bool
 InitClientResources(ClientPtr client)
 {
-    int i, j;
+    ClientResourceRec *rrec;
 
     if (client == serverClient) {
         lastResourceType = X11_RESTYPE_LASTPREDEF;
@@ -654,24 +883,22 @@ InitClientResources(ClientPtr client)
             return FALSE;
         memcpy(resourceTypes, predefTypes, sizeof(predefTypes));
     }
-    clientTable[i = client->index].resources =
-        calloc(INITBUCKETS, sizeof(ResourcePtr));
-    if (!clientTable[i].resources)
+    rrec = &clientTable[client->index];
+    memset(&rrec->old, 0, sizeof(rrec->old));
+    if (!ResourceTableInit(&rrec->table, INITSLOTS))
         return FALSE;
-    clientTable[i].buckets = INITBUCKETS;
-    clientTable[i].elements = 0;
-    clientTable[i].hashsize = INITHASHSIZE;
+    rrec->migrate = 0;
+    rrec->elements = 0;
+    rrec->serial = 0;
+    rrec->walking = 0;
     /* Many IDs allocated from the server client are visible to clients,
      * so we don't use the SERVER_BIT for them, but we have to start
      * past the magic value constants used in the protocol.  For normal
      * clients, we can start from zero, with SERVER_BIT set.
      */
-    clientTable[i].fakeID = client->clientAsMask |
+    rrec->fakeID = client->clientAsMask |
         (client->index ? SERVER_BIT : SERVER_MINID);
-    clientTable[i].endFakeID = (clientTable[i].fakeID | RESOURCE_ID_MASK) + 1;
-    for (j = 0; j < INITBUCKETS; j++) {
-        clientTable[i].resources[j] = NULL;
-    }
+    rrec->endFakeID = (rrec->fakeID | RESOURCE_ID_MASK) + 1;
     return TRUE;
 }
 
@@ -691,51 +918,56 @@ HashResourceID(XID id, unsigned int numBits)
 static XID
 AvailableID(int client, XID id, XID maxid, XID goodid)
 {
-    ResourcePtr res;
-
     if ((goodid >= id) && (goodid <= maxid))
         return goodid;
     for (; id <= maxid; id++) {
-        res = clientTable[client].resources[HashResourceID(id, clientTable[client].hashsize)];
-        while (res && (res->id != id))
-            res = res->next;
-        if (!res)
+        if (!LookupResource(&clientTable[client], id, X11_RESTYPE_NONE, RC_ANY))
             return id;
     }
     return 0;
 }
 
+typedef struct {
+    int client;
+    XID id;
+    XID maxid;
+    XID goodid;
+} XIDRangeRec;
+
+static Bool
+XIDRangeHelper(ClientResourceRec *rrec, ResourcePtr res, void *closure)
+{
+    XIDRangeRec *range = closure;
+
+    if ((res->id < range->id) || (res->id > range->maxid))
+        return FALSE;
+    if (((res->id - range->id) >= (range->maxid - res->id)) ?
+        (range->goodid = AvailableID(range->client, range->id, res->id - 1,
+                                     range->goodid)) :
+        !(range->goodid = AvailableID(range->client, res->id + 1,
+                                      range->maxid, range->goodid)))
+        range->maxid = res->id - 1;
+    else
+        range->id = res->id + 1;
+    return FALSE;
+}
+
 void
 GetXIDRange(int client, Bool server, XID *minp, XID *maxp)
 {
-    XID id, maxid;
-    ResourcePtr *resp;
-    ResourcePtr res;
-    int i;
-    XID goodid;
+    XIDRangeRec range;
 
-    id = (Mask) client << CLIENTOFFSET;
+    range.client = client;
+    range.id = (Mask) client << CLIENTOFFSET;
     if (server)
-        id |= client ? SERVER_BIT : SERVER_MINID;
-    maxid = id | RESOURCE_ID_MASK;
-    goodid = 0;
-    for (resp = clientTable[client].resources, i = clientTable[client].buckets;
-         --i >= 0;) {
-        for (res = *resp++; res; res = res->next) {
-            if ((res->id < id) || (res->id > maxid))
-                continue;
-            if (((res->id - id) >= (maxid - res->id)) ?
-                (goodid = AvailableID(client, id, res->id - 1, goodid)) :
-                !(goodid = AvailableID(client, res->id + 1, maxid, goodid)))
-                maxid = res->id - 1;
-            else
-                id = res->id + 1;
-        }
-    }
-    if (id > maxid)
-        id = maxid = 0;
-    *minp = id;
-    *maxp = maxid;
+        range.id |= client ? SERVER_BIT : SERVER_MINID;
+    range.maxid = range.id | RESOURCE_ID_MASK;
+    range.goodid = 0;
+    WalkClientResources(&clientTable[client], XIDRangeHelper, &range);
+    if (range.id > range.maxid)
+        range.id = range.maxid = 0;
+    *minp = range.id;
+    *maxp = range.maxid;
 }
 
 /**
@@ -818,79 +1050,37 @@ AddResource(XID id, RESTYPE type, void *value)
 {
     int client;
     ClientResourceRec *rrec;
-    ResourcePtr *head;
+    ResourceRec res;
 
 #ifdef XSERVER_DTRACE
     XSERVER_RESOURCE_ALLOC(id, type, value, TypeNameString(type));
 #endif
     client = dixClientIdForXID(id);
     rrec = &clientTable[client];
-    if (!rrec->buckets) {
+    if (!rrec->table.ctrl) {
         ErrorF("[dix] AddResource(%lx, %x, %lx), client=%d \n",
                (unsigned long) id, type, (unsigned long) value, client);
         FatalError("client not in use\n");
     }
-    if ((rrec->elements >= 4 * rrec->buckets) && (rrec->hashsize < MAXHASHSIZE))
-        RebuildTable(client);
-    head = &rrec->resources[HashResourceID(id, clientTable[client].hashsize)];
-    ResourcePtr res = calloc(1, sizeof(ResourceRec));
-    if (!res) {
+    if (!rrec->walking)
+        MigrateResources(rrec, MIGRATESTEP);
+    /* Failing to grow only matters once there is no empty slot left to
+     * terminate probes. */
+    if (rrec->table.used >= ResourceTableLimit(&rrec->table) &&
+        !GrowResourceTable(rrec) && rrec->table.used >= rrec->table.mask) {
         (*resourceTypes[type & TypeMask].deleteFunc) (value, id);
         return FALSE;
     }
-    res->next = *head;
-    res->id = id;
-    res->type = type;
-    res->value = value;
-    *head = res;
+    res.id = id;
+    res.type = type;
+    res.value = value;
+    res.serial = rrec->serial++;
+    ResourceTableInsert(&rrec->table, &res);
     rrec->elements++;
-    CallResourceStateCallback(ResourceStateAdding, res);
+    CallResourceStateCallback(ResourceStateAdding, &res);
     return TRUE;
 }
 
-static void
-RebuildTable(int client)
-{
-    int j;
-    ResourcePtr res, next;
-    ResourcePtr **tails, *resources;
-    ResourcePtr **tptr, *rptr;
-
-    /*
-     * For now, preserve insertion order, since some ddx layers depend
-     * on resources being free in the opposite order they are added.
-     */
-
-    j = 2 * clientTable[client].buckets;
-    tails =  calloc(j, sizeof(ResourcePtr *));
-    if (!tails)
-        return;
-    resources =  calloc(j, sizeof(ResourcePtr));
-    if (!resources) {
-        free(tails);
-        return;
-    }
-    for (rptr = resources, tptr = tails; --j >= 0; rptr++, tptr++) {
-        *rptr = NULL;
-        *tptr = rptr;
-    }
-    clientTable[client].hashsize++;
-    for (j = clientTable[client].buckets,
-         rptr = clientTable[client].resources; --j >= 0; rptr++) {
-        for (res = *rptr; res; res = next) {
-            next = res->next;
-            res->next = NULL;
-            tptr = &tails[HashResourceID(res->id, clientTable[client].hashsize)];
-            **tptr = res;
-            *tptr = &res->next;
-        }
-    }
-    free(tails);
-    clientTable[client].buckets *= 2;
-    free(clientTable[client].resources);
-    clientTable[client].resources = resources;
-}
-
 static void
 doFreeResource(ResourcePtr res, Bool skip)
 {
@@ -898,43 +1088,40 @@ doFreeResource(ResourcePtr res, Bool skip)
 
     if (!skip)
         resourceTypes[res->type & TypeMask].deleteFunc(res->value, res->id);
-
-    free(res);
 }
 
-void
-FreeResource(XID id, RESTYPE skipDeleteFuncType)
+/*
+ * Free all resources with the given id, most recently added first, since
+ * some ddx layers depend on resources being freed in the opposite order
+ * they are added.  The delete functions may add or free other resources,
+ * so the table is searched again after each one.
+ */
+static void
+FreeResourcesByID(ClientResourceRec *rrec, XID id, RESTYPE skipDeleteFuncType)
 {
-    int cid;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
-    int *eltptr;
-    int elements;
-
-    if (((cid = dixClientIdForXID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-        eltptr = &clientTable[cid].elements;
 
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id) {
-                RESTYPE rtype = res->type;
+    while ((res = LookupResource(rrec, id, X11_RESTYPE_NONE, RC_ANY))) {
+        ResourceRec this = *res;
 
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+        XSERVER_RESOURCE_FREE(this.id, this.type,
+                              this.value, TypeNameString(this.type));
 #endif
-                *prev = res->next;
-                elements = --*eltptr;
+        RemoveResource(rrec, res);
+        doFreeResource(&this, this.type == skipDeleteFuncType);
+    }
+}
 
-                doFreeResource(res, rtype == skipDeleteFuncType);
+void
+FreeResource(XID id, RESTYPE skipDeleteFuncType)
+{
+    int cid;
 
-                if (*eltptr != elements)
-                    prev = head;        /* prev may no longer be valid */
-            }
-            else
-                prev = &res->next;
-        }
+    if (((cid = dixClientIdForXID(id)) < LimitClients) && clientTable[cid].table.ctrl) {
+        if (!clientTable[cid].walking)
+            MigrateResources(&clientTable[cid], MIGRATESTEP);
+        FreeResourcesByID(&clientTable[cid], id, skipDeleteFuncType);
     }
 }
 
@@ -943,27 +1130,20 @@ FreeResourceByType(XID id, RESTYPE type, Bool skipFree)
 {
     int cid;
     ResourcePtr res;
-    ResourcePtr *prev, *head;
 
-    if (((cid = dixClientIdForXID(id)) < LimitClients) && clientTable[cid].buckets) {
-        head = &clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
+    if (((cid = dixClientIdForXID(id)) < LimitClients) && clientTable[cid].table.ctrl) {
+        if (!clientTable[cid].walking)
+            MigrateResources(&clientTable[cid], MIGRATESTEP);
+        res = LookupResource(&clientTable[cid], id, type, 0);
+        if (res) {
+            ResourceRec this = *res;
 
-        prev = head;
-        while ((res = *prev)) {
-            if (res->id == id && res->type == type) {
 #ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(res->id, res->type,
-                                      res->value, TypeNameString(res->type));
+            XSERVER_RESOURCE_FREE(this.id, this.type,
+                                  this.value, TypeNameString(this.type));
 #endif
-                *prev = res->next;
-                clientTable[cid].elements--;
-
-                doFreeResource(res, skipFree);
-
-                break;
-            }
-            else
-                prev = &res->next;
+            RemoveResource(&clientTable[cid], res);
+            doFreeResource(&this, skipFree);
         }
     }
 }
@@ -980,18 +1160,37 @@ ChangeResourceValue(XID id, RESTYPE rtype, void *value)
     int cid;
     ResourcePtr res;
 
-    if (((cid = dixClientIdForXID(id)) < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if ((res->id == id) && (res->type == rtype)) {
-                res->value = value;
-                return TRUE;
-            }
+    if (((cid = dixClientIdForXID(id)) < LimitClients) && clientTable[cid].table.ctrl) {
+        res = LookupResource(&clientTable[cid], id, rtype, 0);
+        if (res) {
+            res->value = value;
+            return TRUE;
+        }
     }
     return FALSE;
 }
 
+typedef struct {
+    RESTYPE type;
+    union {
+        FindResType byType;
+        FindAllRes all;
+        FindComplexResType complex;
+    } func;
+    void *cdata;
+    void *result;
+} FindResourcesRec;
+
+static Bool
+FindByTypeHelper(ClientResourceRec *rrec, ResourcePtr res, void *closure)
+{
+    FindResourcesRec *find = closure;
+
+    if (!find->type || res->type == find->type)
+        (*find->func.byType) (res->value, res->id, find->cdata);
+    return FALSE;
+}
+
 /* Note: if func adds or deletes resources, then func can get called
  * more than once for some resources.  If func adds new resources,
  * func might or might not get called for them.  func cannot both
@@ -1002,27 +1201,13 @@ void
 FindClientResourcesByType(ClientPtr client,
                           RESTYPE type, FindResType func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    FindResourcesRec find = { .type = type, .func.byType = func,
+                              .cdata = cdata };
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            if (!type || this->type == type) {
-                elements = *eltptr;
-                (*func) (this->value, this->id, cdata);
-                if (*eltptr != elements)
-                    next = resources[i];        /* start over */
-            }
-        }
-    }
+    WalkClientResources(&clientTable[client->index], FindByTypeHelper, &find);
 }
 
 void FindSubResources(void *resource,
@@ -1034,28 +1219,41 @@ void FindSubResources(void *resource,
     rtype.findSubResFunc(resource, func, cdata);
 }
 
+static Bool
+FindAllHelper(ClientResourceRec *rrec, ResourcePtr res, void *closure)
+{
+    FindResourcesRec *find = closure;
+
+    (*find->func.all) (res->value, res->id, res->type, find->cdata);
+    return FALSE;
+}
+
 void
 FindAllClientResources(ClientPtr client, FindAllRes func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    int i, elements;
-    int *eltptr;
+    FindResourcesRec find = { .func.all = func, .cdata = cdata };
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            elements = *eltptr;
-            (*func) (this->value, this->id, this->type, cdata);
-            if (*eltptr != elements)
-                next = resources[i];    /* start over */
-        }
+    WalkClientResources(&clientTable[client->index], FindAllHelper, &find);
+}
+
+static Bool
+LookupComplexHelper(ClientResourceRec *rrec, ResourcePtr res, void *closure)
+{
+    FindResourcesRec *find = closure;
+    void *value;
+
+    if (find->type && res->type != find->type)
+        return FALSE;
+    /* workaround func freeing the type as DRI1 does */
+    value = res->value;
+    if ((*find->func.complex) (value, res->id, find->cdata)) {
+        find->result = value;
+        return TRUE;
     }
+    return FALSE;
 }
 
 void *
@@ -1063,74 +1261,54 @@ LookupClientResourceComplex(ClientPtr client,
                             RESTYPE type,
                             FindComplexResType func, void *cdata)
 {
-    ResourcePtr *resources;
-    ResourcePtr this, next;
-    void *value;
-    int i;
+    FindResourcesRec find = { .type = type, .func.complex = func,
+                              .cdata = cdata };
 
     if (!client)
         client = serverClient;
 
-    resources = clientTable[client->index].resources;
-    for (i = 0; i < clientTable[client->index].buckets; i++) {
-        for (this = resources[i]; this; this = next) {
-            next = this->next;
-            if (!type || this->type == type) {
-                /* workaround func freeing the type as DRI1 does */
-                value = this->value;
-                if ((*func) (value, this->id, cdata))
-                    return value;
-            }
-        }
+    WalkClientResources(&clientTable[client->index], LookupComplexHelper,
+                        &find);
+    return find.result;
+}
+
+static Bool
+FreeNeverRetainHelper(ClientResourceRec *rrec, ResourcePtr res, void *closure)
+{
+    ResourceRec this = *res;
+
+    if (this.type & RC_NEVERRETAIN) {
+#ifdef XSERVER_DTRACE
+        XSERVER_RESOURCE_FREE(this.id, this.type,
+                              this.value, TypeNameString(this.type));
+#endif
+        RemoveResource(rrec, res);
+        doFreeResource(&this, FALSE);
     }
-    return NULL;
+    return FALSE;
 }
 
 void
 FreeClientNeverRetainResources(ClientPtr client)
 {
-    ResourcePtr *resources;
-    ResourcePtr this;
-    ResourcePtr *prev;
-    int j, elements;
-    int *eltptr;
-
     if (!client)
         return;
 
-    resources = clientTable[client->index].resources;
-    eltptr = &clientTable[client->index].elements;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        prev = &resources[j];
-        while ((this = *prev)) {
-            RESTYPE rtype = this->type;
-
-            if (rtype & RC_NEVERRETAIN) {
-#ifdef XSERVER_DTRACE
-                XSERVER_RESOURCE_FREE(this->id, this->type,
-                                      this->value, TypeNameString(this->type));
-#endif
-                *prev = this->next;
-                clientTable[client->index].elements--;
-                elements = *eltptr;
-
-                doFreeResource(this, FALSE);
+    WalkClientResources(&clientTable[client->index], FreeNeverRetainHelper,
+                        NULL);
+}
 
-                if (*eltptr != elements)
-                    prev = &resources[j];       /* prev may no longer be valid */
-            }
-            else
-                prev = &this->next;
-        }
-    }
+static Bool
+FreeAllHelper(ClientResourceRec *rrec, ResourcePtr res, void *closure)
+{
+    FreeResourcesByID(rrec, res->id, X11_RESTYPE_NONE);
+    return FALSE;
 }
 
 void
 FreeClientResources(ClientPtr client)
 {
-    ResourcePtr *resources;
-    ResourcePtr this;
-    int j;
+    ClientResourceRec *rrec;
 
     /* This routine shouldn't be called with a null client, but just in
        case ... */
@@ -1140,35 +1318,17 @@ FreeClientResources(ClientPtr client)
 
     HandleSaveSet(client);
 
-    resources = clientTable[client->index].resources;
-    for (j = 0; j < clientTable[client->index].buckets; j++) {
-        /* It may seem silly to update the head of this resource list as
-           we delete the members, since the entire list will be deleted any way,
-           but there are some resource deletion functions "FreeClientPixels" for
-           one which do a LookupID on another resource id (a Colormap id in this
-           case), so the resource list must be kept valid up to the point that
-           it is deleted, so every time we delete a resource, we must update the
-           head, just like in FreeResource. I hope that this doesn't slow down
-           mass deletion appreciably. PRH */
-
-        ResourcePtr *head;
-
-        head = &resources[j];
-
-        for (this = *head; this; this = *head) {
-#ifdef XSERVER_DTRACE
-            XSERVER_RESOURCE_FREE(this->id, this->type,
-                                  this->value, TypeNameString(this->type));
-#endif
-            *head = this->next;
-            clientTable[client->index].elements--;
-
-            doFreeResource(this, FALSE);
-        }
-    }
-    free(clientTable[client->index].resources);
-    clientTable[client->index].resources = NULL;
-    clientTable[client->index].buckets = 0;
+    /* Some resource deletion functions, "FreeClientPixels" for one, do a
+       LookupID on another resource id (a Colormap id in this case), so the
+       table must stay valid while we delete.  Freed slots are only marked
+       deleted, and the walk keeps migration from moving anything. */
+    rrec = &clientTable[client->index];
+    WalkClientResources(rrec, FreeAllHelper, NULL);
+
+    ResourceTableFini(&rrec->table);
+    ResourceTableFini(&rrec->old);
+    rrec->elements = 0;
+    rrec->generation++;
 }
 
 void
@@ -1177,7 +1337,7 @@ FreeAllResources(void)
     int i;
 
     for (i = currentMaxClients; --i >= 0;) {
-        if (clientTable[i].buckets)
+        if (clientTable[i].table.ctrl)
             FreeClientResources(clients[i]);
     }
 }
@@ -1213,34 +1373,32 @@ dixLookupResourceByType(void **result, XID id, RESTYPE rtype,
 {
     int cid = dixClientIdForXID(id);
     ResourcePtr res = NULL;
+    void *value;
 
     *result = NULL;
     if ((rtype & TypeMask) > lastResourceType)
         return BadImplementation;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if (res->id == id && res->type == rtype)
-                break;
-    }
+    if ((cid < LimitClients) && clientTable[cid].table.ctrl)
+        res = LookupResource(&clientTable[cid], id, rtype, 0);
     if (client) {
         client->errorValue = id;
     }
     if (!res)
         return resourceTypes[rtype & TypeMask].errorValue;
 
+    /* the slot may move if the access hook adds resources */
+    value = res->value;
     if (client) {
-        cid = XaceHookResourceAccess(client, id, res->type,
-                       res->value, X11_RESTYPE_NONE, NULL, mode);
+        cid = XaceHookResourceAccess(client, id, rtype,
+                       value, X11_RESTYPE_NONE, NULL, mode);
         if (cid == BadValue)
             return resourceTypes[rtype & TypeMask].errorValue;
         if (cid != Success)
             return cid;
     }
 
-    *result = res->value;
+    *result = value;
     return Success;
 }
 
@@ -1250,30 +1408,29 @@ dixLookupResourceByClass(void **result, XID id, RESTYPE rclass,
 {
     int cid = dixClientIdForXID(id);
     ResourcePtr res = NULL;
+    RESTYPE type;
+    void *value;
 
     *result = NULL;
 
-    if ((cid < LimitClients) && clientTable[cid].buckets) {
-        res = clientTable[cid].resources[HashResourceID(id, clientTable[cid].hashsize)];
-
-        for (; res; res = res->next)
-            if (res->id == id && (res->type & rclass))
-                break;
-    }
+    if ((cid < LimitClients) && clientTable[cid].table.ctrl)
+        res = LookupResource(&clientTable[cid], id, X11_RESTYPE_NONE, rclass);
     if (client) {
         client->errorValue = id;
     }
     if (!res)
         return BadValue;
 
+    type = res->type;
+    value = res->value;
     if (client) {
-        cid = XaceHookResourceAccess(client, id, res->type,
-                       res->value, X11_RESTYPE_NONE, NULL, mode);
+        cid = XaceHookResourceAccess(client, id, type,
+                       value, X11_RESTYPE_NONE, NULL, mode);
         if (cid != Success)
             return cid;
     }
 
-    *result = res->value;
+    *result = value;
     return Success;
 }
 
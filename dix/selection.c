@@ -46,6 +46,9 @@ SOFTWARE.
 
 #include <dix-config.h>
 
+#include <stdint.h>
+#include <string.h>
+
 #include "dix/dix_priv.h"
 #include "dix/selection_priv.h"
 
@@ -68,26 +71,152 @@ Selection *CurrentSelections;
 CallbackListPtr SelectionCallback;
 CallbackListPtr SelectionFilterCallback = NULL;
 
+/*
+ * Besides the CurrentSelections list, selections are hashed by their atom,
+ * and the owned ones are linked to their owner client and hashed by their
+ * owner window, so that neither lookups nor client and window teardown
+ * have to go through all the selections ever created.  Both hash tables
+ * have the same size and grow with the number of selections.
+ */
+#define SELECTION_HASH_MIN_BITS 5
+
+static Selection **selectionHash;
+static Selection **selectionWindowHash;
+static int selectionHashBits;
+static int numSelections;
+static Selection *clientSelections[MAXCLIENTS];
+
+static inline unsigned
+SelectionHashAtom(Atom selection)
+{
+    return ((uint32_t) selection * 0x9e3779b1) >> (32 - selectionHashBits);
+}
+
+static inline unsigned
+SelectionHashWindow(WindowPtr pWin)
+{
+    return ((uint32_t) ((uintptr_t) pWin >> 4) * 0x9e3779b1) >>
+        (32 - selectionHashBits);
+}
+
+static void
+SelectionLinkOwner(Selection *pSel)
+{
+    Selection **head;
+
+    head = &clientSelections[pSel->client->index];
+    if ((pSel->clientNext = *head))
+        pSel->clientNext->clientPrev = &pSel->clientNext;
+    pSel->clientPrev = head;
+    *head = pSel;
+
+    head = &selectionWindowHash[SelectionHashWindow(pSel->pWin)];
+    if ((pSel->windowNext = *head))
+        pSel->windowNext->windowPrev = &pSel->windowNext;
+    pSel->windowPrev = head;
+    *head = pSel;
+}
+
+static void
+SelectionUnlinkOwner(Selection *pSel)
+{
+    if ((*pSel->clientPrev = pSel->clientNext))
+        pSel->clientNext->clientPrev = pSel->clientPrev;
+    if ((*pSel->windowPrev = pSel->windowNext))
+        pSel->windowNext->windowPrev = pSel->windowPrev;
+}
+
+static void
+SelectionChangeOwner(Selection *pSel, Window window, WindowPtr pWin,
+                     ClientPtr client)
+{
+    if (pSel->pWin)
+        SelectionUnlinkOwner(pSel);
+
+    pSel->window = window;
+    pSel->pWin = pWin;
+    pSel->client = client;
+
+    if (pSel->pWin)
+        SelectionLinkOwner(pSel);
+}
+
+static Bool
+SelectionResizeHash(int bits)
+{
+    Selection **hash, **windowHash, *pSel;
+
+    hash = calloc(1 << bits, sizeof(Selection *));
+    windowHash = calloc(1 << bits, sizeof(Selection *));
+    if (!hash || !windowHash) {
+        free(hash);
+        free(windowHash);
+        return FALSE;
+    }
+
+    free(selectionHash);
+    free(selectionWindowHash);
+    selectionHash = hash;
+    selectionWindowHash = windowHash;
+    selectionHashBits = bits;
+
+    for (pSel = CurrentSelections; pSel; pSel = pSel->next) {
+        unsigned h = SelectionHashAtom(pSel->selection);
+
+        pSel->hashNext = selectionHash[h];
+        selectionHash[h] = pSel;
+
+        /* the client lists stay as they are, only their heads move */
+        if (pSel->pWin) {
+            Selection **head = &selectionWindowHash[SelectionHashWindow(pSel->pWin)];
+
+            if ((pSel->windowNext = *head))
+                pSel->windowNext->windowPrev = &pSel->windowNext;
+            pSel->windowPrev = head;
+            *head = pSel;
+        }
+    }
+    return TRUE;
+}
+
 int
 dixLookupSelection(Selection ** result, Atom selectionName,
                    ClientPtr client, Mask access_mode)
 {
-    Selection *pSel;
+    Selection *pSel = NULL;
     int rc = BadMatch;
 
     client->errorValue = selectionName;
 
-    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
-        if (pSel->selection == selectionName)
-            break;
+    if (selectionHash)
+        for (pSel = selectionHash[SelectionHashAtom(selectionName)]; pSel;
+             pSel = pSel->hashNext)
+            if (pSel->selection == selectionName)
+                break;
 
     if (!pSel) {
+        unsigned h;
+
+        /* keep the chains short; failing to grow only makes them longer */
+        if (!selectionHash) {
+            if (!SelectionResizeHash(SELECTION_HASH_MIN_BITS))
+                return BadAlloc;
+        }
+        else if (numSelections >= (1 << selectionHashBits) &&
+                 selectionHashBits < 24)
+            SelectionResizeHash(selectionHashBits + 1);
+
         pSel = dixAllocateObjectWithPrivates(Selection, PRIVATE_SELECTION);
         if (!pSel)
             return BadAlloc;
         pSel->selection = selectionName;
         pSel->next = CurrentSelections;
         CurrentSelections = pSel;
+
+        h = SelectionHashAtom(selectionName);
+        pSel->hashNext = selectionHash[h];
+        selectionHash[h] = pSel;
+        numSelections++;
     }
 
     /* security creation/labeling check */
@@ -113,6 +242,14 @@ InitSelections(void)
     }
 
     CurrentSelections = NULL;
+
+    free(selectionHash);
+    free(selectionWindowHash);
+    selectionHash = NULL;
+    selectionWindowHash = NULL;
+    selectionHashBits = 0;
+    numSelections = 0;
+    memset(clientSelections, 0, sizeof(clientSelections));
 }
 
 static inline void
@@ -123,19 +260,31 @@ CallSelectionCallback(Selection * pSel, ClientPtr client,
     CallCallbacks(&SelectionCallback, &info);
 }
 
+static Selection *
+SelectionOwnedByWindow(WindowPtr pWin)
+{
+    Selection *pSel;
+
+    if (!selectionWindowHash)
+        return NULL;
+
+    for (pSel = selectionWindowHash[SelectionHashWindow(pWin)]; pSel;
+         pSel = pSel->windowNext)
+        if (pSel->pWin == pWin)
+            return pSel;
+    return NULL;
+}
+
 void
 DeleteWindowFromAnySelections(WindowPtr pWin)
 {
     Selection *pSel;
 
-    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
-        if (pSel->pWin == pWin) {
-            CallSelectionCallback(pSel, NULL, SelectionWindowDestroy);
+    while ((pSel = SelectionOwnedByWindow(pWin))) {
+        CallSelectionCallback(pSel, NULL, SelectionWindowDestroy);
 
-            pSel->pWin = (WindowPtr) NULL;
-            pSel->window = None;
-            pSel->client = NULL;
-        }
+        SelectionChangeOwner(pSel, None, NULL, NULL);
+    }
 }
 
 void
@@ -143,14 +292,11 @@ DeleteClientFromAnySelections(ClientPtr client)
 {
     Selection *pSel;
 
-    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
-        if (pSel->client == client) {
-            CallSelectionCallback(pSel, NULL, SelectionClientClose);
+    while ((pSel = clientSelections[client->index])) {
+        CallSelectionCallback(pSel, NULL, SelectionClientClose);
 
-            pSel->pWin = (WindowPtr) NULL;
-            pSel->window = None;
-            pSel->client = NULL;
-        }
+        SelectionChangeOwner(pSel, None, NULL, NULL);
+    }
 }
 
 int
@@ -233,9 +379,7 @@ ProcSetSelectionOwner(ClientPtr client)
     }
 
     pSel->lastTimeChanged = time;
-    pSel->window = param.owner;
-    pSel->pWin = pWin;
-    pSel->client = (pWin ? client : NULL);
+    SelectionChangeOwner(pSel, param.owner, pWin, pWin ? client : NULL);
 
     CallSelectionCallback(pSel, client, SelectionSetOwner);
     return Success;
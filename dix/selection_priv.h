@@ -20,6 +20,12 @@ typedef struct _Selection {
     ClientPtr client;
     struct _Selection *next;
     PrivateRec *devPrivates;
+    /* private to dix/selection.c */
+    struct _Selection *hashNext;        /* same selection atom bucket */
+    struct _Selection *clientNext;      /* owned by the same client */
+    struct _Selection **clientPrev;
+    struct _Selection *windowNext;      /* same owner window bucket */
+    struct _Selection **windowPrev;
 } Selection;
 
 typedef enum {
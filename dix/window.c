@@ -906,8 +906,8 @@ dixCreateWindow(Window wid, WindowPtr pParent, int x, int y, unsigned w,
     /* We SHOULD check for an error value here XXX */
     dixScreenRaiseWindowPosition(pWin, pWin->drawable.x, pWin->drawable.y);
 
-    if (!(vmask & CWEventMask))
-        RecalculateDeliverableEvents(pWin);
+    /* even if the event mask is set below, the attributes may fail first */
+    RecalculateDeliverableEvents(pWin);
 
     if (vmask)
         *error = ChangeWindowAttributes(pWin, vmask, vlist, dixClientForWindow(pWin));
@@ -971,6 +971,164 @@ DisposeWindowOptional(WindowPtr pWin)
     pWin->optional = NULL;
 }
 
+/*
+ * Child window index
+ *
+ * miSpriteTrace() looks for the window under the pointer by testing every
+ * child of each window on the way down, which gets slow for windows with
+ * hundreds of children.  Those get a uniform grid over their children's
+ * border boxes, relative to the parent so that moving the parent itself
+ * doesn't invalidate it.  Each cell lists the children overlapping it,
+ * topmost first.  The grid is built on demand and thrown away whenever a
+ * child is added, removed, restacked or changes its geometry; everything
+ * else (mapping, shapes) is checked by the caller for each candidate.
+ */
+
+#define CHILD_INDEX_MIN_CHILDREN 32
+#define CHILD_INDEX_MAX_CELLS 64        /* per axis */
+
+typedef struct _ChildIndex {
+    int x, y;                   /* grid origin, relative to the parent */
+    int cell_width, cell_height;
+    int cols, rows;
+    int *start;                 /* first entry of each cell, cols * rows + 1 */
+    WindowPtr entries[];
+} ChildIndexRec, *ChildIndexPtr;
+
+/* not worth indexing, until the children change */
+static ChildIndexRec noChildIndex;
+
+static void
+ChildBorderBox(WindowPtr pChild, BoxPtr box)
+{
+    WindowPtr pParent = pChild->parent;
+    int bw = wBorderWidth(pChild);
+
+    box->x1 = pChild->drawable.x - bw - pParent->drawable.x;
+    box->y1 = pChild->drawable.y - bw - pParent->drawable.y;
+    box->x2 = box->x1 + (int) pChild->drawable.width + 2 * bw;
+    box->y2 = box->y1 + (int) pChild->drawable.height + 2 * bw;
+}
+
+static void
+ChildCells(ChildIndexPtr index, BoxPtr box, BoxPtr cells)
+{
+    cells->x1 = (box->x1 - index->x) / index->cell_width;
+    cells->y1 = (box->y1 - index->y) / index->cell_height;
+    cells->x2 = (box->x2 - 1 - index->x) / index->cell_width;
+    cells->y2 = (box->y2 - 1 - index->y) / index->cell_height;
+}
+
+static ChildIndexPtr
+BuildChildIndex(WindowPtr pWin)
+{
+    ChildIndexRec grid = { 0 };
+    ChildIndexPtr index;
+    WindowPtr pChild;
+    BoxRec extents, box, cells;
+    int nchildren = 0, nentries = 0, ncells, side, i, x, y;
+    int *fill;
+
+    for (pChild = pWin->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildBorderBox(pChild, &box);
+        if (!nchildren++)
+            extents = box;
+        extents.x1 = min(extents.x1, box.x1);
+        extents.y1 = min(extents.y1, box.y1);
+        extents.x2 = max(extents.x2, box.x2);
+        extents.y2 = max(extents.y2, box.y2);
+    }
+    if (nchildren < CHILD_INDEX_MIN_CHILDREN)
+        return &noChildIndex;
+
+    /* about one child per cell */
+    for (side = 1; side * side < nchildren && side < CHILD_INDEX_MAX_CELLS;)
+        side++;
+    grid.x = extents.x1;
+    grid.y = extents.y1;
+    grid.cols = grid.rows = side;
+    grid.cell_width = (extents.x2 - extents.x1 + side - 1) / side;
+    grid.cell_height = (extents.y2 - extents.y1 + side - 1) / side;
+    ncells = side * side;
+
+    /* a grid of windows covering most of it is no better than the list */
+    for (pChild = pWin->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildBorderBox(pChild, &box);
+        ChildCells(&grid, &box, &cells);
+        nentries += (cells.x2 - cells.x1 + 1) * (cells.y2 - cells.y1 + 1);
+    }
+    if (nentries > 4 * nchildren + ncells)
+        return &noChildIndex;
+
+    index = malloc(sizeof(ChildIndexRec) + nentries * sizeof(WindowPtr));
+    fill = calloc(ncells + 1, sizeof(int));
+    if (index)
+        *index = grid;
+    if (index && fill)
+        index->start = calloc(ncells + 1, sizeof(int));
+    if (!index || !fill || !index->start) {
+        free(index);
+        free(fill);
+        return &noChildIndex;
+    }
+
+    for (pChild = pWin->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildBorderBox(pChild, &box);
+        ChildCells(index, &box, &cells);
+        for (y = cells.y1; y <= cells.y2; y++)
+            for (x = cells.x1; x <= cells.x2; x++)
+                index->start[y * side + x + 1]++;
+    }
+    for (i = 0; i < ncells; i++) {
+        index->start[i + 1] += index->start[i];
+        fill[i] = index->start[i];
+    }
+    /* in stacking order, so every cell lists the topmost child first */
+    for (pChild = pWin->firstChild; pChild; pChild = pChild->nextSib) {
+        ChildBorderBox(pChild, &box);
+        ChildCells(index, &box, &cells);
+        for (y = cells.y1; y <= cells.y2; y++)
+            for (x = cells.x1; x <= cells.x2; x++)
+                index->entries[fill[y * side + x]++] = pChild;
+    }
+    free(fill);
+    return index;
+}
+
+static void
+InvalidateChildIndex(WindowPtr pWin)
+{
+    if (pWin->childIndex && pWin->childIndex != &noChildIndex) {
+        free(pWin->childIndex->start);
+        free(pWin->childIndex);
+    }
+    pWin->childIndex = NULL;
+}
+
+WindowPtr *
+dixWindowChildrenAt(WindowPtr pWin, int x, int y, int *count)
+{
+    ChildIndexPtr index = pWin->childIndex;
+    int cell;
+
+    if (!index)
+        index = pWin->childIndex = BuildChildIndex(pWin);
+    if (index == &noChildIndex)
+        return NULL;
+
+    x -= pWin->drawable.x + index->x;
+    y -= pWin->drawable.y + index->y;
+    if (x < 0 || y < 0 ||
+        x >= index->cols * index->cell_width ||
+        y >= index->rows * index->cell_height) {
+        *count = 0;
+        return index->entries;
+    }
+    cell = (y / index->cell_height) * index->cols + x / index->cell_width;
+    *count = index->start[cell + 1] - index->start[cell];
+    return &index->entries[index->start[cell]];
+}
+
 static void
 FreeWindowResources(WindowPtr pWin)
 {
@@ -993,6 +1151,7 @@ FreeWindowResources(WindowPtr pWin)
         dixDestroyPixmap(pWin->background.pixmap, 0);
 
     DeleteAllWindowProperties(pWin);
+    InvalidateChildIndex(pWin);
 
     /* We SHOULD check for an error value here XXX */
     dixScreenRaiseWindowDestroy(pWin);
@@ -1065,6 +1224,7 @@ DeleteWindow(void *value, XID wid)
 
     FreeWindowResources(pWin);
     if (pParent) {
+        InvalidateChildIndex(pParent);
         if (pParent->firstChild == pWin)
             pParent->firstChild = pWin->nextSib;
         if (pParent->lastChild == pWin)
@@ -1630,6 +1790,8 @@ MoveWindowInStack(WindowPtr pWin, WindowPtr pNextSib)
     if (pWin->nextSib != pNextSib) {
         WindowPtr pOldNextSib = pWin->nextSib;
 
+        InvalidateChildIndex(pParent);
+
         if (!pNextSib) {        /* move to bottom */
             if (pParent->firstChild == pWin)
                 pParent->firstChild = pWin->nextSib;
@@ -1739,6 +1901,10 @@ SetBorderSize(WindowPtr pWin)
 {
     int bw;
 
+    /* geometry of a child changed */
+    if (pWin->parent)
+        InvalidateChildIndex(pWin->parent);
+
     if (HasBorder(pWin)) {
         bw = wBorderWidth(pWin);
         if (pWin->redirectDraw != RedirectDrawNone) {
@@ -2524,6 +2690,7 @@ ReparentWindow(WindowPtr pWin, WindowPtr pParent,
     /* take out of sibling chain */
 
     pPriorParent = pPrev = pWin->parent;
+    InvalidateChildIndex(pPriorParent);
     if (pPrev->firstChild == pWin)
         pPrev->firstChild = pWin->nextSib;
     if (pPrev->lastChild == pWin)
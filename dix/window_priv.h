@@ -53,4 +53,18 @@ Bool MakeWindowOptional(WindowPtr pWin);
  */
 Bool dixWindowIsRoot(Window window);
 
+/*
+ * @brief look up the children of a window that may contain a point
+ *
+ * For windows with many children, returns the children whose border box
+ * may contain (x, y) in screen coordinates, topmost first, and stores how
+ * many there are in count.  Whether the point is really inside any of them,
+ * or whether they are mapped, is up to the caller.  The list is valid until
+ * the window tree changes.
+ *
+ * @return the candidates, or NULL if pWin has too few children to be
+ *         worth indexing and the caller should walk them itself
+ */
+WindowPtr *dixWindowChildrenAt(WindowPtr pWin, int x, int y, int *count);
+
 #endif /* _XSERVER_DIX_WINDOW_PRIV_H */
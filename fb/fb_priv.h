@@ -9,6 +9,7 @@
 
 #include "include/scrnintstr.h"
 #include "fb/fb.h"
+#include "os/kernels_priv.h"
 
 #define FbBitsStrideToStipStride(s) (((s) << (FB_SHIFT - FB_STIP_SHIFT)))
 
@@ -31,6 +32,60 @@ static inline void fbValidateDrawable(DrawablePtr d) {}
 
 #endif /* FB_DEBUG */
 
+/* renders rows [y1, y2) of a banded operation */
+typedef void (*FbBandProc) (int y1, int y2, void *closure);
+
+/*
+ * Split rows [y, y + height) of an operation width pixels wide into bands
+ * and run them on the render threads, returning once all are done.
+ * Returns FALSE without calling anything if the operation is too small or
+ * there are no render threads; the caller then renders it by itself.
+ */
+Bool fbRunBands(int y, int width, int height, FbBandProc proc, void *closure);
+
+void fbSolidRect(FbBits *dst, FbStride dstStride, int dstBpp,
+                 int x, int y, int width, int height, FbBits and, FbBits xor);
+
+/*
+ * Pick the loops applying an and/xor pair along a row, for solid fills
+ * with a raster op and for tiles a word wide: word by word up to
+ * KERNELS_SCALAR, or four and eight words at a time with SSE2 and AVX2.
+ * Overlapping GXcopy rows go through memmove() above KERNELS_REFERENCE.
+ * The level in use comes back, which may be lower on older CPUs.
+ * fbSetupScreen() asks for KERNELS_BEST.
+ */
+KernelLevel fbSelectKernels(KernelLevel level);
+
+typedef void (*FbSolidRowProcPtr) (FbBits *dst, int n, FbBits and,
+                                   FbBits xor);
+
+extern FbSolidRowProcPtr fbSolidRowProc;        /* NULL: reference code */
+extern Bool fbBltMemmove;       /* byte aligned overlapping GXcopy rows */
+
+/* rows narrower than this aren't worth calling a kernel for */
+#define FB_SOLID_ROW_MIN 8
+
+/* FbDoRRop() on n words from dst on, returns the word after them */
+static inline FbBits *
+fbSolidRow(FbBits *dst, int n, FbBits and, FbBits xor)
+{
+#ifndef FB_ACCESS_WRAPPER
+    if (fbSolidRowProc && n >= FB_SOLID_ROW_MIN) {
+        (*fbSolidRowProc) (dst, n, and, xor);
+        return dst + n;
+    }
+#endif
+    if (!and)
+        while (n--)
+            WRITE(dst++, xor);
+    else
+        while (n--) {
+            WRITE(dst, FbDoRRop(READ(dst), and, xor));
+            dst++;
+        }
+    return dst;
+}
+
 Bool fbAllocatePrivates(ScreenPtr pScreen);
 int  fbListInstalledColormaps(ScreenPtr pScreen, Colormap* pmaps);
 
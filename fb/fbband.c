@@ -0,0 +1,155 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Banded rendering on worker threads.
+ *
+ * With -fbthreads, large composite, fill and copy operations are cut into
+ * horizontal bands which a pool of worker threads and the calling thread
+ * render at the same time.  The caller only returns once every band is
+ * done, so nothing is left in flight and GetImage, MIT-SHM or anything else
+ * reading the framebuffer needs no further synchronization.
+ */
+
+#include <dix-config.h>
+
+#include "os/osdep.h"
+
+#include "fb/fb_priv.h"
+
+/* bands smaller than this are not worth waking anybody up for */
+#define FB_BAND_MIN_PIXELS  (64 * 1024)
+#define FB_BAND_MIN_ROWS    16
+
+#if defined(INPUTTHREAD) && !defined(FB_ACCESS_WRAPPER)
+
+#include <pthread.h>
+#include <signal.h>
+
+static struct {
+    FbBandProc proc;
+    void *closure;
+    int y, height;
+    int nbands;
+    int next;                   /* next band to hand out */
+    int pending;                /* bands handed out but not done yet */
+} band_job;
+
+static pthread_mutex_t band_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t band_queued = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t band_done = PTHREAD_COND_INITIALIZER;
+static int band_threads = -1;   /* not started yet */
+static Bool band_busy;
+
+/* Called and returns with band_mutex held */
+static void
+fbRunOneBand(void)
+{
+    int band = band_job.next++;
+    int y1 = band_job.y + band_job.height * band / band_job.nbands;
+    int y2 = band_job.y + band_job.height * (band + 1) / band_job.nbands;
+
+    pthread_mutex_unlock(&band_mutex);
+    (*band_job.proc) (y1, y2, band_job.closure);
+    pthread_mutex_lock(&band_mutex);
+
+    if (--band_job.pending == 0)
+        pthread_cond_signal(&band_done);
+}
+
+static void *
+fbBandWorker(void *arg)
+{
+    sigset_t set;
+
+    /* Don't handle any signals on this thread */
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+#if defined(HAVE_PTHREAD_SETNAME_NP_WITH_TID)
+    pthread_setname_np(pthread_self(), "RenderWorker");
+#elif defined(HAVE_PTHREAD_SETNAME_NP_WITHOUT_TID)
+    pthread_setname_np("RenderWorker");
+#endif
+
+    pthread_mutex_lock(&band_mutex);
+    for (;;) {
+        while (band_job.next >= band_job.nbands)
+            pthread_cond_wait(&band_queued, &band_mutex);
+        fbRunOneBand();
+    }
+    return NULL;
+}
+
+static void
+fbStartBandThreads(void)
+{
+    pthread_t thread;
+    int i;
+
+    for (i = 0; i < FbThreads; i++)
+        if (pthread_create(&thread, NULL, fbBandWorker, NULL) != 0)
+            break;
+    if (i < FbThreads)
+        LogMessage(X_WARNING, "fb: only %d of %d render threads started\n",
+                   i, FbThreads);
+    band_threads = i;
+}
+
+Bool
+fbRunBands(int y, int width, int height, FbBandProc proc, void *closure)
+{
+    int nbands, y1;
+
+    if (FbThreads <= 0 || band_busy)
+        return FALSE;
+    if (band_threads < 0)
+        fbStartBandThreads();
+    if (band_threads == 0)
+        return FALSE;
+
+    /* a couple of bands per thread evens out the load */
+    nbands = 2 * (band_threads + 1);
+    if ((int64_t) width * height < (int64_t) nbands * FB_BAND_MIN_PIXELS)
+        nbands = (int64_t) width * height / FB_BAND_MIN_PIXELS;
+    if (height < nbands * FB_BAND_MIN_ROWS)
+        nbands = height / FB_BAND_MIN_ROWS;
+    if (nbands < 2)
+        return FALSE;
+
+    band_busy = TRUE;
+
+    /*
+     * The first band runs on its own: pixman validates images lazily on
+     * first use, and that must not happen on several threads at once.
+     */
+    y1 = y + height / nbands;
+    (*proc) (y, y1, closure);
+
+    pthread_mutex_lock(&band_mutex);
+    band_job.proc = proc;
+    band_job.closure = closure;
+    band_job.y = y1;
+    band_job.height = y + height - y1;
+    band_job.nbands = nbands - 1;
+    band_job.next = 0;
+    band_job.pending = nbands - 1;
+    pthread_cond_broadcast(&band_queued);
+
+    while (band_job.next < band_job.nbands)
+        fbRunOneBand();
+    while (band_job.pending)
+        pthread_cond_wait(&band_done, &band_mutex);
+    pthread_mutex_unlock(&band_mutex);
+    band_busy = FALSE;
+
+    return TRUE;
+}
+
+#else /* INPUTTHREAD && !FB_ACCESS_WRAPPER */
+
+Bool
+fbRunBands(int y, int width, int height, FbBandProc proc, void *closure)
+{
+    return FALSE;
+}
+
+#endif /* INPUTTHREAD && !FB_ACCESS_WRAPPER */
@@ -23,7 +23,7 @@
 #include <dix-config.h>
 
 #include <string.h>
-#include "fb.h"
+#include "fb/fb_priv.h"
 
 #ifdef FB_ACCESS_WRAPPER
 
@@ -115,6 +115,18 @@ fbBlt(FbBits * srcLine,
 
             return;
         }
+
+#ifndef FB_ACCESS_WRAPPER
+        /* within the same rows, when scrolling sideways */
+        if (fbBltMemmove) {
+            int i;
+
+            for (i = 0; i < height; i++)
+                memmove(dst_byte + i * dst_byte_stride,
+                        src_byte + i * src_byte_stride, width_byte);
+            return;
+        }
+#endif
     }
 
     FbInitializeMergeRop(alu, pm);
@@ -26,6 +26,48 @@
 
 #include "fb/fb_priv.h"
 
+typedef struct {
+    FbBits *src;
+    FbStride srcStride;
+    int srcBpp;
+    int srcX, srcY;
+    FbBits *dst;
+    FbStride dstStride;
+    int dstBpp;
+    int dstX, dstY;
+    int width;
+    CARD8 alu;
+    FbBits pm;
+    Bool reverse, upsidedown;
+} FbCopyBandRec;
+
+/* copies rows [y1, y2) of the rectangle */
+static void
+fbCopyNtoNBand(int y1, int y2, void *closure)
+{
+    FbCopyBandRec *copy = closure;
+
+#ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
+    if (copy->pm == FB_ALLONES && copy->alu == GXcopy &&
+        !copy->reverse && !copy->upsidedown &&
+        pixman_blt((uint32_t *) copy->src, (uint32_t *) copy->dst,
+                   copy->srcStride, copy->dstStride,
+                   copy->srcBpp, copy->dstBpp,
+                   copy->srcX, copy->srcY + y1, copy->dstX, copy->dstY + y1,
+                   copy->width, y2 - y1))
+        return;
+#endif
+    fbBlt(copy->src + (copy->srcY + y1) * copy->srcStride,
+          copy->srcStride,
+          copy->srcX * copy->srcBpp,
+          copy->dst + (copy->dstY + y1) * copy->dstStride,
+          copy->dstStride,
+          copy->dstX * copy->dstBpp,
+          copy->width * copy->dstBpp,
+          y2 - y1, copy->alu, copy->pm, copy->dstBpp,
+          copy->reverse, copy->upsidedown);
+}
+
 void
 fbCopyNtoN(DrawablePtr pSrcDrawable,
            DrawablePtr pDstDrawable,
@@ -35,46 +77,40 @@ fbCopyNtoN(DrawablePtr pSrcDrawable,
            int dx,
            int dy, Bool reverse, Bool upsidedown, Pixel bitplane, void *closure)
 {
-    CARD8 alu = pGC ? pGC->alu : GXcopy;
-    FbBits pm = pGC ? fbGetGCPrivate(pGC)->pm : FB_ALLONES;
-    FbBits *src;
-    FbStride srcStride;
-    int srcBpp;
+    FbCopyBandRec copy = {
+        .alu = pGC ? pGC->alu : GXcopy,
+        .pm = pGC ? fbGetGCPrivate(pGC)->pm : FB_ALLONES,
+        .reverse = reverse,
+        .upsidedown = upsidedown,
+    };
     int srcXoff, srcYoff;
-    FbBits *dst;
-    FbStride dstStride;
-    int dstBpp;
     int dstXoff, dstYoff;
 
-    fbGetDrawable(pSrcDrawable, src, srcStride, srcBpp, srcXoff, srcYoff);
-    fbGetDrawable(pDstDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
+    fbGetDrawable(pSrcDrawable, copy.src, copy.srcStride, copy.srcBpp,
+                  srcXoff, srcYoff);
+    fbGetDrawable(pDstDrawable, copy.dst, copy.dstStride, copy.dstBpp,
+                  dstXoff, dstYoff);
 
     while (nbox--) {
-#ifndef FB_ACCESS_WRAPPER       /* pixman_blt() doesn't support accessors yet */
-        if (pm == FB_ALLONES && alu == GXcopy && !reverse && !upsidedown) {
-            if (!pixman_blt
-                ((uint32_t *) src, (uint32_t *) dst, srcStride, dstStride,
-                 srcBpp, dstBpp, (pbox->x1 + dx + srcXoff),
-                 (pbox->y1 + dy + srcYoff), (pbox->x1 + dstXoff),
-                 (pbox->y1 + dstYoff), (pbox->x2 - pbox->x1),
-                 (pbox->y2 - pbox->y1)))
-                goto fallback;
-            else
-                goto next;
+        int height = pbox->y2 - pbox->y1;
+
+        copy.srcX = pbox->x1 + dx + srcXoff;
+        copy.srcY = pbox->y1 + dy + srcYoff;
+        copy.dstX = pbox->x1 + dstXoff;
+        copy.dstY = pbox->y1 + dstYoff;
+        copy.width = pbox->x2 - pbox->x1;
+
+        /* bands may only run in any order if the rows don't overlap */
+        if (copy.src + (copy.srcY + height) * copy.srcStride <=
+            copy.dst + copy.dstY * copy.dstStride ||
+            copy.dst + (copy.dstY + height) * copy.dstStride <=
+            copy.src + copy.srcY * copy.srcStride) {
+            if (fbRunBands(0, copy.width, height, fbCopyNtoNBand, &copy)) {
+                pbox++;
+                continue;
+            }
         }
- fallback:
-#endif
-        fbBlt(src + (pbox->y1 + dy + srcYoff) * srcStride,
-              srcStride,
-              (pbox->x1 + dx + srcXoff) * srcBpp,
-              dst + (pbox->y1 + dstYoff) * dstStride,
-              dstStride,
-              (pbox->x1 + dstXoff) * dstBpp,
-              (pbox->x2 - pbox->x1) * dstBpp,
-              (pbox->y2 - pbox->y1), alu, pm, dstBpp, reverse, upsidedown);
-#ifndef FB_ACCESS_WRAPPER
- next:
-#endif
+        fbCopyNtoNBand(0, height, &copy);
         pbox++;
     }
     fbFinishAccess(pDstDrawable);
@@ -81,15 +81,8 @@ fbFill(DrawablePtr pDrawable, GCPtr pGC, int x, int y, int width, int height)
 
     switch (pGC->fillStyle) {
     case FillSolid:
-#ifndef FB_ACCESS_WRAPPER
-        if (pPriv->and || !pixman_fill((uint32_t *) dst, dstStride, dstBpp,
-                                       x + dstXoff, y + dstYoff,
-                                       width, height, pPriv->xor))
-#endif
-            fbSolid(dst + (y + dstYoff) * dstStride,
-                    dstStride,
-                    (x + dstXoff) * dstBpp,
-                    dstBpp, width * dstBpp, height, pPriv->and, pPriv->xor);
+        fbSolidRect(dst, dstStride, dstBpp, x + dstXoff, y + dstYoff,
+                    width, height, pPriv->and, pPriv->xor);
         break;
     case FillStippled:
     case FillOpaqueStippled:{
@@ -219,16 +212,9 @@ fbSolidBoxClipped(DrawablePtr pDrawable,
         if (partY2 <= partY1)
             continue;
 
-#ifndef FB_ACCESS_WRAPPER
-        if (and || !pixman_fill((uint32_t *) dst, dstStride, dstBpp,
-                                partX1 + dstXoff, partY1 + dstYoff,
-                                (partX2 - partX1), (partY2 - partY1), xor))
-#endif
-            fbSolid(dst + (partY1 + dstYoff) * dstStride,
-                    dstStride,
-                    (partX1 + dstXoff) * dstBpp,
-                    dstBpp,
-                    (partX2 - partX1) * dstBpp, (partY2 - partY1), and, xor);
+        fbSolidRect(dst, dstStride, dstBpp,
+                    partX1 + dstXoff, partY1 + dstYoff,
+                    (partX2 - partX1), (partY2 - partY1), and, xor);
     }
     fbFinishAccess(pDrawable);
 }
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Runtime-selected row kernels.
+ *
+ * Solid fills with a raster op other than GXcopy or a partial planemask,
+ * and tiles no wider than a word, end up applying the same and/xor pair
+ * to every word of a row.  Those rows are handed to a kernel picked for
+ * the CPU: SSE2 does four and AVX2 eight words per step.  GXcopy fills and
+ * copies without overlap go to pixman and memcpy, which pick their own.
+ */
+
+#include <dix-config.h>
+
+#include <stdint.h>
+
+#include "fb/fb_priv.h"
+
+static void
+fbSolidRowC(FbBits *dst, int n, FbBits and, FbBits xor)
+{
+    if (!and)
+        while (n--)
+            *dst++ = xor;
+    else
+        while (n--) {
+            *dst = FbDoRRop(*dst, and, xor);
+            dst++;
+        }
+}
+
+#ifdef X86_KERNELS
+
+#include <immintrin.h>
+
+__attribute__((target("sse2")))
+static void
+fbSolidRowSSE2(FbBits *dst, int n, FbBits and, FbBits xor)
+{
+    __m128i vxor = _mm_set1_epi32(xor);
+    __m128i vand = _mm_set1_epi32(and);
+
+    if (!and)
+        for (; n >= 4; n -= 4, dst += 4)
+            _mm_storeu_si128((__m128i *) dst, vxor);
+    else
+        for (; n >= 4; n -= 4, dst += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i *) dst);
+
+            _mm_storeu_si128((__m128i *) dst,
+                             _mm_xor_si128(_mm_and_si128(v, vand), vxor));
+        }
+    fbSolidRowC(dst, n, and, xor);
+}
+
+__attribute__((target("avx2")))
+static void
+fbSolidRowAVX2(FbBits *dst, int n, FbBits and, FbBits xor)
+{
+    __m256i vxor = _mm256_set1_epi32(xor);
+    __m256i vand = _mm256_set1_epi32(and);
+
+    /* stores crossing cache lines cost twice */
+    while (((uintptr_t) dst & 31) && n) {
+        *dst = FbDoRRop(*dst, and, xor);
+        dst++;
+        n--;
+    }
+
+    if (!and)
+        for (; n >= 8; n -= 8, dst += 8)
+            _mm256_store_si256((__m256i *) dst, vxor);
+    else
+        for (; n >= 8; n -= 8, dst += 8) {
+            __m256i v = _mm256_load_si256((const __m256i *) dst);
+
+            _mm256_store_si256((__m256i *) dst,
+                               _mm256_xor_si256(_mm256_and_si256(v, vand),
+                                                vxor));
+        }
+    fbSolidRowC(dst, n, and, xor);
+}
+#endif /* x86 */
+
+FbSolidRowProcPtr fbSolidRowProc;
+Bool fbBltMemmove;
+
+KernelLevel
+fbSelectKernels(KernelLevel level)
+{
+    level = OsClampKernels(level);
+
+    switch (level) {
+#ifdef X86_KERNELS
+    case KERNELS_AVX2:
+        fbSolidRowProc = fbSolidRowAVX2;
+        break;
+    case KERNELS_SSE2:
+        fbSolidRowProc = fbSolidRowSSE2;
+        break;
+#endif
+    case KERNELS_SCALAR:
+        fbSolidRowProc = fbSolidRowC;
+        break;
+    default:
+        fbSolidRowProc = NULL;
+        break;
+    }
+    fbBltMemmove = level != KERNELS_REFERENCE;
+    return level;
+}
@@ -27,6 +27,7 @@
 
 #include <string.h>
 
+#include "fb/fb_priv.h"
 #include "fb/fbpict_priv.h"
 
 #include "fb.h"
@@ -34,6 +35,28 @@
 #include "picturestr.h"
 #include "mipict.h"
 
+typedef struct {
+    CARD8 op;
+    pixman_image_t *src, *mask, *dest;
+    int xSrc, ySrc;
+    int xMask, yMask;
+    int xDst, yDst;
+    int width;
+} FbCompositeBandRec;
+
+/* composites destination rows [y1, y2) */
+static void
+fbCompositeBand(int y1, int y2, void *closure)
+{
+    FbCompositeBandRec *c = closure;
+    int dy = y1 - c->yDst;
+
+    pixman_image_composite32(c->op, c->src, c->mask, c->dest,
+                             c->xSrc, c->ySrc + dy,
+                             c->xMask, c->yMask + dy,
+                             c->xDst, y1, c->width, y2 - y1);
+}
+
 void
 fbComposite(CARD8 op,
             PicturePtr pSrc,
@@ -58,10 +81,28 @@ fbComposite(CARD8 op,
     dest = image_from_pict(pDst, TRUE, &dst_xoff, &dst_yoff);
 
     if (src && dest && !(pMask && !mask)) {
-        pixman_image_composite(op, src, mask, dest,
-                               xSrc + src_xoff, ySrc + src_yoff,
-                               xMask + msk_xoff, yMask + msk_yoff,
-                               xDst + dst_xoff, yDst + dst_yoff, width, height);
+        FbCompositeBandRec c = {
+            .op = op,
+            .src = src,
+            .mask = mask,
+            .dest = dest,
+            .xSrc = xSrc + src_xoff,
+            .ySrc = ySrc + src_yoff,
+            .xMask = xMask + msk_xoff,
+            .yMask = yMask + msk_yoff,
+            .xDst = xDst + dst_xoff,
+            .yDst = yDst + dst_yoff,
+            .width = width,
+        };
+
+        uint32_t *bits = pixman_image_get_data(dest);
+
+        /* each band only touches its own destination rows, but a source or
+         * mask in the destination's pixmap may be read from anywhere */
+        if (bits == pixman_image_get_data(src) ||
+            (mask && bits == pixman_image_get_data(mask)) ||
+            !fbRunBands(c.yDst, width, height, fbCompositeBand, &c))
+            fbCompositeBand(c.yDst, c.yDst + height, &c);
     }
 
     free_pixman_pict(pSrc, src);
@@ -470,9 +511,232 @@ image_from_pict_internal(PicturePtr pict, Bool has_clip, int *xoff, int *yoff,
     return image;
 }
 
+#ifndef FB_ACCESS_WRAPPER
+
+/*
+ * Pictures on a drawable keep the pixman images built for them, one for use
+ * as a destination (with the composite clip) and one for use as a source,
+ * so that repeated composites with the same pictures skip the setup.
+ *
+ * Everything that changes a picture marks it for validation, and the
+ * ValidatePicture wrapper below drops the images once that happens; filters
+ * are changed without validation and are handled by their own wrapper.  The
+ * window pixmap and its storage can change underneath a picture without
+ * either, so those are checked on every use.  So are the properties copied
+ * into the image: acceleration architectures like EXA clear repeat for a
+ * single composite and fall back to fb before restoring it, without going
+ * through ChangePicture.  Pictures with an alpha map are not cached, the
+ * alpha map's own pixmap might change at any time.
+ */
+
+typedef struct {
+    pixman_image_t *image;
+    unsigned long serialNumber;
+    PixmapPtr pixmap;
+    void *bits;
+    int devKind;
+    int width, height;
+    int x, y;                   /* drawable position in the pixmap */
+    int xoff, yoff;             /* offsets handed out with the image */
+    unsigned int repeat;
+    unsigned short repeatType;
+    unsigned int componentAlpha;
+    int filter;
+    xFixed *filter_params;
+    int filter_nparams;
+    Bool has_transform;
+    PictTransform transform;
+} FbPictureImageRec, *FbPictureImagePtr;
+
+typedef struct {
+    FbPictureImageRec source;
+    FbPictureImageRec dest;
+} FbPicturePrivRec, *FbPicturePrivPtr;
+
+typedef struct {
+    ValidatePictureProcPtr ValidatePicture;
+    ChangePictureFilterProcPtr ChangePictureFilter;
+    DestroyPictureProcPtr DestroyPicture;
+} FbPictureScreenPrivRec, *FbPictureScreenPrivPtr;
+
+static DevPrivateKeyRec fbPicturePrivateKeyRec;
+static DevPrivateKeyRec fbPictureScreenPrivateKeyRec;
+
+#define fbGetPicturePrivate(pPicture) ((FbPicturePrivPtr) \
+    dixLookupPrivate(&(pPicture)->devPrivates, &fbPicturePrivateKeyRec))
+#define fbGetPictureScreenPrivate(pScreen) ((FbPictureScreenPrivPtr) \
+    dixLookupPrivate(&(pScreen)->devPrivates, &fbPictureScreenPrivateKeyRec))
+
+static void
+fbDropPictureImages(PicturePtr pPicture)
+{
+    FbPicturePrivPtr priv = fbGetPicturePrivate(pPicture);
+
+    if (priv->source.image) {
+        pixman_image_unref(priv->source.image);
+        priv->source.image = NULL;
+    }
+    if (priv->dest.image) {
+        pixman_image_unref(priv->dest.image);
+        priv->dest.image = NULL;
+    }
+}
+
+static void
+fbValidatePicture(PicturePtr pPicture, Mask mask)
+{
+    FbPictureScreenPrivPtr ps_priv =
+        fbGetPictureScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbDropPictureImages(pPicture);
+    (*ps_priv->ValidatePicture) (pPicture, mask);
+}
+
+static int
+fbChangePictureFilter(PicturePtr pPicture,
+                      int filter, xFixed * params, int nparams)
+{
+    FbPictureScreenPrivPtr ps_priv =
+        fbGetPictureScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbDropPictureImages(pPicture);
+    return (*ps_priv->ChangePictureFilter) (pPicture, filter, params, nparams);
+}
+
+static void
+fbDestroyPicture(PicturePtr pPicture)
+{
+    FbPictureScreenPrivPtr ps_priv =
+        fbGetPictureScreenPrivate(pPicture->pDrawable->pScreen);
+
+    fbDropPictureImages(pPicture);
+    (*ps_priv->DestroyPicture) (pPicture);
+}
+
+static Bool
+fbPictureImageCacheable(PicturePtr pict)
+{
+    /* pictures changed since their last validation are used as they are */
+    return pict->pDrawable && !pict->alphaMap &&
+        !(pict->serialNumber & GC_CHANGE_SERIAL_BIT) &&
+        dixPrivateKeyRegistered(&fbPictureScreenPrivateKeyRec) &&
+        fbGetPictureScreenPrivate(pict->pDrawable->pScreen)->ValidatePicture;
+}
+
+/* whether the image was built with the picture's current properties */
+static Bool
+fbPictureImageMatches(FbPictureImagePtr cache, PicturePtr pict)
+{
+    if (cache->repeat != pict->repeat ||
+        cache->repeatType != pict->repeatType ||
+        cache->componentAlpha != pict->componentAlpha ||
+        cache->filter != pict->filter ||
+        cache->filter_params != pict->filter_params ||
+        cache->filter_nparams != pict->filter_nparams)
+        return FALSE;
+
+    if (!pict->transform)
+        return !cache->has_transform;
+    return cache->has_transform &&
+        memcmp(&cache->transform, pict->transform,
+               sizeof(cache->transform)) == 0;
+}
+
+static void
+fbPictureImageStamp(FbPictureImagePtr cache, PicturePtr pict)
+{
+    cache->repeat = pict->repeat;
+    cache->repeatType = pict->repeatType;
+    cache->componentAlpha = pict->componentAlpha;
+    cache->filter = pict->filter;
+    cache->filter_params = pict->filter_params;
+    cache->filter_nparams = pict->filter_nparams;
+    cache->has_transform = pict->transform != NULL;
+    if (pict->transform)
+        cache->transform = *pict->transform;
+}
+
+static pixman_image_t *
+fbCachedPictureImage(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
+{
+    FbPicturePrivPtr priv = fbGetPicturePrivate(pict);
+    FbPictureImagePtr cache = has_clip ? &priv->dest : &priv->source;
+    PixmapPtr pixmap;
+    int x, y;
+
+    fbGetDrawablePixmap(pict->pDrawable, pixmap, x, y);
+    x += pict->pDrawable->x;
+    y += pict->pDrawable->y;
+
+    if (!cache->image ||
+        cache->serialNumber != pict->serialNumber ||
+        cache->pixmap != pixmap ||
+        cache->bits != pixmap->devPrivate.ptr ||
+        cache->devKind != pixmap->devKind ||
+        cache->width != pixmap->drawable.width ||
+        cache->height != pixmap->drawable.height ||
+        cache->x != x || cache->y != y ||
+        !fbPictureImageMatches(cache, pict)) {
+        if (cache->image)
+            pixman_image_unref(cache->image);
+        cache->image = image_from_pict_internal(pict, has_clip, &cache->xoff,
+                                                &cache->yoff, FALSE);
+        if (!cache->image)
+            return NULL;
+
+        cache->serialNumber = pict->serialNumber;
+        cache->pixmap = pixmap;
+        cache->bits = pixmap->devPrivate.ptr;
+        cache->devKind = pixmap->devKind;
+        cache->width = pixmap->drawable.width;
+        cache->height = pixmap->drawable.height;
+        cache->x = x;
+        cache->y = y;
+        fbPictureImageStamp(cache, pict);
+    }
+
+    *xoff = cache->xoff;
+    *yoff = cache->yoff;
+    return pixman_image_ref(cache->image);
+}
+
+static Bool
+fbPictureCacheInit(ScreenPtr pScreen)
+{
+    PictureScreenPtr ps = GetPictureScreen(pScreen);
+    FbPictureScreenPrivPtr ps_priv;
+
+    if (!dixRegisterPrivateKey(&fbPicturePrivateKeyRec, PRIVATE_PICTURE,
+                               sizeof(FbPicturePrivRec)) ||
+        !dixRegisterPrivateKey(&fbPictureScreenPrivateKeyRec, PRIVATE_SCREEN,
+                               sizeof(FbPictureScreenPrivRec)))
+        return FALSE;
+
+    ps_priv = fbGetPictureScreenPrivate(pScreen);
+    ps_priv->ValidatePicture = ps->ValidatePicture;
+    ps_priv->ChangePictureFilter = ps->ChangePictureFilter;
+    ps_priv->DestroyPicture = ps->DestroyPicture;
+    ps->ValidatePicture = fbValidatePicture;
+    ps->ChangePictureFilter = fbChangePictureFilter;
+    ps->DestroyPicture = fbDestroyPicture;
+
+    return TRUE;
+}
+
+#endif /* !FB_ACCESS_WRAPPER */
+
+/*
+ * The image returned holds a reference of its own and has to be released
+ * with free_pixman_pict; it may be shared with later calls for the same
+ * picture and must not be modified.
+ */
 pixman_image_t *
 image_from_pict(PicturePtr pict, Bool has_clip, int *xoff, int *yoff)
 {
+#ifndef FB_ACCESS_WRAPPER
+    if (pict && fbPictureImageCacheable(pict))
+        return fbCachedPictureImage(pict, has_clip, xoff, yoff);
+#endif
     return image_from_pict_internal(pict, has_clip, xoff, yoff, FALSE);
 }
 
@@ -502,5 +766,10 @@ fbPictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
     ps->AddTriangles = fbAddTriangles;
     ps->Triangles = fbTriangles;
 
+#ifndef FB_ACCESS_WRAPPER
+    if (!fbPictureCacheInit(pScreen))
+        return FALSE;
+#endif
+
     return TRUE;
 }
@@ -100,6 +100,7 @@ fbSetupScreen(ScreenPtr pScreen, void *pbits, /* pointer to screen bitmap */
 {                               /* bits per pixel for screen */
     if (!fbAllocatePrivates(pScreen))
         return FALSE;
+    fbSelectKernels(KERNELS_BEST);
     pScreen->defColormap = dixAllocServerXID();
     if (bpp > 1) {
 	/* let CreateDefColormap do whatever it wants for pixels */
@@ -24,7 +24,7 @@
 
 #include <dix-config.h>
 
-#include "fb.h"
+#include "fb/fb_priv.h"
 
 void
 fbSolid(FbBits * dst,
@@ -32,7 +32,7 @@ fbSolid(FbBits * dst,
         int dstX, int bpp, int width, int height, FbBits and, FbBits xor)
 {
     FbBits startmask, endmask;
-    int n, nmiddle;
+    int nmiddle;
     int startbyte, endbyte;
 
     dst += dstX >> FB_SHIFT;
@@ -47,17 +47,60 @@ fbSolid(FbBits * dst,
             FbDoLeftMaskByteRRop(dst, startbyte, startmask, and, xor);
             dst++;
         }
-        n = nmiddle;
-        if (!and)
-            while (n--)
-                WRITE(dst++, xor);
-        else
-            while (n--) {
-                WRITE(dst, FbDoRRop(READ(dst), and, xor));
-                dst++;
-            }
+        dst = fbSolidRow(dst, nmiddle, and, xor);
         if (endmask)
             FbDoRightMaskByteRRop(dst, endbyte, endmask, and, xor);
         dst += dstStride;
     }
 }
+
+typedef struct {
+    FbBits *dst;
+    FbStride dstStride;
+    int dstBpp;
+    int x, width;
+    FbBits and, xor;
+} FbSolidBandRec;
+
+static void
+fbSolidBand(FbBits *dst, FbStride dstStride, int dstBpp,
+            int x, int y, int width, int height, FbBits and, FbBits xor)
+{
+#ifndef FB_ACCESS_WRAPPER
+    if (and || !pixman_fill((uint32_t *) dst, dstStride, dstBpp,
+                            x, y, width, height, xor))
+#endif
+        fbSolid(dst + y * dstStride, dstStride, x * dstBpp,
+                dstBpp, width * dstBpp, height, and, xor);
+}
+
+static void
+fbSolidBandProc(int y1, int y2, void *closure)
+{
+    FbSolidBandRec *band = closure;
+
+    fbSolidBand(band->dst, band->dstStride, band->dstBpp,
+                band->x, y1, band->width, y2 - y1, band->and, band->xor);
+}
+
+/*
+ * Fill a rectangle, x and y in pixels from the start of dst, using pixman
+ * where it can and the render threads when the rectangle is large.
+ */
+void
+fbSolidRect(FbBits *dst, FbStride dstStride, int dstBpp,
+            int x, int y, int width, int height, FbBits and, FbBits xor)
+{
+    FbSolidBandRec band = {
+        .dst = dst,
+        .dstStride = dstStride,
+        .dstBpp = dstBpp,
+        .x = x,
+        .width = width,
+        .and = and,
+        .xor = xor,
+    };
+
+    if (!fbRunBands(y, width, height, fbSolidBandProc, &band))
+        fbSolidBand(dst, dstStride, dstBpp, x, y, width, height, and, xor);
+}
@@ -22,7 +22,7 @@
 
 #include <dix-config.h>
 
-#include "fb.h"
+#include "fb/fb_priv.h"
 
 /*
  * Accelerated tile fill -- tile width is a power of two not greater
@@ -42,7 +42,7 @@ fbEvenTile(FbBits * dst,
     FbBits *t, *tileEnd, bits;
     FbBits startmask, endmask;
     FbBits and, xor;
-    int n, nmiddle;
+    int nmiddle;
     int tileX, tileY;
     int rot;
     int startbyte, endbyte;
@@ -81,15 +81,7 @@ fbEvenTile(FbBits * dst,
             FbDoLeftMaskByteRRop(dst, startbyte, startmask, and, xor);
             dst++;
         }
-        n = nmiddle;
-        if (!and)
-            while (n--)
-                WRITE(dst++, xor);
-        else
-            while (n--) {
-                WRITE(dst, FbDoRRop(READ(dst), and, xor));
-                dst++;
-            }
+        dst = fbSolidRow(dst, nmiddle, and, xor);
         if (endmask)
             FbDoRightMaskByteRRop(dst, endbyte, endmask, and, xor);
         dst += dstStride;
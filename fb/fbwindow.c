@@ -158,31 +158,12 @@ fbFillRegionSolid(DrawablePtr pDrawable,
     int n = RegionNumRects(pRegion);
     BoxPtr pbox = RegionRects(pRegion);
 
-#ifndef FB_ACCESS_WRAPPER
-    int try_mmx = 0;
-
-    if (!and)
-        try_mmx = 1;
-#endif
-
     fbGetDrawable(pDrawable, dst, dstStride, dstBpp, dstXoff, dstYoff);
 
     while (n--) {
-#ifndef FB_ACCESS_WRAPPER
-        if (!try_mmx || !pixman_fill((uint32_t *) dst, dstStride, dstBpp,
-                                     pbox->x1 + dstXoff, pbox->y1 + dstYoff,
-                                     (pbox->x2 - pbox->x1),
-                                     (pbox->y2 - pbox->y1), xor)) {
-#endif
-            fbSolid(dst + (pbox->y1 + dstYoff) * dstStride,
-                    dstStride,
-                    (pbox->x1 + dstXoff) * dstBpp,
-                    dstBpp,
-                    (pbox->x2 - pbox->x1) * dstBpp,
-                    pbox->y2 - pbox->y1, and, xor);
-#ifndef FB_ACCESS_WRAPPER
-        }
-#endif
+        fbSolidRect(dst, dstStride, dstBpp,
+                    pbox->x1 + dstXoff, pbox->y1 + dstYoff,
+                    (pbox->x2 - pbox->x1), (pbox->y2 - pbox->y1), and, xor);
         fbValidateDrawable(pDrawable);
         pbox++;
     }
@@ -8,6 +8,7 @@
 #define fbArc32 wfbArc32
 #define fbArc8 wfbArc8
 #define fbBlt wfbBlt
+#define fbBltMemmove wfbBltMemmove
 #define fbBltOne wfbBltOne
 #define fbBltPlane wfbBltPlane
 #define fbBltStip wfbBltStip
@@ -101,9 +102,11 @@
 #define fbRealizeFont wfbRealizeFont
 #define fbReplicatePixel wfbReplicatePixel
 #define fbResolveColor wfbResolveColor
+#define fbRunBands wfbRunBands
 #define fbScreenPrivateKeyRec wfbScreenPrivateKeyRec
 #define fbSegment wfbSegment
 #define fbSelectBres wfbSelectBres
+#define fbSelectKernels wfbSelectKernels
 #define fbSetSpans wfbSetSpans
 #define fbSetupScreen wfbSetupScreen
 #define fbSetVisualTypes wfbSetVisualTypes
@@ -111,6 +114,8 @@
 #define _fbSetWindowPixmap _wfbSetWindowPixmap
 #define fbSolid wfbSolid
 #define fbSolidBoxClipped wfbSolidBoxClipped
+#define fbSolidRect wfbSolidRect
+#define fbSolidRowProc wfbSolidRowProc
 #define fbTile wfbTile
 #define fbTrapezoids wfbTrapezoids
 #define fbTriangles wfbTriangles
@@ -206,11 +206,8 @@ GLXReset(ExtensionEntry *extEntry)
     GlxMappingReset();
 
     if ((dispatchException & DE_TERMINATE) == DE_TERMINATE) {
-        while (vndInitCallbackList.list != NULL) {
-            CallbackPtr next = vndInitCallbackList.list->next;
-            free(vndInitCallbackList.list);
-            vndInitCallbackList.list = next;
-        }
+        free(vndInitCallbackList.callbacks);
+        memset(&vndInitCallbackList, 0, sizeof(vndInitCallbackList));
     }
 }
 
@@ -74,9 +74,9 @@
  * mask is 0xFFFF0000.
  */
 #define ABI_ANSIC_VERSION	SET_ABI_VERSION(1, 4)
-#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(28, 0)
-#define ABI_XINPUT_VERSION	SET_ABI_VERSION(26, 0)
-#define ABI_EXTENSION_VERSION	SET_ABI_VERSION(11, 0)
+#define ABI_VIDEODRV_VERSION	SET_ABI_VERSION(29, 0)
+#define ABI_XINPUT_VERSION	SET_ABI_VERSION(27, 0)
+#define ABI_EXTENSION_VERSION	SET_ABI_VERSION(12, 0)
 
 #define MODINFOSTRING1	0xef23fdc5
 #define MODINFOSTRING2	0x10dc023a
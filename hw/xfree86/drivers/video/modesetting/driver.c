@@ -1382,6 +1382,7 @@ PreInit(ScrnInfoPtr pScrn, int flags)
         ms->shadow.Setup        = LoaderSymbolFromModule(mod, "shadowSetup");
         ms->shadow.Add          = LoaderSymbolFromModule(mod, "shadowAdd");
         ms->shadow.Remove       = LoaderSymbolFromModule(mod, "shadowRemove");
+        ms->shadow.SetTiles     = LoaderSymbolFromModule(mod, "shadowSetTiles");
         ms->shadow.Update32to24 = LoaderSymbolFromModule(mod, "shadowUpdate32to24");
         ms->shadow.UpdatePacked = LoaderSymbolFromModule(mod, "shadowUpdatePacked");
     }
@@ -1406,7 +1407,8 @@ msShadowWindow(ScreenPtr screen, CARD32 row, CARD32 offset, int mode,
 }
 
 /* somewhat arbitrary tile size, in pixels */
-#define TILE 16
+#define TILE_SHIFT 4
+#define TILE (1 << TILE_SHIFT)
 
 static int
 msUpdateIntersect(modesettingPtr ms, shadowBufPtr pBuf, BoxPtr box,
@@ -1448,39 +1450,68 @@ msUpdatePacked(ScreenPtr pScreen, shadowBufPtr pBuf)
     Bool use_3224 = ms->drmmode.force_24_32 && pScrn->bitsPerPixel == 32;
 
     if (ms->drmmode.shadow_enable2 && ms->drmmode.shadow_fb2) do {
-        RegionPtr damage = DamageRegion(pBuf->pDamage), tiles;
-        BoxPtr extents = RegionExtents(damage);
+        RegionPtr damage, tiles;
         xRectangle *prect;
         int nrects;
-        int i, j, tx1, tx2, ty1, ty2;
 
-        tx1 = extents->x1 / TILE;
-        tx2 = (extents->x2 + TILE - 1) / TILE;
-        ty1 = extents->y1 / TILE;
-        ty2 = (extents->y2 + TILE - 1) / TILE;
+        if (DamageTilesComplete(pBuf->pDamage)) {
+            /* the damage is kept in TILE sized tiles, only walk the dirty ones */
+            BoxRec run;
+            int pos;
 
-        nrects = (tx2 - tx1) * (ty2 - ty1);
-        if (!(prect = calloc(nrects, sizeof(xRectangle))))
-            break;
+            nrects = 0;
+            for (pos = 0; DamageNextDirtyTiles(pBuf->pDamage, &pos, &run);)
+                nrects += (run.x2 - run.x1 + TILE - 1) / TILE;
+            if (!(prect = calloc(nrects, sizeof(xRectangle))))
+                break;
 
-        nrects = 0;
-        for (j = ty2 - 1; j >= ty1; j--) {
-            for (i = tx2 - 1; i >= tx1; i--) {
-                BoxRec box;
+            nrects = 0;
+            for (pos = 0; DamageNextDirtyTiles(pBuf->pDamage, &pos, &run);) {
+                BoxRec box = run;
 
-                box.x1 = max(i * TILE, extents->x1);
-                box.y1 = max(j * TILE, extents->y1);
-                box.x2 = min((i+1) * TILE, extents->x2);
-                box.y2 = min((j+1) * TILE, extents->y2);
-
-                if (RegionContainsRect(damage, &box) != rgnOUT) {
-                    if (msUpdateIntersect(ms, pBuf, &box, prect + nrects)) {
+                for (box.x1 = run.x1; box.x1 < run.x2; box.x1 += TILE) {
+                    box.x2 = min(box.x1 + TILE, run.x2);
+                    if (msUpdateIntersect(ms, pBuf, &box, prect + nrects))
                         nrects++;
+                }
+            }
+        }
+        else {
+            BoxPtr extents;
+            int i, j, tx1, tx2, ty1, ty2;
+
+            damage = DamageRegion(pBuf->pDamage);
+            extents = RegionExtents(damage);
+
+            tx1 = extents->x1 / TILE;
+            tx2 = (extents->x2 + TILE - 1) / TILE;
+            ty1 = extents->y1 / TILE;
+            ty2 = (extents->y2 + TILE - 1) / TILE;
+
+            nrects = (tx2 - tx1) * (ty2 - ty1);
+            if (!(prect = calloc(nrects, sizeof(xRectangle))))
+                break;
+
+            nrects = 0;
+            for (j = ty2 - 1; j >= ty1; j--) {
+                for (i = tx2 - 1; i >= tx1; i--) {
+                    BoxRec box;
+
+                    box.x1 = max(i * TILE, extents->x1);
+                    box.y1 = max(j * TILE, extents->y1);
+                    box.x2 = min((i+1) * TILE, extents->x2);
+                    box.y2 = min((j+1) * TILE, extents->y2);
+
+                    if (RegionContainsRect(damage, &box) != rgnOUT) {
+                        if (msUpdateIntersect(ms, pBuf, &box, prect + nrects)) {
+                            nrects++;
+                        }
                     }
                 }
             }
         }
 
+        damage = DamageRegion(pBuf->pDamage);
         tiles = RegionFromRects(nrects, prect, CT_NONE);
         RegionIntersect(damage, damage, tiles);
         RegionDestroy(tiles);
@@ -1676,6 +1707,8 @@ modesetCreateScreenResources(ScreenPtr pScreen)
         if (!ms->shadow.Add(pScreen, rootPixmap, msUpdatePacked, msShadowWindow,
                             0, 0))
             return FALSE;
+        if (ms->drmmode.shadow_enable2)
+            ms->shadow.SetTiles(pScreen, TILE_SHIFT);
     }
 
     err = drmModeDirtyFB(ms->fd, ms->drmmode.fb_id, NULL, 0);
@@ -1685,6 +1718,10 @@ modesetCreateScreenResources(ScreenPtr pScreen)
                                   pScreen, rootPixmap);
 
         if (ms->damage) {
+            /* read once per frame; the kernel takes at most
+             * DRM_MODE_FB_DIRTY_MAX_CLIPS clip rectangles at once */
+            DamageSetDeferred(ms->damage, TRUE);
+            DamageSetMaxRects(ms->damage, 256);
             DamageRegister(&rootPixmap->drawable, ms->damage);
             ms->dirty_enabled = err != -EINVAL && err != -ENOSYS;
             xf86DrvMsg(pScrn->scrnIndex, X_INFO, "Damage tracking initialized\n");
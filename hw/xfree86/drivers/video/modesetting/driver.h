@@ -152,6 +152,7 @@ typedef struct _modesettingRec {
         Bool (*Add)(ScreenPtr, PixmapPtr, ShadowUpdateProc, ShadowWindowProc,
                     int, void *);
         void (*Remove)(ScreenPtr, PixmapPtr);
+        void (*SetTiles)(ScreenPtr, int);
         void (*Update32to24)(ScreenPtr, shadowBufPtr);
         void (*UpdatePacked)(ScreenPtr, shadowBufPtr);
     } shadow;
@@ -64,6 +64,32 @@ typedef struct _CallbackList *CallbackListPtr;  /* also in misc.h */
 
 typedef void (*CallbackProcPtr) (CallbackListPtr *, void *, void *);
 
+typedef struct _CallbackRec {
+    CallbackProcPtr proc;       /* NULL once deleted from within a call */
+    void *data;
+} CallbackRec, *CallbackPtr;
+
+/*
+ * Callbacks are kept in registration order in a flat array and called
+ * newest first.  Deleting one while the list is being called only clears
+ * its slot; the array is compacted once the outermost call returns.
+ */
+typedef struct _CallbackList {
+    int numCallbacks;           /* live callbacks */
+    int numEntries;             /* used slots, including cleared ones */
+    int size;
+    int inCallback;
+    Bool deleted;
+    CallbackPtr callbacks;
+} CallbackListRec;
+
+/* TRUE if calling the list would not call anything */
+static inline Bool
+CallbackListEmpty(CallbackListPtr cbl)
+{
+    return !cbl || !cbl->numCallbacks;
+}
+
 extern _X_EXPORT Bool AddCallback(CallbackListPtr *pcbl,
                                   CallbackProcPtr callback,
                                   void *data);
@@ -78,7 +104,7 @@ extern _X_EXPORT void _CallCallbacks(CallbackListPtr *pcbl,
 static inline void
 CallCallbacks(CallbackListPtr *pcbl, void *call_data)
 {
-    if (!pcbl || !*pcbl)
+    if (!pcbl || CallbackListEmpty(*pcbl))
         return;
     _CallCallbacks(pcbl, call_data);
 }
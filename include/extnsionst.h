@@ -93,6 +93,18 @@ AddExtension(const char * /*name */ ,
              unsigned short (* /*MinorOpcodeProc */ )(ClientPtr /*client */ )
     );
 
+/*
+ * Let Dispatch() call the extension's requests directly, bypassing its
+ * main procs.  Only for extensions whose main procs do nothing but call
+ * procs[minor] / swappedProcs[minor] for minor < numRequests and fail with
+ * BadRequest otherwise.  The vectors are read on every request, so they
+ * may still be changed afterwards.
+ */
+extern _X_EXPORT void
+SetExtensionRequestVectors(ExtensionEntry *ext, int numRequests,
+                           int (**procs) (ClientPtr),
+                           int (**swappedProcs) (ClientPtr));
+
 extern _X_EXPORT ExtensionEntry *
 CheckExtension(const char *extname);
 extern _X_EXPORT ExtensionEntry *
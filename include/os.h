@@ -96,6 +96,15 @@ extern _X_EXPORT int ReadFdFromClient(ClientPtr client);
 extern _X_EXPORT int WriteToClient(ClientPtr /*who */ , int /*count */ ,
                                    const void * /*buf */ );
 
+typedef void (*ClientWriteReleaseProcPtr)(void *closure);
+
+/* Queue buf for writing without copying it; release(closure) is called
+ * once the server is done with buf. */
+extern _X_EXPORT int WriteToClientRef(ClientPtr who, int count,
+                                      const void *buf,
+                                      ClientWriteReleaseProcPtr release,
+                                      void *closure);
+
 typedef void (*NotifyFdProcPtr)(int fd, int ready, void *data);
 
 #include "fd_notify.h"
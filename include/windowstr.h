@@ -124,6 +124,16 @@ typedef struct _WindowOpt {
 #define RedirectDrawAutomatic	1
 #define RedirectDrawManual	2
 
+/*
+ * Events selected on a window, in any form and by any client or device.
+ * Only ever a superset of what may actually be delivered.
+ */
+typedef struct _EventSummary {
+    Mask core;                  /* core event masks */
+    Mask xi;                    /* XI 1.x event masks */
+    uint64_t xi2;               /* XI2 event types */
+} EventSummaryRec;
+
 typedef struct _Window {
     DrawableRec drawable;
     PrivateRec *devPrivates;
@@ -164,6 +174,11 @@ typedef struct _Window {
     unsigned inhibitBGPaint:1;  /* paint the background? */
 
     PropertyPtr properties;     /* default: NULL */
+    struct _PropertyIndex *propertyIndex;       /* default: NULL */
+    struct _ChildIndex *childIndex;     /* default: NULL */
+    EventSummaryRec selectedEvents;     /* selected here, or stopped here
+                                           by a do-not-propagate mask */
+    EventSummaryRec ancestorEvents;     /* selected here or on any ancestor */
 } WindowRec;
 
 /*
@@ -68,6 +68,8 @@ in this Software without prior written authorization from The Open Group.
 #define QUEUE_INITIAL_SIZE                 512
 #define QUEUE_RESERVED_SIZE                 64
 #define QUEUE_MAXIMUM_SIZE                4096
+/* one slab of event storage for the initial queue and each doubling */
+#define QUEUE_SLABS                          4
 #define QUEUE_DROP_BACKTRACE_FREQUENCY     100
 #define QUEUE_DROP_BACKTRACE_MAX            10
 
@@ -87,6 +89,9 @@ typedef struct _EventQueue {
     EventRec *events;           /* our queue as an array */
     size_t nevents;             /* the number of buckets in our queue */
     size_t dropped;             /* counter for number of consecutive dropped events */
+    size_t device_dropped[MAXDEVICES];  /* the same, per device id */
+    InternalEvent *slabs[QUEUE_SLABS];  /* storage the events point into */
+    int nslabs;
     mieqHandler handlers[128];  /* custom event handler */
 } EventQueueRec, *EventQueuePtr;
 
@@ -108,30 +113,36 @@ mieqNumEnqueued(EventQueuePtr eventQueue)
     return n_enqueued;
 }
 
-/* Pre-condition: Called with input_lock held */
+/*
+ * Allocate a new event array of new_nevents and a single slab of event
+ * storage for the entries beyond nevents.  Doesn't touch the queue, so it
+ * can be called without input_lock.
+ */
 static Bool
-mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
+mieqAllocQueue(size_t nevents, size_t new_nevents,
+               EventRec **new_events, InternalEvent **slab)
 {
-    size_t i, n_enqueued, first_hunk;
-    EventRec *new_events;
-
-    if (!eventQueue) {
-        ErrorF("[mi] mieqGrowQueue called with a NULL eventQueue\n");
-        return FALSE;
-    }
-
-    if (new_nevents <= eventQueue->nevents)
-        return FALSE;
-
-    new_events = calloc(new_nevents, sizeof(EventRec));
-    if (new_events == NULL) {
+    *new_events = calloc(new_nevents, sizeof(EventRec));
+    *slab = InitEventList(new_nevents - nevents);
+    if (!*new_events || !*slab) {
         ErrorF("[mi] mieqGrowQueue memory allocation error.\n");
+        free(*new_events);
+        FreeEventList(*slab, new_nevents - nevents);
         return FALSE;
     }
+    return TRUE;
+}
+
+/* Pre-condition: Called with input_lock held */
+static void
+mieqSwapQueue(EventQueuePtr eventQueue, size_t new_nevents,
+              EventRec *new_events, InternalEvent *slab)
+{
+    size_t i, n_enqueued, first_hunk;
 
     n_enqueued = mieqNumEnqueued(eventQueue);
 
-    /* First copy the existing events */
+    /* First copy the existing events, they keep their storage */
     first_hunk = eventQueue->nevents - eventQueue->head;
     if (eventQueue->events) {
         memcpy(new_events,
@@ -141,20 +152,10 @@ mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
                eventQueue->events, eventQueue->head * sizeof(EventRec));
     }
 
-    /* Initialize the new portion */
-    for (i = eventQueue->nevents; i < new_nevents; i++) {
-        InternalEvent *evlist = InitEventList(1);
-
-        if (!evlist) {
-            size_t j;
-
-            for (j = 0; j < i; j++)
-                FreeEventList(new_events[j].events, 1);
-            free(new_events);
-            return FALSE;
-        }
-        new_events[i].events = evlist;
-    }
+    /* The new portion points into the new slab */
+    for (i = eventQueue->nevents; i < new_nevents; i++)
+        new_events[i].events = &slab[i - eventQueue->nevents];
+    eventQueue->slabs[eventQueue->nslabs++] = slab;
 
     /* And update our record */
     eventQueue->tail = n_enqueued;
@@ -162,10 +163,66 @@ mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
     eventQueue->nevents = new_nevents;
     free(eventQueue->events);
     eventQueue->events = new_events;
+}
+
+/* Pre-condition: Called with input_lock held */
+static Bool
+mieqGrowQueue(EventQueuePtr eventQueue, size_t new_nevents)
+{
+    EventRec *new_events;
+    InternalEvent *slab;
 
+    if (!eventQueue) {
+        ErrorF("[mi] mieqGrowQueue called with a NULL eventQueue\n");
+        return FALSE;
+    }
+
+    if (new_nevents <= eventQueue->nevents ||
+        new_nevents > QUEUE_MAXIMUM_SIZE ||
+        eventQueue->nslabs == QUEUE_SLABS)
+        return FALSE;
+
+    if (!mieqAllocQueue(eventQueue->nevents, new_nevents, &new_events, &slab))
+        return FALSE;
+    mieqSwapQueue(eventQueue, new_nevents, new_events, slab);
     return TRUE;
 }
 
+/*
+ * Grow the queue from the main thread once it is half full, allocating
+ * without input_lock, so that the input thread rarely has to grow it (and
+ * block other input) itself.
+ *
+ * Pre-condition: Called with input_lock held
+ */
+static void
+mieqGrowQueueAhead(EventQueuePtr eventQueue)
+{
+    size_t nevents = eventQueue->nevents;
+    EventRec *new_events;
+    InternalEvent *slab;
+    Bool allocated;
+
+    if (nevents >= QUEUE_MAXIMUM_SIZE ||
+        eventQueue->nslabs == QUEUE_SLABS ||
+        mieqNumEnqueued(eventQueue) < nevents / 2)
+        return;
+
+    input_unlock();
+    allocated = mieqAllocQueue(nevents, nevents << 1, &new_events, &slab);
+    input_lock();
+
+    if (!allocated)
+        return;
+    if (eventQueue->nevents != nevents) {
+        /* the input thread got there first */
+        free(new_events);
+        FreeEventList(slab, nevents);
+        return;
+    }
+    mieqSwapQueue(eventQueue, nevents << 1, new_events, slab);
+}
+
 Bool
 mieqInit(void)
 {
@@ -186,13 +243,14 @@ mieqFini(void)
 {
     int i;
 
-    for (i = 0; i < miEventQueue.nevents; i++) {
-        if (miEventQueue.events[i].events != NULL) {
-            FreeEventList(miEventQueue.events[i].events, 1);
-            miEventQueue.events[i].events = NULL;
-        }
+    for (i = 0; i < miEventQueue.nslabs; i++) {
+        FreeEventList(miEventQueue.slabs[i], 0);
+        miEventQueue.slabs[i] = NULL;
     }
+    miEventQueue.nslabs = 0;
     free(miEventQueue.events);
+    miEventQueue.events = NULL;
+    miEventQueue.nevents = 0;
 }
 
 /*
@@ -228,6 +286,8 @@ mieqEnqueue(DeviceIntPtr pDev, InternalEvent *e)
              * stuck in an infinite loop in the main thread.
              */
             miEventQueue.dropped++;
+            if (pDev && pDev->id >= 0 && pDev->id < MAXDEVICES)
+                miEventQueue.device_dropped[pDev->id]++;
             if (miEventQueue.dropped == 1) {
                 ErrorF("[mi] EQ overflowing.  Additional events will be "
                        "discarded until existing events are processed.\n");
@@ -514,6 +574,20 @@ mieqProcessDeviceEvent(DeviceIntPtr dev, InternalEvent *event, ScreenPtr screen)
     }
 }
 
+static const char *
+mieqDeviceName(int id)
+{
+    DeviceIntPtr dev;
+
+    for (dev = inputInfo.devices; dev; dev = dev->next)
+        if (dev->id == id && dev->name)
+            return dev->name;
+    for (dev = inputInfo.off_devices; dev; dev = dev->next)
+        if (dev->id == id && dev->name)
+            return dev->name;
+    return "unknown";
+}
+
 /* Call this from ProcessInputEvents(). */
 void
 mieqProcessInputEvents(void)
@@ -535,13 +609,25 @@ mieqProcessInputEvents(void)
     inProcessInputEvents = TRUE;
 
     if (miEventQueue.dropped) {
+        int id;
+
         ErrorF("[mi] EQ processing has resumed after %lu dropped events.\n",
                (unsigned long) miEventQueue.dropped);
+        for (id = 0; id < MAXDEVICES; id++) {
+            if (!miEventQueue.device_dropped[id])
+                continue;
+            ErrorF("[mi]   %lu from device %d (%s)\n",
+                   (unsigned long) miEventQueue.device_dropped[id], id,
+                   mieqDeviceName(id));
+            miEventQueue.device_dropped[id] = 0;
+        }
         ErrorF
             ("[mi] This may be caused by a misbehaving driver monopolizing the server's resources.\n");
         miEventQueue.dropped = 0;
     }
 
+    mieqGrowQueueAhead(&miEventQueue);
+
     while (miEventQueue.head != miEventQueue.tail) {
         e = &miEventQueue.events[miEventQueue.head];
 
@@ -52,6 +52,7 @@ SOFTWARE.
 #include "dix/cursor_priv.h"
 #include "dix/dix_priv.h"
 #include "dix/input_priv.h"
+#include "dix/window_priv.h"
 #include "mi/mi_priv.h"
 
 #include "regionstr.h"
@@ -742,15 +743,12 @@ miMarkUnrealizedWindow(WindowPtr pChild, WindowPtr pWin, Bool fromConfigure)
     }
 }
 
-WindowPtr
-miSpriteTrace(SpritePtr pSprite, int x, int y)
+static Bool
+miSpriteHit(WindowPtr pWin, int x, int y)
 {
-    WindowPtr pWin;
     BoxRec box;
 
-    pWin = DeepestSpriteWin(pSprite)->firstChild;
-    while (pWin) {
-        if ((pWin->mapped) &&
+    return ((pWin->mapped) &&
             (x >= pWin->drawable.x - wBorderWidth(pWin)) &&
             (x < pWin->drawable.x + (int) pWin->drawable.width +
              wBorderWidth(pWin)) &&
@@ -770,18 +768,44 @@ miSpriteTrace(SpritePtr pSprite, int x, int y)
              * they're in X's stack. (E.g. if the native window system
              * implements some form of virtual desktop system).
              */
-            && !pWin->unhittable) {
-            if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
-                pSprite->spriteTraceSize += 10;
-                pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
-                                                    pSprite->spriteTraceSize,
-                                                    sizeof(WindowPtr));
+            && !pWin->unhittable);
+}
+
+WindowPtr
+miSpriteTrace(SpritePtr pSprite, int x, int y)
+{
+    WindowPtr pParent, pWin, *candidates;
+    int i, ncandidates;
+
+    pParent = DeepestSpriteWin(pSprite);
+    for (;;) {
+        /* windows with many children keep an index of them */
+        candidates = dixWindowChildrenAt(pParent, x, y, &ncandidates);
+        if (candidates) {
+            pWin = NullWindow;
+            for (i = 0; i < ncandidates; i++) {
+                if (miSpriteHit(candidates[i], x, y)) {
+                    pWin = candidates[i];
+                    break;
+                }
             }
-            pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
-            pWin = pWin->firstChild;
         }
-        else
-            pWin = pWin->nextSib;
+        else {
+            for (pWin = pParent->firstChild; pWin; pWin = pWin->nextSib)
+                if (miSpriteHit(pWin, x, y))
+                    break;
+        }
+        if (!pWin)
+            break;
+
+        if (pSprite->spriteTraceGood >= pSprite->spriteTraceSize) {
+            pSprite->spriteTraceSize += 10;
+            pSprite->spriteTrace = reallocarray(pSprite->spriteTrace,
+                                                pSprite->spriteTraceSize,
+                                                sizeof(WindowPtr));
+        }
+        pSprite->spriteTrace[pSprite->spriteTraceGood++] = pWin;
+        pParent = pWin;
     }
     return DeepestSpriteWin(pSprite);
 }
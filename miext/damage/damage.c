@@ -23,6 +23,7 @@
 #include <dix-config.h>
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "dix/screen_hooks_priv.h"
 #include "os/osdep.h"
@@ -123,6 +124,254 @@ getDrawableDamageRef(DrawablePtr pDrawable)
     DamagePtr	*pPrev = (DamagePtr *) \
 	dixLookupPrivateAddr(&(pWindow)->devPrivates, damageWinPrivateKey)
 
+/*
+ * Reduce pRegion to at most maxRects boxes by replacing groups of
+ * consecutive bands with their bounding boxes.  The result covers the
+ * original region, so consumers redraw a bit more but never miss anything.
+ */
+static void
+damageBoundRegion(RegionPtr pRegion, int maxRects)
+{
+    int nrects = RegionNumRects(pRegion);
+    int nbands, perBox, band, n, i;
+    BoxPtr rects, boxes;
+    RegionRec bounded;
+    BoxRec extents;
+
+    if (maxRects <= 0 || nrects <= maxRects)
+        return;
+
+    extents = *RegionExtents(pRegion);
+    rects = RegionRects(pRegion);
+    boxes = maxRects > 1 ? calloc(maxRects, sizeof(BoxRec)) : NULL;
+    if (!boxes) {
+        RegionReset(pRegion, &extents);
+        return;
+    }
+
+    for (nbands = 1, i = 1; i < nrects; i++)
+        nbands += rects[i].y1 != rects[i - 1].y1;
+    perBox = (nbands + maxRects - 1) / maxRects;
+
+    for (n = -1, band = -1, i = 0; i < nrects; i++) {
+        if (i == 0 || rects[i].y1 != rects[i - 1].y1) {
+            if (++band % perBox == 0) {
+                boxes[++n] = rects[i];
+                continue;
+            }
+        }
+        boxes[n].x1 = min(boxes[n].x1, rects[i].x1);
+        boxes[n].x2 = max(boxes[n].x2, rects[i].x2);
+        boxes[n].y2 = max(boxes[n].y2, rects[i].y2);
+    }
+
+    if (RegionInitBoxes(&bounded, boxes, n + 1)) {
+        RegionUninit(pRegion);
+        *pRegion = bounded;
+    }
+    else {
+        RegionUninit(&bounded);
+        RegionReset(pRegion, &extents);
+    }
+    free(boxes);
+}
+
+static RegionPtr
+damageBatchRegion(DamagePtr pDamage)
+{
+    return pDamage->reportAfter ? &pDamage->pendingDamage : &pDamage->damage;
+}
+
+/* Merge the batched boxes into the region they were collected for */
+static void
+damageFlushBatch(DamagePtr pDamage)
+{
+    RegionPtr pRegion = damageBatchRegion(pDamage);
+    RegionRec batch;
+
+    if (!pDamage->nBatch)
+        return;
+
+    if (RegionInitBoxes(&batch, pDamage->batch, pDamage->nBatch))
+        RegionUnion(pRegion, pRegion, &batch);
+    else {
+        /* out of memory, settle for the extents of the batch */
+        BoxRec extents = pDamage->batch[0];
+        int i;
+
+        for (i = 1; i < pDamage->nBatch; i++) {
+            extents.x1 = min(extents.x1, pDamage->batch[i].x1);
+            extents.y1 = min(extents.y1, pDamage->batch[i].y1);
+            extents.x2 = max(extents.x2, pDamage->batch[i].x2);
+            extents.y2 = max(extents.y2, pDamage->batch[i].y2);
+        }
+        RegionUninit(&batch);
+        RegionInit(&batch, &extents, 1);
+        RegionUnion(pRegion, pRegion, &batch);
+    }
+    RegionUninit(&batch);
+    pDamage->nBatch = 0;
+}
+
+static void
+damageBatchAppend(DamagePtr pDamage, RegionPtr pDamageRegion)
+{
+    int n = RegionNumRects(pDamageRegion);
+
+    if (pDamage->nBatch + n > DAMAGE_BATCH_BOXES)
+        damageFlushBatch(pDamage);
+    if (n > DAMAGE_BATCH_BOXES) {
+        RegionPtr pRegion = damageBatchRegion(pDamage);
+
+        RegionUnion(pRegion, pRegion, pDamageRegion);
+        return;
+    }
+    memcpy(&pDamage->batch[pDamage->nBatch], RegionRects(pDamageRegion),
+           n * sizeof(BoxRec));
+    pDamage->nBatch += n;
+}
+
+#define TILE_WORD_BITS (sizeof(unsigned long) * 8)
+
+typedef struct _damageTiles {
+    int width, height;          /* in tiles */
+    int stride;                 /* words per row */
+    Bool dirty;
+    unsigned long bits[];
+} DamageTilesRec, *DamageTilesPtr;
+
+#define tileWord(t, x, y)  (&(t)->bits[(y) * (t)->stride + (x) / TILE_WORD_BITS])
+#define tileBit(x)         (1UL << ((x) % TILE_WORD_BITS))
+
+/* The tile bitmap for the drawable's current size */
+static DamageTilesPtr
+damageGetTiles(DamagePtr pDamage)
+{
+    DamageTilesPtr tiles = pDamage->tiles;
+    DrawablePtr pDrawable = pDamage->pDrawable;
+    int size = 1 << pDamage->tileShift;
+    int width = (pDrawable->width + size - 1) >> pDamage->tileShift;
+    int height = (pDrawable->height + size - 1) >> pDamage->tileShift;
+    int stride = (width + TILE_WORD_BITS - 1) / TILE_WORD_BITS;
+    Bool was_dirty;
+    int y;
+
+    if (tiles && tiles->width == width && tiles->height == height)
+        return tiles;
+
+    /* resized, everything that was dirty before may be anywhere now */
+    was_dirty = tiles && tiles->dirty;
+    free(tiles);
+    tiles = calloc(1, sizeof(DamageTilesRec) +
+                   (size_t) stride * height * sizeof(unsigned long));
+    pDamage->tiles = tiles;
+    if (!tiles) {
+        if (was_dirty) {
+            BoxRec box = { 0, 0, pDrawable->width, pDrawable->height };
+            RegionRec region;
+
+            RegionInit(&region, &box, 1);
+            RegionUnion(&pDamage->damage, &pDamage->damage, &region);
+            RegionUninit(&region);
+        }
+        return NULL;
+    }
+    tiles->width = width;
+    tiles->height = height;
+    tiles->stride = stride;
+    if (was_dirty) {
+        for (y = 0; y < height; y++)
+            memset(tileWord(tiles, 0, y), 0xff, stride * sizeof(unsigned long));
+        tiles->dirty = TRUE;
+    }
+    return tiles;
+}
+
+static void
+damageTilesMark(DamagePtr pDamage, RegionPtr pRegion)
+{
+    DamageTilesPtr tiles = damageGetTiles(pDamage);
+    int shift = pDamage->tileShift;
+    BoxPtr pBox = RegionRects(pRegion);
+    int nBox = RegionNumRects(pRegion);
+
+    if (!tiles) {
+        /* no bitmap, fall back to the region */
+        RegionUnion(&pDamage->damage, &pDamage->damage, pRegion);
+        return;
+    }
+
+    for (; nBox--; pBox++) {
+        int x1 = max(pBox->x1, 0);
+        int y1 = max(pBox->y1, 0);
+        int x2 = min(pBox->x2, pDamage->pDrawable->width);
+        int y2 = min(pBox->y2, pDamage->pDrawable->height);
+        int x, y;
+
+        if (x1 >= x2 || y1 >= y2)
+            continue;
+        x1 >>= shift;
+        y1 >>= shift;
+        x2 = (x2 - 1) >> shift;
+        y2 = (y2 - 1) >> shift;
+
+        for (y = y1; y <= y2; y++) {
+            for (x = x1; x <= x2; x++) {
+                unsigned long *word = tileWord(tiles, x, y);
+
+                if (x % TILE_WORD_BITS == 0 && x + TILE_WORD_BITS - 1 <= x2) {
+                    *word = ~0UL;
+                    x += TILE_WORD_BITS - 1;
+                }
+                else
+                    *word |= tileBit(x);
+            }
+        }
+        tiles->dirty = TRUE;
+    }
+}
+
+static Bool
+damageTilesDirty(DamagePtr pDamage)
+{
+    return pDamage->tiles && pDamage->tiles->dirty;
+}
+
+static void
+damageTilesClear(DamagePtr pDamage)
+{
+    DamageTilesPtr tiles = pDamage->tiles;
+
+    if (tiles && tiles->dirty) {
+        memset(tiles->bits, 0,
+               (size_t) tiles->stride * tiles->height * sizeof(unsigned long));
+        tiles->dirty = FALSE;
+    }
+}
+
+/* Move the dirty tiles into the damage region */
+static void
+damageFlushTiles(DamagePtr pDamage)
+{
+    RegionRec region;
+
+    if (!damageTilesDirty(pDamage) || !pDamage->pDrawable)
+        return;
+
+    if (DamageTilesRegion(pDamage, &region))
+        RegionUnion(&pDamage->damage, &pDamage->damage, &region);
+    else {
+        BoxRec box = { 0, 0, pDamage->pDrawable->width,
+                       pDamage->pDrawable->height };
+
+        RegionUninit(&region);
+        RegionInit(&region, &box, 1);
+        RegionUnion(&pDamage->damage, &pDamage->damage, &region);
+    }
+    RegionUninit(&region);
+    damageTilesClear(pDamage);
+}
+
 #if DAMAGE_DEBUG_ENABLE
 static void
 _damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
@@ -251,15 +500,25 @@ damageRegionAppend(DrawablePtr pDrawable, RegionPtr pRegion, Bool clip,
         if (draw_x || draw_y)
             RegionTranslate(pDamageRegion, -draw_x, -draw_y);
 
+        /* Tiles are marked right away, there is nothing to merge */
+        if (pDamage->damageLevel == DamageReportTiles)
+            DamageReportDamage(pDamage, pDamageRegion);
+
         /* Store damage region if needed after submission. */
-        if (pDamage->reportAfter)
-            RegionUnion(&pDamage->pendingDamage,
-                        &pDamage->pendingDamage, pDamageRegion);
+        else if (pDamage->reportAfter) {
+            if (pDamage->deferred)
+                damageBatchAppend(pDamage, pDamageRegion);
+            else
+                RegionUnion(&pDamage->pendingDamage,
+                            &pDamage->pendingDamage, pDamageRegion);
+        }
 
         /* Report damage now, if desired. */
-        if (!pDamage->reportAfter) {
+        else {
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, pDamageRegion);
+            else if (pDamage->deferred)
+                damageBatchAppend(pDamage, pDamageRegion);
             else
                 RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
         }
@@ -283,6 +542,9 @@ damageRegionProcessPending(DrawablePtr pDrawable)
 
     for (; pDamage != NULL; pDamage = pDamage->pNext) {
         if (pDamage->reportAfter) {
+            damageFlushBatch(pDamage);
+            damageBoundRegion(&pDamage->pendingDamage, pDamage->maxRects);
+
             /* It's possible that there is only interest in postRendering reporting. */
             if (pDamage->damageReport)
                 DamageReportDamage(pDamage, &pDamage->pendingDamage);
@@ -1713,6 +1975,7 @@ DamageCreate(DamageReportFunc damageReport,
     pDamage->damageReport = damageReport;
     pDamage->damageDestroy = damageDestroy;
     pDamage->pScreen = pScreen;
+    pDamage->tileShift = DAMAGE_TILE_SHIFT;
 
     (*pScrPriv->funcs.Create) (pDamage);
 
@@ -1820,6 +2083,7 @@ DamageDestroy(DamagePtr pDamage)
     (*pScrPriv->funcs.Destroy) (pDamage);
     RegionUninit(&pDamage->damage);
     RegionUninit(&pDamage->pendingDamage);
+    free(pDamage->tiles);
     free(pDamage);
 }
 
@@ -1830,6 +2094,9 @@ DamageSubtract(DamagePtr pDamage, const RegionPtr pRegion)
     RegionRec pixmapClip;
     DrawablePtr pDrawable = pDamage->pDrawable;
 
+    if (!pDamage->reportAfter)
+        damageFlushBatch(pDamage);
+    damageFlushTiles(pDamage);
     RegionSubtract(&pDamage->damage, &pDamage->damage, pRegion);
     if (pDrawable) {
         if (pDrawable->type == DRAWABLE_WINDOW)
@@ -1856,18 +2123,27 @@ DamageSubtract(DamagePtr pDamage, const RegionPtr pRegion)
 void
 DamageEmpty(DamagePtr pDamage)
 {
+    if (!pDamage->reportAfter)
+        pDamage->nBatch = 0;
+    damageTilesClear(pDamage);
     RegionEmpty(&pDamage->damage);
 }
 
 RegionPtr
 DamageRegion(DamagePtr pDamage)
 {
+    if (!pDamage->reportAfter)
+        damageFlushBatch(pDamage);
+    damageFlushTiles(pDamage);
+    damageBoundRegion(&pDamage->damage, pDamage->maxRects);
     return &pDamage->damage;
 }
 
 RegionPtr
 DamagePendingRegion(DamagePtr pDamage)
 {
+    if (pDamage->reportAfter)
+        damageFlushBatch(pDamage);
     return &pDamage->pendingDamage;
 }
 
@@ -1899,9 +2175,113 @@ DamageDamageRegion(DrawablePtr pDrawable, RegionPtr pRegion)
 void
 DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter)
 {
+    damageFlushBatch(pDamage);
     pDamage->reportAfter = reportAfter;
 }
 
+void
+DamageSetDeferred(DamagePtr pDamage, Bool deferred)
+{
+    damageFlushBatch(pDamage);
+    pDamage->deferred = deferred;
+}
+
+void
+DamageSetMaxRects(DamagePtr pDamage, int maxRects)
+{
+    pDamage->maxRects = max(maxRects, 0);
+}
+
+void
+DamageSetTiles(DamagePtr pDamage, int tileShift)
+{
+    damageFlushBatch(pDamage);
+    damageFlushTiles(pDamage);
+    free(pDamage->tiles);
+    pDamage->tiles = NULL;
+    pDamage->tileShift = tileShift;
+    pDamage->damageLevel = DamageReportTiles;
+}
+
+Bool
+DamageNextDirtyTiles(DamagePtr pDamage, int *pos, BoxPtr pBox)
+{
+    DamageTilesPtr tiles;
+    int shift = pDamage->tileShift;
+    int x, y, end;
+
+    if (!damageTilesDirty(pDamage) || !pDamage->pDrawable ||
+        !(tiles = damageGetTiles(pDamage)))
+        return FALSE;
+
+    for (y = *pos / tiles->width, x = *pos % tiles->width; y < tiles->height;
+         y++, x = 0) {
+        while (x < tiles->width) {
+            unsigned long word = *tileWord(tiles, x, y) >> (x % TILE_WORD_BITS);
+
+            if (!word) {
+                /* skip the rest of the word */
+                x += TILE_WORD_BITS - x % TILE_WORD_BITS;
+                continue;
+            }
+            if (!(word & 1)) {
+                x++;
+                continue;
+            }
+
+            for (end = x + 1; end < tiles->width &&
+                 (*tileWord(tiles, end, y) & tileBit(end)); end++)
+                ;
+            pBox->x1 = x << shift;
+            pBox->y1 = y << shift;
+            pBox->x2 = min(end << shift, pDamage->pDrawable->width);
+            pBox->y2 = min((y + 1) << shift, pDamage->pDrawable->height);
+            *pos = y * tiles->width + end;
+            return TRUE;
+        }
+    }
+    *pos = tiles->width * tiles->height;
+    return FALSE;
+}
+
+Bool
+DamageTilesRegion(DamagePtr pDamage, RegionPtr pRegion)
+{
+    DamageTilesPtr tiles;
+    BoxPtr boxes;
+    int pos = 0, n = 0;
+    Bool ret;
+
+    if (!damageTilesDirty(pDamage) || !pDamage->pDrawable ||
+        !(tiles = damageGetTiles(pDamage))) {
+        RegionNull(pRegion);
+        return TRUE;
+    }
+
+    /* at most every other tile starts a run */
+    boxes = calloc((tiles->width + 1) / 2 * tiles->height, sizeof(BoxRec));
+    if (!boxes) {
+        RegionNull(pRegion);
+        return FALSE;
+    }
+    while (DamageNextDirtyTiles(pDamage, &pos, &boxes[n]))
+        n++;
+    ret = RegionInitBoxes(pRegion, boxes, n);
+    free(boxes);
+    return ret;
+}
+
+Bool
+DamageTilesComplete(DamagePtr pDamage)
+{
+    if (pDamage->damageLevel != DamageReportTiles || !pDamage->pDrawable)
+        return FALSE;
+    /* following a resize of the drawable may fall back to the region */
+    if (damageTilesDirty(pDamage) && !damageGetTiles(pDamage))
+        return FALSE;
+    return !RegionNotEmpty(&pDamage->damage);
+}
+
 DamageScreenFuncsPtr
 DamageGetScreenFuncs(ScreenPtr pScreen)
 {
@@ -1916,7 +2296,20 @@ DamageReportDamage(DamagePtr pDamage, RegionPtr pDamageRegion)
     RegionRec tmpRegion;
     Bool was_empty;
 
+    damageFlushBatch(pDamage);
+
     switch (pDamage->damageLevel) {
+    case DamageReportTiles:
+        was_empty = !damageTilesDirty(pDamage) &&
+            !RegionNotEmpty(&pDamage->damage);
+        if (pDamage->pDrawable)
+            damageTilesMark(pDamage, pDamageRegion);
+        else
+            RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
+        if (was_empty && pDamage->damageReport)
+            (*pDamage->damageReport) (pDamage, pDamageRegion,
+                                      pDamage->closure);
+        break;
     case DamageReportRawRegion:
         RegionUnion(&pDamage->damage, &pDamage->damage, pDamageRegion);
         (*pDamage->damageReport) (pDamage, pDamageRegion, pDamage->closure);
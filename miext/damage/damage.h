@@ -34,9 +34,13 @@ typedef enum _damageReportLevel {
     DamageReportDeltaRegion,
     DamageReportBoundingBox,
     DamageReportNonEmpty,
-    DamageReportNone
+    DamageReportNone,
+    DamageReportTiles
 } DamageReportLevel;
 
+/* default tile size of DamageReportTiles, 64x64 pixels */
+#define DAMAGE_TILE_SHIFT 6
+
 typedef void (*DamageReportFunc) (DamagePtr pDamage, RegionPtr pRegion,
                                   void *closure);
 typedef void (*DamageDestroyFunc) (DamagePtr pDamage, void *closure);
@@ -122,6 +126,46 @@ extern _X_EXPORT void
 extern _X_EXPORT void
  DamageSetReportAfterOp(DamagePtr pDamage, Bool reportAfter);
 
+/* Collect damage from drawing in a small batch and only merge it into the
+ * damage region when the region is read or reported.  Doesn't change
+ * anything for damage that is reported right away. */
+extern _X_EXPORT void
+ DamageSetDeferred(DamagePtr pDamage, Bool deferred);
+
+/* Merge nearby boxes so that the damage read or reported consists of at
+ * most maxRects rectangles, covering a bit more than what was drawn.
+ * 0 means no limit. */
+extern _X_EXPORT void
+ DamageSetMaxRects(DamagePtr pDamage, int maxRects);
+
+/*
+ * DamageReportTiles tracks damage as a bitmap of fixed-size tiles of the
+ * drawable, which makes marking damage cheap.  Consumers either walk the
+ * dirty tiles and DamageEmpty() the damage, or use DamageRegion(), which
+ * folds the tiles into the damage region.  The report function, if any,
+ * is called when the damage goes from clean to dirty.
+ */
+
+/* Switch to DamageReportTiles with tiles of (1 << tileShift) pixels */
+extern _X_EXPORT void
+ DamageSetTiles(DamagePtr pDamage, int tileShift);
+
+/* Find the next run of horizontally adjacent dirty tiles, in drawable
+ * coordinates and clipped to it.  *pos must be 0 for the first call. */
+extern _X_EXPORT Bool
+ DamageNextDirtyTiles(DamagePtr pDamage, int *pos, BoxPtr pBox);
+
+/* Initialize pRegion to the dirty tiles, FALSE if out of memory */
+extern _X_EXPORT Bool
+ DamageTilesRegion(DamagePtr pDamage, RegionPtr pRegion);
+
+/* TRUE if DamageNextDirtyTiles() finds all of the damage.  FALSE if some
+ * of it is in the damage region instead, because it was read as a region
+ * since it was last emptied, was there before DamageSetTiles() or the
+ * bitmap couldn't be allocated. */
+extern _X_EXPORT Bool
+ DamageTilesComplete(DamagePtr pDamage);
+
 extern _X_EXPORT DamageScreenFuncsPtr DamageGetScreenFuncs(ScreenPtr);
 
 #endif                          /* _DAMAGE_H_ */
@@ -32,6 +32,9 @@
 #include "privates.h"
 #include "picturestr.h"
 
+/* boxes batched by a deferred damage before they are added to its region */
+#define DAMAGE_BATCH_BOXES 64
+
 typedef struct _damage {
     DamagePtr pNext;
     DamagePtr pNextWin;
@@ -49,6 +52,20 @@ typedef struct _damage {
     Bool reportAfter;
     RegionRec pendingDamage;    /* will be flushed post submission at the latest */
     ScreenPtr pScreen;
+
+    /*
+     * Deferred damage: boxes not yet added to damage, or to pendingDamage
+     * with reportAfter.  They are reduced when the damage is read or
+     * reported, or when the batch is full.
+     */
+    Bool deferred;
+    int nBatch;
+    BoxRec batch[DAMAGE_BATCH_BOXES];
+    int maxRects;               /* 0: no limit */
+
+    /* DamageReportTiles: bitmap of dirty tiles, not yet in damage */
+    int tileShift;
+    struct _damageTiles *tiles;
 } DamageRec;
 
 typedef struct _damageScrPriv {
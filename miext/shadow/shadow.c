@@ -56,12 +56,23 @@ static void
 shadowRedisplay(ScreenPtr pScreen)
 {
     shadowBuf(pScreen);
-    RegionPtr pRegion;
+    DamagePtr pDamage;
+    Bool dirty;
 
     if (!pBuf || !pBuf->pDamage || !pBuf->update)
         return;
-    pRegion = DamageRegion(pBuf->pDamage);
-    if (RegionNotEmpty(pRegion)) {
+    pDamage = pBuf->pDamage;
+    if (pDamage->damageLevel == DamageReportTiles) {
+        /* leave the tiles for the update function to walk */
+        BoxRec box;
+        int pos = 0;
+
+        dirty = RegionNotEmpty(&pDamage->damage) ||
+            DamageNextDirtyTiles(pDamage, &pos, &box);
+    }
+    else
+        dirty = RegionNotEmpty(DamageRegion(pDamage));
+    if (dirty) {
         (*pBuf->update) (pScreen, pBuf);
         DamageEmpty(pBuf->pDamage);
     }
@@ -128,6 +139,8 @@ shadowSetup(ScreenPtr pScreen)
         free(pBuf);
         return FALSE;
     }
+    /* only looked at in the block handler */
+    DamageSetDeferred(pBuf->pDamage, TRUE);
 
     dixScreenHookClose(pScreen, shadowCloseScreen);
 
@@ -190,3 +203,11 @@ shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap)
         pBuf->pPixmap = 0;
     }
 }
+
+void
+shadowSetTiles(ScreenPtr pScreen, int tileShift)
+{
+    shadowBuf(pScreen);
+
+    DamageSetTiles(pBuf->pDamage, tileShift);
+}
@@ -81,6 +81,10 @@ shadowAdd(ScreenPtr pScreen,
 extern _X_EXPORT void
  shadowRemove(ScreenPtr pScreen, PixmapPtr pPixmap);
 
+/* Track damage in tiles of 1 << tileShift pixels, see DamageSetTiles() */
+extern _X_EXPORT void
+ shadowSetTiles(ScreenPtr pScreen, int tileShift);
+
 extern _X_EXPORT void
  shadowUpdateAfb4(ScreenPtr pScreen, shadowBufPtr pBuf);
 
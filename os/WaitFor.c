@@ -96,26 +96,133 @@ SOFTWARE.
 #include <X11/extensions/dpmsconst.h>
 #endif
 
+/*
+ * Pending timers are kept in a binary min-heap ordered by expiry, and by
+ * the order they were set in for equal expiry, so setting and cancelling
+ * a timer is O(log n).  Expiry times live on a 64-bit millisecond clock
+ * extended from GetTimeInMillis() and don't wrap.  All timers that are
+ * due get run together in one pass.
+ */
 struct _OsTimerRec {
-    struct xorg_list list;
-    CARD32 expires;
+    CARD64 expires;
+    CARD64 seq;
     CARD32 delta;
+    int index;                  /* slot in timer_heap, -1 if not pending */
     OsTimerCallback callback;
     void *arg;
 };
 
-static void DoTimer(OsTimerPtr timer, CARD32 now);
-static void DoTimers(CARD32 now);
+static void DoTimer(OsTimerPtr timer, CARD64 now);
+static void DoTimers(CARD64 now);
 static void CheckAllTimers(void);
-static volatile struct xorg_list timers;
+
+static OsTimerPtr *timer_heap;
+static int timer_count;
+static int timer_heap_size;
+static int timer_allocated;     /* timers that may need a slot in timer_heap */
+static CARD64 timer_seq;
+static CARD64 timer_clock;
+
+/* Must be called with the input lock held */
+static CARD64
+timer_now(void)
+{
+    CARD32 now = GetTimeInMillis();
+
+    if (!timer_clock)
+        timer_clock = now;
+    else
+        timer_clock += (INT32) (now - (CARD32) timer_clock);
+    return timer_clock;
+}
+
+static inline Bool
+timer_before(OsTimerPtr a, OsTimerPtr b)
+{
+    return a->expires < b->expires ||
+        (a->expires == b->expires && a->seq < b->seq);
+}
+
+static inline void
+timer_place(OsTimerPtr timer, int i)
+{
+    timer_heap[i] = timer;
+    timer->index = i;
+}
+
+static void
+timer_sift_up(int i)
+{
+    OsTimerPtr timer = timer_heap[i];
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+
+        if (!timer_before(timer, timer_heap[parent]))
+            break;
+        timer_place(timer_heap[parent], i);
+        i = parent;
+    }
+    timer_place(timer, i);
+}
+
+static void
+timer_sift_down(int i)
+{
+    OsTimerPtr timer = timer_heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= timer_count)
+            break;
+        if (child + 1 < timer_count &&
+            timer_before(timer_heap[child + 1], timer_heap[child]))
+            child++;
+        if (!timer_before(timer_heap[child], timer))
+            break;
+        timer_place(timer_heap[child], i);
+        i = child;
+    }
+    timer_place(timer, i);
+}
+
+/* timer_heap always has room for every allocated timer, see TimerSet */
+static void
+timer_insert(OsTimerPtr timer)
+{
+    timer->seq = timer_seq++;
+    timer_heap[timer_count] = timer;
+    timer_sift_up(timer_count++);
+}
+
+static void
+timer_remove(OsTimerPtr timer)
+{
+    int i = timer->index;
+    OsTimerPtr last;
+
+    if (i < 0)
+        return;
+    timer->index = -1;
+    last = timer_heap[--timer_count];
+    if (i == timer_count)
+        return;
+    timer_place(last, i);
+    if (i > 0 && timer_before(last, timer_heap[(i - 1) / 2]))
+        timer_sift_up(i);
+    else
+        timer_sift_down(i);
+}
 
 static inline OsTimerPtr
 first_timer(void)
 {
-    /* inline xorg_list_is_empty which can't handle volatile */
-    if (timers.next == &timers)
-        return NULL;
-    return xorg_list_first_entry(&timers, struct _OsTimerRec, list);
+    return timer_count ? timer_heap[0] : NULL;
+}
+
+static inline Bool timer_pending(OsTimerPtr timer) {
+    return timer->index >= 0;
 }
 
 /*
@@ -126,25 +233,25 @@ static int
 check_timers(void)
 {
     OsTimerPtr timer;
+    int timeout = -1;
 
+    input_lock();
     if ((timer = first_timer()) != NULL) {
-        CARD32 now = GetTimeInMillis();
-        int timeout = timer->expires - now;
+        CARD64 now = timer_now();
 
-        if (timeout <= 0) {
+        timeout = 0;
+        if (timer->expires <= now) {
             DoTimers(now);
-        } else {
+        } else if (timer->expires - now < (CARD64) timer->delta + 250) {
             /* Make sure the timeout is sane */
-            if (timeout < timer->delta + 250)
-                return timeout;
-
+            timeout = min(timer->expires - now, INT_MAX);
+        } else {
             /* time has rewound.  reset the timers. */
             CheckAllTimers();
         }
-
-        return 0;
     }
-    return -1;
+    input_unlock();
+    return timeout;
 }
 
 /*****************
@@ -240,24 +347,23 @@ AdjustWaitForDelay(void *waitTime, int newdelay)
         *timeoutp = newdelay;
 }
 
-static inline Bool timer_pending(OsTimerPtr timer) {
-    return !xorg_list_is_empty(&timer->list);
-}
-
 /* If time has rewound, re-run every affected timer.
- * Timers might drop out of the list, so we have to restart every time. */
+ * Timers might drop out of the heap, so we have to restart every time. */
 static void
 CheckAllTimers(void)
 {
     OsTimerPtr timer;
-    CARD32 now;
+    CARD64 now;
+    int i;
 
     input_lock();
  start:
-    now = GetTimeInMillis();
+    now = timer_now();
 
-    xorg_list_for_each_entry(timer, &timers, list) {
-        if (timer->expires - now > timer->delta + 250) {
+    for (i = 0; i < timer_count; i++) {
+        timer = timer_heap[i];
+        if (timer->expires > now &&
+            timer->expires - now > (CARD64) timer->delta + 250) {
             DoTimer(timer, now);
             goto start;
         }
@@ -266,24 +372,24 @@ CheckAllTimers(void)
 }
 
 static void
-DoTimer(OsTimerPtr timer, CARD32 now)
+DoTimer(OsTimerPtr timer, CARD64 now)
 {
     CARD32 newTime;
 
-    xorg_list_del(&timer->list);
-    newTime = (*timer->callback) (timer, now, timer->arg);
+    timer_remove(timer);
+    newTime = (*timer->callback) (timer, (CARD32) now, timer->arg);
     if (newTime)
         TimerSet(timer, 0, newTime, timer->callback, timer->arg);
 }
 
 static void
-DoTimers(CARD32 now)
+DoTimers(CARD64 now)
 {
     OsTimerPtr  timer;
 
     input_lock();
     while ((timer = first_timer())) {
-        if ((int) (timer->expires - now) > 0)
+        if (timer->expires > now)
             break;
         DoTimer(timer, now);
     }
@@ -294,47 +400,61 @@ OsTimerPtr
 TimerSet(OsTimerPtr timer, int flags, CARD32 millis,
          OsTimerCallback func, void *arg)
 {
-    OsTimerPtr existing;
-    CARD32 now = GetTimeInMillis();
+    CARD64 now;
 
     if (!timer) {
         timer = calloc(1, sizeof(struct _OsTimerRec));
         if (!timer)
             return NULL;
-        xorg_list_init(&timer->list);
+        timer->index = -1;
+
+        /* reserve a heap slot up front so arming a timer can't fail */
+        input_lock();
+        if (timer_allocated == timer_heap_size) {
+            int size = timer_heap_size ? timer_heap_size * 2 : 32;
+            OsTimerPtr *heap = reallocarray(timer_heap, size,
+                                            sizeof(OsTimerPtr));
+
+            if (!heap) {
+                input_unlock();
+                free(timer);
+                return NULL;
+            }
+            timer_heap = heap;
+            timer_heap_size = size;
+        }
+        timer_allocated++;
+        input_unlock();
     }
     else {
         input_lock();
         if (timer_pending(timer)) {
-            xorg_list_del(&timer->list);
+            timer_remove(timer);
             if (flags & TimerForceOld)
-                (void) (*timer->callback) (timer, now, timer->arg);
+                (void) (*timer->callback) (timer, (CARD32) timer_now(),
+                                           timer->arg);
         }
         input_unlock();
     }
     if (!millis)
         return timer;
+
+    input_lock();
+    now = timer_now();
     if (flags & TimerAbsolute) {
-        timer->delta = millis - now;
+        timer->delta = millis - (CARD32) now;
+        timer->expires = now + (INT32) timer->delta;
     }
     else {
         timer->delta = millis;
-        millis += now;
+        timer->expires = now + millis;
     }
-    timer->expires = millis;
     timer->callback = func;
     timer->arg = arg;
-    input_lock();
-
-    /* Sort into list */
-    xorg_list_for_each_entry(existing, &timers, list)
-        if ((int) (existing->expires - millis) > 0)
-            break;
-    /* This even works at the end of the list -- existing->list will be timers */
-    xorg_list_append(&timer->list, &existing->list);
+    timer_insert(timer);
 
     /* Check to see if the timer is ready to run now */
-    if ((int) (millis - now) <= 0)
+    if (timer->expires <= now)
         DoTimer(timer, now);
 
     input_unlock();
@@ -349,7 +469,7 @@ TimerForce(OsTimerPtr timer)
     input_lock();
     pending = timer_pending(timer);
     if (pending)
-        DoTimer(timer, GetTimeInMillis());
+        DoTimer(timer, timer_now());
     input_unlock();
     return pending;
 }
@@ -360,7 +480,7 @@ TimerCancel(OsTimerPtr timer)
     if (!timer)
         return;
     input_lock();
-    xorg_list_del(&timer->list);
+    timer_remove(timer);
     input_unlock();
 }
 
@@ -369,25 +489,22 @@ TimerFree(OsTimerPtr timer)
 {
     if (!timer)
         return;
-    TimerCancel(timer);
+    input_lock();
+    timer_remove(timer);
+    timer_allocated--;
+    input_unlock();
     free(timer);
 }
 
 void
 TimerInit(void)
 {
-    static Bool been_here;
-    OsTimerPtr timer, tmp;
-
-    if (!been_here) {
-        been_here = TRUE;
-        xorg_list_init((struct xorg_list*) &timers);
-    }
-
-    xorg_list_for_each_entry_safe(timer, tmp, &timers, list) {
-        xorg_list_del(&timer->list);
-        free(timer);
+    input_lock();
+    while (timer_count) {
+        free(timer_heap[--timer_count]);
+        timer_allocated--;
     }
+    input_unlock();
 }
 
 #ifdef DPMSExtension
@@ -49,6 +49,21 @@ Bool InsertFakeRequest(struct _Client *client, char *data, int count);
 void FlushAllOutput(void);
 void FlushIfCriticalOutputPending(void);
 void ResetOsBuffers(void);
+
+/* Input buffer pool counters, bytes held and the cap on it.  The counters
+ * start over with every server generation, see ResetInputPoolStats(). */
+typedef struct _InputPoolStats {
+    unsigned long hits;         /* buffers reused from the pool */
+    unsigned long misses;       /* buffers that had to be allocated */
+    unsigned long held;         /* bytes currently kept in the pool */
+    unsigned long cap;          /* upper limit for held */
+} InputPoolStats;
+
+void GetInputPoolStats(InputPoolStats *stats);
+
+/* Log the input buffer pool counters and start them over, called at the
+ * end of each server generation */
+void ResetInputPoolStats(void);
 void NotifyParentProcess(void);
 void CreateWellKnownSockets(void);
 void ResetWellKnownSockets(void);
@@ -783,7 +783,7 @@ CloseDownConnection(ClientPtr client)
 {
     OsCommPtr oc = (OsCommPtr) client->osPrivate;
 
-    if (FlushCallback)
+    if (!CallbackListEmpty(FlushCallback))
         CallCallbacks(&FlushCallback, client);
 
     if (oc->output)
@@ -964,7 +964,7 @@ MakeClientGrabImpervious(ClientPtr client)
     oc->flags |= OS_COMM_GRAB_IMPERVIOUS;
     set_poll_client(client);
 
-    if (ServerGrabCallback) {
+    if (!CallbackListEmpty(ServerGrabCallback)) {
         ServerGrabInfoRec grabinfo;
 
         grabinfo.client = client;
@@ -984,7 +984,7 @@ MakeClientGrabPervious(ClientPtr client)
     set_poll_client(client);
     isItTimeToYield = TRUE;
 
-    if (ServerGrabCallback) {
+    if (!CallbackListEmpty(ServerGrabCallback)) {
         ServerGrabInfoRec grabinfo;
 
         grabinfo.client = client;
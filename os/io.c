@@ -71,6 +71,7 @@ SOFTWARE.
 #include <X11/Xproto.h>
 
 #include "dix/dix_priv.h"
+#include "dix/profile_priv.h"
 #include "os/bug_priv.h"
 #include "os/client_priv.h"
 #include "os/osdep.h"
@@ -84,28 +85,49 @@ CallbackListPtr ReplyCallback;
 CallbackListPtr FlushCallback;
 
 typedef struct _connectionInput {
-    struct _connectionInput *next;
     char *buffer;               /* contains current client input */
     char *bufptr;               /* pointer to current start of data */
     int bufcnt;                 /* count of bytes in buffer */
     int lenLastReq;
     int size;
     unsigned int ignoreBytes;   /* bytes to ignore before the next request */
+    Bool idle;                  /* empty since the last idle sweep */
 } ConnectionInput;
 
+/*
+ * A large payload handed over with WriteToClientRef() is not copied into
+ * the output buffer.  It is queued as a reference instead, positioned
+ * after the first 'pos' bytes of buf, and its release function is called
+ * once the data has been written or the connection goes away.
+ */
+typedef struct _outputRef {
+    const char *data;           /* unwritten part of the payload */
+    int len;                    /* bytes of payload left */
+    int pad;                    /* bytes of padding left */
+    int pos;                    /* offset into buf this reference follows */
+    ClientWriteReleaseProcPtr release;
+    void *closure;
+} OutputRef;
+
 typedef struct _connectionOutput {
     struct _connectionOutput *next;
     unsigned char *buf;
     int size;
     int count;
+    OutputRef *refs;            /* queued references, oldest first */
+    int nrefs;
+    int refsize;
+    long refbytes;              /* sum of len + pad over all refs */
 } ConnectionOutput;
 
 static ConnectionInputPtr AllocateInputBuffer(void);
+static void FreeInputBuffer(ConnectionInputPtr oci);
 static ConnectionOutputPtr AllocateOutputBuffer(void);
+static void FreeOutputBuffer(ConnectionOutputPtr oco);
+static void ReleaseOutputRefs(ConnectionOutputPtr oco);
 
 static Bool CriticalOutputPending;
 static int timesThisConnection = 0;
-static ConnectionInputPtr FreeInputs = (ConnectionInputPtr) NULL;
 static ConnectionOutputPtr FreeOutputs = (ConnectionOutputPtr) NULL;
 static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 
@@ -121,6 +143,28 @@ static OsCommPtr AvailableInput = (OsCommPtr) NULL;
 #define BUFSIZE 16384
 #define BUFWATERMARK 32768
 
+/*
+ * Input buffers are shared through a pool of power-of-two size classes,
+ * BUFSIZE << 0 up to BUFSIZE << (INPUT_POOL_CLASSES - 1).  Released buffers
+ * are kept for reuse as long as the pool holds less than InputPoolCap
+ * bytes; larger buffers always go straight back to malloc.  Clients that
+ * sit on an empty buffer for a whole sweep interval give it back.
+ */
+#define INPUT_POOL_CLASSES 8
+#define INPUT_SWEEP_INTERVAL 5000       /* ms */
+
+unsigned long InputPoolCap = 4 * 1024 * 1024;
+
+static char *InputPool[INPUT_POOL_CLASSES];
+static InputPoolStats inputPoolStats;
+static OsTimerPtr InputSweepTimer;
+static Bool InputSweepPending;
+
+/* WriteToClientRef() payloads smaller than this are simply copied */
+#define OUTPUT_REF_THRESHOLD (BUFSIZE / 4)
+/* maximum number of iovecs handed to a single writev */
+#define OUTPUT_IOV_MAX 64
+
 /*
  *   A lot of the code in this file manipulates a ConnectionInputPtr:
  *
@@ -199,26 +243,137 @@ YieldControlDeath(void)
     timesThisConnection = 0;
 }
 
-/* If an input buffer was empty, either free it if it is too big or link it
- * into our list of free input buffers.  This means that different clients can
- * share the same input buffer (at different times).  This was done to save
- * memory.
+static int
+InputPoolClass(unsigned int size)
+{
+    int c;
+
+    for (c = 0; c < INPUT_POOL_CLASSES; c++)
+        if (size <= (BUFSIZE << c))
+            return c;
+    return -1;
+}
+
+/* Get a buffer of at least needed bytes, its actual size goes to *size. */
+static char *
+InputPoolAlloc(unsigned int needed, int *size)
+{
+    int c = InputPoolClass(needed);
+    char *buf;
+
+    if (c < 0) {
+        inputPoolStats.misses++;
+        *size = needed;
+        return malloc(needed);
+    }
+    *size = BUFSIZE << c;
+    if ((buf = InputPool[c])) {
+        InputPool[c] = *(char **) buf;
+        inputPoolStats.hits++;
+        inputPoolStats.held -= *size;
+        return buf;
+    }
+    inputPoolStats.misses++;
+    return malloc(*size);
+}
+
+static void
+InputPoolFree(char *buf, int size)
+{
+    int c = InputPoolClass(size);
+
+    if (c < 0 || size != (BUFSIZE << c) ||
+        inputPoolStats.held + size > InputPoolCap) {
+        free(buf);
+        return;
+    }
+    *(char **) buf = InputPool[c];
+    InputPool[c] = buf;
+    inputPoolStats.held += size;
+}
+
+/* Replace the buffer of oci with one of at least needed bytes, keeping the
+ * first keep bytes. */
+static Bool
+ResizeInputBuffer(ConnectionInputPtr oci, unsigned int needed, int keep)
+{
+    int size;
+    char *ibuf = InputPoolAlloc(needed, &size);
+
+    if (!ibuf)
+        return FALSE;
+    memcpy(ibuf, oci->buffer, keep);
+    InputPoolFree(oci->buffer, oci->size);
+    oci->bufptr = ibuf + (oci->bufptr - oci->buffer);
+    oci->buffer = ibuf;
+    oci->size = size;
+    return TRUE;
+}
+
+void
+GetInputPoolStats(InputPoolStats *stats)
+{
+    *stats = inputPoolStats;
+    stats->cap = InputPoolCap;
+}
+
+/* Drop the input buffers of clients that have had nothing to read since
+ * the previous sweep. */
+static CARD32
+InputBufferSweep(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    Bool attached = FALSE;
+    int i;
+
+    for (i = 1; i < currentMaxClients; i++) {
+        ClientPtr client = clients[i];
+        ConnectionInputPtr oci;
+        OsCommPtr oc;
+
+        if (!client || !(oc = client->osPrivate) || !(oci = oc->input))
+            continue;
+        if (oci->bufptr + oci->lenLastReq != oci->buffer + oci->bufcnt ||
+            oci->ignoreBytes || !oci->idle) {
+            oci->idle = TRUE;
+            attached = TRUE;
+            continue;
+        }
+        if (AvailableInput == oc)
+            AvailableInput = NULL;
+        FreeInputBuffer(oci);
+        oc->input = NULL;
+    }
+
+    InputSweepPending = attached;
+    return attached ? INPUT_SWEEP_INTERVAL : 0;
+}
+
+static ConnectionInputPtr
+AttachInputBuffer(OsCommPtr oc)
+{
+    ConnectionInputPtr oci = AllocateInputBuffer();
+
+    if (!oci)
+        return NULL;
+    oc->input = oci;
+    if (!InputSweepPending) {
+        InputSweepTimer = TimerSet(InputSweepTimer, 0, INPUT_SWEEP_INTERVAL,
+                                   InputBufferSweep, NULL);
+        InputSweepPending = InputSweepTimer != NULL;
+    }
+    return oci;
+}
+
+/* If an input buffer was empty, hand it back to the pool so that different
+ * clients can share the same input buffer (at different times).  This was
+ * done to save memory.
  */
 static void
 NextAvailableInput(OsCommPtr oc)
 {
     if (AvailableInput) {
         if (AvailableInput != oc) {
-            ConnectionInputPtr aci = AvailableInput->input;
-
-            if (aci->size > BUFWATERMARK) {
-                free(aci->buffer);
-                free(aci);
-            }
-            else {
-                aci->next = FreeInputs;
-                FreeInputs = aci;
-            }
+            FreeInputBuffer(AvailableInput->input);
             AvailableInput->input = NULL;
         }
         AvailableInput = NULL;
@@ -240,16 +395,11 @@ ReadRequestFromClient(ClientPtr client)
 
     /* make sure we have an input buffer */
 
-    if (!oci) {
-        if ((oci = FreeInputs)) {
-            FreeInputs = oci->next;
-        }
-        else if (!(oci = AllocateInputBuffer())) {
-            YieldControlDeath();
-            return -1;
-        }
-        oc->input = oci;
+    if (!oci && !(oci = AttachInputBuffer(oc))) {
+        YieldControlDeath();
+        return -1;
     }
+    oci->idle = FALSE;
 
 #if XTRANS_SEND_FDS
     /* Discard any unused file descriptors */
@@ -322,25 +472,22 @@ ReadRequestFromClient(ClientPtr client)
             oci->lenLastReq = gotnow;
             return needed;
         }
-        if ((gotnow == 0) || ((oci->bufptr - oci->buffer + needed) > oci->size)) {
-            /* no data, or the request is too big to fit in the buffer */
+        if ((gotnow == 0) || ((oci->bufptr - oci->buffer + needed) > oci->size) ||
+            (oci->bufptr - oci->buffer >= oci->size / 2)) {
+            /* no data, the request is too big to fit in the buffer, or
+               compacting it makes room for a much bigger read */
 
             if ((gotnow > 0) && (oci->bufptr != oci->buffer))
                 /* save the data we've already read */
                 memmove(oci->buffer, oci->bufptr, gotnow);
+            oci->bufptr = oci->buffer;
             if (needed > oci->size) {
                 /* make buffer bigger to accommodate request */
-                char *ibuf;
-
-                ibuf = (char *) realloc(oci->buffer, needed);
-                if (!ibuf) {
+                if (!ResizeInputBuffer(oci, needed, gotnow)) {
                     YieldControlDeath();
                     return -1;
                 }
-                oci->size = needed;
-                oci->buffer = ibuf;
             }
-            oci->bufptr = oci->buffer;
             oci->bufcnt = gotnow;
         }
         /*  XXX this is a workaround.  This function is sometimes called
@@ -370,16 +517,8 @@ ReadRequestFromClient(ClientPtr client)
         gotnow += result;
         /* free up some space after huge requests */
         if ((oci->size > BUFWATERMARK) &&
-            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE)) {
-            char *ibuf;
-
-            ibuf = (char *) realloc(oci->buffer, BUFSIZE);
-            if (ibuf) {
-                oci->size = BUFSIZE;
-                oci->buffer = ibuf;
-                oci->bufptr = ibuf + oci->bufcnt - gotnow;
-            }
-        }
+            (oci->bufcnt < BUFSIZE) && (needed < BUFSIZE))
+            (void) ResizeInputBuffer(oci, BUFSIZE, oci->bufcnt);
         if (need_header && gotnow >= needed) {
             /* We wanted an xReq, now we've gotten it. */
             request = (xReq *) oci->bufptr;
@@ -512,25 +651,15 @@ InsertFakeRequest(ClientPtr client, char *data, int count)
 
     NextAvailableInput(oc);
 
-    if (!oci) {
-        if ((oci = FreeInputs))
-            FreeInputs = oci->next;
-        else if (!(oci = AllocateInputBuffer()))
-            return FALSE;
-        oc->input = oci;
-    }
+    if (!oci && !(oci = AttachInputBuffer(oc)))
+        return FALSE;
+    oci->idle = FALSE;
     oci->bufptr += oci->lenLastReq;
     oci->lenLastReq = 0;
     gotnow = oci->bufcnt + oci->buffer - oci->bufptr;
     if ((gotnow + count) > oci->size) {
-        char *ibuf;
-
-        ibuf = (char *) realloc(oci->buffer, gotnow + count);
-        if (!ibuf)
+        if (!ResizeInputBuffer(oci, gotnow + count, oci->bufcnt))
             return FALSE;
-        oci->size = gotnow + count;
-        oci->buffer = ibuf;
-        oci->bufptr = ibuf + oci->bufcnt - gotnow;
     }
     moveup = count - (oci->bufptr - oci->buffer);
     if (moveup > 0) {
@@ -680,24 +809,52 @@ AbortClient(ClientPtr client)
  *    this routine as int.
  *****************/
 
-int
-WriteToClient(ClientPtr who, int count, const void *__buf)
+static Bool
+QueueOutputRef(ConnectionOutputPtr oco, const char *buf, int count,
+               int padBytes, ClientWriteReleaseProcPtr release, void *closure)
+{
+    OutputRef *ref;
+
+    if (oco->nrefs == oco->refsize) {
+        int newsize = oco->refsize ? oco->refsize * 2 : 8;
+        OutputRef *refs = reallocarray(oco->refs, newsize, sizeof(OutputRef));
+
+        if (!refs)
+            return FALSE;
+        oco->refs = refs;
+        oco->refsize = newsize;
+    }
+    ref = &oco->refs[oco->nrefs++];
+    ref->data = buf;
+    ref->len = count;
+    ref->pad = padBytes;
+    ref->pos = oco->count;
+    ref->release = release;
+    ref->closure = closure;
+    oco->refbytes += count + padBytes;
+    return TRUE;
+}
+
+static int
+QueueClientOutput(ClientPtr who, int count, const char *buf,
+                  ClientWriteReleaseProcPtr release, void *closure)
 {
     OsCommPtr oc;
     ConnectionOutputPtr oco;
     int padBytes;
-    const char *buf = __buf;
-
-    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
-                       "******** %s called from input thread *********\n", __func__);
 
 #ifdef DEBUG_COMMUNICATION
     Bool multicount = FALSE;
 #endif
-    if (!count || !who || who == serverClient || who->clientGone)
+    if (!count || !who || who == serverClient || who->clientGone) {
+        if (release)
+            release(closure);
         return 0;
+    }
     oc = who->osPrivate;
     oco = oc->output;
+    if (ProfileEnabled)
+        ProfileOutput(who, count);
 #ifdef DEBUG_COMMUNICATION
     {
         char info[128];
@@ -744,6 +901,8 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
             FreeOutputs = oco->next;
         }
         else if (!(oco = AllocateOutputBuffer())) {
+            if (release)
+                release(closure);
             AbortClient(who);
             dixMarkClientException(who);
             return -1;
@@ -753,7 +912,7 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
 
     padBytes = padding_for_int32(count);
 
-    if (ReplyCallback) {
+    if (!CallbackListEmpty(ReplyCallback)) {
         ReplyInfoRec replyinfo;
 
         replyinfo.client = who;
@@ -793,7 +952,31 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
         }
     }
 #endif
-    if ((oco->count == 0 && who->local) || oco->count + count + padBytes > oco->size) {
+    if (release) {
+        if (!QueueOutputRef(oco, buf, count, padBytes, release, closure)) {
+            release(closure);
+            AbortClient(who);
+            dixMarkClientException(who);
+            return -1;
+        }
+        if (who->local || oco->count + oco->refbytes > oco->size) {
+            output_pending_clear(who);
+            if (!any_output_pending()) {
+                CriticalOutputPending = FALSE;
+                NewOutputPending = FALSE;
+            }
+
+            if (FlushClient(who, oc, NULL, 0) < 0)
+                return -1;
+            return count;
+        }
+        NewOutputPending = TRUE;
+        output_pending_mark(who);
+        return count;
+    }
+
+    if ((oco->count == 0 && oco->nrefs == 0 && who->local) ||
+        oco->count + count + padBytes > oco->size) {
         output_pending_clear(who);
         if (!any_output_pending()) {
             CriticalOutputPending = FALSE;
@@ -814,6 +997,41 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
     return count;
 }
 
+int
+WriteToClient(ClientPtr who, int count, const void *buf)
+{
+    BUG_RETURN_VAL_MSG(in_input_thread(), 0,
+                       "******** %s called from input thread *********\n", __func__);
+
+    return QueueClientOutput(who, count, buf, NULL, NULL);
+}
+
+/*****************
+ * WriteToClientRef
+ *    Like WriteToClient, but hands the buffer over to the output layer
+ *    instead of copying it.  Large payloads are written straight from buf
+ *    and, if the client can't keep up, stay queued by reference; release
+ *    is called with closure once buf is no longer needed, which may be
+ *    before this function returns.  Small payloads are copied as usual.
+ *****************/
+
+int
+WriteToClientRef(ClientPtr who, int count, const void *buf,
+                 ClientWriteReleaseProcPtr release, void *closure)
+{
+    int ret;
+
+    /* WriteToClient complains about use from the input thread */
+    if (!release || count < OUTPUT_REF_THRESHOLD || in_input_thread()) {
+        ret = WriteToClient(who, count, buf);
+        if (release)
+            release(closure);
+        return ret;
+    }
+
+    return QueueClientOutput(who, count, buf, release, closure);
+}
+
  /********************
  * FlushClient()
  *    If the client isn't keeping up with us, then we try to continue
@@ -822,75 +1040,146 @@ WriteToClient(ClientPtr who, int count, const void *__buf)
  *    a permanent error, or we can't allocate any more space, we then
  *    close the connection.
  *
+ *    Pending output is the buffered bytes interleaved with any queued
+ *    references, followed by extraBuf and its padding.  References are
+ *    written in place and never copied; only what is left of extraBuf
+ *    gets buffered when the client blocks.
+ *
  **********************/
 
+static void
+AddIOV(struct iovec *iov, int *i, long *todo, const void *pointer, long length)
+{
+    if (length <= 0 || *todo <= 0 || *i >= OUTPUT_IOV_MAX)
+        return;
+    if (length > *todo)
+        length = *todo;
+    iov[*i].iov_base = (void *) pointer;
+    iov[*i].iov_len = length;
+    (*i)++;
+    *todo -= length;
+}
+
+static int
+BuildOutputIOV(ConnectionOutputPtr oco, struct iovec *iov,
+               const char *extraBuf, long extraCount, long padsize, long todo)
+{
+    static char padBuffer[3];
+    int i = 0, r;
+    long cur = 0;
+
+    for (r = 0; r < oco->nrefs; r++) {
+        OutputRef *ref = &oco->refs[r];
+
+        AddIOV(iov, &i, &todo, oco->buf + cur, ref->pos - cur);
+        AddIOV(iov, &i, &todo, ref->data, ref->len);
+        AddIOV(iov, &i, &todo, padBuffer + 3 - ref->pad, ref->pad);
+        cur = ref->pos;
+    }
+    AddIOV(iov, &i, &todo, oco->buf + cur, oco->count - cur);
+    AddIOV(iov, &i, &todo, extraBuf, extraCount);
+    AddIOV(iov, &i, &todo, padBuffer, padsize);
+    return i;
+}
+
+/* Drop the first n written bytes from the pending output of oco, releasing
+ * the references that are done.  Returns the part of n that went past the
+ * pending output, i.e. into the extra buffer of FlushClient. */
+static long
+ConsumeOutput(ConnectionOutputPtr oco, long n)
+{
+    long cur = 0;
+    long chunk;
+    int done = 0;
+    int r;
+
+    while (n > 0 && done < oco->nrefs) {
+        OutputRef *ref = &oco->refs[done];
+
+        chunk = ref->pos - cur;
+        if (n < chunk) {
+            cur += n;
+            n = 0;
+            break;
+        }
+        n -= chunk;
+        cur = ref->pos;
+
+        chunk = min(n, ref->len);
+        ref->data += chunk;
+        ref->len -= chunk;
+        n -= chunk;
+        chunk = min(n, ref->pad);
+        ref->pad -= chunk;
+        n -= chunk;
+        if (ref->len || ref->pad)
+            break;
+        ref->release(ref->closure);
+        done++;
+    }
+    if (n > 0) {
+        chunk = min(n, oco->count - cur);
+        cur += chunk;
+        n -= chunk;
+    }
+
+    if (done) {
+        oco->nrefs -= done;
+        memmove(oco->refs, oco->refs + done, oco->nrefs * sizeof(OutputRef));
+    }
+    oco->refbytes = 0;
+    for (r = 0; r < oco->nrefs; r++) {
+        oco->refs[r].pos -= cur;
+        oco->refbytes += oco->refs[r].len + oco->refs[r].pad;
+    }
+    if (cur) {
+        oco->count -= cur;
+        memmove(oco->buf, oco->buf + cur, oco->count);
+    }
+    return n;
+}
+
 int
 FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
 {
     ConnectionOutputPtr oco = oc->output;
     XtransConnInfo trans_conn = oc->trans_conn;
-    struct iovec iov[3];
-    static char padBuffer[3];
+    struct iovec iov[OUTPUT_IOV_MAX];
     const char *extraBuf = __extraBuf;
-    long written;
+    long extraLeft = extraCount;
     long padsize;
     long notWritten;
     long todo;
+    long len;
 
     if (!oco)
 	return 0;
-    written = 0;
     padsize = padding_for_int32(extraCount);
-    notWritten = oco->count + extraCount + padsize;
+    notWritten = oco->count + oco->refbytes + extraCount + padsize;
     if (!notWritten)
         return 0;
 
-    if (FlushCallback)
+    if (!CallbackListEmpty(FlushCallback))
         CallCallbacks(&FlushCallback, who);
 
     todo = notWritten;
     while (notWritten) {
-        long before = written;  /* amount of whole thing written */
-        long remain = todo;     /* amount to try this time, <= notWritten */
-        int i = 0;
-        long len;
-
-        /* You could be very general here and have "in" and "out" iovecs
-         * and write a loop without using a macro, but what the heck.  This
-         * translates to:
-         *
-         *     how much of this piece is new?
-         *     if more new then we are trying this time, clamp
-         *     if nothing new
-         *         then bump down amount already written, for next piece
-         *         else put new stuff in iovec, will need all of next piece
-         *
-         * Note that todo had better be at least 1 or else we'll end up
-         * writing 0 iovecs.
-         */
-#define InsertIOV(pointer, length) \
-	len = (length) - before; \
-	if (len > remain) \
-	    len = remain; \
-	if (len <= 0) { \
-	    before = (-len); \
-	} else { \
-	    iov[i].iov_len = len; \
-	    iov[i].iov_base = (pointer) + before;	\
-	    i++; \
-	    remain -= len; \
-	    before = 0; \
-	}
-
-        InsertIOV((char *) oco->buf, oco->count)
-            InsertIOV((char *) extraBuf, extraCount)
-            InsertIOV(padBuffer, padsize)
-
-            errno = 0;
+        int i = BuildOutputIOV(oco, iov, extraBuf, extraLeft, padsize, todo);
+
+        errno = 0;
         if (trans_conn && (len = _XSERVTransWritev(trans_conn, iov, i)) >= 0) {
-            written += len;
             notWritten -= len;
             todo = notWritten;
+
+            /* whatever went past the pending output came from extraBuf,
+               and after that from its padding */
+            len = ConsumeOutput(oco, len);
+            if (len > extraLeft) {
+                padsize -= len - extraLeft;
+                len = extraLeft;
+            }
+            extraBuf += len;
+            extraLeft -= len;
         }
         else if (ETEST(errno)
 #ifdef EMSGSIZE                 /* check for another brain-damaged OS bug */
@@ -899,45 +1188,35 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
             ) {
             /* If we've arrived here, then the client is stuffed to the gills
                and not ready to accept more.  Make a note of it and buffer
-               the rest. */
+               the rest.  Queued references stay where they are. */
             output_pending_mark(who);
 
-            if (written < oco->count) {
-                if (written > 0) {
-                    oco->count -= written;
-                    memmove((char *) oco->buf,
-                            (char *) oco->buf + written, oco->count);
-                    written = 0;
-                }
-            }
-            else {
-                written -= oco->count;
-                oco->count = 0;
-            }
-
-            if (notWritten > oco->size) {
+            if (oco->count + extraLeft + padsize > oco->size) {
+                long needed = oco->count + extraLeft + padsize;
                 unsigned char *obuf = NULL;
 
-                if (notWritten + BUFSIZE <= INT_MAX) {
-                    obuf = realloc(oco->buf, notWritten + BUFSIZE);
+                if (needed + BUFSIZE <= INT_MAX) {
+                    obuf = realloc(oco->buf, needed + BUFSIZE);
                 }
                 if (!obuf) {
                     AbortClient(who);
                     dixMarkClientException(who);
+                    ReleaseOutputRefs(oco);
                     oco->count = 0;
                     return -1;
                 }
-                oco->size = notWritten + BUFSIZE;
+                oco->size = needed + BUFSIZE;
                 oco->buf = obuf;
             }
 
-            /* If the amount written extended into the padBuffer, then the
-               difference "extraCount - written" may be less than 0 */
-            if ((len = extraCount - written) > 0)
-                memmove((char *) oco->buf + oco->count,
-                        extraBuf + written, len);
-
-            oco->count = notWritten;    /* this will include the pad */
+            if (extraLeft) {
+                memmove((char *) oco->buf + oco->count, extraBuf, extraLeft);
+                oco->count += extraLeft;
+            }
+            if (padsize) {
+                memset(oco->buf + oco->count, '\0', padsize);
+                oco->count += padsize;
+            }
             ospoll_listen(server_poll, oc->fd, X_NOTIFY_WRITE);
 
             /* return only the amount explicitly requested */
@@ -951,6 +1230,7 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
         else {
             AbortClient(who);
             dixMarkClientException(who);
+            ReleaseOutputRefs(oco);
             oco->count = 0;
             return -1;
         }
@@ -961,8 +1241,7 @@ FlushClient(ClientPtr who, OsCommPtr oc, const void *__extraBuf, int extraCount)
     output_pending_clear(who);
 
     if (oco->size > BUFWATERMARK) {
-        free(oco->buf);
-        free(oco);
+        FreeOutputBuffer(oco);
     }
     else {
         oco->next = FreeOutputs;
@@ -978,12 +1257,11 @@ AllocateInputBuffer(void)
     ConnectionInputPtr oci = calloc(1, sizeof(ConnectionInput));
     if (!oci)
         return NULL;
-    oci->buffer = calloc(1, BUFSIZE);
+    oci->buffer = InputPoolAlloc(BUFSIZE, &oci->size);
     if (!oci->buffer) {
         free(oci);
         return NULL;
     }
-    oci->size = BUFSIZE;
     oci->bufptr = oci->buffer;
     oci->bufcnt = 0;
     oci->lenLastReq = 0;
@@ -991,6 +1269,13 @@ AllocateInputBuffer(void)
     return oci;
 }
 
+static void
+FreeInputBuffer(ConnectionInputPtr oci)
+{
+    InputPoolFree(oci->buffer, oci->size);
+    free(oci);
+}
+
 static ConnectionOutputPtr
 AllocateOutputBuffer(void)
 {
@@ -1007,6 +1292,26 @@ AllocateOutputBuffer(void)
     return oco;
 }
 
+static void
+ReleaseOutputRefs(ConnectionOutputPtr oco)
+{
+    int r;
+
+    for (r = 0; r < oco->nrefs; r++)
+        oco->refs[r].release(oco->refs[r].closure);
+    oco->nrefs = 0;
+    oco->refbytes = 0;
+}
+
+static void
+FreeOutputBuffer(ConnectionOutputPtr oco)
+{
+    ReleaseOutputRefs(oco);
+    free(oco->refs);
+    free(oco->buf);
+    free(oco);
+}
+
 void
 FreeOsBuffers(OsCommPtr oc)
 {
@@ -1015,24 +1320,12 @@ FreeOsBuffers(OsCommPtr oc)
 
     if (AvailableInput == oc)
         AvailableInput = (OsCommPtr) NULL;
-    if ((oci = oc->input)) {
-        if (FreeInputs) {
-            free(oci->buffer);
-            free(oci);
-        }
-        else {
-            FreeInputs = oci;
-            oci->next = (ConnectionInputPtr) NULL;
-            oci->bufptr = oci->buffer;
-            oci->bufcnt = 0;
-            oci->lenLastReq = 0;
-            oci->ignoreBytes = 0;
-        }
-    }
+    if ((oci = oc->input))
+        FreeInputBuffer(oci);
     if ((oco = oc->output)) {
+        ReleaseOutputRefs(oco);
         if (FreeOutputs) {
-            free(oco->buf);
-            free(oco);
+            FreeOutputBuffer(oco);
         }
         else {
             FreeOutputs = oco;
@@ -1042,20 +1335,42 @@ FreeOsBuffers(OsCommPtr oc)
     }
 }
 
+void
+ResetInputPoolStats(void)
+{
+    InputPoolStats stats;
+
+    GetInputPoolStats(&stats);
+    if (stats.hits || stats.misses)
+        LogMessageVerb(X_INFO, 3,
+                       "Input buffer pool: %lu hits, %lu misses, "
+                       "%lu of %lu bytes held\n",
+                       stats.hits, stats.misses, stats.held, stats.cap);
+
+    inputPoolStats.hits = 0;
+    inputPoolStats.misses = 0;
+}
+
 void
 ResetOsBuffers(void)
 {
-    ConnectionInputPtr oci;
     ConnectionOutputPtr oco;
+    char *buf;
+    int c;
 
-    while ((oci = FreeInputs)) {
-        FreeInputs = oci->next;
-        free(oci->buffer);
-        free(oci);
+    for (c = 0; c < INPUT_POOL_CLASSES; c++) {
+        while ((buf = InputPool[c])) {
+            InputPool[c] = *(char **) buf;
+            free(buf);
+        }
     }
+    inputPoolStats.held = 0;
+    TimerFree(InputSweepTimer);
+    InputSweepTimer = NULL;
+    InputSweepPending = FALSE;
+
     while ((oco = FreeOutputs)) {
         FreeOutputs = oco->next;
-        free(oco->buf);
-        free(oco);
+        FreeOutputBuffer(oco);
     }
 }
@@ -0,0 +1,28 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Instruction set detection for the kernel levels of os/kernels_priv.h.
+ */
+
+#include <dix-config.h>
+
+#include "os/kernels_priv.h"
+
+KernelLevel
+OsClampKernels(KernelLevel level)
+{
+    if (level > KERNELS_AVX2)
+        level = KERNELS_AVX2;
+
+#ifdef X86_KERNELS
+    __builtin_cpu_init();
+    if (level >= KERNELS_AVX2 && !__builtin_cpu_supports("avx2"))
+        level = KERNELS_SSE2;
+    if (level >= KERNELS_SSE2 && !__builtin_cpu_supports("sse2"))
+        level = KERNELS_SCALAR;
+#else
+    if (level > KERNELS_SCALAR)
+        level = KERNELS_SCALAR;
+#endif
+
+    return level;
+}
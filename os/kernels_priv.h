@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Picking code paths for the CPU the server runs on.
+ */
+#ifndef _XSERVER_OS_KERNELS_PRIV_H
+#define _XSERVER_OS_KERNELS_PRIV_H
+
+/* vector kernels are built with target attributes, GCC and clang only */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#endif
+
+typedef enum {
+    KERNELS_REFERENCE,          /* the code as it was before any kernels */
+    KERNELS_SCALAR,             /* plain C */
+    KERNELS_SSE2,
+    KERNELS_AVX2,
+    KERNELS_BEST,
+} KernelLevel;
+
+/*
+ * Lower level until this CPU can run it: anything past KERNELS_SCALAR is
+ * only ever available on x86.
+ */
+KernelLevel OsClampKernels(KernelLevel level);
+
+#endif /* _XSERVER_OS_KERNELS_PRIV_H */
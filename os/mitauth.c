@@ -141,7 +141,7 @@ MitRemoveCookie(unsigned short data_length, const char *data)
 
 static char cookie[16];         /* 128 bits */
 
-static void
+void
 GenerateRandomData(int len, char *buf)
 {
 #ifdef HAVE_ARC4RANDOM_BUF
@@ -188,6 +188,9 @@ int OnlyListenToOneClient(ClientPtr client);
 
 void ListenToAllClients(void);
 
+/* fill buf with len random bytes, for keys and cookies */
+void GenerateRandomData(int len, char *buf);
+
 /* allow DDX to force using another clock */
 void ForceClockId(clockid_t forced_clockid);
 
@@ -195,6 +198,8 @@ Bool WaitForSomething(Bool clients_are_ready);
 void CloseDownConnection(ClientPtr client);
 
 extern int LimitClients;
+extern unsigned long InputPoolCap;
+extern int FbThreads;
 extern Bool PartialNetwork;
 
 extern Bool CoreDump;
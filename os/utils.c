@@ -92,6 +92,7 @@ OR PERFORMANCE OF THIS SOFTWARE.
 
 #include "dix/dix_priv.h"
 #include "dix/input_priv.h"
+#include "dix/profile_priv.h"
 #include "miext/extinit_priv.h"
 #include "os/audit.h"
 #include "os/auth.h"
@@ -118,6 +119,8 @@ OR PERFORMANCE OF THIS SOFTWARE.
 
 Bool CoreDump;
 
+int FbThreads = 0;
+
 Bool enableIndirectGLX = FALSE;
 
 Bool AllowByteSwappedClients = FALSE;
@@ -299,6 +302,7 @@ UseMsg(void)
     ErrorF("-nolisten string       don't listen on protocol\n");
     ErrorF("-listen string         listen on protocol\n");
     ErrorF("-noreset               don't reset after last client exists\n");
+    ErrorF("-profile               profile requests, SIGUSR2 dumps and toggles\n");
     ErrorF("-background [none]     create root window with no background\n");
     ErrorF("-reset                 reset after last client exists\n");
     ErrorF("-p #                   screen-saver pattern duration (minutes)\n");
@@ -318,12 +322,17 @@ UseMsg(void)
     ErrorF("-v                     screen-saver without video blanking\n");
     ErrorF("-wr                    create root window with white background\n");
     ErrorF("-maxbigreqsize         set maximal bigrequest size \n");
+    ErrorF("-inputpool KiB         limit memory kept in the input buffer pool\n");
+#ifdef INPUTTHREAD
+    ErrorF("-fbthreads n           render large software operations on n threads\n");
+#endif
 #ifdef XINERAMA
     ErrorF("+xinerama              Enable XINERAMA extension\n");
     ErrorF("-xinerama              Disable XINERAMA extension\n");
 #endif /* XINERAMA */
     ErrorF("-dumbSched             Disable smart scheduling and threaded input, enable old behavior\n");
     ErrorF("-schedInterval int     Set scheduler interval in msec\n");
+    ErrorF("-schedLatency          Run latency critical clients first\n");
     ErrorF("+extension name        Enable extension\n");
     ErrorF("-extension name        Disable extension\n");
     ListStaticExtensions();
@@ -607,6 +616,9 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-profile") == 0) {
+            ProfileEnabled = TRUE;
+        }
         else if (strcmp(argv[i], "-noreset") == 0) {
             dispatchExceptionAtReset = 0;
         }
@@ -692,6 +704,34 @@ ProcessCommandLine(int argc, char *argv[])
                 UseMsg();
             }
         }
+        else if (strcmp(argv[i], "-inputpool") == 0) {
+            if (++i < argc) {
+                long poolSizeArg = atol(argv[i]);
+
+                if (poolSizeArg >= 0L && poolSizeArg <= 1048576L)
+                    InputPoolCap = poolSizeArg * 1024UL;
+                else
+                    UseMsg();
+            }
+            else {
+                UseMsg();
+            }
+        }
+#ifdef INPUTTHREAD
+        else if (strcmp(argv[i], "-fbthreads") == 0) {
+            if (++i < argc) {
+                int threads = atoi(argv[i]);
+
+                if (threads >= 0 && threads <= 64)
+                    FbThreads = threads;
+                else
+                    UseMsg();
+            }
+            else {
+                UseMsg();
+            }
+        }
+#endif
 #ifdef CONFIG_NAMESPACE
         else if (strcmp(argv[i], "-namespace") == 0) {
             if (++i < argc) {
@@ -739,6 +779,9 @@ ProcessCommandLine(int argc, char *argv[])
             else
                 UseMsg();
         }
+        else if (strcmp(argv[i], "-schedLatency") == 0) {
+            SmartScheduleLatencyAware = TRUE;
+        }
         else if (strcmp(argv[i], "-schedMax") == 0) {
             if (++i < argc) {
                 SmartScheduleMaxSlice = atoi(argv[i]);
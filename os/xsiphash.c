@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * SipHash-2-4, following "SipHash: a fast short-input PRF" by
+ * Jean-Philippe Aumasson and Daniel J. Bernstein, with the 128 bit output
+ * variant of the reference implementation.
+ */
+
+#include <dix-config.h>
+
+#include "os/xsiphash.h"
+
+#define ROTL(x, b)  (uint64_t) (((x) << (b)) | ((x) >> (64 - (b))))
+
+#define SIPROUND(ctx) do {                                              \
+    (ctx)->v0 += (ctx)->v1; (ctx)->v1 = ROTL((ctx)->v1, 13);            \
+    (ctx)->v1 ^= (ctx)->v0; (ctx)->v0 = ROTL((ctx)->v0, 32);            \
+    (ctx)->v2 += (ctx)->v3; (ctx)->v3 = ROTL((ctx)->v3, 16);            \
+    (ctx)->v3 ^= (ctx)->v2;                                             \
+    (ctx)->v0 += (ctx)->v3; (ctx)->v3 = ROTL((ctx)->v3, 21);            \
+    (ctx)->v3 ^= (ctx)->v0;                                             \
+    (ctx)->v2 += (ctx)->v1; (ctx)->v1 = ROTL((ctx)->v1, 17);            \
+    (ctx)->v1 ^= (ctx)->v2; (ctx)->v2 = ROTL((ctx)->v2, 32);            \
+} while (0)
+
+static inline uint64_t
+load64(const unsigned char *p)
+{
+    return (uint64_t) p[0] | (uint64_t) p[1] << 8 |
+        (uint64_t) p[2] << 16 | (uint64_t) p[3] << 24 |
+        (uint64_t) p[4] << 32 | (uint64_t) p[5] << 40 |
+        (uint64_t) p[6] << 48 | (uint64_t) p[7] << 56;
+}
+
+static inline void
+store64(unsigned char *p, uint64_t v)
+{
+    int i;
+
+    for (i = 0; i < 8; i++)
+        p[i] = v >> (8 * i);
+}
+
+static inline void
+x_siphash_compress(XSipHashRec *ctx, uint64_t m)
+{
+    ctx->v3 ^= m;
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    ctx->v0 ^= m;
+}
+
+void
+x_siphash_init(XSipHashRec *ctx, const unsigned char key[16])
+{
+    uint64_t k0 = load64(key), k1 = load64(key + 8);
+
+    ctx->v0 = k0 ^ 0x736f6d6570736575ULL;
+    ctx->v1 = k1 ^ 0x646f72616e646f6dULL ^ 0xee;
+    ctx->v2 = k0 ^ 0x6c7967656e657261ULL;
+    ctx->v3 = k1 ^ 0x7465646279746573ULL;
+    ctx->tail = 0;
+    ctx->len = 0;
+}
+
+void
+x_siphash_update(XSipHashRec *ctx, const void *data, size_t size)
+{
+    const unsigned char *p = data;
+    int used = ctx->len & 7;
+
+    ctx->len += size;
+
+    /* top up the bytes left over from last time first */
+    if (used) {
+        while (size && used < 8) {
+            ctx->tail |= (uint64_t) *p++ << (8 * used++);
+            size--;
+        }
+        if (used < 8)
+            return;
+        x_siphash_compress(ctx, ctx->tail);
+        ctx->tail = 0;
+    }
+
+    for (; size >= 8; p += 8, size -= 8)
+        x_siphash_compress(ctx, load64(p));
+
+    for (used = 0; size; size--, used++)
+        ctx->tail |= (uint64_t) *p++ << (8 * used);
+}
+
+void
+x_siphash_final(XSipHashRec *ctx, unsigned char result[16])
+{
+    x_siphash_compress(ctx, ctx->tail | (uint64_t) ctx->len << 56);
+
+    ctx->v2 ^= 0xee;
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    store64(result, ctx->v0 ^ ctx->v1 ^ ctx->v2 ^ ctx->v3);
+
+    ctx->v1 ^= 0xdd;
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    SIPROUND(ctx);
+    store64(result + 8, ctx->v0 ^ ctx->v1 ^ ctx->v2 ^ ctx->v3);
+}
@@ -0,0 +1,25 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * SipHash-2-4 with 128 bit output: a keyed hash, fast on short inputs and
+ * safe against clients trying to make their data collide as long as the
+ * key stays secret.
+ */
+#ifndef XSIPHASH_H
+#define XSIPHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint64_t v0, v1, v2, v3;
+    uint64_t tail;              /* bytes not hashed yet, little endian */
+    size_t len;
+} XSipHashRec;
+
+void x_siphash_init(XSipHashRec *ctx, const unsigned char key[16]);
+
+void x_siphash_update(XSipHashRec *ctx, const void *data, size_t size);
+
+void x_siphash_final(XSipHashRec *ctx, unsigned char result[16]);
+
+#endif
@@ -173,6 +173,7 @@ present_send_complete_notify(WindowPtr window, CARD8 kind, CARD8 mode, CARD32 se
             if (event->mask & PresentCompleteNotifyMask) {
                 cn.eid = event->id;
                 WriteEventsToClient(event->client, 1, (xEvent *) &cn);
+                SmartScheduleBoostClient(event->client);
             }
         }
     }
@@ -25,7 +25,8 @@
 #include <dix-config.h>
 
 #include "os/bug_priv.h"
-#include "os/xsha1.h"
+#include "os/osdep.h"
+#include "os/xsiphash.h"
 
 #include "misc.h"
 #include "scrnintstr.h"
@@ -38,6 +39,7 @@
 #include "cursorstr.h"
 #include "dixstruct.h"
 #include "gcstruct.h"
+#include "list.h"
 #include "servermd.h"
 #include "picturestr.h"
 #include "glyphstr_priv.h"
@@ -78,21 +80,58 @@ static GlyphHashSetRec glyphHashSets[] = {
 
 #define NGLYPHHASHSETS	ARRAY_SIZE(glyphHashSets)
 
+/*
+ * Tables are resized incrementally: the new table takes all insertions,
+ * and every insertion or removal moves this many slots of the previous
+ * table over, so that no single request pays for rehashing millions of
+ * glyphs.  Lookups check the new table first and the previous one after.
+ */
+#define GLYPH_HASH_MOVE 16
+
 static GlyphHashRec globalGlyphs[GlyphFormatNum];
 
+/* Slots of both the table and the one it is being moved from */
+static inline CARD32
+GlyphHashSlots(GlyphHashPtr hash)
+{
+    return hash->hashSet->size +
+        (hash->oldTable ? hash->oldHashSet->size : 0);
+}
+
+static inline GlyphRefPtr
+GlyphHashSlot(GlyphHashPtr hash, CARD32 i)
+{
+    if (i < hash->hashSet->size)
+        return &hash->table[i];
+    return &hash->oldTable[i - hash->hashSet->size];
+}
+
+static void FreeGlyphRunCache(ScreenPtr pScreen);
+
 void
 GlyphUninit(ScreenPtr pScreen)
 {
     PictureScreenPtr ps = GetPictureScreen(pScreen);
+    GlyphRunStats stats;
     GlyphPtr glyph;
     int fdepth, i;
 
+    GetGlyphRunStats(pScreen, &stats);
+    if (stats.hits || stats.misses)
+        LogMessageVerb(X_INFO, 3,
+                       "Screen %d glyph run cache: %lu hits, %lu misses, "
+                       "%lu runs in %lu bytes\n", pScreen->myNum,
+                       stats.hits, stats.misses, stats.runs, stats.bytes);
+    FreeGlyphRunCache(pScreen);
+
     for (fdepth = 0; fdepth < GlyphFormatNum; fdepth++) {
-        if (!globalGlyphs[fdepth].hashSet)
+        GlyphHashPtr hash = &globalGlyphs[fdepth];
+
+        if (!hash->hashSet)
             continue;
 
-        for (i = 0; i < globalGlyphs[fdepth].hashSet->size; i++) {
-            glyph = globalGlyphs[fdepth].table[i].glyph;
+        for (i = 0; i < GlyphHashSlots(hash); i++) {
+            glyph = GlyphHashSlot(hash, i)->glyph;
             if (glyph && glyph != DeletedGlyph) {
                 if (GetGlyphPicture(glyph, pScreen)) {
                     FreePicture((void *) GetGlyphPicture(glyph, pScreen), 0);
@@ -116,19 +155,14 @@ FindGlyphHashSet(CARD32 filled)
 }
 
 static GlyphRefPtr
-FindGlyphRef(GlyphHashPtr hash,
-             CARD32 signature, Bool match, unsigned char sha1[20])
+FindGlyphRefIn(GlyphRefPtr table, GlyphHashSetPtr hashSet,
+               CARD32 signature, Bool match, unsigned char sha1[20])
 {
     CARD32 elt, step, s;
     GlyphPtr glyph;
-    GlyphRefPtr table, gr, del;
+    GlyphRefPtr gr, del;
+    CARD32 tableSize = hashSet->size;
 
-    if ((hash == NULL) || (hash->hashSet == NULL))
-        return NULL;
-
-    CARD32 tableSize = hash->hashSet->size;
-
-    table = hash->table;
     elt = signature % tableSize;
     step = 0;
     del = 0;
@@ -152,7 +186,7 @@ FindGlyphRef(GlyphHashPtr hash,
             break;
         }
         if (!step) {
-            step = signature % hash->hashSet->rehash;
+            step = signature % hashSet->rehash;
             if (!step)
                 step = 1;
         }
@@ -163,25 +197,117 @@ FindGlyphRef(GlyphHashPtr hash,
     return gr;
 }
 
+/*
+ * Returns the matching entry, from whichever table it is in, or else the
+ * free slot of the current table to put it in.
+ */
+static GlyphRefPtr
+FindGlyphRef(GlyphHashPtr hash,
+             CARD32 signature, Bool match, unsigned char sha1[20])
+{
+    GlyphRefPtr gr, old;
+
+    if ((hash == NULL) || (hash->hashSet == NULL))
+        return NULL;
+
+    gr = FindGlyphRefIn(hash->table, hash->hashSet, signature, match, sha1);
+    if (hash->oldTable && (!gr->glyph || gr->glyph == DeletedGlyph)) {
+        old = FindGlyphRefIn(hash->oldTable, hash->oldHashSet,
+                             signature, match, sha1);
+        if (old->glyph && old->glyph != DeletedGlyph)
+            return old;
+    }
+    return gr;
+}
+
+/* Moves up to count slots of the previous table into the current one */
+static void
+MoveGlyphHash(GlyphHashPtr hash, CARD32 count, Bool global)
+{
+    GlyphRefPtr old, gr;
+    CARD32 oldSize;
+
+    if (!hash->oldTable)
+        return;
+
+    oldSize = hash->oldHashSet->size;
+    for (; count && hash->oldNext < oldSize; count--) {
+        old = &hash->oldTable[hash->oldNext++];
+        if (!old->glyph || old->glyph == DeletedGlyph)
+            continue;
+
+        gr = FindGlyphRefIn(hash->table, hash->hashSet, old->signature,
+                            global, old->glyph->sha1);
+        if (gr->glyph == DeletedGlyph)
+            hash->tableDeleted--;
+        gr->signature = old->signature;
+        gr->glyph = old->glyph;
+
+        /* keep the probe sequences through this slot intact */
+        old->glyph = DeletedGlyph;
+    }
+
+    if (hash->oldNext == oldSize) {
+        free(hash->oldTable);
+        hash->oldTable = NULL;
+        hash->oldHashSet = NULL;
+        hash->oldNext = 0;
+    }
+}
+
+/* Fills in the free slot gr returned by FindGlyphRef */
+static void
+InsertGlyphRef(GlyphHashPtr hash, GlyphRefPtr gr,
+               CARD32 signature, GlyphPtr glyph, Bool global)
+{
+    if (gr->glyph == DeletedGlyph)
+        hash->tableDeleted--;
+    gr->glyph = glyph;
+    gr->signature = signature;
+    hash->tableEntries++;
+    MoveGlyphHash(hash, GLYPH_HASH_MOVE, global);
+}
+
+static void
+RemoveGlyphRef(GlyphHashPtr hash, GlyphRefPtr gr, Bool global)
+{
+    if (gr >= hash->table && gr < hash->table + hash->hashSet->size)
+        hash->tableDeleted++;
+    gr->glyph = DeletedGlyph;
+    gr->signature = 0;
+    hash->tableEntries--;
+    MoveGlyphHash(hash, GLYPH_HASH_MOVE, global);
+}
+
+/*
+ * Glyphs are shared between all clients by their hash, so it has to be one
+ * that clients can't produce collisions for: SipHash with a key of our
+ * own.  The last four bytes of the hash are left zero.
+ */
+static const unsigned char *
+GlyphHashKey(void)
+{
+    static unsigned char key[16];
+    static Bool keySet;
+
+    if (!keySet) {
+        GenerateRandomData(sizeof(key), (char *) key);
+        keySet = TRUE;
+    }
+    return key;
+}
+
 int
 HashGlyph(xGlyphInfo * gi,
           CARD8 *bits, unsigned long size, unsigned char sha1[20])
 {
-    void *ctx = x_sha1_init();
-    int success;
-
-    if (!ctx)
-        return BadAlloc;
-
-    success = x_sha1_update(ctx, gi, sizeof(xGlyphInfo));
-    if (!success)
-        return BadAlloc;
-    success = x_sha1_update(ctx, bits, size);
-    if (!success)
-        return BadAlloc;
-    success = x_sha1_final(ctx, sha1);
-    if (!success)
-        return BadAlloc;
+    XSipHashRec ctx;
+
+    x_siphash_init(&ctx, GlyphHashKey());
+    x_siphash_update(&ctx, gi, sizeof(xGlyphInfo));
+    x_siphash_update(&ctx, bits, size);
+    x_siphash_final(&ctx, sha1);
+    memset(sha1 + 16, 0, 4);
     return Success;
 }
 
@@ -254,10 +380,16 @@ FreeGlyph(GlyphPtr glyph, int format)
     BUG_RETURN(glyph->refcnt == 0);
     if (--glyph->refcnt == 0) {
         GlyphRefPtr gr;
+        CARD32 signature;
+#ifdef CHECK_DUPLICATES
         int i;
         int first;
-        CARD32 signature;
+#endif
 
+        signature = *(CARD32 *) glyph->sha1;
+        gr = FindGlyphRef(&globalGlyphs[format], signature, TRUE, glyph->sha1);
+
+#ifdef CHECK_DUPLICATES
         first = -1;
         for (i = 0; i < globalGlyphs[format].hashSet->size; i++)
             if (globalGlyphs[format].table[i].glyph == glyph) {
@@ -265,52 +397,60 @@ FreeGlyph(GlyphPtr glyph, int format)
                     DuplicateRef(glyph, "FreeGlyph check");
                 first = i;
             }
-
-        signature = *(CARD32 *) glyph->sha1;
-        gr = FindGlyphRef(&globalGlyphs[format], signature, TRUE, glyph->sha1);
         if (gr - globalGlyphs[format].table != first)
             DuplicateRef(glyph, "Found wrong one");
-        if (gr && gr->glyph && gr->glyph != DeletedGlyph) {
-            gr->glyph = DeletedGlyph;
-            gr->signature = 0;
-            globalGlyphs[format].tableEntries--;
-        }
+#endif
+
+        /* glyphs which didn't make it into the table have nothing there */
+        if (gr && gr->glyph == glyph)
+            RemoveGlyphRef(&globalGlyphs[format], gr, TRUE);
 
         FreeGlyphPicture(glyph);
         dixFreeObjectWithPrivates(glyph, PRIVATE_GLYPH);
     }
 }
 
+/*
+ * Makes a new glyph, with its hash filled in, the one FindGlyphByHash
+ * returns from now on.  ResizeGlyphSet must have made room for it.
+ */
 void
-AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id)
+AddGlyphByHash(GlyphPtr glyph, int format)
 {
     GlyphRefPtr gr;
     CARD32 signature;
 
-    CheckDuplicates(&globalGlyphs[glyphSet->fdepth], "AddGlyph top global");
-    /* Locate existing matching glyph */
     signature = *(CARD32 *) glyph->sha1;
-    gr = FindGlyphRef(&globalGlyphs[glyphSet->fdepth], signature,
-                      TRUE, glyph->sha1);
-    if (gr->glyph && gr->glyph != DeletedGlyph && gr->glyph != glyph) {
-        glyph = gr->glyph;
-    }
-    else if (gr->glyph != glyph) {
-        gr->glyph = glyph;
-        gr->signature = signature;
-        globalGlyphs[glyphSet->fdepth].tableEntries++;
-    }
+    gr = FindGlyphRef(&globalGlyphs[format], signature, TRUE, glyph->sha1);
+    BUG_RETURN(!gr || (gr->glyph && gr->glyph != DeletedGlyph));
+    InsertGlyphRef(&globalGlyphs[format], gr, signature, glyph, TRUE);
+    CheckDuplicates(&globalGlyphs[format], "AddGlyphByHash");
+}
 
-    /* Insert/replace glyphset value */
-    gr = FindGlyphRef(&glyphSet->hash, id, FALSE, 0);
-    ++glyph->refcnt;
-    if (gr->glyph && gr->glyph != DeletedGlyph)
-        FreeGlyph(gr->glyph, glyphSet->fdepth);
-    else
-        glyphSet->hash.tableEntries++;
-    gr->glyph = glyph;
-    gr->signature = id;
-    CheckDuplicates(&globalGlyphs[glyphSet->fdepth], "AddGlyph bottom");
+/*
+ * Adds all glyphs of an AddGlyphs request to glyphSet, replacing any with
+ * the same ids.  The glyphs have to be known by their hash already, and
+ * the set takes over the caller's reference to each.  ResizeGlyphSet must
+ * have made room for them.
+ */
+void
+AddGlyphs(GlyphSetPtr glyphSet, int nglyphs, const CARD32 *ids,
+          GlyphPtr *glyphs)
+{
+    GlyphRefPtr gr;
+    GlyphPtr old;
+    int i;
+
+    for (i = 0; i < nglyphs; i++) {
+        gr = FindGlyphRef(&glyphSet->hash, ids[i], FALSE, 0);
+        old = gr->glyph;
+        if (old && old != DeletedGlyph) {
+            gr->glyph = glyphs[i];
+            FreeGlyph(old, glyphSet->fdepth);
+        }
+        else
+            InsertGlyphRef(&glyphSet->hash, gr, ids[i], glyphs[i], FALSE);
+    }
 }
 
 Bool
@@ -322,8 +462,7 @@ DeleteGlyph(GlyphSetPtr glyphSet, Glyph id)
     gr = FindGlyphRef(&glyphSet->hash, id, FALSE, 0);
     glyph = gr->glyph;
     if (glyph && glyph != DeletedGlyph) {
-        gr->glyph = DeletedGlyph;
-        glyphSet->hash.tableEntries--;
+        RemoveGlyphRef(&glyphSet->hash, gr, FALSE);
         FreeGlyph(glyph, glyphSet->fdepth);
         return TRUE;
     }
@@ -392,45 +531,63 @@ AllocateGlyphHash(GlyphHashPtr hash, GlyphHashSetPtr hashSet)
         return FALSE;
     hash->hashSet = hashSet;
     hash->tableEntries = 0;
+    hash->tableDeleted = 0;
+    hash->oldTable = NULL;
+    hash->oldHashSet = NULL;
+    hash->oldNext = 0;
     return TRUE;
 }
 
+static void
+FreeGlyphHash(GlyphHashPtr hash)
+{
+    free(hash->table);
+    free(hash->oldTable);
+    memset(hash, 0, sizeof(*hash));
+}
+
+/*
+ * Makes sure change more entries fit in, starting a resize if they don't.
+ * Tables shrink once they are less than a quarter full, and get rebuilt at
+ * the same size when deleted entries clog them up.
+ */
 static Bool
 ResizeGlyphHash(GlyphHashPtr hash, CARD32 change, Bool global)
 {
     CARD32 tableEntries;
     GlyphHashSetPtr hashSet;
-    GlyphHashRec newHash;
-    GlyphRefPtr gr;
-    GlyphPtr glyph;
-    int i;
-    int oldSize;
-    CARD32 s;
+    GlyphRefPtr table;
 
     tableEntries = hash->tableEntries + change;
     hashSet = FindGlyphHashSet(tableEntries);
-    if (hashSet == hash->hashSet)
-        return TRUE;
+    if (!hashSet)
+        return FALSE;
+    if (hash->hashSet && hashSet <= hash->hashSet) {
+        if (hashSet + 1 < hash->hashSet)
+            hashSet++;
+        else if (tableEntries + hash->tableDeleted <= hash->hashSet->entries)
+            return TRUE;
+        else
+            hashSet = hash->hashSet;
+    }
     if (global)
         CheckDuplicates(hash, "ResizeGlyphHash top");
-    if (!AllocateGlyphHash(&newHash, hashSet))
+
+    table = calloc(hashSet->size, sizeof(GlyphRefRec));
+    if (!table)
         return FALSE;
-    if (hash->table) {
-        oldSize = hash->hashSet->size;
-        for (i = 0; i < oldSize; i++) {
-            glyph = hash->table[i].glyph;
-            if (glyph && glyph != DeletedGlyph) {
-                s = hash->table[i].signature;
-                if ((gr = FindGlyphRef(&newHash, s, global, glyph->sha1))) {
-                    gr->signature = s;
-                    gr->glyph = glyph;
-                }
-                ++newHash.tableEntries;
-            }
-        }
-        free(hash->table);
-    }
-    *hash = newHash;
+
+    /* a previous resize has to be done before the next one starts */
+    if (hash->oldTable)
+        MoveGlyphHash(hash, hash->oldHashSet->size, global);
+
+    hash->oldTable = hash->table;
+    hash->oldHashSet = hash->oldTable ? hash->hashSet : NULL;
+    hash->oldNext = 0;
+    hash->table = table;
+    hash->hashSet = hashSet;
+    hash->tableDeleted = 0;
+
     if (global)
         CheckDuplicates(hash, "ResizeGlyphHash bottom");
     return TRUE;
@@ -473,23 +630,19 @@ FreeGlyphSet(void *value, XID gid)
     GlyphSetPtr glyphSet = (GlyphSetPtr) value;
 
     if (--glyphSet->refcnt == 0) {
-        CARD32 i, tableSize = glyphSet->hash.hashSet->size;
-        GlyphRefPtr table = glyphSet->hash.table;
+        CARD32 i, slots = GlyphHashSlots(&glyphSet->hash);
         GlyphPtr glyph;
 
-        for (i = 0; i < tableSize; i++) {
-            glyph = table[i].glyph;
+        for (i = 0; i < slots; i++) {
+            glyph = GlyphHashSlot(&glyphSet->hash, i)->glyph;
             if (glyph && glyph != DeletedGlyph)
                 FreeGlyph(glyph, glyphSet->fdepth);
         }
-        if (!globalGlyphs[glyphSet->fdepth].tableEntries) {
-            free(globalGlyphs[glyphSet->fdepth].table);
-            globalGlyphs[glyphSet->fdepth].table = 0;
-            globalGlyphs[glyphSet->fdepth].hashSet = 0;
-        }
+        if (!globalGlyphs[glyphSet->fdepth].tableEntries)
+            FreeGlyphHash(&globalGlyphs[glyphSet->fdepth]);
         else
             ResizeGlyphHash(&globalGlyphs[glyphSet->fdepth], 0, TRUE);
-        free(table);
+        FreeGlyphHash(&glyphSet->hash);
         dixFreeObjectWithPrivates(glyphSet, PRIVATE_GLYPHSET);
     }
     return Success;
@@ -544,6 +697,296 @@ GlyphExtents(int nlist, GlyphListPtr list, GlyphPtr * glyphs, BoxPtr extents)
 
 #define NeedsComponent(f) (PICT_FORMAT_A(f) != 0 && PICT_FORMAT_RGB(f) != 0)
 
+/*
+ * Text runs drawn through a mask are cached per screen: editors and
+ * terminals send the same runs over and over, and with the mask of a run
+ * at hand drawing it again is a single composite.  Runs are identified by
+ * a hash of the mask format and the glyph formats, hashes and positions
+ * relative to the start of the run, so the same text at another place
+ * still hits and changing a glyph in the set can't bring back a stale
+ * mask.  A run only gets a mask the second time it is seen, so text that
+ * is drawn once costs no more than hashing it.
+ */
+#define GLYPH_RUN_BUCKETS   256
+#define GLYPH_RUN_MAX_RUNS  1024
+#define GLYPH_RUN_MAX_BYTES (8 << 20)   /* in all masks */
+#define GLYPH_RUN_MAX_MASK  (256 << 10) /* in one mask */
+
+typedef struct _GlyphRun {
+    struct _GlyphRun *next;     /* in its hash bucket */
+    struct xorg_list lru;       /* most recently used first */
+    unsigned char key[16];
+    BoxRec extents;             /* of the mask, relative to the run */
+    PicturePtr mask;            /* NULL until the run comes again */
+    CARD32 bytes;
+} GlyphRunRec, *GlyphRunPtr;
+
+typedef struct {
+    GlyphRunPtr buckets[GLYPH_RUN_BUCKETS];
+    struct xorg_list lru;
+    GlyphRunStats stats;
+} GlyphRunCacheRec, *GlyphRunCachePtr;
+
+static DevPrivateKeyRec glyphRunCacheKeyRec;
+
+#define GetGlyphRunCache(s) ((GlyphRunCachePtr) \
+    dixLookupPrivate(&(s)->devPrivates, &glyphRunCacheKeyRec))
+#define SetGlyphRunCache(s,c) \
+    dixSetPrivate(&(s)->devPrivates, &glyphRunCacheKeyRec, c)
+
+Bool
+GlyphInit(ScreenPtr pScreen)
+{
+    return dixRegisterPrivateKey(&glyphRunCacheKeyRec, PRIVATE_SCREEN, 0);
+}
+
+void
+GetGlyphRunStats(ScreenPtr pScreen, GlyphRunStats *stats)
+{
+    GlyphRunCachePtr cache = GetGlyphRunCache(pScreen);
+
+    if (cache)
+        *stats = cache->stats;
+    else
+        memset(stats, 0, sizeof(*stats));
+}
+
+static void
+GlyphRunKey(PictFormatPtr maskFormat, int nlist, GlyphListPtr list,
+            GlyphPtr *glyphs, unsigned char key[16])
+{
+    XSipHashRec ctx;
+    CARD32 header[4];
+    int i, n;
+
+    x_siphash_init(&ctx, GlyphHashKey());
+    header[0] = maskFormat->format;
+    header[1] = maskFormat->depth;
+    x_siphash_update(&ctx, header, 2 * sizeof(CARD32));
+    for (i = 0; i < nlist; i++) {
+        /* the first offset is where the run goes, not part of it */
+        header[0] = i ? (CARD32) (CARD16) list[i].xOff << 16 |
+            (CARD16) list[i].yOff : 0;
+        header[1] = list[i].len;
+        header[2] = list[i].format->format;
+        header[3] = list[i].format->depth;
+        x_siphash_update(&ctx, header, sizeof(header));
+        for (n = 0; n < list[i].len; n++)
+            x_siphash_update(&ctx, (*glyphs++)->sha1, 16);
+    }
+    x_siphash_final(&ctx, key);
+}
+
+static inline GlyphRunPtr *
+GlyphRunBucket(GlyphRunCachePtr cache, const unsigned char key[16])
+{
+    return &cache->buckets[*(const CARD32 *) key % GLYPH_RUN_BUCKETS];
+}
+
+static void
+FreeGlyphRun(GlyphRunCachePtr cache, GlyphRunPtr run)
+{
+    GlyphRunPtr *prev = GlyphRunBucket(cache, run->key);
+
+    while (*prev != run)
+        prev = &(*prev)->next;
+    *prev = run->next;
+    xorg_list_del(&run->lru);
+    if (run->mask)
+        FreePicture((void *) run->mask, (XID) 0);
+    cache->stats.runs--;
+    cache->stats.bytes -= run->bytes;
+    free(run);
+}
+
+/* Drops the least recently used runs until the cache fits the limits */
+static void
+TrimGlyphRuns(GlyphRunCachePtr cache, unsigned long runs, unsigned long bytes)
+{
+    while (!xorg_list_is_empty(&cache->lru) &&
+           (cache->stats.runs > runs || cache->stats.bytes > bytes))
+        FreeGlyphRun(cache,
+                     xorg_list_last_entry(&cache->lru, GlyphRunRec, lru));
+}
+
+static void
+FreeGlyphRunCache(ScreenPtr pScreen)
+{
+    GlyphRunCachePtr cache = GetGlyphRunCache(pScreen);
+
+    if (!cache)
+        return;
+    TrimGlyphRuns(cache, 0, 0);
+    free(cache);
+    SetGlyphRunCache(pScreen, NULL);
+}
+
+/* Renders the mask of a run the way miGlyphs does and keeps it */
+static Bool
+RenderGlyphRun(ScreenPtr pScreen, GlyphRunCachePtr cache, GlyphRunPtr run,
+               PictFormatPtr maskFormat, int nlist, GlyphListPtr list,
+               GlyphPtr *glyphs)
+{
+    int xDst = list->xOff, yDst = list->yOff;
+    PixmapPtr pMaskPixmap;
+    PicturePtr pMask, pPicture;
+    GCPtr pGC;
+    xRectangle rect;
+    BoxRec extents;
+    CARD32 component_alpha;
+    uint64_t bytes;
+    GlyphPtr glyph;
+    int width, height;
+    int x, y, n, error;
+
+    GlyphExtents(nlist, list, glyphs, &extents);
+    if (extents.x2 <= extents.x1 || extents.y2 <= extents.y1)
+        return FALSE;
+    /* clipped to the coordinate space, so not the same elsewhere */
+    if (extents.x1 == MINSHORT || extents.y1 == MINSHORT ||
+        extents.x2 == MAXSHORT || extents.y2 == MAXSHORT)
+        return FALSE;
+    width = extents.x2 - extents.x1;
+    height = extents.y2 - extents.y1;
+    bytes = (uint64_t) width * height * BitsPerPixel(maskFormat->depth) / 8;
+    if (bytes > GLYPH_RUN_MAX_MASK)
+        return FALSE;
+
+    pMaskPixmap = (*pScreen->CreatePixmap) (pScreen, width, height,
+                                            maskFormat->depth, 0);
+    if (!pMaskPixmap)
+        return FALSE;
+    component_alpha = NeedsComponent(maskFormat->format);
+    pMask = CreatePicture(0, &pMaskPixmap->drawable,
+                          maskFormat, CPComponentAlpha, &component_alpha,
+                          serverClient, &error);
+    /* the picture holds on to the pixmap */
+    dixDestroyPixmap(pMaskPixmap, 0);
+    if (!pMask)
+        return FALSE;
+    pGC = GetScratchGC(pMaskPixmap->drawable.depth, pScreen);
+    if (!pGC) {
+        FreePicture((void *) pMask, (XID) 0);
+        return FALSE;
+    }
+    ValidateGC(&pMaskPixmap->drawable, pGC);
+    rect.x = 0;
+    rect.y = 0;
+    rect.width = width;
+    rect.height = height;
+    (*pGC->ops->PolyFillRect) (&pMaskPixmap->drawable, pGC, 1, &rect);
+    FreeScratchGC(pGC);
+
+    x = -extents.x1;
+    y = -extents.y1;
+    while (nlist--) {
+        x += list->xOff;
+        y += list->yOff;
+        n = list->len;
+        while (n--) {
+            glyph = *glyphs++;
+            pPicture = GetGlyphPicture(glyph, pScreen);
+            if (pPicture)
+                CompositePicture(PictOpAdd, pPicture, None, pMask,
+                                 0, 0, 0, 0,
+                                 x - glyph->info.x, y - glyph->info.y,
+                                 glyph->info.width, glyph->info.height);
+            x += glyph->info.xOff;
+            y += glyph->info.yOff;
+        }
+        list++;
+    }
+
+    TrimGlyphRuns(cache, GLYPH_RUN_MAX_RUNS, GLYPH_RUN_MAX_BYTES - bytes);
+    run->mask = pMask;
+    run->bytes = bytes;
+    run->extents.x1 = extents.x1 - xDst;
+    run->extents.y1 = extents.y1 - yDst;
+    run->extents.x2 = extents.x2 - xDst;
+    run->extents.y2 = extents.y2 - yDst;
+    cache->stats.bytes += bytes;
+    return TRUE;
+}
+
+/*
+ * Draws a run from its cached mask.  Returns FALSE when the run has to be
+ * drawn glyph by glyph.
+ */
+static Bool
+CompositeGlyphRun(CARD8 op,
+                  PicturePtr pSrc,
+                  PicturePtr pDst,
+                  PictFormatPtr maskFormat,
+                  INT16 xSrc,
+                  INT16 ySrc, int nlist, GlyphListPtr list, GlyphPtr * glyphs)
+{
+    ScreenPtr pScreen = pDst->pDrawable->pScreen;
+    GlyphRunCachePtr cache = GetGlyphRunCache(pScreen);
+    int xDst = list->xOff, yDst = list->yOff;
+    unsigned char key[16];
+    GlyphRunPtr run, *bucket;
+    int x, y, width, height;
+
+    if (!cache) {
+        cache = calloc(1, sizeof(GlyphRunCacheRec));
+        if (!cache)
+            return FALSE;
+        xorg_list_init(&cache->lru);
+        SetGlyphRunCache(pScreen, cache);
+    }
+
+    GlyphRunKey(maskFormat, nlist, list, glyphs, key);
+    bucket = GlyphRunBucket(cache, key);
+    for (run = *bucket; run; run = run->next)
+        if (memcmp(run->key, key, sizeof(key)) == 0)
+            break;
+
+    if (!run) {
+        /* remember it, the mask is only worth it if the run comes again */
+        cache->stats.misses++;
+        TrimGlyphRuns(cache, GLYPH_RUN_MAX_RUNS - 1, GLYPH_RUN_MAX_BYTES);
+        run = calloc(1, sizeof(GlyphRunRec));
+        if (!run)
+            return FALSE;
+        memcpy(run->key, key, sizeof(key));
+        run->next = *bucket;
+        *bucket = run;
+        xorg_list_add(&run->lru, &cache->lru);
+        cache->stats.runs++;
+        return FALSE;
+    }
+
+    xorg_list_del(&run->lru);
+    xorg_list_add(&run->lru, &cache->lru);
+
+    if (run->mask) {
+        x = xDst + run->extents.x1;
+        y = yDst + run->extents.y1;
+        if (x <= MINSHORT || y <= MINSHORT ||
+            xDst + run->extents.x2 >= MAXSHORT ||
+            yDst + run->extents.y2 >= MAXSHORT) {
+            cache->stats.misses++;
+            return FALSE;
+        }
+        cache->stats.hits++;
+    }
+    else {
+        cache->stats.misses++;
+        if (!RenderGlyphRun(pScreen, cache, run, maskFormat,
+                            nlist, list, glyphs))
+            return FALSE;
+        x = xDst + run->extents.x1;
+        y = yDst + run->extents.y1;
+    }
+
+    width = run->extents.x2 - run->extents.x1;
+    height = run->extents.y2 - run->extents.y1;
+    CompositePicture(op, pSrc, run->mask, pDst,
+                     xSrc + x - xDst, ySrc + y - yDst, 0, 0,
+                     x, y, width, height);
+    return TRUE;
+}
+
 void
 CompositeGlyphs(CARD8 op,
                 PicturePtr pSrc,
@@ -556,6 +999,10 @@ CompositeGlyphs(CARD8 op,
 
     ValidatePicture(pSrc);
     ValidatePicture(pDst);
+    if (maskFormat && nlist > 0 &&
+        CompositeGlyphRun(op, pSrc, pDst, maskFormat, xSrc, ySrc,
+                          nlist, lists, glyphs))
+        return;
     (*ps->Glyphs) (op, pSrc, pDst, maskFormat, xSrc, ySrc, nlist, lists,
                    glyphs);
 }
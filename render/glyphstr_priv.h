@@ -32,7 +32,12 @@ typedef struct {
 typedef struct {
     GlyphRefPtr table;
     GlyphHashSetPtr hashSet;
-    CARD32 tableEntries;
+    CARD32 tableEntries;        /* in both tables */
+    CARD32 tableDeleted;        /* DeletedGlyph slots in table */
+    /* while resizing, the previous table and how far it has been moved */
+    GlyphRefPtr oldTable;
+    GlyphHashSetPtr oldHashSet;
+    CARD32 oldNext;
 } GlyphHashRec, *GlyphHashPtr;
 
 typedef struct {
@@ -49,10 +54,22 @@ typedef struct {
 #define GlyphSetSetPrivate(pGlyphSet,k,ptr) \
     dixSetPrivate(&(pGlyphSet)->devPrivates, k, ptr)
 
+/* Text run cache counters of a screen, see CompositeGlyphs() */
+typedef struct _GlyphRunStats {
+    unsigned long hits;         /* runs drawn from a cached mask */
+    unsigned long misses;       /* runs drawn glyph by glyph */
+    unsigned long runs;         /* runs in the cache, with a mask or not */
+    unsigned long bytes;        /* held in cached masks */
+} GlyphRunStats;
+
+Bool GlyphInit(ScreenPtr pScreen);
 void GlyphUninit(ScreenPtr pScreen);
+void GetGlyphRunStats(ScreenPtr pScreen, GlyphRunStats *stats);
 GlyphPtr FindGlyphByHash(unsigned char sha1[20], int format);
 int HashGlyph(xGlyphInfo * gi, CARD8 *bits, unsigned long size, unsigned char sha1[20]);
-void AddGlyph(GlyphSetPtr glyphSet, GlyphPtr glyph, Glyph id);
+void AddGlyphByHash(GlyphPtr glyph, int format);
+void AddGlyphs(GlyphSetPtr glyphSet, int nglyphs, const CARD32 *ids,
+               GlyphPtr *glyphs);
 Bool DeleteGlyph(GlyphSetPtr glyphSet, Glyph id);
 GlyphPtr FindGlyph(GlyphSetPtr glyphSet, Glyph id);
 GlyphPtr AllocateGlyph(xGlyphInfo * gi, int format);
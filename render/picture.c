@@ -621,6 +621,9 @@ PictureInit(ScreenPtr pScreen, PictFormatPtr formats, int nformats)
     if (!dixRegisterPrivateKey(&PictureWindowPrivateKeyRec, PRIVATE_WINDOW, 0))
         return FALSE;
 
+    if (!GlyphInit(pScreen))
+        return FALSE;
+
     if (!formats) {
         formats = PictureCreateDefaultFormats(pScreen, &nformats);
         if (!formats)
@@ -859,7 +862,7 @@ CreateSolidPicture(Picture pid, xRenderColor * color, int *error)
     pPicture->pSourcePict = calloc(1, sizeof(SourcePict));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     pPicture->pSourcePict->type = SourcePictTypeSolidFill;
@@ -890,7 +893,7 @@ CreateLinearGradientPicture(Picture pid, xPointFixed * p1, xPointFixed * p2,
     pPicture->pSourcePict = calloc(1, sizeof(SourcePict));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
 
@@ -900,7 +903,7 @@ CreateLinearGradientPicture(Picture pid, xPointFixed * p1, xPointFixed * p2,
 
     initGradient(pPicture->pSourcePict, nStops, stops, colors, error);
     if (*error) {
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     return pPicture;
@@ -930,7 +933,7 @@ CreateRadialGradientPicture(Picture pid, xPointFixed * inner,
     pPicture->pSourcePict = calloc(1, sizeof(SourcePict));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     radial = &pPicture->pSourcePict->radial;
@@ -945,7 +948,7 @@ CreateRadialGradientPicture(Picture pid, xPointFixed * inner,
 
     initGradient(pPicture->pSourcePict, nStops, stops, colors, error);
     if (*error) {
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     return pPicture;
@@ -973,7 +976,7 @@ CreateConicalGradientPicture(Picture pid, xPointFixed * center, xFixed angle,
     pPicture->pSourcePict = calloc(1, sizeof(SourcePict));
     if (!pPicture->pSourcePict) {
         *error = BadAlloc;
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
 
@@ -983,7 +986,7 @@ CreateConicalGradientPicture(Picture pid, xPointFixed * center, xFixed angle,
 
     initGradient(pPicture->pSourcePict, nStops, stops, colors, error);
     if (*error) {
-        free(pPicture);
+        dixFreeObjectWithPrivates(pPicture, PRIVATE_PICTURE);
         return 0;
     }
     return pPicture;
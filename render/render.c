@@ -242,6 +242,8 @@ RenderExtensionInit(void)
                             NULL, StandardMinorOpcode);
     if (!extEntry)
         return;
+    SetExtensionRequestVectors(extEntry, RenderNumberRequests,
+                               ProcRenderVector, SProcRenderVector);
     RenderErrBase = extEntry->errorBase;
 #ifdef XINERAMA
     if (XRT_PICTURE)
@@ -982,23 +984,22 @@ ProcRenderFreeGlyphSet(ClientPtr client)
     return Success;
 }
 
-typedef struct _GlyphNew {
-    Glyph id;
-    GlyphPtr glyph;
-    Bool found;
-    unsigned char sha1[20];
-} GlyphNewRec, *GlyphNewPtr;
-
 #define NeedsComponent(f) (PICT_FORMAT_A(f) != 0 && PICT_FORMAT_RGB(f) != 0)
 
+/*
+ * Each glyph is hashed and looked up, and uploaded and added to the global
+ * glyph table if it is new, in a single pass over the request; glyphs
+ * repeated within the request are only uploaded once.  The glyph set only
+ * gets to see them after the whole request checked out.
+ */
 static int
 ProcRenderAddGlyphs(ClientPtr client)
 {
     GlyphSetPtr glyphSet;
 
     REQUEST(xRenderAddGlyphsReq);
-    GlyphNewRec glyphsLocal[NLOCALGLYPH];
-    GlyphNewPtr glyphsBase, glyphs, glyph_new;
+    GlyphPtr glyphsLocal[NLOCALGLYPH];
+    GlyphPtr *glyphs;
     int remain, nglyphs;
     CARD32 *gids;
     xGlyphInfo *gi;
@@ -1021,25 +1022,23 @@ ProcRenderAddGlyphs(ClientPtr client)
 
     err = BadAlloc;
     nglyphs = stuff->nglyphs;
-    if (nglyphs > UINT32_MAX / sizeof(GlyphNewRec))
+    if (nglyphs > UINT32_MAX / sizeof(GlyphPtr))
         return BadAlloc;
 
     component_alpha = NeedsComponent(glyphSet->format->format);
 
     if (nglyphs <= NLOCALGLYPH) {
         memset(glyphsLocal, 0, sizeof(glyphsLocal));
-        glyphsBase = glyphsLocal;
+        glyphs = glyphsLocal;
     }
     else {
-        glyphsBase = (GlyphNewPtr) calloc(nglyphs, sizeof(GlyphNewRec));
-        if (!glyphsBase)
+        glyphs = calloc(nglyphs, sizeof(GlyphPtr));
+        if (!glyphs)
             return BadAlloc;
     }
 
     remain = (client->req_len << 2) - sizeof(xRenderAddGlyphsReq);
 
-    glyphs = glyphsBase;
-
     gids = (CARD32 *) (stuff + 1);
     gi = (xGlyphInfo *) (gids + nglyphs);
     bits = (CARD8 *) (gi + nglyphs);
@@ -1054,11 +1053,10 @@ ProcRenderAddGlyphs(ClientPtr client)
         goto bail;
     }
 
+    /* all of the bits have to be there before the tables grow for them */
     for (i = 0; i < nglyphs; i++) {
         size_t padded_width;
 
-        glyph_new = &glyphs[i];
-
         padded_width = PixmapBytePad(gi[i].width, glyphSet->format->depth);
 
         if (gi[i].height &&
@@ -1069,25 +1067,45 @@ ProcRenderAddGlyphs(ClientPtr client)
         if (remain < size)
             break;
 
-        err = HashGlyph(&gi[i], bits, size, glyph_new->sha1);
+        if (size & 3)
+            size += 4 - (size & 3);
+        remain -= size;
+    }
+    if (remain || i < nglyphs) {
+        err = BadLength;
+        goto bail;
+    }
+
+    /* room for all of them, in the glyph set and the global table */
+    if (!ResizeGlyphSet(glyphSet, nglyphs)) {
+        err = BadAlloc;
+        goto bail;
+    }
+
+    for (i = 0; i < nglyphs; i++) {
+        unsigned char sha1[20];
+        GlyphPtr glyph;
+
+        size = gi[i].height *
+            PixmapBytePad(gi[i].width, glyphSet->format->depth);
+
+        err = HashGlyph(&gi[i], bits, size, sha1);
         if (err)
             goto bail;
 
-        glyph_new->glyph = FindGlyphByHash(glyph_new->sha1, glyphSet->fdepth);
+        glyph = FindGlyphByHash(sha1, glyphSet->fdepth);
 
-        if (glyph_new->glyph && glyph_new->glyph != DeletedGlyph) {
-            glyph_new->found = TRUE;
-            ++glyph_new->glyph->refcnt;
+        if (glyph) {
+            ++glyph->refcnt;
+            glyphs[i] = glyph;
         }
         else {
-            GlyphPtr glyph;
-
-            glyph_new->found = FALSE;
-            glyph_new->glyph = glyph = AllocateGlyph(&gi[i], glyphSet->fdepth);
+            glyphs[i] = glyph = AllocateGlyph(&gi[i], glyphSet->fdepth);
             if (!glyph) {
                 err = BadAlloc;
                 goto bail;
             }
+            memcpy(glyph->sha1, sha1, 20);
 
             for (screen = 0; screen < screenInfo.numScreens; screen++) {
                 int width = gi[i].width;
@@ -1152,31 +1170,18 @@ ProcRenderAddGlyphs(ClientPtr client)
                 pSrcPix = NULL;
             }
 
-            memcpy(glyph_new->glyph->sha1, glyph_new->sha1, 20);
+            AddGlyphByHash(glyph, glyphSet->fdepth);
         }
 
-        glyph_new->id = gids[i];
-
         if (size & 3)
             size += 4 - (size & 3);
         bits += size;
-        remain -= size;
-    }
-    if (remain || i < nglyphs) {
-        err = BadLength;
-        goto bail;
-    }
-    if (!ResizeGlyphSet(glyphSet, nglyphs)) {
-        err = BadAlloc;
-        goto bail;
-    }
-    for (i = 0; i < nglyphs; i++) {
-        AddGlyph(glyphSet, glyphs[i].glyph, glyphs[i].id);
-        FreeGlyph(glyphs[i].glyph, glyphSet->fdepth);
     }
 
-    if (glyphsBase != glyphsLocal)
-        free(glyphsBase);
+    AddGlyphs(glyphSet, nglyphs, gids, glyphs);
+
+    if (glyphs != glyphsLocal)
+        free(glyphs);
     return Success;
  bail:
     if (pSrc)
@@ -1184,14 +1189,11 @@ ProcRenderAddGlyphs(ClientPtr client)
     if (pSrcPix)
         FreeScratchPixmapHeader(pSrcPix);
     for (i = 0; i < nglyphs; i++) {
-        if (glyphs[i].glyph) {
-            --glyphs[i].glyph->refcnt;
-            if (!glyphs[i].found)
-                free(glyphs[i].glyph);
-        }
+        if (glyphs[i])
+            FreeGlyph(glyphs[i], glyphSet->fdepth);
     }
-    if (glyphsBase != glyphsLocal)
-        free(glyphsBase);
+    if (glyphs != glyphsLocal)
+        free(glyphs);
     return err;
 }
 
@@ -0,0 +1,132 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Core rendering throughput of the fb row code with each set of kernels,
+ * x11perf style but in process: rectangle fills with GXcopy and GXxor,
+ * fills with a tile one word wide and copies within the same rows, at
+ * 8, 16 and 32 bpp.  GXcopy fills go to pixman whatever the kernels and
+ * are there for comparison.
+ *
+ * Run with "meson test --benchmark fb" or directly.
+ */
+
+#include <dix-config.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/X.h>
+
+#include "fb/fb_priv.h"
+
+#include "tests-common.h"
+
+#define WIDTH 1920
+#define HEIGHT 1080
+#define STRIDE (WIDTH * 32 / FB_UNIT)   /* in FbBits, enough for 32 bpp */
+#define TOTAL_PIXELS (200 * 1000 * 1000)
+
+static FbBits *bits;
+static FbBits tile[8];
+
+typedef void (*BenchOpProcPtr) (int bpp, int x, int y, int size);
+
+typedef struct {
+    BenchOpProcPtr op;
+    int bpp, size;
+} BenchOpRec;
+
+static void
+op_fill_copy(int bpp, int x, int y, int size)
+{
+    FbBits fg = fbReplicatePixel(0x336699, bpp);
+
+    fbSolidRect(bits, STRIDE, bpp, x, y, size, size,
+                fbAnd(GXcopy, fg, FB_ALLONES), fbXor(GXcopy, fg, FB_ALLONES));
+}
+
+static void
+op_fill_xor(int bpp, int x, int y, int size)
+{
+    FbBits fg = fbReplicatePixel(0x336699, bpp);
+
+    fbSolidRect(bits, STRIDE, bpp, x, y, size, size,
+                fbAnd(GXxor, fg, FB_ALLONES), fbXor(GXxor, fg, FB_ALLONES));
+}
+
+static void
+op_tile(int bpp, int x, int y, int size)
+{
+    fbTile(bits + y * STRIDE, STRIDE, x * bpp, size * bpp, size,
+           tile, 1, FB_UNIT, ARRAY_SIZE(tile), GXcopy, FB_ALLONES, bpp,
+           0, 0);
+}
+
+/* shifts the rectangle right by one pixel, as when inserting text */
+static void
+op_scroll(int bpp, int x, int y, int size)
+{
+    fbBlt(bits + y * STRIDE, STRIDE, x * bpp,
+          bits + y * STRIDE, STRIDE, (x + 1) * bpp,
+          size * bpp, size, GXcopy, FB_ALLONES, bpp, TRUE, FALSE);
+}
+
+/* one op, at a different place each round */
+static void
+bench_op_round(int i, void *data)
+{
+    BenchOpRec *bench = data;
+
+    bench->op(bench->bpp, (i * 7) % (WIDTH - bench->size - 1),
+              (i * 13) % (HEIGHT - bench->size), bench->size);
+}
+
+static void
+bench_op(const char *name, BenchOpProcPtr op, int size)
+{
+    static const int depths[] = { 8, 16, 32 };
+    BenchOpRec bench = { .op = op, .size = size };
+    KernelLevel kernels, best;
+    int d, rounds = TOTAL_PIXELS / (size * size);
+
+    best = fbSelectKernels(KERNELS_BEST);
+    for (d = 0; d < ARRAY_SIZE(depths); d++) {
+        bench.bpp = depths[d];
+        for (kernels = KERNELS_REFERENCE; kernels <= best; kernels++) {
+            uint64_t elapsed;
+
+            fbSelectKernels(kernels);
+            elapsed = bench_time(rounds, bench_op_round, &bench);
+
+            printf("%-10s %4dx%-4d %2d bpp %-10s %9.1f ns/op %7.2f ns/kpixel\n",
+                   name, size, size, depths[d], bench_kernel_name(kernels),
+                   (double) elapsed / rounds,
+                   (double) elapsed * 1000 / rounds / (size * size));
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    int i;
+
+    bits = calloc(HEIGHT * STRIDE, sizeof(FbBits));
+    if (!bits) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (i = 0; i < ARRAY_SIZE(tile); i++)
+        tile[i] = 0x01010101 * (i + 1);
+
+    bench_op("fill-copy", op_fill_copy, 500);
+    bench_op("fill-xor", op_fill_xor, 10);
+    bench_op("fill-xor", op_fill_xor, 100);
+    bench_op("fill-xor", op_fill_xor, 500);
+    bench_op("tile", op_tile, 100);
+    bench_op("tile", op_tile, 500);
+    bench_op("scroll", op_scroll, 100);
+    bench_op("scroll", op_scroll, 500);
+
+    free(bits);
+    return 0;
+}
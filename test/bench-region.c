@@ -0,0 +1,136 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * RegionFromRects() / RegionValidate() throughput with each set of region
+ * kernels, for rectangle lists shaped like shaped windows, damage and
+ * random XFixes regions.
+ *
+ * Run with "meson test --benchmark region" or directly.
+ */
+
+#include <dix-config.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/X.h>
+
+#include "dix/region_priv.h"
+
+#include "misc.h"
+#include "regionstr.h"
+#include "gc.h"
+
+#include "tests-common.h"
+
+#define TOTAL_RECTS (4 * 1000 * 1000)
+
+typedef struct {
+    xRectangle *rects;
+    int n;
+    int boxes;
+} BenchShapeRec;
+
+/* a round window: one span per scanline, shuffled */
+static void
+shape_round(xRectangle *rects, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        int dy = i - n / 2;
+        int dx = 0;
+
+        while ((dx + 1) * (dx + 1) + dy * dy < (n / 2) * (n / 2))
+            dx++;
+        rects[i].x = 1000 - dx;
+        rects[i].y = i;
+        rects[i].width = 2 * dx + 1;
+        rects[i].height = 1;
+    }
+}
+
+/* damage on a tiled surface: a grid of equally sized tiles */
+static void
+shape_tiles(xRectangle *rects, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        rects[i].x = (i % 64) * 32;
+        rects[i].y = (i / 64) * 32;
+        rects[i].width = 24;
+        rects[i].height = 32;
+    }
+}
+
+/* random, overlapping rectangles */
+static void
+shape_random(xRectangle *rects, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        rects[i].x = random() % 4000;
+        rects[i].y = random() % 4000;
+        rects[i].width = random() % 200 + 1;
+        rects[i].height = random() % 200 + 1;
+    }
+}
+
+static void
+bench_shape_round(int i, void *data)
+{
+    BenchShapeRec *bench = data;
+    RegionPtr reg = RegionFromRects(bench->n, bench->rects, CT_UNSORTED);
+
+    bench->boxes = RegionNumRects(reg);
+    RegionDestroy(reg);
+}
+
+static void
+bench_shape(const char *name, void (*shape) (xRectangle *, int), int n)
+{
+    xRectangle *rects = calloc(n, sizeof(xRectangle));
+    xRectangle *shuffled = calloc(n, sizeof(xRectangle));
+    KernelLevel kernels, best;
+    int i, j, rounds = TOTAL_RECTS / n;
+
+    if (!rects || !shuffled)
+        FatalError("out of memory");
+
+    srandom(n);
+    shape(rects, n);
+    for (i = 0; i < n; i++) {
+        j = random() % (i + 1);
+        shuffled[i] = shuffled[j];
+        shuffled[j] = rects[i];
+    }
+
+    best = RegionSelectKernels(KERNELS_BEST);
+    for (kernels = KERNELS_REFERENCE; kernels <= best; kernels++) {
+        BenchShapeRec bench = { .rects = shuffled, .n = n };
+        uint64_t elapsed;
+
+        RegionSelectKernels(kernels);
+        elapsed = bench_time(rounds, bench_shape_round, &bench);
+
+        printf("%-8s %6d rects -> %6d boxes %-10s %8.1f ns/rect\n",
+               name, n, bench.boxes, bench_kernel_name(kernels),
+               (double) elapsed / rounds / n);
+    }
+
+    free(rects);
+    free(shuffled);
+}
+
+int
+main(int argc, char **argv)
+{
+    InitRegions();
+
+    bench_shape("round", shape_round, 1000);
+    bench_shape("tiles", shape_tiles, 64 * 64);
+    bench_shape("random", shape_random, 100);
+    bench_shape("random", shape_random, 10000);
+    return 0;
+}
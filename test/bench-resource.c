@@ -0,0 +1,124 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Resource lookup latency at various table sizes.
+ *
+ * Run with "meson test --benchmark resource" or directly.
+ */
+
+#include <dix-config.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dix/dix_priv.h"
+#include "dix/resource_priv.h"
+
+#include "misc.h"
+#include "resource.h"
+#include "dixstruct.h"
+
+#include "tests-common.h"
+
+#define FIRST_ID 0x100
+#define LOOKUPS (4 * 1000 * 1000)
+
+typedef struct {
+    RESTYPE type;
+    XID *ids;
+    XID offset;                 /* added to the ids, past them for misses */
+    int found;
+} BenchLookupRec;
+
+static int
+delete_resource(void *value, XID id)
+{
+    return Success;
+}
+
+static void
+bench_add_round(int i, void *data)
+{
+    BenchLookupRec *bench = data;
+
+    AddResource(FIRST_ID + i, bench->type, (void *) (uintptr_t) (i + 1));
+}
+
+static void
+bench_lookup_round(int i, void *data)
+{
+    BenchLookupRec *bench = data;
+    void *value;
+
+    bench->found += dixLookupResourceByType(&value,
+                                            bench->ids[i] + bench->offset,
+                                            bench->type, NULL,
+                                            DixReadAccess) == Success;
+}
+
+static void
+bench_lookup(int count)
+{
+    static ClientRec server_client;
+    BenchLookupRec bench = { 0 };
+    uint64_t add, hit, miss;
+    int i;
+
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    if (!InitClientResources(serverClient))
+        FatalError("couldn't init server resources");
+    bench.type = CreateNewResourceType(delete_resource, "BenchType");
+
+    bench.ids = calloc(LOOKUPS, sizeof(XID));
+    if (!bench.ids)
+        FatalError("out of memory");
+    /* random access pattern, so the cache has to work for it */
+    srandom(count);
+    for (i = 0; i < LOOKUPS; i++)
+        bench.ids[i] = FIRST_ID + random() % count;
+
+    add = bench_time(count, bench_add_round, &bench);
+    hit = bench_time(LOOKUPS, bench_lookup_round, &bench);
+    bench.offset = count;
+    miss = bench_time(LOOKUPS, bench_lookup_round, &bench);
+
+    if (bench.found != LOOKUPS)
+        FatalError("lookup failed: %d of %d found\n", bench.found, LOOKUPS);
+
+    printf("%8d resources: add %6.1f ns, hit %6.1f ns, miss %6.1f ns\n",
+           count, (double) add / count, (double) hit / LOOKUPS,
+           (double) miss / LOOKUPS);
+
+    free(bench.ids);
+    FreeClientResources(serverClient);
+}
+
+int
+main(int argc, char **argv)
+{
+    bench_lookup(1000);
+    bench_lookup(100 * 1000);
+    bench_lookup(1000 * 1000);
+    return 0;
+}
@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Callback lists: callbacks run newest first, and adding or deleting
+ * callbacks from within a callback must neither crash nor call anything
+ * the caller did not expect.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "dix/callback_priv.h"
+
+#include "callback.h"
+#include "dix.h"
+
+#include "tests-common.h"
+
+#define NUM_CALLBACKS 10
+
+static CallbackListPtr list;
+static int calls[NUM_CALLBACKS];
+static int order[NUM_CALLBACKS * 2];
+static int ncalls;
+
+static void
+record_callback(CallbackListPtr *pcbl, void *data, void *call_data)
+{
+    int n = (intptr_t) data;
+
+    assert(pcbl == &list);
+    calls[n]++;
+    order[ncalls++] = n;
+}
+
+/* deletes every even callback, and itself */
+static void
+delete_even_callback(CallbackListPtr *pcbl, void *data, void *call_data)
+{
+    int i;
+
+    for (i = 0; i < NUM_CALLBACKS; i += 2)
+        DeleteCallback(pcbl, record_callback, (void *) (intptr_t) i);
+    assert(DeleteCallback(pcbl, delete_even_callback, data));
+}
+
+static void
+add_callback(CallbackListPtr *pcbl, void *data, void *call_data)
+{
+    record_callback(pcbl, data, call_data);
+    assert(AddCallback(pcbl, record_callback, (void *) (intptr_t) 0));
+}
+
+static void
+reset_calls(void)
+{
+    memset(calls, 0, sizeof(calls));
+    ncalls = 0;
+}
+
+static void
+callback_order_test(void)
+{
+    int i;
+
+    assert(CallbackListEmpty(list));
+    for (i = 0; i < NUM_CALLBACKS; i++)
+        assert(AddCallback(&list, record_callback, (void *) (intptr_t) i));
+    assert(!CallbackListEmpty(list));
+
+    reset_calls();
+    CallCallbacks(&list, NULL);
+    assert(ncalls == NUM_CALLBACKS);
+    for (i = 0; i < NUM_CALLBACKS; i++)
+        assert(order[i] == NUM_CALLBACKS - 1 - i);
+
+    for (i = 0; i < NUM_CALLBACKS; i++)
+        assert(DeleteCallback(&list, record_callback, (void *) (intptr_t) i));
+    assert(!DeleteCallback(&list, record_callback, (void *) (intptr_t) 0));
+    assert(CallbackListEmpty(list));
+
+    reset_calls();
+    CallCallbacks(&list, NULL);
+    assert(ncalls == 0);
+
+    DeleteCallbackList(&list);
+    assert(!list);
+}
+
+static void
+callback_delete_in_callback_test(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_CALLBACKS; i++) {
+        assert(AddCallback(&list, record_callback, (void *) (intptr_t) i));
+        if (i == NUM_CALLBACKS / 2)
+            assert(AddCallback(&list, delete_even_callback,
+                               (void *) (intptr_t) i));
+    }
+
+    /* the later (older) even callbacks are gone before they get called */
+    reset_calls();
+    CallCallbacks(&list, NULL);
+    for (i = 0; i < NUM_CALLBACKS; i++) {
+        if (i >= NUM_CALLBACKS / 2 || i % 2)
+            assert(calls[i] == 1);
+        else
+            assert(calls[i] == 0);
+    }
+
+    reset_calls();
+    CallCallbacks(&list, NULL);
+    assert(ncalls == NUM_CALLBACKS / 2);
+    for (i = 0; i < NUM_CALLBACKS; i++)
+        assert(calls[i] == i % 2);
+
+    DeleteCallbackList(&list);
+}
+
+static void
+callback_add_in_callback_test(void)
+{
+    assert(AddCallback(&list, add_callback, (void *) (intptr_t) 1));
+
+    /* the new callback only runs the next time round */
+    reset_calls();
+    CallCallbacks(&list, NULL);
+    assert(ncalls == 1 && calls[1] == 1);
+
+    reset_calls();
+    CallCallbacks(&list, NULL);
+    assert(ncalls == 2 && calls[0] == 1 && calls[1] == 1);
+    assert(order[0] == 0);
+
+    DeleteCallbackList(&list);
+    assert(!list);
+}
+
+const testfunc_t*
+callback_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        callback_order_test,
+        callback_delete_in_callback_test,
+        callback_add_in_callback_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
@@ -0,0 +1,599 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Deferred damage collects boxes in a batch before they reach the region,
+ * which nobody reading or reporting the damage may notice.  Bounded damage
+ * may cover more than was drawn, but never less.  Tiled damage marks every
+ * tile a box touches, and only those, and says when some of the damage is
+ * only in the region instead.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <X11/X.h>
+
+#include "pixmapstr.h"
+#include "regionstr.h"
+#include "scrnintstr.h"
+
+#include "tests-common.h"
+
+#define ROUNDS 500
+#define WIDTH 300
+#define HEIGHT 200
+
+static ScreenRec screen;
+
+/* a screen with damage set up and a pixmap on it */
+static PixmapPtr
+damage_pixmap(void)
+{
+    PixmapPtr pixmap;
+
+    dixResetPrivates();
+    screenInfo.numScreens = 1;
+    screenInfo.screens[0] = &screen;
+    assert(dixAllocatePrivates(&screen.devPrivates, PRIVATE_SCREEN));
+    assert(DamageSetup(&screen));
+    dixInitScreenSpecificPrivates(&screen);
+    assert(PixmapScreenInit(&screen));
+
+    pixmap = AllocatePixmap(&screen, 0);
+    assert(pixmap);
+    pixmap->drawable.type = DRAWABLE_PIXMAP;
+    pixmap->drawable.pScreen = &screen;
+    pixmap->drawable.width = WIDTH;
+    pixmap->drawable.height = HEIGHT;
+    pixmap->refcnt = 1;
+    return pixmap;
+}
+
+static DamagePtr
+damage_watch(PixmapPtr pixmap, DamageReportFunc report, void *closure)
+{
+    DamagePtr pDamage;
+
+    pDamage = DamageCreate(report, NULL,
+                           report ? DamageReportRawRegion : DamageReportNone,
+                           FALSE, &screen, closure);
+    assert(pDamage);
+    DamageRegister(&pixmap->drawable, pDamage);
+    return pDamage;
+}
+
+/* unions everything reported into the closure */
+static void
+damage_collect(DamagePtr pDamage, RegionPtr pRegion, void *closure)
+{
+    RegionUnion(closure, closure, pRegion);
+}
+
+static void
+random_box(BoxPtr box, int size)
+{
+    box->x1 = random() % WIDTH;
+    box->y1 = random() % HEIGHT;
+    box->x2 = min(box->x1 + random() % size + 1, WIDTH);
+    box->y2 = min(box->y1 + random() % size + 1, HEIGHT);
+}
+
+/* a random op: mostly a few small boxes, sometimes more than a batch */
+static void
+draw_random(PixmapPtr pixmap)
+{
+    BoxRec boxes[100];
+    RegionRec region;
+    int i, n;
+
+    if (random() % 8 == 0) {
+        /* a comb, one box per tooth */
+        n = ARRAY_SIZE(boxes);
+        for (i = 0; i < n; i++) {
+            boxes[i].x1 = i * 3;
+            boxes[i].x2 = i * 3 + 1;
+            boxes[i].y1 = random() % 10;
+            boxes[i].y2 = boxes[i].y1 + 1;
+        }
+    }
+    else {
+        n = random() % 5 + 1;
+        for (i = 0; i < n; i++)
+            random_box(&boxes[i], 30);
+    }
+    assert(RegionInitBoxes(&region, boxes, n));
+    DamageRegionAppend(&pixmap->drawable, &region);
+    RegionUninit(&region);
+}
+
+static void
+damage_batch_read_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    DamagePtr plain = damage_watch(pixmap, NULL, NULL);
+    DamagePtr batched = damage_watch(pixmap, NULL, NULL);
+    BoxRec box = { 10, 20, 30, 40 };
+    RegionRec region;
+    int round, i;
+
+    DamageSetDeferred(batched, TRUE);
+
+    /* the first read already sees the batch */
+    RegionInit(&region, &box, 1);
+    DamageRegionAppend(&pixmap->drawable, &region);
+    assert(RegionEqual(DamageRegion(batched), &region));
+    assert(!RegionNotEmpty(DamagePendingRegion(batched)));
+    RegionUninit(&region);
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = random() % 40; i >= 0; i--)
+            draw_random(pixmap);
+        assert(RegionEqual(DamageRegion(plain), DamageRegion(batched)));
+        if (random() % 4 == 0) {
+            DamageEmpty(plain);
+            DamageEmpty(batched);
+        }
+    }
+
+    /* turning it off hands over what was batched */
+    draw_random(pixmap);
+    DamageSetDeferred(batched, FALSE);
+    assert(RegionEqual(DamageRegion(plain), DamageRegion(batched)));
+
+    DamageDestroy(plain);
+    DamageDestroy(batched);
+    FreePixmap(pixmap);
+}
+
+static void
+damage_batch_report_after_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    RegionRec plain_reported, batched_reported;
+    DamagePtr plain, batched;
+    int round, i;
+
+    RegionNull(&plain_reported);
+    RegionNull(&batched_reported);
+    plain = damage_watch(pixmap, damage_collect, &plain_reported);
+    batched = damage_watch(pixmap, damage_collect, &batched_reported);
+    DamageSetReportAfterOp(plain, TRUE);
+    DamageSetReportAfterOp(batched, TRUE);
+    DamageSetDeferred(batched, TRUE);
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = random() % 40; i >= 0; i--)
+            draw_random(pixmap);
+
+        /* pending until the op is done, reported then */
+        assert(RegionEqual(DamagePendingRegion(plain),
+                           DamagePendingRegion(batched)));
+        assert(RegionEqual(DamageRegion(plain), DamageRegion(batched)));
+        assert(RegionEqual(&plain_reported, &batched_reported));
+
+        DamageRegionProcessPending(&pixmap->drawable);
+        assert(!RegionNotEmpty(DamagePendingRegion(batched)));
+        assert(RegionEqual(&plain_reported, &batched_reported));
+        assert(RegionEqual(DamageRegion(plain), DamageRegion(batched)));
+    }
+    assert(RegionNotEmpty(&batched_reported));
+
+    /* turning reportAfter off leaves the batch with the pending damage */
+    draw_random(pixmap);
+    DamageSetReportAfterOp(plain, FALSE);
+    DamageSetReportAfterOp(batched, FALSE);
+    assert(RegionNotEmpty(DamagePendingRegion(batched)));
+    assert(RegionEqual(DamagePendingRegion(plain),
+                       DamagePendingRegion(batched)));
+
+    DamageDestroy(plain);
+    DamageDestroy(batched);
+    RegionUninit(&plain_reported);
+    RegionUninit(&batched_reported);
+    FreePixmap(pixmap);
+}
+
+static void
+damage_batch_subtract_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    DamagePtr plain = damage_watch(pixmap, NULL, NULL);
+    DamagePtr batched = damage_watch(pixmap, NULL, NULL);
+    DamagePtr plain_after = damage_watch(pixmap, NULL, NULL);
+    DamagePtr batched_after = damage_watch(pixmap, NULL, NULL);
+    int round, i;
+
+    DamageSetDeferred(batched, TRUE);
+    DamageSetReportAfterOp(plain_after, TRUE);
+    DamageSetReportAfterOp(batched_after, TRUE);
+    DamageSetDeferred(batched_after, TRUE);
+
+    for (round = 0; round < ROUNDS; round++) {
+        for (i = random() % 40; i >= 0; i--)
+            draw_random(pixmap);
+
+        /* with the boxes still batched */
+        switch (random() % 3) {
+        case 0: {
+            BoxRec box;
+            RegionRec region;
+
+            random_box(&box, 150);
+            RegionInit(&region, &box, 1);
+            assert(DamageSubtract(plain, &region) ==
+                   DamageSubtract(batched, &region));
+            assert(DamageSubtract(plain_after, &region) ==
+                   DamageSubtract(batched_after, &region));
+            RegionUninit(&region);
+            break;
+        }
+        case 1:
+            DamageEmpty(plain);
+            DamageEmpty(batched);
+            /* the pending damage is not the damage yet */
+            DamageEmpty(plain_after);
+            DamageEmpty(batched_after);
+            break;
+        }
+        DamageRegionProcessPending(&pixmap->drawable);
+        assert(RegionEqual(DamageRegion(plain), DamageRegion(batched)));
+        assert(RegionEqual(DamageRegion(plain_after),
+                           DamageRegion(batched_after)));
+    }
+
+    DamageDestroy(plain);
+    DamageDestroy(batched);
+    DamageDestroy(plain_after);
+    DamageDestroy(batched_after);
+    FreePixmap(pixmap);
+}
+
+struct bounded_report {
+    RegionRec region;
+    int maxRects;
+};
+
+static void
+damage_collect_bounded(DamagePtr pDamage, RegionPtr pRegion, void *closure)
+{
+    struct bounded_report *report = closure;
+
+    assert(RegionNumRects(pRegion) <= report->maxRects);
+    RegionUnion(&report->region, &report->region, pRegion);
+}
+
+/* bounded covers exact, with the same extents and few enough boxes */
+static void
+assert_bounded(RegionPtr exact, RegionPtr bounded, int maxRects)
+{
+    RegionRec missed;
+
+    assert(RegionNumRects(bounded) <= maxRects);
+    RegionNull(&missed);
+    RegionSubtract(&missed, exact, bounded);
+    assert(!RegionNotEmpty(&missed));
+    RegionUninit(&missed);
+    if (RegionNotEmpty(exact)) {
+        BoxPtr a = RegionExtents(exact), b = RegionExtents(bounded);
+
+        assert(a->x1 == b->x1 && a->y1 == b->y1 &&
+               a->x2 == b->x2 && a->y2 == b->y2);
+    }
+}
+
+static void
+damage_bound_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    struct bounded_report report;
+    RegionRec exact_reported;
+    DamagePtr exact, bounded, exact_after, bounded_after;
+    int round, i;
+
+    RegionNull(&exact_reported);
+    RegionNull(&report.region);
+    exact = damage_watch(pixmap, NULL, NULL);
+    bounded = damage_watch(pixmap, NULL, NULL);
+    exact_after = damage_watch(pixmap, damage_collect, &exact_reported);
+    bounded_after = damage_watch(pixmap, damage_collect_bounded, &report);
+    DamageSetReportAfterOp(exact_after, TRUE);
+    DamageSetReportAfterOp(bounded_after, TRUE);
+
+    for (round = 0; round < ROUNDS; round++) {
+        int maxRects = random() % 20 + 1;
+
+        DamageSetMaxRects(bounded, maxRects);
+        DamageSetMaxRects(bounded_after, maxRects);
+        report.maxRects = maxRects;
+        DamageSetDeferred(bounded, random() % 2);
+        DamageSetDeferred(bounded_after, random() % 2);
+
+        for (i = random() % 40; i >= 0; i--)
+            draw_random(pixmap);
+        DamageRegionProcessPending(&pixmap->drawable);
+
+        assert_bounded(DamageRegion(exact), DamageRegion(bounded), maxRects);
+        assert_bounded(&exact_reported, &report.region, INT_MAX);
+
+        if (random() % 4 == 0) {
+            DamageEmpty(exact);
+            DamageEmpty(bounded);
+        }
+    }
+
+    DamageDestroy(exact);
+    DamageDestroy(bounded);
+    DamageDestroy(exact_after);
+    DamageDestroy(bounded_after);
+    RegionUninit(&exact_reported);
+    RegionUninit(&report.region);
+    FreePixmap(pixmap);
+}
+
+/* the tiles covering box, clipped to the drawable */
+static void
+tiles_union(RegionPtr tiles, const BoxRec *box, int shift)
+{
+    int size = 1 << shift;
+    BoxRec rounded = {
+        max(box->x1, 0), max(box->y1, 0),
+        min(box->x2, WIDTH), min(box->y2, HEIGHT)
+    };
+    RegionRec region;
+
+    if (rounded.x1 >= rounded.x2 || rounded.y1 >= rounded.y2)
+        return;
+    rounded.x1 &= ~(size - 1);
+    rounded.y1 &= ~(size - 1);
+    rounded.x2 = min((rounded.x2 + size - 1) & ~(size - 1), WIDTH);
+    rounded.y2 = min((rounded.y2 + size - 1) & ~(size - 1), HEIGHT);
+    RegionInit(&region, &rounded, 1);
+    RegionUnion(tiles, tiles, &region);
+    RegionUninit(&region);
+}
+
+static void
+draw_box(PixmapPtr pixmap, int x1, int y1, int x2, int y2)
+{
+    BoxRec box = { x1, y1, x2, y2 };
+    RegionRec region;
+
+    RegionInit(&region, &box, 1);
+    DamageRegionAppend(&pixmap->drawable, &region);
+    RegionUninit(&region);
+}
+
+/* the runs of dirty tiles are maximal, in order and make up tiles */
+static void
+assert_tiles(DamagePtr pDamage, RegionPtr tiles)
+{
+    RegionRec region, runs;
+    BoxRec box, last = { 0, -1, 0, 0 };
+    int pos = 0;
+
+    RegionNull(&runs);
+    while (DamageNextDirtyTiles(pDamage, &pos, &box)) {
+        assert(box.x1 < box.x2 && box.y1 < box.y2);
+        assert(box.y1 > last.y1 || (box.y1 == last.y1 && box.x1 > last.x2));
+        RegionInit(&region, &box, 1);
+        RegionUnion(&runs, &runs, &region);
+        RegionUninit(&region);
+        last = box;
+    }
+    assert(!DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(RegionEqual(&runs, tiles));
+    RegionUninit(&runs);
+
+    assert(DamageTilesRegion(pDamage, &region));
+    assert(RegionEqual(&region, tiles));
+    RegionUninit(&region);
+}
+
+static void
+damage_count(DamagePtr pDamage, RegionPtr pRegion, void *closure)
+{
+    (*(int *) closure)++;
+}
+
+/* single pixel tiles, so a word of the bitmap covers 64 pixels of a row */
+static void
+damage_tiles_word_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    DamagePtr pDamage = damage_watch(pixmap, NULL, NULL);
+    BoxRec box;
+    int pos = 0;
+
+    DamageSetTiles(pDamage, 0);
+
+    /* across the first word boundary */
+    draw_box(pixmap, 60, 0, 70, 1);
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 60 && box.x2 == 70 && box.y1 == 0 && box.y2 == 1);
+    assert(!DamageNextDirtyTiles(pDamage, &pos, &box));
+    DamageEmpty(pDamage);
+
+    /* whole words, then part of the next */
+    draw_box(pixmap, 0, 1, 200, 2);
+    pos = 0;
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 0 && box.x2 == 200 && box.y1 == 1 && box.y2 == 2);
+    assert(!DamageNextDirtyTiles(pDamage, &pos, &box));
+
+    /* runs ending and starting at either side of a boundary */
+    draw_box(pixmap, 120, 2, 128, 3);
+    draw_box(pixmap, 129, 2, 192, 3);
+    draw_box(pixmap, 256, 2, WIDTH, 3);
+    /* one short of a whole word */
+    draw_box(pixmap, 64, 3, 127, 4);
+    pos = 0;
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box) && box.y1 == 1);
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 120 && box.x2 == 128 && box.y1 == 2);
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 129 && box.x2 == 192 && box.y1 == 2);
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 256 && box.x2 == WIDTH && box.y1 == 2);
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 64 && box.x2 == 127 && box.y1 == 3);
+    assert(!DamageNextDirtyTiles(pDamage, &pos, &box));
+
+    DamageDestroy(pDamage);
+    FreePixmap(pixmap);
+}
+
+static void
+damage_tiles_region_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    int reports = 0;
+    DamagePtr pDamage = damage_watch(pixmap, damage_count, &reports);
+    RegionRec tiles;
+    int round, i;
+
+    for (round = 0; round < ROUNDS; round++) {
+        int shift = random() % 6;
+
+        DamageSetTiles(pDamage, shift);
+        DamageEmpty(pDamage);
+        reports = 0;
+        RegionNull(&tiles);
+
+        for (i = random() % 20; i >= 0; i--) {
+            BoxRec box;
+
+            /* some off the edges, some many words wide */
+            random_box(&box, random() % 4 ? 30 : WIDTH);
+            box.x1 -= 20;
+            box.y1 -= 20;
+            draw_box(pixmap, box.x1, box.y1, box.x2, box.y2);
+            tiles_union(&tiles, &box, shift);
+        }
+        assert(reports == 1);
+        assert_tiles(pDamage, &tiles);
+
+        /* read as a region, the tiles move into it */
+        assert(RegionEqual(DamageRegion(pDamage), &tiles));
+        RegionEmpty(&tiles);
+        assert_tiles(pDamage, &tiles);
+        RegionUninit(&tiles);
+    }
+
+    DamageDestroy(pDamage);
+    FreePixmap(pixmap);
+}
+
+static void
+damage_tiles_resize_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    DamagePtr pDamage = damage_watch(pixmap, NULL, NULL);
+    RegionRec tiles;
+    BoxRec box;
+    int pos = 0;
+
+    DamageSetTiles(pDamage, 4);
+    draw_box(pixmap, 5, 5, 6, 6);
+
+    /* dirty tiles may be anywhere after a resize */
+    pixmap->drawable.width = WIDTH / 2;
+    pixmap->drawable.height = HEIGHT / 3;
+    assert(DamageTilesRegion(pDamage, &tiles));
+    assert(RegionNumRects(&tiles) == 1);
+    assert(RegionExtents(&tiles)->x2 == WIDTH / 2 &&
+           RegionExtents(&tiles)->y2 == HEIGHT / 3);
+    RegionUninit(&tiles);
+
+    pixmap->drawable.width = WIDTH;
+    pixmap->drawable.height = HEIGHT;
+    assert(DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(box.x1 == 0 && box.y1 == 0 && box.x2 == WIDTH && box.y2 == 16);
+
+    /* clean ones stay clean */
+    DamageEmpty(pDamage);
+    pixmap->drawable.width = WIDTH / 2;
+    pos = 0;
+    assert(!DamageNextDirtyTiles(pDamage, &pos, &box));
+    assert(DamageTilesRegion(pDamage, &tiles));
+    assert(!RegionNotEmpty(&tiles));
+    RegionUninit(&tiles);
+
+    pixmap->drawable.width = WIDTH;
+    DamageDestroy(pDamage);
+    FreePixmap(pixmap);
+}
+
+/* damage outside the bitmap, which walking the tiles doesn't find */
+static void
+damage_tiles_fallback_test(void)
+{
+    PixmapPtr pixmap = damage_pixmap();
+    DamagePtr pDamage = damage_watch(pixmap, NULL, NULL);
+    DamagePtr unregistered;
+    RegionRec tiles;
+    BoxRec first = { 5, 5, 6, 6 }, second = { 100, 50, 101, 51 };
+
+    DamageSetTiles(pDamage, 4);
+    assert(DamageTilesComplete(pDamage));
+    draw_box(pixmap, first.x1, first.y1, first.x2, first.y2);
+    assert(DamageTilesComplete(pDamage));
+
+    /* read as a region, the first box is no longer in the bitmap */
+    assert(RegionNotEmpty(DamageRegion(pDamage)));
+    draw_box(pixmap, second.x1, second.y1, second.x2, second.y2);
+    assert(!DamageTilesComplete(pDamage));
+    RegionNull(&tiles);
+    tiles_union(&tiles, &second, 4);
+    assert_tiles(pDamage, &tiles);
+    tiles_union(&tiles, &first, 4);
+    assert(RegionEqual(DamageRegion(pDamage), &tiles));
+    RegionUninit(&tiles);
+
+    DamageEmpty(pDamage);
+    assert(DamageTilesComplete(pDamage));
+
+    /* collected before switching to tiles */
+    DamageDestroy(pDamage);
+    pDamage = damage_watch(pixmap, NULL, NULL);
+    draw_box(pixmap, first.x1, first.y1, first.x2, first.y2);
+    DamageSetTiles(pDamage, 4);
+    assert(!DamageTilesComplete(pDamage));
+    RegionNull(&tiles);
+    assert_tiles(pDamage, &tiles);
+    RegionUninit(&tiles);
+    assert(RegionNumRects(DamageRegion(pDamage)) == 1);
+    assert(RegionExtents(DamageRegion(pDamage))->x1 == first.x1);
+
+    /* without a drawable there is no bitmap at all */
+    unregistered = DamageCreate(NULL, NULL, DamageReportNone, FALSE, &screen,
+                                NULL);
+    assert(unregistered);
+    DamageSetTiles(unregistered, 4);
+    assert(!DamageTilesComplete(unregistered));
+
+    DamageDestroy(unregistered);
+    DamageDestroy(pDamage);
+    FreePixmap(pixmap);
+}
+
+const testfunc_t*
+damage_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        damage_batch_read_test,
+        damage_batch_report_after_test,
+        damage_batch_subtract_test,
+        damage_bound_test,
+        damage_tiles_word_test,
+        damage_tiles_region_test,
+        damage_tiles_resize_test,
+        damage_tiles_fallback_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
@@ -0,0 +1,107 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Request dispatch overhead: pipelines batches of cheap requests, core and
+ * extension ones, and reports the average round trip per request.
+ *
+ * Run with "meson test --benchmark dispatch" or against any server.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#include "tests-common.h"
+
+#define BATCH 10000
+#define ROUNDS 20
+
+typedef struct {
+    xcb_connection_t *c;
+    void (*batch) (xcb_connection_t *);
+} BenchBatchRec;
+
+/* NoOperation: no reply, nothing to do but dispatch */
+static void
+batch_no_operation(xcb_connection_t *c)
+{
+    int i;
+
+    for (i = 0; i < BATCH; i++)
+        xcb_no_operation(c);
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+/* a core request with a reply */
+static void
+batch_get_input_focus(xcb_connection_t *c)
+{
+    xcb_get_input_focus_cookie_t cookie;
+    int i;
+
+    for (i = 0; i < BATCH - 1; i++)
+        xcb_discard_reply(c, xcb_get_input_focus(c).sequence);
+    cookie = xcb_get_input_focus(c);
+    free(xcb_get_input_focus_reply(c, cookie, NULL));
+}
+
+/* the same through an extension's dispatch */
+static void
+batch_render_query_version(xcb_connection_t *c)
+{
+    xcb_render_query_version_cookie_t cookie;
+    int i;
+
+    for (i = 0; i < BATCH - 1; i++)
+        xcb_discard_reply(c, xcb_render_query_version(c, 0, 11).sequence);
+    cookie = xcb_render_query_version(c, 0, 11);
+    free(xcb_render_query_version_reply(c, cookie, NULL));
+}
+
+static void
+bench_batch_round(int i, void *data)
+{
+    BenchBatchRec *bench = data;
+
+    bench->batch(bench->c);
+}
+
+static void
+bench(xcb_connection_t *c, const char *name,
+      void (*batch) (xcb_connection_t *))
+{
+    BenchBatchRec bench = { .c = c, .batch = batch };
+    uint64_t best;
+
+    /* warm up */
+    batch(c);
+
+    best = bench_best(ROUNDS, bench_batch_round, &bench);
+    assert(!xcb_connection_has_error(c));
+
+    printf("%-22s %8.1f ns/request\n", name, (double) best / BATCH);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_connection_t *c = xcb_connect(NULL, NULL);
+    const xcb_query_extension_reply_t *render;
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        return 1;
+    }
+
+    bench(c, "NoOperation", batch_no_operation);
+    bench(c, "GetInputFocus", batch_get_input_focus);
+
+    render = xcb_get_extension_data(c, &xcb_render_id);
+    if (render && render->present)
+        bench(c, "RenderQueryVersion", batch_render_query_version);
+
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,397 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Solid fills, even tiles and copies with the accelerated fb kernels must
+ * touch exactly the pixels the reference code touches, with the same
+ * result, for every raster op and at every depth.  Composites, fills and
+ * copies cut into bands for the render threads must come out exactly as
+ * they do on one thread.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "fb/fb_priv.h"
+#include "fb/fbpict_priv.h"
+#include "os/osdep.h"
+
+#include "picturestr.h"
+#include "pixmapstr.h"
+
+#include "tests-common.h"
+
+#define FUZZ_ROUNDS 2000
+#define WIDTH 300               /* in pixels, at most 32 bpp */
+#define HEIGHT 8
+#define STRIDE (WIDTH * 32 / FB_UNIT + 1)       /* in FbBits */
+
+static FbBits ref[HEIGHT * STRIDE], out[HEIGHT * STRIDE];
+static FbBits tile[4];
+
+static const int depths[] = { 8, 16, 32 };
+
+#define BAND_ROUNDS 20
+#define BAND_THREADS 3
+#define BAND_WIDTH 1000         /* in pixels, at 32 bpp */
+#define BAND_HEIGHT 333         /* rows don't split evenly into bands */
+
+static FbBits band_one[BAND_HEIGHT * BAND_WIDTH];      /* one thread */
+static FbBits band_many[BAND_HEIGHT * BAND_WIDTH];     /* in bands */
+static FbBits band_src[BAND_HEIGHT * BAND_WIDTH];
+static FbBits band_mask[BAND_HEIGHT * BAND_WIDTH / 4]; /* at 8 bpp */
+static ScreenRec band_screen;
+
+static void
+random_bits(FbBits *bits, int n)
+{
+    while (n--)
+        *bits++ = (FbBits) random() << 16 ^ random();
+}
+
+/* random and/xor for a random alu, planemask and pixel */
+static void
+random_rop(int bpp, FbBits *and, FbBits *xor, int *alu, FbBits *pm)
+{
+    FbBits fg = fbReplicatePixel(random(), bpp);
+
+    *alu = random() % 16;
+    *pm = random() % 2 ? FB_ALLONES : fbReplicatePixel(random(), bpp);
+    *and = fbAnd(*alu, fg, *pm);
+    *xor = fbXor(*alu, fg, *pm);
+}
+
+static void
+fb_solid_test(void)
+{
+    KernelLevel kernels, best = fbSelectKernels(KERNELS_BEST);
+    int round;
+
+    for (round = 0; round < FUZZ_ROUNDS; round++) {
+        int bpp = depths[round % ARRAY_SIZE(depths)];
+        int x = random() % WIDTH;
+        int width = random() % (WIDTH - x) + 1;
+        int height = random() % HEIGHT + 1;
+        FbBits and, xor, pm;
+        int alu;
+
+        random_rop(bpp, &and, &xor, &alu, &pm);
+        random_bits(ref, HEIGHT * STRIDE);
+
+        fbSelectKernels(KERNELS_REFERENCE);
+        memcpy(out, ref, sizeof(out));
+        fbSolid(ref, STRIDE, x * bpp, bpp, width * bpp, height, and, xor);
+
+        for (kernels = KERNELS_SCALAR; kernels <= best; kernels++) {
+            FbBits result[HEIGHT * STRIDE];
+
+            assert(fbSelectKernels(kernels) == kernels);
+            memcpy(result, out, sizeof(out));
+            fbSolid(result, STRIDE, x * bpp, bpp, width * bpp, height,
+                    and, xor);
+            assert(memcmp(result, ref, sizeof(ref)) == 0);
+        }
+    }
+    fbSelectKernels(KERNELS_BEST);
+}
+
+static void
+fb_tile_test(void)
+{
+    KernelLevel kernels, best = fbSelectKernels(KERNELS_BEST);
+    int round;
+
+    for (round = 0; round < FUZZ_ROUNDS; round++) {
+        int bpp = depths[round % ARRAY_SIZE(depths)];
+        int x = random() % WIDTH;
+        int width = random() % (WIDTH - x) + 1;
+        int height = random() % HEIGHT + 1;
+        int tileHeight = random() % ARRAY_SIZE(tile) + 1;
+        int xRot = random() % 64, yRot = random() % 8;
+        FbBits and, xor, pm;
+        int alu;
+
+        /* a tile one word wide goes through fbEvenTile() */
+        random_rop(bpp, &and, &xor, &alu, &pm);
+        random_bits(tile, ARRAY_SIZE(tile));
+        random_bits(ref, HEIGHT * STRIDE);
+
+        fbSelectKernels(KERNELS_REFERENCE);
+        memcpy(out, ref, sizeof(out));
+        fbTile(ref, STRIDE, x * bpp, width * bpp, height,
+               tile, 1, FB_UNIT, tileHeight, alu, pm, bpp,
+               xRot * bpp, yRot);
+
+        for (kernels = KERNELS_SCALAR; kernels <= best; kernels++) {
+            FbBits result[HEIGHT * STRIDE];
+
+            fbSelectKernels(kernels);
+            memcpy(result, out, sizeof(out));
+            fbTile(result, STRIDE, x * bpp, width * bpp, height,
+                   tile, 1, FB_UNIT, tileHeight, alu, pm, bpp,
+                   xRot * bpp, yRot);
+            assert(memcmp(result, ref, sizeof(ref)) == 0);
+        }
+    }
+    fbSelectKernels(KERNELS_BEST);
+}
+
+/* copies within the same rows, both ways, as when scrolling sideways */
+static void
+fb_blt_overlap_test(void)
+{
+    int round;
+
+    for (round = 0; round < FUZZ_ROUNDS; round++) {
+        int bpp = depths[round % ARRAY_SIZE(depths)];
+        int srcX = random() % WIDTH;
+        int dstX = random() % WIDTH;
+        int width = random() % (WIDTH - (srcX > dstX ? srcX : dstX)) + 1;
+        int height = random() % HEIGHT + 1;
+        Bool reverse = srcX < dstX;
+
+        random_bits(ref, HEIGHT * STRIDE);
+        memcpy(out, ref, sizeof(out));
+
+        fbSelectKernels(KERNELS_REFERENCE);
+        fbBlt(ref, STRIDE, srcX * bpp, ref, STRIDE, dstX * bpp,
+              width * bpp, height, GXcopy, FB_ALLONES, bpp, reverse, FALSE);
+
+        fbSelectKernels(KERNELS_BEST);
+        fbBlt(out, STRIDE, srcX * bpp, out, STRIDE, dstX * bpp,
+              width * bpp, height, GXcopy, FB_ALLONES, bpp, reverse, FALSE);
+        assert(memcmp(out, ref, sizeof(ref)) == 0);
+    }
+}
+
+static void
+band_count_rows(int y1, int y2, void *closure)
+{
+    int *rows = closure;
+
+    /* each row is in exactly one band, so no two threads share a counter */
+    while (y1 < y2)
+        rows[y1++]++;
+}
+
+/* the bands cover every row once, whatever the seams */
+static void
+fb_bands_seam_test(void)
+{
+    int rows[BAND_HEIGHT + 1];
+    int round;
+
+    FbThreads = BAND_THREADS;
+    for (round = 0; round < BAND_ROUNDS * 10; round++) {
+        int height = random() % BAND_HEIGHT + 1;
+        int y = random() % (BAND_HEIGHT - height + 1);
+        int i;
+
+        memset(rows, 0, sizeof(rows));
+        if (!fbRunBands(y, BAND_WIDTH, height, band_count_rows, rows))
+            continue;
+        for (i = 0; i <= BAND_HEIGHT; i++)
+            assert(rows[i] == (i >= y && i < y + height));
+    }
+    FbThreads = 0;
+}
+
+static void
+band_source_validate(DrawablePtr pDrawable, int x, int y, int width,
+                     int height, unsigned int subWindowMode)
+{
+}
+
+static void
+band_pixmap(PixmapPtr pPixmap, FbBits *bits, int depth, int bpp)
+{
+    memset(pPixmap, 0, sizeof(*pPixmap));
+    band_screen.SourceValidate = band_source_validate;
+    pPixmap->drawable.type = DRAWABLE_PIXMAP;
+    pPixmap->drawable.depth = depth;
+    pPixmap->drawable.bitsPerPixel = bpp;
+    pPixmap->drawable.width = BAND_WIDTH;
+    pPixmap->drawable.height = BAND_HEIGHT;
+    pPixmap->drawable.pScreen = &band_screen;
+    pPixmap->devKind = BAND_WIDTH * bpp / 8;
+    pPixmap->devPrivate.ptr = bits;
+}
+
+static void
+fb_bands_fill_test(void)
+{
+    int round;
+
+    for (round = 0; round < BAND_ROUNDS; round++) {
+        int bpp = depths[round % ARRAY_SIZE(depths)];
+        int pixels = BAND_WIDTH * FB_UNIT / bpp;        /* in each row */
+        int x = random() % pixels;
+        int width = random() % (pixels - x) + 1;
+        int height = random() % BAND_HEIGHT + 1;
+        int y = random() % (BAND_HEIGHT - height + 1);
+        FbBits and, xor, pm;
+        int alu;
+
+        /* and == 0 goes through pixman_fill(), anything else fbSolid() */
+        random_rop(bpp, &and, &xor, &alu, &pm);
+        if (round % 2)
+            and = 0;
+        random_bits(band_one, ARRAY_SIZE(band_one));
+        memcpy(band_many, band_one, sizeof(band_many));
+
+        FbThreads = 0;
+        fbSolidRect(band_one, BAND_WIDTH, bpp, x, y, width, height, and, xor);
+        FbThreads = BAND_THREADS;
+        fbSolidRect(band_many, BAND_WIDTH, bpp, x, y, width, height, and, xor);
+        FbThreads = 0;
+        assert(memcmp(band_many, band_one, sizeof(band_one)) == 0);
+    }
+}
+
+static void
+band_copy(PixmapPtr pSrc, PixmapPtr pDst, BoxPtr pBox, int dx, int dy)
+{
+    /* as miCopyRegion() orders a copy within one pixmap */
+    Bool reverse = pSrc == pDst && dx < 0;
+    Bool upsidedown = pSrc == pDst && dy < 0;
+
+    fbCopyNtoN(&pSrc->drawable, &pDst->drawable, NULL, pBox, 1, dx, dy,
+               reverse, upsidedown, 0, NULL);
+}
+
+/* between pixmaps, and within one with and without rows in common */
+static void
+fb_bands_copy_test(void)
+{
+    PixmapRec one, many, src_one, src_many;
+    int round;
+
+    band_pixmap(&one, band_one, 32, 32);
+    band_pixmap(&many, band_many, 32, 32);
+    band_pixmap(&src_one, band_src, 32, 32);
+    band_pixmap(&src_many, band_src, 32, 32);
+
+    for (round = 0; round < BAND_ROUNDS * 3; round++) {
+        int width = random() % BAND_WIDTH + 1;
+        int height = random() % BAND_HEIGHT + 1;
+        int srcX = random() % (BAND_WIDTH - width + 1);
+        int srcY = random() % (BAND_HEIGHT - height + 1);
+        int dstX = random() % (BAND_WIDTH - width + 1);
+        int dstY = random() % (BAND_HEIGHT - height + 1);
+        BoxRec box = { dstX, dstY, dstX + width, dstY + height };
+        Bool within = round % 3 != 0;
+
+        random_bits(band_one, ARRAY_SIZE(band_one));
+        memcpy(band_many, band_one, sizeof(band_many));
+        random_bits(band_src, ARRAY_SIZE(band_src));
+
+        FbThreads = 0;
+        band_copy(within ? &one : &src_one, &one, &box,
+                  srcX - dstX, srcY - dstY);
+        FbThreads = BAND_THREADS;
+        band_copy(within ? &many : &src_many, &many, &box,
+                  srcX - dstX, srcY - dstY);
+        FbThreads = 0;
+        assert(memcmp(band_many, band_one, sizeof(band_one)) == 0);
+    }
+}
+
+static void
+band_picture(PicturePtr pPicture, PixmapPtr pPixmap, PictFormatShort format,
+             RegionPtr pClip)
+{
+    static PictFormatRec pict_format;
+
+    memset(pPicture, 0, sizeof(*pPicture));
+    pPicture->pDrawable = &pPixmap->drawable;
+    pPicture->pFormat = &pict_format;
+    pPicture->format = format;
+    pPicture->pCompositeClip = pClip;
+}
+
+static void
+band_composite(CARD8 op, PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst,
+               int xSrc, int ySrc, int xDst, int yDst, int width, int height)
+{
+    fbComposite(op, pSrc, pMask, pDst, xSrc, ySrc, xSrc, ySrc,
+                xDst, yDst, width, height);
+}
+
+/* with and without a mask, a repeating source, and one from the target */
+static void
+fb_bands_composite_test(void)
+{
+    static const CARD8 ops[] = { PictOpSrc, PictOpOver, PictOpAdd };
+    BoxRec bounds = { 0, 0, BAND_WIDTH, BAND_HEIGHT };
+    PixmapRec one, many, src, mask;
+    PictureRec dst_one, dst_many, src_one, src_many, src_pict, mask_pict;
+    RegionRec clip;
+    int round;
+
+    RegionInit(&clip, &bounds, 1);
+    band_pixmap(&one, band_one, 32, 32);
+    band_pixmap(&many, band_many, 32, 32);
+    band_pixmap(&src, band_src, 32, 32);
+    band_pixmap(&mask, band_mask, 8, 8);
+    band_picture(&dst_one, &one, PICT_a8r8g8b8, &clip);
+    band_picture(&dst_many, &many, PICT_a8r8g8b8, &clip);
+    band_picture(&src_one, &one, PICT_a8r8g8b8, &clip);
+    band_picture(&src_many, &many, PICT_a8r8g8b8, &clip);
+    band_picture(&src_pict, &src, PICT_a8r8g8b8, NULL);
+    band_picture(&mask_pict, &mask, PICT_a8, NULL);
+
+    for (round = 0; round < BAND_ROUNDS * 3; round++) {
+        CARD8 op = ops[random() % ARRAY_SIZE(ops)];
+        int width = random() % BAND_WIDTH + 1;
+        int height = random() % BAND_HEIGHT + 1;
+        int xSrc = random() % (BAND_WIDTH - width + 1);
+        int ySrc = random() % (BAND_HEIGHT - height + 1);
+        int xDst = random() % (BAND_WIDTH - width + 1);
+        int yDst = random() % (BAND_HEIGHT - height + 1);
+        PicturePtr pMask = round % 2 ? &mask_pict : NULL;
+        Bool within = round % 3 == 0;
+
+        /* repeating from further away than one band */
+        src_pict.repeat = random() % 2;
+        src_pict.repeatType = src_pict.repeat ? RepeatNormal : RepeatNone;
+        if (src_pict.repeat)
+            ySrc = random() % (BAND_HEIGHT * 4) - BAND_HEIGHT * 2;
+
+        random_bits(band_one, ARRAY_SIZE(band_one));
+        memcpy(band_many, band_one, sizeof(band_many));
+        random_bits(band_src, ARRAY_SIZE(band_src));
+        random_bits(band_mask, ARRAY_SIZE(band_mask));
+
+        FbThreads = 0;
+        band_composite(op, within ? &src_one : &src_pict, pMask, &dst_one,
+                       xSrc, ySrc, xDst, yDst, width, height);
+        FbThreads = BAND_THREADS;
+        band_composite(op, within ? &src_many : &src_pict, pMask, &dst_many,
+                       xSrc, ySrc, xDst, yDst, width, height);
+        FbThreads = 0;
+        assert(memcmp(band_many, band_one, sizeof(band_one)) == 0);
+    }
+    RegionUninit(&clip);
+}
+
+const testfunc_t*
+fb_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        fb_solid_test,
+        fb_tile_test,
+        fb_blt_overlap_test,
+        fb_bands_seam_test,
+        fb_bands_fill_test,
+        fb_bands_copy_test,
+        fb_bands_composite_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
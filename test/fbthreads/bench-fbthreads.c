@@ -0,0 +1,160 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Software rendering throughput for full-screen 4K operations: an alpha
+ * blended composite, a solid fill and a copy between pixmaps.  Meson runs
+ * it against Xvfb with different -fbthreads settings; the label given on
+ * the command line tells the runs apart.
+ *
+ * Run with "meson test --benchmark --suite fbthreads" or against any
+ * server.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#include "tests-common.h"
+
+#define WIDTH 3840
+#define HEIGHT 2160
+#define ROUNDS 20
+
+static xcb_connection_t *c;
+static xcb_render_picture_t src_pict, dst_pict;
+static xcb_pixmap_t src_pixmap, dst_pixmap;
+static xcb_gcontext_t gc;
+
+static void
+sync_server(void)
+{
+    free(xcb_get_input_focus_reply(c, xcb_get_input_focus(c), NULL));
+}
+
+static xcb_render_pictformat_t
+find_format(uint8_t depth, uint16_t alpha_mask)
+{
+    xcb_render_query_pict_formats_reply_t *formats;
+    xcb_render_pictforminfo_iterator_t it;
+    xcb_render_pictformat_t id = 0;
+
+    formats = xcb_render_query_pict_formats_reply(c,
+        xcb_render_query_pict_formats(c), NULL);
+    if (!formats)
+        return 0;
+
+    for (it = xcb_render_query_pict_formats_formats_iterator(formats);
+         it.rem; xcb_render_pictforminfo_next(&it)) {
+        if (it.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            it.data->depth == depth &&
+            it.data->direct.alpha_mask == alpha_mask) {
+            id = it.data->id;
+            break;
+        }
+    }
+    free(formats);
+    return id;
+}
+
+static void
+op_composite(void)
+{
+    xcb_render_composite(c, XCB_RENDER_PICT_OP_OVER, src_pict, XCB_NONE,
+                         dst_pict, 0, 0, 0, 0, 0, 0, WIDTH, HEIGHT);
+}
+
+static void
+op_fill(void)
+{
+    xcb_rectangle_t rect = { 0, 0, WIDTH, HEIGHT };
+
+    xcb_poly_fill_rectangle(c, dst_pixmap, gc, 1, &rect);
+}
+
+static void
+op_copy(void)
+{
+    xcb_copy_area(c, src_pixmap, dst_pixmap, gc, 0, 0, 0, 0, WIDTH, HEIGHT);
+}
+
+/* an op and the round trip that makes sure the server has done it */
+static void
+bench_op_round(int i, void *data)
+{
+    void (**op) (void) = data;
+
+    (*op) ();
+    sync_server();
+}
+
+static void
+bench(const char *label, const char *name, void (*op) (void))
+{
+    uint64_t best;
+
+    /* warm up */
+    op();
+    sync_server();
+
+    best = bench_best(ROUNDS, bench_op_round, &op);
+
+    printf("%-12s %-10s %8.2f ms\n", label, name, best / 1e6);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *label = argc > 1 ? argv[1] : "";
+    xcb_render_color_t color = { 0x4000, 0x8000, 0xc000, 0x8000 };
+    xcb_rectangle_t rect = { 0, 0, WIDTH, HEIGHT };
+    xcb_render_pictformat_t argb32, rgb24;
+    xcb_pixmap_t alpha_pixmap;
+    xcb_screen_t *screen;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    argb32 = find_format(32, 0xff);
+    rgb24 = find_format(24, 0);
+    if (!argb32 || !rgb24) {
+        fprintf(stderr, "No ARGB32 or RGB24 picture format\n");
+        return 77;
+    }
+
+    alpha_pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, alpha_pixmap, screen->root, WIDTH, HEIGHT);
+    src_pict = xcb_generate_id(c);
+    xcb_render_create_picture(c, src_pict, alpha_pixmap, argb32, 0, NULL);
+    /* half transparent, so Over has to blend every pixel */
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, src_pict, color,
+                               1, &rect);
+
+    dst_pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, dst_pixmap, screen->root, WIDTH, HEIGHT);
+    dst_pict = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst_pict, dst_pixmap, rgb24, 0, NULL);
+
+    /* copies need the same depth on both ends */
+    src_pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, src_pixmap, screen->root, WIDTH, HEIGHT);
+
+    gc = xcb_generate_id(c);
+    xcb_create_gc(c, gc, dst_pixmap, XCB_GC_FOREGROUND,
+                  (uint32_t[]) { 0x336699 });
+
+    bench(label, "composite", op_composite);
+    bench(label, "fill", op_fill);
+    bench(label, "copy", op_copy);
+
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "X connection failed\n");
+        return 1;
+    }
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,446 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Glyph hashing and the glyph tables: glyphs with the same bits are shared,
+ * and every glyph stays reachable by id and by hash while the tables grow,
+ * shrink and get rebuilt underneath them.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "os/xsiphash.h"
+#include "render/glyphstr_priv.h"
+
+#include "gcstruct.h"
+#include "picturestr.h"
+#include "pixmapstr.h"
+#include "scrnintstr.h"
+#include "servermd.h"
+
+#include "tests-common.h"
+
+#define NUM_GLYPHS 20000
+#define BATCH 100
+
+static void
+glyph_siphash_test(void)
+{
+    /* from the SipHash reference implementation, key and data 0, 1, 2, ... */
+    static const unsigned char expected[2][16] = {
+        { 0xa3, 0x81, 0x7f, 0x04, 0xba, 0x25, 0xa8, 0xe6,
+          0x6d, 0xf6, 0x72, 0x14, 0xc7, 0x55, 0x02, 0x93 },
+        { 0xda, 0x87, 0xc1, 0xd8, 0x6b, 0x99, 0xaf, 0x44,
+          0x34, 0x76, 0x59, 0x11, 0x9b, 0x22, 0xfc, 0x45 },
+    };
+    unsigned char key[16], data[64], whole[16], split[16];
+    XSipHashRec ctx;
+    size_t len, i;
+
+    for (i = 0; i < sizeof(key); i++)
+        key[i] = i;
+    for (i = 0; i < sizeof(data); i++)
+        data[i] = i;
+
+    for (len = 0; len < ARRAY_SIZE(expected); len++) {
+        x_siphash_init(&ctx, key);
+        x_siphash_update(&ctx, data, len);
+        x_siphash_final(&ctx, whole);
+        assert(memcmp(whole, expected[len], 16) == 0);
+    }
+
+    /* feeding the data in pieces makes no difference */
+    for (len = 0; len <= sizeof(data); len++) {
+        x_siphash_init(&ctx, key);
+        x_siphash_update(&ctx, data, len);
+        x_siphash_final(&ctx, whole);
+
+        x_siphash_init(&ctx, key);
+        for (i = 0; i < len; i += 3)
+            x_siphash_update(&ctx, data + i, len - i < 3 ? len - i : 3);
+        x_siphash_final(&ctx, split);
+        assert(memcmp(whole, split, 16) == 0);
+    }
+}
+
+static void
+glyph_bits(int n, xGlyphInfo *gi, CARD32 *bits)
+{
+    memset(gi, 0, sizeof(*gi));
+    gi->width = 32;
+    gi->height = 1;
+    *bits = n;
+}
+
+static void
+glyph_hash_test(void)
+{
+    unsigned char a[20], b[20];
+    xGlyphInfo gi;
+    CARD32 bits;
+
+    glyph_bits(1, &gi, &bits);
+    assert(HashGlyph(&gi, (CARD8 *) &bits, sizeof(bits), a) == Success);
+    assert(HashGlyph(&gi, (CARD8 *) &bits, sizeof(bits), b) == Success);
+    assert(memcmp(a, b, 20) == 0);
+    assert(!a[16] && !a[17] && !a[18] && !a[19]);
+
+    bits = 2;
+    assert(HashGlyph(&gi, (CARD8 *) &bits, sizeof(bits), b) == Success);
+    assert(memcmp(a, b, 16) != 0);
+
+    /* the metrics are part of the glyph */
+    bits = 1;
+    gi.xOff = 1;
+    assert(HashGlyph(&gi, (CARD8 *) &bits, sizeof(bits), b) == Success);
+    assert(memcmp(a, b, 16) != 0);
+}
+
+/* what ProcRenderAddGlyphs does for each glyph, minus the pictures */
+static GlyphPtr
+get_glyph(int n, int fdepth)
+{
+    unsigned char sha1[20];
+    xGlyphInfo gi;
+    CARD32 bits;
+    GlyphPtr glyph;
+
+    glyph_bits(n, &gi, &bits);
+    assert(HashGlyph(&gi, (CARD8 *) &bits, sizeof(bits), sha1) == Success);
+
+    glyph = FindGlyphByHash(sha1, fdepth);
+    if (glyph) {
+        glyph->refcnt++;
+        return glyph;
+    }
+
+    glyph = AllocateGlyph(&gi, fdepth);
+    assert(glyph);
+    memcpy(glyph->sha1, sha1, 20);
+    AddGlyphByHash(glyph, fdepth);
+    return glyph;
+}
+
+static GlyphPtr
+find_glyph_by_bits(int n, int fdepth)
+{
+    unsigned char sha1[20];
+    xGlyphInfo gi;
+    CARD32 bits;
+
+    glyph_bits(n, &gi, &bits);
+    assert(HashGlyph(&gi, (CARD8 *) &bits, sizeof(bits), sha1) == Success);
+    return FindGlyphByHash(sha1, fdepth);
+}
+
+/* adds glyphs [first, first + count) with ids of their own, in one go */
+static void
+add_glyphs(GlyphSetPtr glyphSet, int first, int count)
+{
+    CARD32 ids[BATCH];
+    GlyphPtr glyphs[BATCH];
+    int i;
+
+    assert(count <= BATCH);
+    assert(ResizeGlyphSet(glyphSet, count));
+    for (i = 0; i < count; i++) {
+        ids[i] = first + i;
+        glyphs[i] = get_glyph(first + i, glyphSet->fdepth);
+    }
+    AddGlyphs(glyphSet, count, ids, glyphs);
+}
+
+static void
+glyph_table_test(void)
+{
+    GlyphSetPtr glyphSet, other;
+    GlyphPtr glyph;
+    CARD32 id;
+    int i;
+
+    glyphSet = AllocateGlyphSet(GlyphFormat8, NULL);
+    assert(glyphSet);
+
+    for (i = 0; i < NUM_GLYPHS; i += BATCH) {
+        add_glyphs(glyphSet, i, BATCH);
+        /* everything added so far, whether moved to a new table yet or not */
+        for (id = 0; id < i + BATCH; id += 7) {
+            glyph = FindGlyph(glyphSet, id);
+            assert(glyph && glyph->refcnt == 1);
+            assert(glyph == find_glyph_by_bits(id, GlyphFormat8));
+        }
+    }
+    assert(glyphSet->hash.tableEntries == NUM_GLYPHS);
+
+    /* the same bits under another id, and in another set, are shared */
+    glyph = FindGlyph(glyphSet, 5);
+    id = NUM_GLYPHS;
+    assert(ResizeGlyphSet(glyphSet, 1));
+    glyph->refcnt++;
+    AddGlyphs(glyphSet, 1, &id, &glyph);
+    assert(glyph->refcnt == 2);
+
+    other = AllocateGlyphSet(GlyphFormat8, NULL);
+    assert(other);
+    add_glyphs(other, 0, BATCH);
+    assert(FindGlyph(other, 5) == glyph && glyph->refcnt == 3);
+
+    /* replacing a glyph drops the set's reference to the old one */
+    id = 5;
+    assert(ResizeGlyphSet(other, 1));
+    glyph = get_glyph(NUM_GLYPHS + 1, GlyphFormat8);
+    AddGlyphs(other, 1, &id, &glyph);
+    assert(FindGlyph(glyphSet, 5)->refcnt == 2);
+
+    FreeGlyphSet(other, 0);
+    assert(FindGlyph(glyphSet, 5)->refcnt == 2);
+    assert(!find_glyph_by_bits(NUM_GLYPHS + 1, GlyphFormat8));
+
+    /* delete every other glyph, the rest has to survive the shuffling */
+    for (id = 0; id < NUM_GLYPHS; id += 2)
+        assert(DeleteGlyph(glyphSet, id));
+    assert(!DeleteGlyph(glyphSet, 0));
+    for (id = 0; id < NUM_GLYPHS; id++) {
+        glyph = FindGlyph(glyphSet, id);
+        if (id % 2 && id != 5) {
+            assert(glyph && glyph->refcnt == 1);
+            assert(glyph == find_glyph_by_bits(id, GlyphFormat8));
+        }
+        else if (id != 5) {
+            assert(!glyph);
+            assert(!find_glyph_by_bits(id, GlyphFormat8));
+        }
+    }
+    assert(FindGlyph(glyphSet, NUM_GLYPHS) == FindGlyph(glyphSet, 5));
+
+    /* and the deleted ones can come back */
+    for (i = 0; i < NUM_GLYPHS; i += BATCH)
+        add_glyphs(glyphSet, i, BATCH);
+    for (id = 0; id < NUM_GLYPHS; id++)
+        assert(FindGlyph(glyphSet, id) == find_glyph_by_bits(id, GlyphFormat8));
+
+    FreeGlyphSet(glyphSet, 0);
+    for (id = 0; id < NUM_GLYPHS; id += 7)
+        assert(!find_glyph_by_bits(id, GlyphFormat8));
+}
+
+/* a screen whose rendering hooks only count how often they are called */
+static int glyphs_calls, composite_calls;
+
+static PixmapPtr
+run_create_pixmap(ScreenPtr pScreen, int width, int height, int depth,
+                  unsigned usage_hint)
+{
+    PixmapPtr pixmap = calloc(1, sizeof(PixmapRec));
+
+    assert(pixmap);
+    pixmap->drawable.type = DRAWABLE_PIXMAP;
+    pixmap->drawable.pScreen = pScreen;
+    pixmap->drawable.width = width;
+    pixmap->drawable.height = height;
+    pixmap->drawable.depth = depth;
+    pixmap->drawable.bitsPerPixel = depth;
+    pixmap->refcnt = 1;
+    return pixmap;
+}
+
+static Bool
+run_destroy_pixmap(PixmapPtr pixmap)
+{
+    if (--pixmap->refcnt == 0)
+        free(pixmap);
+    return TRUE;
+}
+
+static void
+run_validate_gc(GCPtr pGC, unsigned long changes, DrawablePtr pDrawable)
+{
+}
+
+static void
+run_poly_fill_rect(DrawablePtr pDrawable, GCPtr pGC, int nrect,
+                   xRectangle *rects)
+{
+}
+
+static int
+run_create_picture(PicturePtr pPicture)
+{
+    return Success;
+}
+
+static void
+run_picture_noop(PicturePtr pPicture)
+{
+}
+
+static void
+run_picture_mask(PicturePtr pPicture, Mask mask)
+{
+}
+
+static void
+run_composite(CARD8 op, PicturePtr pSrc, PicturePtr pMask, PicturePtr pDst,
+              INT16 xSrc, INT16 ySrc, INT16 xMask, INT16 yMask,
+              INT16 xDst, INT16 yDst, CARD16 width, CARD16 height)
+{
+    composite_calls++;
+}
+
+static void
+run_glyphs(CARD8 op, PicturePtr pSrc, PicturePtr pDst,
+           PictFormatPtr maskFormat, INT16 xSrc, INT16 ySrc,
+           int nlist, GlyphListPtr list, GlyphPtr *glyphs)
+{
+    glyphs_calls++;
+}
+
+static Bool
+run_realize_glyph(ScreenPtr pScreen, GlyphPtr glyph)
+{
+    return TRUE;
+}
+
+static void
+run_unrealize_glyph(ScreenPtr pScreen, GlyphPtr glyph)
+{
+}
+
+static PicturePtr
+run_picture(ScreenPtr pScreen, PictFormatPtr format)
+{
+    PixmapPtr pixmap = run_create_pixmap(pScreen, 64, 64, format->depth, 0);
+    PicturePtr picture;
+    int error;
+
+    picture = CreatePicture(0, &pixmap->drawable, format, 0, NULL,
+                            serverClient, &error);
+    assert(picture);
+    dixDestroyPixmap(pixmap, 0);
+    return picture;
+}
+
+/* Runs drawn with a mask format are remembered the first time, get a mask
+ * the second time and are drawn from it from then on, wherever they go. */
+static void
+glyph_run_cache_test(void)
+{
+    static ScreenRec screen;
+    static PictureScreenRec ps;
+    static GCFuncs gc_funcs = { .ValidateGC = run_validate_gc };
+    static GCOps gc_ops = { .PolyFillRect = run_poly_fill_rect };
+    static struct _GC gc = {
+        .depth = 8, .funcs = &gc_funcs, .ops = &gc_ops,
+    };
+    PictFormatRec a8 = { .type = PictTypeDirect, .depth = 8,
+                         .format = PICT_a8 };
+    PictFormatRec argb = { .type = PictTypeDirect, .depth = 32,
+                           .format = PICT_a8r8g8b8 };
+    GlyphListRec list = { .xOff = 10, .yOff = 20, .len = 3, .format = &a8 };
+    GlyphPtr glyphs[3], swapped[3];
+    GlyphSetPtr glyphSet;
+    PicturePtr src, dst;
+    GlyphRunStats stats;
+    int i;
+
+    dixResetPrivates();
+    assert(dixRegisterPrivateKey(&PictureScreenPrivateKeyRec, PRIVATE_SCREEN,
+                                 0));
+    assert(GlyphInit(&screen));
+    assert(dixAllocatePrivates(&screen.devPrivates, PRIVATE_SCREEN));
+    dixInitScreenSpecificPrivates(&screen);
+    screenInfo.numScreens = 1;
+    screenInfo.screens[0] = &screen;
+
+    PixmapWidthPaddingInfo[8].bitsPerPixel = 8;
+    screen.CreatePixmap = run_create_pixmap;
+    screen.DestroyPixmap = run_destroy_pixmap;
+    screen.GCperDepth[0] = &gc;
+    ps.CreatePicture = run_create_picture;
+    ps.ChangePicture = run_picture_mask;
+    ps.ValidatePicture = run_picture_mask;
+    ps.DestroyPicture = run_picture_noop;
+    ps.DestroyPictureClip = run_picture_noop;
+    ps.Composite = run_composite;
+    ps.Glyphs = run_glyphs;
+    ps.RealizeGlyph = run_realize_glyph;
+    ps.UnrealizeGlyph = run_unrealize_glyph;
+    SetPictureScreen(&screen, &ps);
+
+    src = run_picture(&screen, &argb);
+    dst = run_picture(&screen, &argb);
+    glyphSet = AllocateGlyphSet(GlyphFormat8, NULL);
+    assert(glyphSet);
+    for (i = 0; i < 3; i++)
+        glyphs[i] = get_glyph(i, GlyphFormat8);
+
+    /* without a mask format nothing is cached */
+    CompositeGlyphs(PictOpOver, src, dst, NULL, 0, 0, 1, &list, glyphs);
+    GetGlyphRunStats(&screen, &stats);
+    assert(glyphs_calls == 1);
+    assert(stats.hits == 0 && stats.misses == 0 && stats.runs == 0);
+    assert(stats.bytes == 0);
+
+    /* seen once: drawn glyph by glyph and remembered */
+    CompositeGlyphs(PictOpOver, src, dst, &a8, 0, 0, 1, &list, glyphs);
+    GetGlyphRunStats(&screen, &stats);
+    assert(glyphs_calls == 2 && composite_calls == 0);
+    assert(stats.hits == 0 && stats.misses == 1 && stats.runs == 1);
+
+    /* seen again: the mask is rendered and used */
+    CompositeGlyphs(PictOpOver, src, dst, &a8, 0, 0, 1, &list, glyphs);
+    GetGlyphRunStats(&screen, &stats);
+    assert(glyphs_calls == 2 && composite_calls == 1);
+    assert(stats.hits == 0 && stats.misses == 2 && stats.runs == 1);
+    assert(stats.bytes == 32);
+
+    /* from then on, and elsewhere, it comes from the cache */
+    CompositeGlyphs(PictOpOver, src, dst, &a8, 0, 0, 1, &list, glyphs);
+    list.xOff = 100;
+    list.yOff = -50;
+    CompositeGlyphs(PictOpOver, src, dst, &a8, 0, 0, 1, &list, glyphs);
+    GetGlyphRunStats(&screen, &stats);
+    assert(glyphs_calls == 2 && composite_calls == 3);
+    assert(stats.hits == 2 && stats.misses == 2 && stats.runs == 1);
+
+    /* other glyph orders and mask formats are other runs */
+    swapped[0] = glyphs[1];
+    swapped[1] = glyphs[0];
+    swapped[2] = glyphs[2];
+    CompositeGlyphs(PictOpOver, src, dst, &a8, 0, 0, 1, &list, swapped);
+    CompositeGlyphs(PictOpOver, src, dst, &argb, 0, 0, 1, &list, glyphs);
+    GetGlyphRunStats(&screen, &stats);
+    assert(glyphs_calls == 4 && composite_calls == 3);
+    assert(stats.hits == 2 && stats.misses == 4 && stats.runs == 3);
+    assert(stats.bytes == 32);
+
+    GlyphUninit(&screen);
+    GetGlyphRunStats(&screen, &stats);
+    assert(stats.hits == 0 && stats.misses == 0 && stats.runs == 0);
+    assert(stats.bytes == 0);
+
+    FreeGlyphSet(glyphSet, 0);
+    FreePicture(src, 0);
+    FreePicture(dst, 0);
+}
+
+const testfunc_t*
+glyph_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        glyph_siphash_test,
+        glyph_hash_test,
+        glyph_table_test,
+        glyph_run_cache_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
@@ -1928,6 +1928,66 @@ dix_enqueue_events(void)
     inputInfo.devices = NULL;
 }
 
+/* Event summaries follow selections on a window and its ancestors */
+static void
+dix_event_summary(void)
+{
+    WindowRec root, mid, leaf;
+    WindowOptRec optional;
+    OtherInputMasks inputMasks;
+    InputClients client;
+
+    memset(&root, 0, sizeof(root));
+    memset(&mid, 0, sizeof(mid));
+    memset(&leaf, 0, sizeof(leaf));
+    memset(&optional, 0, sizeof(optional));
+    memset(&inputMasks, 0, sizeof(inputMasks));
+    memset(&client, 0, sizeof(client));
+
+    root.firstChild = root.lastChild = &mid;
+    mid.parent = &root;
+    mid.firstChild = mid.lastChild = &leaf;
+    leaf.parent = &mid;
+
+    root.eventMask = KeyPressMask;
+    leaf.eventMask = PointerMotionMask;
+    RecalculateDeliverableEvents(&root);
+
+    assert(root.selectedEvents.core == KeyPressMask);
+    assert(root.ancestorEvents.core == KeyPressMask);
+    assert(mid.selectedEvents.core == 0);
+    assert(mid.ancestorEvents.core == KeyPressMask);
+    assert(leaf.selectedEvents.core == PointerMotionMask);
+    assert(leaf.ancestorEvents.core == (KeyPressMask | PointerMotionMask));
+    assert(!leaf.ancestorEvents.xi && !leaf.ancestorEvents.xi2);
+
+    /* XI2 selection on the middle window, for a single device */
+    client.xi2mask = xi2mask_new();
+    inputMasks.xi2mask = xi2mask_new();
+    assert(client.xi2mask && inputMasks.xi2mask);
+    xi2mask_set(client.xi2mask, 2, XI_Motion);
+    inputMasks.inputClients = &client;
+    optional.inputMasks = &inputMasks;
+    mid.optional = &optional;
+    RecalculateDeviceDeliverableEvents(&mid);
+
+    assert(!root.ancestorEvents.xi2);
+    assert(mid.selectedEvents.xi2 == (1 << XI_Motion));
+    assert(leaf.ancestorEvents.xi2 == (1 << XI_Motion));
+    assert(!leaf.selectedEvents.xi2);
+
+    /* do-not-propagate makes the window interesting, but selects nothing */
+    optional.dontPropagateMask = ButtonPressMask;
+    RecalculateDeliverableEvents(&mid);
+
+    assert(mid.selectedEvents.core == ButtonPressMask);
+    assert(mid.ancestorEvents.core == KeyPressMask);
+    assert(leaf.ancestorEvents.core == (KeyPressMask | PointerMotionMask));
+
+    xi2mask_free(&inputMasks.xi2mask);
+    xi2mask_free(&client.xi2mask);
+}
+
 const testfunc_t*
 input_test(void)
 {
@@ -1951,6 +2011,7 @@ input_test(void)
         dix_get_master,
         input_option_test,
         mieq_test,
+        dix_event_summary,
         NULL,
     };
 
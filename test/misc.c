@@ -27,9 +27,15 @@
 #include <dix-config.h>
 
 #include <stdint.h>
+#include <X11/Xatom.h>
 
+#include "dix/atom_priv.h"
+#include "dix/dix_priv.h"
 #include "dix/input_priv.h"
+#include "dix/profile_priv.h"
+#include "os/client_priv.h"
 #include "os/fmt.h"
+#include "os/osdep.h"
 
 #include "misc.h"
 #include "scrnintstr.h"
@@ -224,6 +230,239 @@ bswap_test(void)
     assert(result_64 == expect_64);
 }
 
+static void
+dix_atoms(void)
+{
+    const char *names[] = { "FOO", "BAR", "WM_NAME", "FOO" };
+    const unsigned lens[] = { 3, 3, 7, 3 };
+    Atom atoms[ARRAY_SIZE(names)];
+    char name[32];
+    Atom a, first;
+    int i;
+
+    InitAtoms();
+
+    assert(dixGetAtomID("WM_NAME") == XA_WM_NAME);
+    assert(strcmp(NameForAtom(XA_WM_NAME), "WM_NAME") == 0);
+    assert(NameForAtom(None) == NULL);
+    assert(dixGetAtomID("NOT_AN_ATOM") == None);
+
+    /* enough atoms to grow both tables */
+    first = dixAddAtom("ATOM_0");
+    for (i = 1; i < 5000; i++) {
+        snprintf(name, sizeof(name), "ATOM_%d", i);
+        a = dixAddAtom(name);
+        assert(a == first + i);
+        assert(strcmp(NameForAtom(a), name) == 0);
+    }
+    for (i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "ATOM_%d", i);
+        assert(dixGetAtomID(name) == first + i);
+    }
+
+    /* a prefix of an existing name is a different atom */
+    assert(MakeAtom("ATOM_1", 5, FALSE) == None);
+    assert(ValidAtom(first + 4999));
+    assert(!ValidAtom(first + 5000));
+
+    assert(MakeAtoms(names, lens, ARRAY_SIZE(names), FALSE, atoms));
+    assert(atoms[0] == None);
+    assert(atoms[2] == XA_WM_NAME);
+    assert(MakeAtoms(names, lens, ARRAY_SIZE(names), TRUE, atoms));
+    assert(atoms[0] != None);
+    assert(atoms[1] != None && atoms[1] != atoms[0]);
+    assert(atoms[3] == atoms[0]);
+
+    FreeAllAtoms();
+}
+
+static int timer_fired[256];
+
+static CARD32
+count_timer(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    timer_fired[(intptr_t) arg]++;
+    return 0;
+}
+
+static CARD32
+rearm_timer(OsTimerPtr timer, CARD32 now, void *arg)
+{
+    /* fire once more, far in the future */
+    return timer_fired[(intptr_t) arg]++ ? 0 : 1000000;
+}
+
+static void
+os_timers(void)
+{
+    OsTimerPtr timers[ARRAY_SIZE(timer_fired)];
+    Bool pending[ARRAY_SIZE(timer_fired)];
+    unsigned int seed = 42;
+    int i, round;
+
+    for (i = 0; i < ARRAY_SIZE(timers); i++) {
+        timers[i] = TimerSet(NULL, 0, 1000000 + rand_r(&seed) % 1000,
+                             count_timer, (void *) (intptr_t) i);
+        assert(timers[i]);
+        pending[i] = TRUE;
+    }
+
+    /* shuffle the heap around: cancel, re-arm and replace timers */
+    for (round = 0; round < 4096; round++) {
+        i = rand_r(&seed) % ARRAY_SIZE(timers);
+        switch (rand_r(&seed) % 3) {
+        case 0:
+            TimerCancel(timers[i]);
+            pending[i] = FALSE;
+            break;
+        case 1:
+            TimerSet(timers[i], 0, 1000000 + rand_r(&seed) % 1000,
+                     count_timer, (void *) (intptr_t) i);
+            pending[i] = TRUE;
+            break;
+        case 2:
+            TimerFree(timers[i]);
+            timers[i] = TimerSet(NULL, 0, 1000000 + rand_r(&seed) % 1000,
+                                 count_timer, (void *) (intptr_t) i);
+            assert(timers[i]);
+            pending[i] = TRUE;
+            break;
+        }
+    }
+
+    /* every pending timer fires exactly once when forced */
+    for (i = 0; i < ARRAY_SIZE(timers); i++) {
+        assert(TimerForce(timers[i]) == pending[i]);
+        assert(timer_fired[i] == (pending[i] ? 1 : 0));
+        assert(!TimerForce(timers[i]));
+        TimerFree(timers[i]);
+    }
+
+    /* an absolute expiry in the past runs the timer right away */
+    memset(timer_fired, 0, sizeof(timer_fired));
+    timers[0] = TimerSet(NULL, TimerAbsolute, GetTimeInMillis() - 10,
+                         count_timer, (void *) (intptr_t) 0);
+    assert(timer_fired[0] == 1);
+    assert(!TimerForce(timers[0]));
+
+    /* a non-zero return value re-arms the timer */
+    TimerSet(timers[0], 0, 1000000, rearm_timer, (void *) (intptr_t) 1);
+    assert(TimerForce(timers[0]));
+    assert(timer_fired[1] == 1);
+    assert(TimerForce(timers[0]));
+    assert(timer_fired[1] == 2);
+    assert(!TimerForce(timers[0]));
+    TimerFree(timers[0]);
+}
+
+static void
+dix_profile(void)
+{
+    ClientRec client = { .index = 1 };
+    ProfileCountersRec c;
+
+    ProfileToggle();
+    assert(ProfileEnabled);
+
+    assert(ProfileClientOutput(&client) == 0);
+    ProfileOutput(&client, 32);
+
+    /* core requests ignore the minor opcode */
+    client.majorOp = X_InternAtom;
+    client.minorOp = 7;
+    client.req_len = 3;
+    ProfileRequest(&client, 10, 32);
+    client.req_len = 5;
+    ProfileRequest(&client, 30, 0);
+    assert(ProfileGetRequest(X_InternAtom, 0, &c));
+    assert(c.count == 2 && c.time == 40 && c.max_time == 30);
+    assert(c.bytes_in == 32 && c.bytes_out == 32);
+    assert(!ProfileGetRequest(X_GetAtomName, 0, &c));
+
+    client.majorOp = EXTENSION_BASE + 2;
+    client.minorOp = 4;
+    ProfileRequest(&client, 5, 0);
+    assert(ProfileGetRequest(EXTENSION_BASE + 2, 4, &c) && c.count == 1);
+    assert(!ProfileGetRequest(EXTENSION_BASE + 2, 5, &c));
+
+    assert(ProfileGetClient(&client, &c));
+    assert(c.count == 3 && c.time == 45 && c.max_time == 30);
+    assert(ProfileClientOutput(&client) == 32);
+
+    ProfileClientGone(&client);
+    assert(!ProfileGetClient(&client, &c));
+
+    /* dumps to the log and starts over the next time */
+    ProfileToggle();
+    assert(!ProfileEnabled);
+    ProfileToggle();
+    assert(!ProfileGetRequest(X_InternAtom, 0, &c));
+    ProfileToggle();
+}
+
+static void
+os_input_pool(void)
+{
+    OsCommRec oc[2] = { { .fd = -1 }, { .fd = -1 } };
+    ClientRec client[2] = {
+        { .index = 1, .osPrivate = &oc[0] },
+        { .index = 2, .osPrivate = &oc[1] },
+    };
+    /* claims more than is inserted, so the clients never become ready */
+    xReq req = { .reqType = X_NoOperation, .length = 0xffff };
+    unsigned long cap = InputPoolCap, held;
+    InputPoolStats stats;
+    char *big;
+
+    ResetOsBuffers();
+    ResetInputPoolStats();
+    GetInputPoolStats(&stats);
+    assert(stats.hits == 0 && stats.misses == 0 && stats.held == 0);
+    assert(stats.cap == InputPoolCap);
+
+    /* an empty pool allocates, a freed buffer is kept and handed out again */
+    assert(InsertFakeRequest(&client[0], (char *) &req, sizeof(req)));
+    GetInputPoolStats(&stats);
+    assert(stats.hits == 0 && stats.misses == 1 && stats.held == 0);
+
+    FreeOsBuffers(&oc[0]);
+    oc[0].input = NULL;
+    GetInputPoolStats(&stats);
+    assert(stats.held > 0);
+    held = stats.held;
+
+    assert(InsertFakeRequest(&client[1], (char *) &req, sizeof(req)));
+    GetInputPoolStats(&stats);
+    assert(stats.hits == 1 && stats.misses == 1 && stats.held == 0);
+
+    /* growing for a big request takes a bigger class and pools the old one */
+    big = calloc(1, 2 * held);
+    assert(big);
+    memcpy(big, &req, sizeof(req));
+    assert(InsertFakeRequest(&client[1], big, 2 * held));
+    free(big);
+    GetInputPoolStats(&stats);
+    assert(stats.hits == 1 && stats.misses == 2 && stats.held == held);
+
+    /* nothing is kept beyond the cap */
+    InputPoolCap = held;
+    FreeOsBuffers(&oc[1]);
+    oc[1].input = NULL;
+    GetInputPoolStats(&stats);
+    assert(stats.held == held && stats.cap == held);
+    InputPoolCap = cap;
+
+    /* the screen saver empties the pool, the counters go on */
+    ResetOsBuffers();
+    GetInputPoolStats(&stats);
+    assert(stats.hits == 1 && stats.misses == 2 && stats.held == 0);
+
+    /* until the end of the server generation */
+    ResetInputPoolStats();
+    GetInputPoolStats(&stats);
+    assert(stats.hits == 0 && stats.misses == 0 && stats.held == 0);
+}
+
 const testfunc_t*
 misc_test(void)
 {
@@ -232,6 +471,10 @@ misc_test(void)
         dix_update_desktop_dimensions,
         dix_request_size_checks,
         bswap_test,
+        dix_atoms,
+        os_timers,
+        dix_profile,
+        os_input_pool,
         NULL,
     };
     return testfuncs;
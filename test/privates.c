@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Objects with privates allocated from the slab caches must come out
+ * zeroed and must not overlap, however allocations and frees interleave.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "dix/privates_priv.h"
+
+#include "gcstruct.h"
+#include "privates.h"
+
+#include "tests-common.h"
+
+#define NUM_OBJECTS 500
+#define PRIVATE_SIZE 40
+
+static DevPrivateKeyRec gc_key;
+
+static Bool
+object_is_zero(const char *p, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++)
+        if (p[i])
+            return FALSE;
+    return TRUE;
+}
+
+static GCPtr
+alloc_gc(int tag)
+{
+    GCPtr pGC = dixAllocateScreenObjectWithPrivates(NULL, GCRec, PRIVATE_GC);
+    char *priv;
+
+    assert(pGC);
+    priv = dixGetPrivateAddr(&pGC->devPrivates, &gc_key);
+    assert(object_is_zero((char *) pGC, offsetof(GCRec, devPrivates)));
+    assert(object_is_zero(priv, PRIVATE_SIZE));
+
+    memset(pGC, tag, offsetof(GCRec, devPrivates));
+    memset(priv, tag, PRIVATE_SIZE);
+    return pGC;
+}
+
+static void
+check_gc(GCPtr pGC, int tag)
+{
+    char *priv = dixGetPrivateAddr(&pGC->devPrivates, &gc_key);
+    size_t i;
+
+    for (i = 0; i < offsetof(GCRec, devPrivates); i++)
+        assert(((unsigned char *) pGC)[i] == (unsigned char) tag);
+    for (i = 0; i < PRIVATE_SIZE; i++)
+        assert(((unsigned char *) priv)[i] == (unsigned char) tag);
+}
+
+static void
+privates_slab_test(void)
+{
+    GCPtr gcs[NUM_OBJECTS];
+    int i, round;
+
+    assert(dixRegisterPrivateKey(&gc_key, PRIVATE_GC, PRIVATE_SIZE));
+    assert(!dixPrivatesCreated(PRIVATE_GC));
+
+    for (i = 0; i < NUM_OBJECTS; i++)
+        gcs[i] = alloc_gc(i);
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        check_gc(gcs[i], i);
+        assert(((uintptr_t) gcs[i] & (sizeof(void *) - 1)) == 0);
+    }
+
+    /* free and reallocate in random order, nothing may get clobbered */
+    srandom(0x51ab);
+    for (round = 0; round < 20000; round++) {
+        i = random() % NUM_OBJECTS;
+        if (gcs[i]) {
+            check_gc(gcs[i], i);
+            dixFreeObjectWithPrivates(gcs[i], PRIVATE_GC);
+            gcs[i] = NULL;
+        }
+        else
+            gcs[i] = alloc_gc(i);
+    }
+
+    for (i = 0; i < NUM_OBJECTS; i++) {
+        if (gcs[i]) {
+            check_gc(gcs[i], i);
+            dixFreeObjectWithPrivates(gcs[i], PRIVATE_GC);
+        }
+    }
+    assert(!dixPrivatesCreated(PRIVATE_GC));
+}
+
+static void
+privates_large_object_test(void)
+{
+    size_t sizes[] = { 1, 100, 2000, 3000, 100000 };
+    void *objects[ARRAY_SIZE(sizes)];
+    size_t i;
+
+    /* too big for a slab, or an odd size on its own */
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        objects[i] = dixAllocateObject(PRIVATE_PIXMAP, sizes[i]);
+        assert(objects[i]);
+        assert(object_is_zero(objects[i], sizes[i]));
+        memset(objects[i], 0xff, sizes[i]);
+    }
+    for (i = 0; i < ARRAY_SIZE(sizes); i++)
+        dixFreeObject(objects[i], PRIVATE_PIXMAP);
+}
+
+const testfunc_t*
+privates_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        privates_slab_test,
+        privates_large_object_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Windows with many properties look them up through an index, which has
+ * to follow every property added and deleted, up past the threshold, back
+ * down below it and up again.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+#include <X11/Xatom.h>
+
+#include "dix/property_priv.h"
+
+#include "dixstruct.h"
+#include "propertyst.h"
+#include "scrnintstr.h"
+#include "windowstr.h"
+
+#include "tests-common.h"
+
+#define NAMES (PROPERTY_INDEX_THRESHOLD * 20)
+
+static ScreenRec screen;
+static WindowOptRec optional;
+static WindowRec window;
+static ClientRec client;
+
+/* the value of each property, 0 if the window doesn't have it */
+static CARD32 values[NAMES + 1];
+
+static void
+property_set(Atom name, CARD32 value)
+{
+    assert(dixChangeWindowProperty(&client, &window, name, XA_INTEGER, 32,
+                                   PropModeReplace, 1, &value,
+                                   FALSE) == Success);
+    values[name] = value;
+}
+
+static void
+property_delete(Atom name)
+{
+    assert(DeleteProperty(&client, &window, name) == Success);
+    values[name] = 0;
+}
+
+static void
+assert_properties(void)
+{
+    PropertyPtr pProp;
+    int count = 0, listed = 0;
+    Atom name;
+
+    for (name = 1; name <= NAMES; name++) {
+        int rc = dixLookupProperty(&pProp, &window, name, &client,
+                                   DixReadAccess);
+
+        if (values[name]) {
+            assert(rc == Success);
+            assert(pProp->propertyName == name);
+            assert(*(CARD32 *) pProp->data == values[name]);
+            count++;
+        }
+        else
+            assert(rc == BadMatch && !pProp);
+    }
+
+    for (pProp = window.properties; pProp; pProp = pProp->next)
+        listed++;
+    assert(listed == count);
+    assert(!window.propertyIndex == (count < PROPERTY_INDEX_THRESHOLD));
+}
+
+static void
+property_window(void)
+{
+    window.drawable.pScreen = &screen;
+    window.optional = &optional;
+}
+
+static void
+property_threshold_test(void)
+{
+    CARD32 serial = 0;
+    int name, round;
+
+    property_window();
+
+    for (round = 0; round < 3; round++) {
+        /* up past the threshold, one at a time */
+        for (name = 1; name <= PROPERTY_INDEX_THRESHOLD * 3; name++) {
+            property_set(name, ++serial);
+            assert_properties();
+        }
+
+        /* replacing values keeps them indexed */
+        for (name = 1; name <= PROPERTY_INDEX_THRESHOLD * 3; name += 5) {
+            property_set(name, ++serial);
+            assert_properties();
+        }
+
+        /* every other one, then the rest down to none */
+        for (name = 2; name <= PROPERTY_INDEX_THRESHOLD * 3; name += 2) {
+            property_delete(name);
+            assert_properties();
+        }
+        for (name = PROPERTY_INDEX_THRESHOLD * 3 - 1; name >= 1; name -= 2) {
+            property_delete(name);
+            assert_properties();
+        }
+        assert(!window.properties);
+    }
+
+    /* back and forth across the threshold */
+    for (name = 1; name < PROPERTY_INDEX_THRESHOLD; name++)
+        property_set(name, ++serial);
+    for (round = 0; round < 10; round++) {
+        property_set(PROPERTY_INDEX_THRESHOLD, ++serial);
+        assert_properties();
+        assert(window.propertyIndex);
+        property_delete(round % 2 ? 1 : PROPERTY_INDEX_THRESHOLD);
+        assert_properties();
+        assert(!window.propertyIndex);
+        if (round % 2)
+            property_set(1, ++serial);
+    }
+
+    DeleteAllWindowProperties(&window);
+    assert(!window.properties && !window.propertyIndex);
+}
+
+static void
+property_churn_test(void)
+{
+    CARD32 serial = 0;
+    int i;
+
+    property_window();
+
+    for (i = 0; i < 20000; i++) {
+        /* grow to many properties, shrink to few, and again */
+        Bool grow = i / 1000 % 2 == 0;
+        Atom name = random() % NAMES + 1;
+
+        if (grow && random() % 4)
+            property_set(name, ++serial);
+        else
+            property_delete(name);
+        if (i % 100 == 0)
+            assert_properties();
+    }
+    assert_properties();
+
+    DeleteAllWindowProperties(&window);
+    assert(!window.properties && !window.propertyIndex);
+    memset(values, 0, sizeof(values));
+    assert_properties();
+}
+
+const testfunc_t*
+property_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        property_threshold_test,
+        property_churn_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
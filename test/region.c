@@ -0,0 +1,212 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * RegionValidate() with the accelerated kernels must produce exactly what
+ * the reference code produces, box for box.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "dix/region_priv.h"
+
+#include "regionstr.h"
+#include "gc.h"
+
+#include "tests-common.h"
+
+#define FUZZ_ROUNDS 1000
+#define FUZZ_MAX_RECTS 600
+
+static void
+region_assert_identical(RegionPtr a, RegionPtr b)
+{
+    assert(!RegionNar(a) && !RegionNar(b));
+    assert(memcmp(&a->extents, &b->extents, sizeof(BoxRec)) == 0);
+    assert(RegionNumRects(a) == RegionNumRects(b));
+    assert(memcmp(RegionRects(a), RegionRects(b),
+                  RegionNumRects(a) * sizeof(BoxRec)) == 0);
+}
+
+/* Build an unvalidated region out of rects and validate it */
+static void
+region_validate(RegionPtr reg, xRectangle *rects, int nrects, Bool *overlap)
+{
+    int i;
+
+    RegionNull(reg);
+    for (i = 0; i < nrects; i++) {
+        BoxRec box = {
+            rects[i].x, rects[i].y,
+            rects[i].x + rects[i].width, rects[i].y + rects[i].height
+        };
+        RegionRec tmp;
+
+        RegionInit(&tmp, &box, 1);
+        assert(RegionAppend(reg, &tmp));
+        RegionUninit(&tmp);
+    }
+    assert(RegionValidate(reg, overlap));
+}
+
+static void
+random_rects(xRectangle *rects, int nrects, int round)
+{
+    int i, grid, range;
+
+    /* small grids give many identical edges and lots of coalescing */
+    switch (round % 3) {
+    case 0:
+        grid = 8;
+        range = 16;
+        break;
+    case 1:
+        grid = 1;
+        range = 256;
+        break;
+    default:
+        grid = 1;
+        range = 20000;
+        break;
+    }
+
+    for (i = 0; i < nrects; i++) {
+        rects[i].x = (random() % range) * grid - (round & 4 ? range : 0);
+        rects[i].y = (random() % range) * grid - (round & 8 ? range : 0);
+        rects[i].width = (random() % (range / 2) + 1) * grid;
+        rects[i].height = (random() % (range / 2) + 1) * grid;
+    }
+}
+
+static void
+region_validate_fuzz_test(void)
+{
+    xRectangle *rects = calloc(FUZZ_MAX_RECTS, sizeof(xRectangle));
+    KernelLevel best, kernels;
+    int round;
+
+    assert(rects);
+    best = RegionSelectKernels(KERNELS_BEST);
+    srandom(0x5eed);
+
+    for (round = 0; round < FUZZ_ROUNDS; round++) {
+        int nrects = random() % FUZZ_MAX_RECTS + 1;
+        RegionRec ref, reg, oracle;
+        Bool ref_overlap, overlap;
+        int i;
+
+        random_rects(rects, nrects, round);
+
+        RegionSelectKernels(KERNELS_REFERENCE);
+        region_validate(&ref, rects, nrects, &ref_overlap);
+
+        /* the reference agrees with pixman */
+        RegionNull(&oracle);
+        for (i = 0; i < nrects; i++) {
+            RegionRec tmp;
+            BoxRec box = {
+                rects[i].x, rects[i].y,
+                rects[i].x + rects[i].width, rects[i].y + rects[i].height
+            };
+
+            RegionInit(&tmp, &box, 1);
+            assert(RegionUnion(&oracle, &oracle, &tmp));
+            RegionUninit(&tmp);
+        }
+        assert(RegionEqual(&ref, &oracle));
+        RegionUninit(&oracle);
+
+        for (kernels = KERNELS_SCALAR; kernels <= best; kernels++) {
+            assert(RegionSelectKernels(kernels) == kernels);
+            region_validate(&reg, rects, nrects, &overlap);
+            region_assert_identical(&ref, &reg);
+            assert(overlap == ref_overlap);
+            RegionUninit(&reg);
+        }
+        RegionUninit(&ref);
+    }
+
+    RegionSelectKernels(KERNELS_BEST);
+    free(rects);
+}
+
+/*
+ * Stacked rows of a comb, each row differing from the one above it in the
+ * left edge or the high byte of the right edge of a single tooth, so that
+ * every lane of the vector compares has to catch the difference.
+ */
+static void
+region_coalesce_test(void)
+{
+    enum { TEETH = 37, ROWS = 4 * TEETH };
+    xRectangle rects[ROWS * TEETH];
+    KernelLevel best, kernels;
+    RegionRec ref, reg;
+    Bool overlap;
+    int row, i, n = 0;
+
+    for (row = 0; row < ROWS; row++) {
+        for (i = 0; i < TEETH; i++) {
+            rects[n].x = i * 300;
+            rects[n].y = row * 4;
+            rects[n].width = 5;
+            if (row % 4 == 1 && i == row / 4) {
+                rects[n].x--;
+                rects[n].width++;
+            }
+            if (row % 4 == 3 && i == row / 4)
+                rects[n].width += 256;
+            rects[n].height = 4;
+            n++;
+        }
+    }
+
+    best = RegionSelectKernels(KERNELS_BEST);
+
+    RegionSelectKernels(KERNELS_REFERENCE);
+    region_validate(&ref, rects, n, &overlap);
+    assert(!overlap);
+    /* no two adjacent rows may be coalesced */
+    assert(RegionNumRects(&ref) == n);
+
+    for (kernels = KERNELS_SCALAR; kernels <= best; kernels++) {
+        RegionSelectKernels(kernels);
+        region_validate(&reg, rects, n, &overlap);
+        region_assert_identical(&ref, &reg);
+        RegionUninit(&reg);
+    }
+    RegionUninit(&ref);
+
+    /* identical rows collapse into a single band */
+    for (i = 0; i < n; i++) {
+        rects[i].x = (i % TEETH) * 300;
+        rects[i].width = 5;
+    }
+    for (kernels = KERNELS_REFERENCE; kernels <= best; kernels++) {
+        RegionSelectKernels(kernels);
+        region_validate(&reg, rects, n, &overlap);
+        assert(RegionNumRects(&reg) == TEETH);
+        assert(reg.extents.y1 == 0 && reg.extents.y2 == ROWS * 4);
+        RegionUninit(&reg);
+    }
+
+    RegionSelectKernels(KERNELS_BEST);
+}
+
+const testfunc_t*
+region_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        region_validate_fuzz_test,
+        region_coalesce_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
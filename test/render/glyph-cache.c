@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Text runs drawn through a mask are cached by the server: drawing the same
+ * run again, at the same or another place, must give the same pixels as the
+ * first time, and changing a glyph in the set must show up the next time
+ * the run is drawn.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define WIDTH 32
+#define HEIGHT 16
+#define GLYPH 4
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_render_pictformat_t a8, rgb24;
+static xcb_pixmap_t dst_pixmap;
+static xcb_render_picture_t src, dst;
+static xcb_render_glyphset_t glyphset;
+
+static xcb_render_pictformat_t
+find_format(uint8_t depth, uint16_t alpha_mask)
+{
+    xcb_render_query_pict_formats_reply_t *formats;
+    xcb_render_pictforminfo_iterator_t it;
+    xcb_render_pictformat_t id = 0;
+
+    formats = xcb_render_query_pict_formats_reply(c,
+        xcb_render_query_pict_formats(c), NULL);
+    if (!formats)
+        return 0;
+
+    for (it = xcb_render_query_pict_formats_formats_iterator(formats);
+         it.rem; xcb_render_pictforminfo_next(&it)) {
+        if (it.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            it.data->depth == depth &&
+            it.data->direct.alpha_mask == alpha_mask) {
+            id = it.data->id;
+            break;
+        }
+    }
+    free(formats);
+    return id;
+}
+
+/* a GLYPH x GLYPH square of one alpha value, advancing by its width */
+static void
+add_glyph(uint32_t id, uint8_t alpha)
+{
+    xcb_render_glyphinfo_t info = {
+        .width = GLYPH, .height = GLYPH, .x = 0, .y = GLYPH,
+        .x_off = GLYPH, .y_off = 0,
+    };
+    uint8_t bits[GLYPH * GLYPH];
+
+    memset(bits, alpha, sizeof(bits));
+    xcb_render_add_glyphs(c, glyphset, 1, &id, &info, sizeof(bits), bits);
+}
+
+/* draws glyphs 1, 2, 1 with their baseline at x, y */
+static void
+draw_run(int x, int y)
+{
+    xcb_render_color_t black = { 0, 0, 0, 0xffff };
+    xcb_rectangle_t rect = { 0, 0, WIDTH, HEIGHT };
+    struct {
+        uint8_t len, pad[3];
+        int16_t dx, dy;
+        uint8_t glyphs[4];
+    } cmd = { 3, { 0 }, x, y, { 1, 2, 1, 0 } };
+
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, dst, black,
+                               1, &rect);
+    xcb_render_composite_glyphs_8(c, XCB_RENDER_PICT_OP_OVER, src, dst, a8,
+                                  glyphset, 0, 0, sizeof(cmd),
+                                  (uint8_t *) &cmd);
+}
+
+static void
+get_pixels(uint32_t *pixels)
+{
+    xcb_get_image_reply_t *reply;
+
+    reply = xcb_get_image_reply(c,
+        xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pixmap, 0, 0,
+                      WIDTH, HEIGHT, ~0), NULL);
+    assert(reply);
+    assert(xcb_get_image_data_length(reply) == WIDTH * HEIGHT * 4);
+    memcpy(pixels, xcb_get_image_data(reply), WIDTH * HEIGHT * 4);
+    free(reply);
+}
+
+static uint32_t
+pixel(const uint32_t *pixels, int x, int y)
+{
+    return pixels[y * WIDTH + x] & 0xffffff;
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_render_color_t white = { 0xffff, 0xffff, 0xffff, 0xffff };
+    static uint32_t first[WIDTH * HEIGHT], again[WIDTH * HEIGHT];
+    int i, x;
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    a8 = find_format(8, 0xff);
+    rgb24 = find_format(24, 0);
+    if (!a8 || !rgb24) {
+        fprintf(stderr, "No A8 or RGB24 picture format\n");
+        return 77;
+    }
+
+    src = xcb_generate_id(c);
+    xcb_render_create_solid_fill(c, src, white);
+
+    dst_pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, dst_pixmap, screen->root, WIDTH, HEIGHT);
+    dst = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst, dst_pixmap, rgb24, 0, NULL);
+
+    glyphset = xcb_generate_id(c);
+    xcb_render_create_glyph_set(c, glyphset, a8);
+    add_glyph(1, 0xff);
+    add_glyph(2, 0x80);
+
+    draw_run(2, 8);
+    get_pixels(first);
+    assert(pixel(first, 2, 4) == 0xffffff);
+    assert(pixel(first, 6, 4) != 0xffffff && pixel(first, 6, 4) != 0);
+    assert(pixel(first, 10, 4) == 0xffffff);
+    assert(pixel(first, 14, 4) == 0);
+
+    /* seen before, then drawn from the cached mask */
+    for (i = 0; i < 3; i++) {
+        draw_run(2, 8);
+        get_pixels(again);
+        assert(memcmp(first, again, sizeof(first)) == 0);
+    }
+
+    /* the same run elsewhere */
+    draw_run(10, 12);
+    get_pixels(again);
+    for (x = 0; x < 12; x++)
+        assert(pixel(again, x + 8, 8) == pixel(first, x, 4));
+    assert(pixel(again, 2, 4) == 0);
+
+    /* replacing a glyph changes the run */
+    add_glyph(1, 0);
+    draw_run(2, 8);
+    get_pixels(again);
+    assert(pixel(again, 2, 4) == 0);
+    assert(pixel(again, 6, 4) == pixel(first, 6, 4));
+    assert(pixel(again, 10, 4) == 0);
+
+    /* and back */
+    add_glyph(1, 0xff);
+    draw_run(2, 8);
+    get_pixels(again);
+    assert(memcmp(first, again, sizeof(first)) == 0);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Pictures that are changed between composites must be rendered with their
+ * new attributes: repeat, clip, transform and filter changes all have to
+ * show up in the next composite, however often the pictures were used
+ * before.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <xcb/xcb.h>
+#include <xcb/render.h>
+
+#define SIZE 16
+
+#define RED   0xff0000
+#define BLUE  0x0000ff
+
+static xcb_connection_t *c;
+static xcb_screen_t *screen;
+static xcb_render_pictformat_t argb32, rgb24;
+static xcb_pixmap_t dst_pixmap;
+static xcb_render_picture_t src, dst;
+
+static xcb_render_pictformat_t
+find_format(uint8_t depth, uint16_t alpha_mask)
+{
+    xcb_render_query_pict_formats_reply_t *formats;
+    xcb_render_pictforminfo_iterator_t it;
+    xcb_render_pictformat_t id = 0;
+
+    formats = xcb_render_query_pict_formats_reply(c,
+        xcb_render_query_pict_formats(c), NULL);
+    if (!formats)
+        return 0;
+
+    for (it = xcb_render_query_pict_formats_formats_iterator(formats);
+         it.rem; xcb_render_pictforminfo_next(&it)) {
+        if (it.data->type == XCB_RENDER_PICT_TYPE_DIRECT &&
+            it.data->depth == depth &&
+            it.data->direct.alpha_mask == alpha_mask) {
+            id = it.data->id;
+            break;
+        }
+    }
+    free(formats);
+    return id;
+}
+
+static void
+fill(xcb_render_picture_t pict, uint32_t rgb, int x, int y, int w, int h)
+{
+    xcb_render_color_t color = {
+        .red = ((rgb >> 16) & 0xff) * 0x101,
+        .green = ((rgb >> 8) & 0xff) * 0x101,
+        .blue = (rgb & 0xff) * 0x101,
+        .alpha = 0xffff,
+    };
+    xcb_rectangle_t rect = { x, y, w, h };
+
+    xcb_render_fill_rectangles(c, XCB_RENDER_PICT_OP_SRC, pict, color,
+                               1, &rect);
+}
+
+static uint32_t
+get_pixel(int x, int y)
+{
+    xcb_get_image_reply_t *reply;
+    uint32_t pixel;
+
+    reply = xcb_get_image_reply(c,
+        xcb_get_image(c, XCB_IMAGE_FORMAT_Z_PIXMAP, dst_pixmap, x, y, 1, 1,
+                      ~0), NULL);
+    assert(reply);
+    assert(xcb_get_image_data_length(reply) >= 4);
+    memcpy(&pixel, xcb_get_image_data(reply), 4);
+    free(reply);
+    return pixel & 0xffffff;
+}
+
+static void
+composite(void)
+{
+    fill(dst, 0, 0, 0, SIZE, SIZE);
+    xcb_render_composite(c, XCB_RENDER_PICT_OP_SRC, src, XCB_NONE, dst,
+                         0, 0, 0, 0, 0, 0, SIZE, SIZE);
+}
+
+static void
+set_transform(int dx)
+{
+    xcb_render_transform_t transform = {
+        1 << 16, 0, dx << 16,
+        0, 1 << 16, 0,
+        0, 0, 1 << 16,
+    };
+
+    xcb_render_set_picture_transform(c, src, transform);
+}
+
+int
+main(int argc, char **argv)
+{
+    xcb_pixmap_t src_pixmap;
+    xcb_rectangle_t clip = { 0, 0, 4, 4 };
+    uint32_t value;
+    /* a 3x1 box blur */
+    xcb_render_fixed_t kernel[] = { 3 << 16, 1 << 16,
+                                    0x5555, 0x5555, 0x5555 };
+
+    c = xcb_connect(NULL, NULL);
+    if (xcb_connection_has_error(c)) {
+        fprintf(stderr, "Failed to connect to the X server\n");
+        return 1;
+    }
+    screen = xcb_setup_roots_iterator(xcb_get_setup(c)).data;
+
+    argb32 = find_format(32, 0xff);
+    rgb24 = find_format(24, 0);
+    if (!argb32 || !rgb24) {
+        fprintf(stderr, "No ARGB32 or RGB24 picture format\n");
+        return 77;
+    }
+
+    /* a 4x4 source, red on the left and blue on the right */
+    src_pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 32, src_pixmap, screen->root, 4, 4);
+    src = xcb_generate_id(c);
+    xcb_render_create_picture(c, src, src_pixmap, argb32, 0, NULL);
+    fill(src, RED, 0, 0, 2, 4);
+    fill(src, BLUE, 2, 0, 2, 4);
+
+    dst_pixmap = xcb_generate_id(c);
+    xcb_create_pixmap(c, 24, dst_pixmap, screen->root, SIZE, SIZE);
+    dst = xcb_generate_id(c);
+    xcb_render_create_picture(c, dst, dst_pixmap, rgb24, 0, NULL);
+
+    composite();
+    composite();
+    assert(get_pixel(0, 0) == RED);
+    assert(get_pixel(3, 0) == BLUE);
+    assert(get_pixel(4, 0) == 0);
+
+    /* repeat on the source */
+    value = XCB_RENDER_REPEAT_NORMAL;
+    xcb_render_change_picture(c, src, XCB_RENDER_CP_REPEAT, &value);
+    composite();
+    assert(get_pixel(4, 0) == RED);
+    assert(get_pixel(15, 15) == BLUE);
+
+    /* transform on the source */
+    set_transform(2);
+    composite();
+    assert(get_pixel(0, 0) == BLUE);
+    assert(get_pixel(2, 0) == RED);
+    set_transform(0);
+    composite();
+    assert(get_pixel(0, 0) == RED);
+
+    /* filter on the source: the blur mixes red and blue at the edge */
+    xcb_render_set_picture_filter(c, src, strlen("convolution"),
+                                  "convolution", 5, kernel);
+    composite();
+    assert(get_pixel(1, 0) != RED && get_pixel(1, 0) != BLUE);
+    xcb_render_set_picture_filter(c, src, strlen("nearest"), "nearest",
+                                  0, NULL);
+    composite();
+    assert(get_pixel(1, 0) == RED);
+
+    /* clip on the destination; the fill in composite() is clipped too */
+    xcb_render_set_picture_clip_rectangles(c, dst, 0, 0, 1, &clip);
+    fill(src, BLUE, 0, 0, 4, 4);
+    composite();
+    assert(get_pixel(0, 0) == BLUE);
+    assert(get_pixel(4, 0) == RED);
+    assert(get_pixel(15, 15) == BLUE);
+    assert(get_pixel(8, 0) == RED);
+
+    value = XCB_NONE;
+    xcb_render_change_picture(c, dst, XCB_RENDER_CP_CLIP_MASK, &value);
+    composite();
+    assert(get_pixel(8, 0) == BLUE);
+
+    assert(!xcb_connection_has_error(c));
+    xcb_disconnect(c);
+    return 0;
+}
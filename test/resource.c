@@ -0,0 +1,239 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <stdint.h>
+
+#include "dix/dix_priv.h"
+#include "dix/resource_priv.h"
+
+#include "misc.h"
+#include "resource.h"
+#include "dixstruct.h"
+#include "tests-common.h"
+
+#define FIRST_ID 0x100
+
+static int deleted;
+static XID delete_order[8];
+
+static int
+delete_resource(void *value, XID id)
+{
+    if (deleted < ARRAY_SIZE(delete_order))
+        delete_order[deleted] = (XID) (uintptr_t) value;
+    deleted++;
+    return Success;
+}
+
+static void
+count_resource(void *value, XID id, void *cdata)
+{
+    int *count = cdata;
+
+    assert((XID) (uintptr_t) value == id);
+    (*count)++;
+}
+
+static void
+resource_init(void)
+{
+    static ClientRec server_client;
+
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    if (!InitClientResources(serverClient))
+        FatalError("couldn't init server resources");
+    deleted = 0;
+}
+
+static void *
+lookup(XID id, RESTYPE type)
+{
+    void *value;
+
+    if (dixLookupResourceByType(&value, id, type, NULL,
+                                DixReadAccess) != Success)
+        return NULL;
+    return value;
+}
+
+/* Add, look up and free enough resources to grow the table several
+ * times, with frees interleaved so migration sees deleted slots. */
+static void
+resource_add_lookup_free(void)
+{
+    RESTYPE type;
+    XID id;
+    const int count = 20000;
+    int found = 0;
+
+    resource_init();
+    type = CreateNewResourceType(delete_resource, "TestType");
+    assert(type);
+
+    for (id = FIRST_ID; id < FIRST_ID + count; id++) {
+        assert(AddResource(id, type, (void *) (uintptr_t) id));
+        if (id % 3 == 0)
+            FreeResource(id - 1, X11_RESTYPE_NONE);
+    }
+
+    for (id = FIRST_ID; id < FIRST_ID + count; id++) {
+        void *value = lookup(id, type);
+
+        if ((id + 1) % 3 == 0 && id + 1 < FIRST_ID + count)
+            assert(value == NULL);
+        else
+            assert(value == (void *) (uintptr_t) id);
+    }
+
+    FindClientResourcesByType(serverClient, type, count_resource, &found);
+    assert(found == count - deleted);
+
+    assert(lookup(FIRST_ID + count, type) == NULL);
+    assert(ChangeResourceValue(FIRST_ID, type, (void *) 0x1));
+    assert(lookup(FIRST_ID, type) == (void *) 0x1);
+    FreeResourceByType(FIRST_ID, type, TRUE);
+    assert(lookup(FIRST_ID, type) == NULL);
+}
+
+/* Resources sharing an id are freed most recently added first. */
+static void
+resource_same_id_order(void)
+{
+    RESTYPE a, b, c;
+    void *value;
+
+    resource_init();
+    a = CreateNewResourceType(delete_resource, "TestA");
+    b = CreateNewResourceType(delete_resource, "TestB");
+    c = CreateNewResourceType(delete_resource, "TestC");
+
+    assert(AddResource(FIRST_ID, a, (void *) 1));
+    assert(AddResource(FIRST_ID, b, (void *) 2));
+    assert(AddResource(FIRST_ID, c, (void *) 3));
+
+    assert(lookup(FIRST_ID, b) == (void *) 2);
+    assert(dixLookupResourceByClass(&value, FIRST_ID, RC_ANY, NULL,
+                                    DixReadAccess) == Success);
+    assert(value == (void *) 3);
+
+    FreeResource(FIRST_ID, X11_RESTYPE_NONE);
+    assert(deleted == 3);
+    assert(delete_order[0] == 3);
+    assert(delete_order[1] == 2);
+    assert(delete_order[2] == 1);
+    assert(lookup(FIRST_ID, a) == NULL);
+}
+
+static void
+resource_free_client(void)
+{
+    RESTYPE type;
+    XID id;
+
+    resource_init();
+    type = CreateNewResourceType(delete_resource, "TestType");
+
+    for (id = FIRST_ID; id < FIRST_ID + 1000; id++)
+        assert(AddResource(id, type, (void *) (uintptr_t) id));
+
+    FreeClientResources(serverClient);
+    assert(deleted == 1000);
+}
+
+struct walk_adder {
+    RESTYPE type;
+    XID next, end;
+};
+
+/* adds a batch of resources every time it is called */
+static void
+add_while_walking(void *value, XID id, void *cdata)
+{
+    struct walk_adder *adder = cdata;
+    int i;
+
+    for (i = 0; i < 100 && adder->next < adder->end; i++, adder->next++)
+        assert(AddResource(adder->next, adder->type,
+                           (void *) (uintptr_t) adder->next));
+}
+
+/* Migration stops while the table is walked, so resources added from the
+ * callbacks grow the table again while the entries of the previous table
+ * are still waiting to be moved.  Deleted slots make the first grow pick a
+ * table only just big enough for the live entries, so the second has to
+ * place more entries than fit into the table it replaces. */
+static void
+resource_add_while_walking(void)
+{
+    struct walk_adder adder;
+    RESTYPE a;
+    XID id;
+    int found = 0;
+
+    resource_init();
+    a = CreateNewResourceType(delete_resource, "TestWalked");
+    adder.type = CreateNewResourceType(delete_resource, "TestAdded");
+
+    for (id = FIRST_ID; id < FIRST_ID + 44; id++)
+        assert(AddResource(id, a, (void *) (uintptr_t) id));
+    for (id = FIRST_ID; id < FIRST_ID + 40; id += 5)
+        FreeResource(id, X11_RESTYPE_NONE);
+    assert(deleted == 8);
+
+    adder.next = FIRST_ID + 44;
+    adder.end = FIRST_ID + 5000;
+    FindClientResourcesByType(serverClient, a, add_while_walking, &adder);
+    assert(adder.next == adder.end);
+
+    for (id = FIRST_ID; id < FIRST_ID + 44; id++) {
+        Bool freed = id < FIRST_ID + 40 && (id - FIRST_ID) % 5 == 0;
+
+        assert(lookup(id, a) == (freed ? NULL : (void *) (uintptr_t) id));
+    }
+    for (; id < adder.end; id++)
+        assert(lookup(id, adder.type) == (void *) (uintptr_t) id);
+
+    FindClientResourcesByType(serverClient, adder.type, count_resource,
+                              &found);
+    assert(found == adder.end - FIRST_ID - 44);
+
+    FreeClientResources(serverClient);
+    assert(deleted == adder.end - FIRST_ID);
+}
+
+const testfunc_t*
+resource_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        resource_add_lookup_free,
+        resource_same_id_order,
+        resource_free_client,
+        resource_add_while_walking,
+        NULL,
+    };
+    return testfuncs;
+}
@@ -0,0 +1,297 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Selections are hashed by their atom, and the owned ones indexed by owner
+ * client and window.  Lookups have to keep finding every selection as the
+ * tables grow, and closing a client or destroying a window has to disown
+ * exactly the selections it owned and no others.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/X.h>
+#include <X11/Xproto.h>
+
+#include "dix/atom_priv.h"
+#include "dix/dix_priv.h"
+#include "dix/dispatch.h"
+#include "dix/selection_priv.h"
+
+#include "dixstruct.h"
+#include "resource.h"
+#include "windowstr.h"
+
+#include "tests-common.h"
+
+#define SELECTIONS 1000         /* enough to grow the tables five times */
+#define CLIENTS 8
+#define WINDOWS 32
+#define NOBODY -1
+
+static ClientRec server_client;
+static ClientRec test_clients[CLIENTS];
+static WindowRec windows[WINDOWS];
+static HWEventQueueType input_queue;
+
+static Atom names[SELECTIONS];
+static Selection *selections[SELECTIONS];
+/* who should own each selection, NOBODY or an index into the above */
+static int owner_client[SELECTIONS], owner_window[SELECTIONS];
+static int disowned;
+
+/* the test clients have no connection for SelectionClear to go to */
+static void
+selection_filter(CallbackListPtr *pcbl, void *unused, void *calldata)
+{
+    SelectionFilterParamPtr param = calldata;
+
+    if (param->op == SELECTION_FILTER_EV_CLEAR)
+        param->recvClient = serverClient;
+}
+
+static void
+selection_callback(CallbackListPtr *pcbl, void *unused, void *calldata)
+{
+    SelectionInfoRec *info = calldata;
+
+    if (info->kind != SelectionSetOwner)
+        disowned++;
+}
+
+static void
+selection_init(void)
+{
+    char name[32];
+    int i;
+
+    dixResetPrivates();
+    InitAtoms();
+    InitSelections();
+
+    serverClient = &server_client;
+    InitClient(serverClient, 0, (void *) NULL);
+    assert(InitClientResources(serverClient));
+
+    /* UpdateCurrentTime() looks for pending input */
+    SetInputCheck(&input_queue, &input_queue);
+
+    for (i = 0; i < CLIENTS; i++)
+        test_clients[i] = (ClientRec) { .index = i + 1 };
+
+    for (i = 0; i < WINDOWS; i++) {
+        windows[i].drawable.type = DRAWABLE_WINDOW;
+        windows[i].drawable.id = i + 1;
+        assert(AddResource(windows[i].drawable.id, X11_RESTYPE_WINDOW,
+                           &windows[i]));
+    }
+
+    for (i = 0; i < SELECTIONS; i++) {
+        snprintf(name, sizeof(name), "SELECTION_%d", i);
+        names[i] = dixAddAtom(name);
+        selections[i] = NULL;
+        owner_client[i] = owner_window[i] = NOBODY;
+    }
+
+    assert(AddCallback(&SelectionFilterCallback, selection_filter, NULL));
+    assert(AddCallback(&SelectionCallback, selection_callback, NULL));
+    disowned = 0;
+}
+
+static void
+selection_fini(void)
+{
+    int i;
+
+    DeleteCallback(&SelectionFilterCallback, selection_filter, NULL);
+    DeleteCallback(&SelectionCallback, selection_callback, NULL);
+
+    /* without calling DeleteWindow() on them */
+    for (i = 0; i < WINDOWS; i++)
+        FreeResource(windows[i].drawable.id, X11_RESTYPE_WINDOW);
+
+    InitSelections();
+}
+
+static Selection *
+selection_lookup(int sel)
+{
+    Selection *pSel;
+
+    assert(dixLookupSelection(&pSel, names[sel], &test_clients[0],
+                              DixGetAttrAccess) == Success);
+    assert(pSel->selection == names[sel]);
+    /* found again, not made up anew */
+    if (selections[sel])
+        assert(pSel == selections[sel]);
+    selections[sel] = pSel;
+    return pSel;
+}
+
+static void
+selection_set_owner(int sel, int client, int window)
+{
+    xSetSelectionOwnerReq req = {
+        .reqType = X_SetSelectionOwner,
+        .length = sizeof(req) >> 2,
+        .window = window == NOBODY ? None : windows[window].drawable.id,
+        .selection = names[sel],
+        .time = CurrentTime,
+    };
+    ClientPtr pClient = &test_clients[client];
+
+    pClient->requestBuffer = &req;
+    pClient->req_len = req.length;
+    assert(ProcSetSelectionOwner(pClient) == Success);
+
+    owner_client[sel] = window == NOBODY ? NOBODY : client;
+    owner_window[sel] = window;
+}
+
+static void
+assert_selection(int sel)
+{
+    Selection *pSel = selection_lookup(sel);
+
+    if (owner_window[sel] == NOBODY) {
+        assert(pSel->window == None);
+        assert(!pSel->pWin && !pSel->client);
+    }
+    else {
+        WindowPtr pWin = &windows[owner_window[sel]];
+
+        assert(pSel->window == pWin->drawable.id);
+        assert(pSel->pWin == pWin);
+        assert(pSel->client == &test_clients[owner_client[sel]]);
+    }
+}
+
+static void
+assert_selections(int count)
+{
+    Selection *pSel;
+    int i, listed = 0;
+
+    for (i = 0; i < count; i++)
+        assert_selection(i);
+
+    for (pSel = CurrentSelections; pSel; pSel = pSel->next)
+        listed++;
+    assert(listed == count);
+}
+
+static void
+selection_close_client(int client)
+{
+    int i, owned = 0;
+
+    disowned = 0;
+    DeleteClientFromAnySelections(&test_clients[client]);
+    for (i = 0; i < SELECTIONS; i++) {
+        if (owner_client[i] == client) {
+            owner_client[i] = owner_window[i] = NOBODY;
+            owned++;
+        }
+    }
+    assert(disowned == owned);
+}
+
+static void
+selection_destroy_window(int window)
+{
+    int i, owned = 0;
+
+    disowned = 0;
+    DeleteWindowFromAnySelections(&windows[window]);
+    for (i = 0; i < SELECTIONS; i++) {
+        if (owner_window[i] == window) {
+            owner_client[i] = owner_window[i] = NOBODY;
+            owned++;
+        }
+    }
+    assert(disowned == owned);
+}
+
+static void
+selection_grow_test(void)
+{
+    int i;
+
+    selection_init();
+
+    for (i = 0; i < SELECTIONS; i++) {
+        selection_lookup(i);
+        /* some owned already while the tables grow */
+        if (i % 3 == 0)
+            selection_set_owner(i, random() % CLIENTS, random() % WINDOWS);
+        /* around every time the tables double */
+        if ((i & (i - 1)) == 0 || ((i + 1) & i) == 0)
+            assert_selections(i + 1);
+    }
+    assert_selections(SELECTIONS);
+
+    /* the owners are still found through the rebuilt window table */
+    for (i = 0; i < WINDOWS; i++) {
+        selection_destroy_window(i);
+        assert_selections(SELECTIONS);
+    }
+
+    selection_fini();
+}
+
+static void
+selection_teardown_test(void)
+{
+    int i;
+
+    selection_init();
+
+    for (i = 0; i < SELECTIONS; i++)
+        selection_lookup(i);
+
+    for (i = 0; i < 5000; i++) {
+        int sel = random() % SELECTIONS;
+
+        switch (random() % 20) {
+        case 0:
+            selection_close_client(random() % CLIENTS);
+            assert_selections(SELECTIONS);
+            break;
+        case 1:
+            selection_destroy_window(random() % WINDOWS);
+            assert_selections(SELECTIONS);
+            break;
+        case 2:
+            selection_set_owner(sel, random() % CLIENTS, NOBODY);
+            assert_selection(sel);
+            break;
+        default:
+            /* often taking it over from another owner */
+            selection_set_owner(sel, random() % CLIENTS, random() % WINDOWS);
+            assert_selection(sel);
+            break;
+        }
+    }
+
+    for (i = 0; i < CLIENTS; i++)
+        selection_close_client(i);
+    assert_selections(SELECTIONS);
+
+    selection_fini();
+}
+
+const testfunc_t*
+selection_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        selection_grow_test,
+        selection_teardown_test,
+        NULL,
+    };
+
+    return testfuncs;
+}
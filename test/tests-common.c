@@ -2,6 +2,7 @@
 #include <sys/wait.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "tests-common.h"
@@ -38,3 +39,53 @@ run_test_in_child(const testfunc_t* (*suite)(void), const char *funcname)
     }
     printf(" Pass\n");
 }
+
+static uint64_t
+bench_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+uint64_t
+bench_time(int rounds, bench_func_t func, void *data)
+{
+    uint64_t start = bench_now_ns();
+    int i;
+
+    for (i = 0; i < rounds; i++)
+        func(i, data);
+    return bench_now_ns() - start;
+}
+
+uint64_t
+bench_best(int rounds, bench_func_t func, void *data)
+{
+    uint64_t best = UINT64_MAX;
+    int i;
+
+    for (i = 0; i < rounds; i++) {
+        uint64_t start = bench_now_ns(), elapsed;
+
+        func(i, data);
+        elapsed = bench_now_ns() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+const char *
+bench_kernel_name(KernelLevel level)
+{
+    static const char *names[] = {
+        [KERNELS_REFERENCE] = "reference",
+        [KERNELS_SCALAR] = "scalar",
+        [KERNELS_SSE2] = "sse2",
+        [KERNELS_AVX2] = "avx2",
+    };
+
+    return level < ARRAY_SIZE(names) ? names[level] : "?";
+}
@@ -1,6 +1,10 @@
 #ifndef TESTS_COMMON_H
 #define TESTS_COMMON_H
 
+#include <stdint.h>
+
+#include "os/kernels_priv.h"
+
 #include "tests.h"
 
 
@@ -10,4 +14,15 @@
 
 void run_test_in_child(const testfunc_t* (*func)(void), const char *funcname);
 
+typedef void (*bench_func_t)(int i, void *data);
+
+/* nanoseconds taken by calling func(i, data) for i from 0 to rounds - 1 */
+uint64_t bench_time(int rounds, bench_func_t func, void *data);
+
+/* nanoseconds taken by the fastest of rounds such calls */
+uint64_t bench_best(int rounds, bench_func_t func, void *data);
+
+/* what the benchmarks print for a kernel level */
+const char *bench_kernel_name(KernelLevel level);
+
 #endif /* TESTS_COMMON_H */
@@ -0,0 +1,369 @@
+/* SPDX-License-Identifier: MIT OR X11
+ *
+ * Windows with many children find the children under a point through a
+ * grid, which has to be thrown away whenever the children are restacked,
+ * reparented or destroyed, or their borders change.  Mapping leaves the
+ * grid alone, but the topmost mapped child must still come out on top.
+ */
+
+/* Test relies on assert() */
+#undef NDEBUG
+
+#include <dix-config.h>
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <X11/X.h>
+
+#include "dix/window_priv.h"
+#include "mi/mi_priv.h"
+
+#include "dixstruct.h"
+#include "inputstr.h"
+#include "scrnintstr.h"
+#include "windowstr.h"
+
+#include "tests-common.h"
+
+#define CHILDREN 64
+#define AREA 400                /* of each parent, holding its children */
+#define STEP 4                  /* between the points looked up */
+
+static ScreenRec screen;
+static WindowOptRec optional;
+static WindowRec root;
+static ClientRec client;
+static DeviceIntRec device;
+static DeviceIntPtr saved_pointer, saved_keyboard;
+static Window last_wid;
+
+static Bool
+window_create_hook(WindowPtr pWin)
+{
+    return TRUE;
+}
+
+static void
+window_init(void)
+{
+    BoxRec box = { 0, 0, AREA * 2, AREA * 2 };
+
+    memset(&screen, 0, sizeof(screen));
+    screen.CreateWindow = window_create_hook;
+    screen.MoveWindow = miMoveWindow;
+    screen.ChangeBorderWidth = miChangeBorderWidth;
+
+    optional.visual = 0x21;
+    optional.colormap = 0x20;
+
+    memset(&root, 0, sizeof(root));
+    root.drawable.type = DRAWABLE_WINDOW;
+    root.drawable.class = InputOutput;
+    root.drawable.depth = 24;
+    root.drawable.bitsPerPixel = 32;
+    root.drawable.id = last_wid = 0x100;
+    root.drawable.width = root.drawable.height = AREA * 2;
+    root.drawable.pScreen = &screen;
+    root.optional = &optional;
+    root.borderIsPixel = TRUE;
+    RegionInit(&root.winSize, &box, 1);
+    RegionInit(&root.borderSize, &box, 1);
+    screen.root = &root;
+
+    /* DeleteWindow() looks for grabs on the core devices */
+    saved_pointer = inputInfo.pointer;
+    saved_keyboard = inputInfo.keyboard;
+    inputInfo.pointer = inputInfo.keyboard = &device;
+}
+
+static void
+window_fini(void)
+{
+    WindowPtr pParent;
+
+    while ((pParent = root.firstChild)) {
+        while (pParent->firstChild)
+            DeleteWindow(pParent->firstChild, pParent->firstChild->drawable.id);
+        DeleteWindow(pParent, pParent->drawable.id);
+    }
+    RegionUninit(&root.winSize);
+    RegionUninit(&root.borderSize);
+
+    inputInfo.pointer = saved_pointer;
+    inputInfo.keyboard = saved_keyboard;
+}
+
+static WindowPtr
+window_create(WindowPtr pParent, int x, int y, int w, int h, int bw)
+{
+    WindowPtr pWin;
+    int error;
+
+    pWin = dixCreateWindow(++last_wid, pParent, x, y, w, h, bw, InputOutput,
+                           0, NULL, 0, &client, CopyFromParent, &error);
+    assert(pWin && error == Success);
+    return pWin;
+}
+
+/* overlapping here and there, but not enough to give up on the grid */
+static WindowPtr
+window_parent(int x, int y)
+{
+    WindowPtr pParent = window_create(&root, x, y, AREA, AREA, 0);
+    int i;
+
+    for (i = 0; i < CHILDREN; i++) {
+        WindowPtr pChild = window_create(pParent,
+                                         random() % (AREA - 60),
+                                         random() % (AREA - 60),
+                                         random() % 50 + 10,
+                                         random() % 50 + 10,
+                                         random() % 3);
+
+        assert(MapWindow(pChild, &client) == Success);
+    }
+    return pParent;
+}
+
+static int
+window_count(WindowPtr pParent)
+{
+    WindowPtr pChild;
+    int count = 0;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib)
+        count++;
+    return count;
+}
+
+static WindowPtr
+window_random_child(WindowPtr pParent)
+{
+    WindowPtr pChild = pParent->firstChild;
+    int i = random() % window_count(pParent);
+
+    while (i--)
+        pChild = pChild->nextSib;
+    return pChild;
+}
+
+static Bool
+window_is_child(WindowPtr pParent, WindowPtr pWin)
+{
+    WindowPtr pChild;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib)
+        if (pChild == pWin)
+            return TRUE;
+    return FALSE;
+}
+
+static Bool
+window_contains(WindowPtr pWin, int x, int y)
+{
+    int bw = wBorderWidth(pWin);
+
+    return x >= pWin->drawable.x - bw &&
+        x < pWin->drawable.x + (int) pWin->drawable.width + bw &&
+        y >= pWin->drawable.y - bw &&
+        y < pWin->drawable.y + (int) pWin->drawable.height + bw;
+}
+
+/* the topmost mapped child at (x, y), from the grid as miSpriteTrace() does */
+static WindowPtr
+window_pick(WindowPtr pParent, int x, int y)
+{
+    WindowPtr *candidates;
+    int count, i;
+
+    candidates = dixWindowChildrenAt(pParent, x, y, &count);
+    if (!candidates)
+        return NULL;
+
+    for (i = 0; i < count; i++) {
+        /* not one that has gone elsewhere or been destroyed */
+        assert(window_is_child(pParent, candidates[i]));
+        if (candidates[i]->mapped && window_contains(candidates[i], x, y))
+            return candidates[i];
+    }
+    return NULL;
+}
+
+static WindowPtr
+window_walk(WindowPtr pParent, int x, int y)
+{
+    WindowPtr pChild;
+
+    for (pChild = pParent->firstChild; pChild; pChild = pChild->nextSib)
+        if (pChild->mapped && window_contains(pChild, x, y))
+            return pChild;
+    return NULL;
+}
+
+static Bool
+window_indexed(WindowPtr pParent)
+{
+    int count;
+
+    return dixWindowChildrenAt(pParent, 0, 0, &count) != NULL;
+}
+
+static void
+assert_children(WindowPtr pParent)
+{
+    int x, y;
+
+    if (!window_indexed(pParent))
+        return;
+
+    for (y = -STEP; y < AREA + STEP; y += STEP) {
+        for (x = -STEP; x < AREA + STEP; x += STEP) {
+            int sx = pParent->drawable.x + x, sy = pParent->drawable.y + y;
+
+            assert(window_pick(pParent, sx, sy) ==
+                   window_walk(pParent, sx, sy));
+        }
+    }
+}
+
+static void
+window_restack_test(void)
+{
+    WindowPtr pParent;
+    int i;
+
+    window_init();
+    pParent = window_parent(30, 20);
+    assert(window_indexed(pParent));
+    assert_children(pParent);
+
+    for (i = 0; i < 100; i++) {
+        XID mode = random() % 2 ? Above : Below;
+
+        assert(ConfigureWindow(window_random_child(pParent), CWStackMode,
+                               &mode, &client) == Success);
+        assert_children(pParent);
+    }
+
+    window_fini();
+}
+
+static void
+window_reparent_test(void)
+{
+    WindowPtr pParents[2];
+    int i;
+
+    window_init();
+    pParents[0] = window_parent(0, 0);
+    pParents[1] = window_parent(AREA / 2, AREA / 3);
+    assert(window_indexed(pParents[0]) && window_indexed(pParents[1]));
+
+    for (i = 0; i < 100; i++) {
+        /* back and forth, so that both stay big enough for a grid */
+        WindowPtr pFrom = pParents[i % 2], pTo = pParents[!(i % 2)];
+
+        assert(ReparentWindow(window_random_child(pFrom), pTo,
+                              random() % (AREA - 60), random() % (AREA - 60),
+                              &client) == Success);
+        assert_children(pFrom);
+        assert_children(pTo);
+    }
+
+    window_fini();
+}
+
+static void
+window_destroy_test(void)
+{
+    WindowPtr pParent, pChild;
+
+    window_init();
+    pParent = window_parent(10, 40);
+    assert(window_indexed(pParent));
+
+    /* down to too few children for a grid */
+    while (pParent->firstChild) {
+        pChild = window_random_child(pParent);
+        assert(DeleteWindow(pChild, pChild->drawable.id) == Success);
+        assert_children(pParent);
+    }
+    assert(!window_indexed(pParent));
+
+    window_fini();
+}
+
+static void
+window_map_test(void)
+{
+    WindowPtr pParent, pChild;
+    int i;
+
+    window_init();
+    pParent = window_parent(50, 0);
+    assert(window_indexed(pParent));
+
+    for (i = 0; i < 200; i++) {
+        pChild = window_random_child(pParent);
+        if (pChild->mapped)
+            assert(UnmapWindow(pChild, FALSE) == Success);
+        else
+            assert(MapWindow(pChild, &client) == Success);
+        assert_children(pParent);
+    }
+
+    window_fini();
+}
+
+static void
+window_border_test(void)
+{
+    WindowPtr pParent, pChild;
+    int i;
+
+    window_init();
+    pParent = window_parent(0, 30);
+    assert(window_indexed(pParent));
+
+    for (i = 0; i < 100; i++) {
+        XID bw = random() % 6;
+
+        pChild = window_random_child(pParent);
+        if (i % 2) {
+            /* keeping the outer corner, through MoveWindow */
+            assert(ConfigureWindow(pChild, CWBorderWidth, &bw,
+                                   &client) == Success);
+        }
+        else {
+            /* keeping the inside, through ChangeBorderWidth */
+            XID values[] = {
+                pChild->drawable.x - pParent->drawable.x - bw,
+                pChild->drawable.y - pParent->drawable.y - bw,
+                bw,
+            };
+
+            assert(ConfigureWindow(pChild, CWX | CWY | CWBorderWidth, values,
+                                   &client) == Success);
+        }
+        assert(pChild->borderWidth == bw);
+        assert_children(pParent);
+    }
+
+    window_fini();
+}
+
+const testfunc_t*
+window_test(void)
+{
+    static const testfunc_t testfuncs[] = {
+        window_restack_test,
+        window_reparent_test,
+        window_destroy_test,
+        window_map_test,
+        window_border_test,
+        NULL,
+    };
+
+    return testfuncs;
+}